@@ -0,0 +1,166 @@
+#include "AsyncMemcpy.h"
+#include "atomic.h"
+
+#include <algorithm>
+
+const unsigned int AsyncMemcpy::MAX_STREAMS;
+const unsigned int AsyncMemcpy::QUEUE_SIZE;
+const unsigned int AsyncMemcpy::MAX_COUNT;
+const unsigned int AsyncMemcpy::FIFO_BYTES;
+
+AsyncMemcpy::AsyncMemcpy() :
+    mStreamCount(0)
+{
+}
+
+void AsyncMemcpy::addStream(Dma::Stream *stream)
+{
+    if (stream == nullptr || mStreamCount >= MAX_STREAMS) return;
+    Runner& runner = mRunners[mStreamCount];
+    runner.mStream = stream;
+    runner.mBusy = false;
+    runner.mPartLen = 0;
+    runner.mPattern = 0;
+    // no direct mode from memory to memory
+    stream->configFifo(Dma::Stream::FifoThreshold::Full);
+    stream->setCallback(this);
+    ++mStreamCount;
+}
+
+bool AsyncMemcpy::memcpy(void *dest, const void *src, unsigned int len, System::Event *event)
+{
+    Job job = { static_cast<uint8_t*>(dest), static_cast<const uint8_t*>(src), len, event, false, 0 };
+    return add(job);
+}
+
+bool AsyncMemcpy::memset(void *dest, uint8_t value, unsigned int len, System::Event *event)
+{
+    Job job = { static_cast<uint8_t*>(dest), nullptr, len, event, true, value };
+    return add(job);
+}
+
+bool AsyncMemcpy::idle()
+{
+    uint32_t mask = interrupt_disable();
+    bool idle = mQueue.used() == 0;
+    for (unsigned int i = 0; i < mStreamCount; ++i) idle = idle && !mRunners[i].mBusy;
+    interrupt_restore(mask);
+    return idle;
+}
+
+AsyncMemcpy::Part AsyncMemcpy::nextPart(uint32_t dest, uint32_t src, unsigned int len, bool fill)
+{
+    // the source of a fill doesn't move
+    uint32_t align = fill ? dest : dest | src;
+    Part part;
+    if ((align & 3) == 0 && len >= 4) part.mDataSize = Dma::Stream::DataSize::Word;
+    else if ((align & 1) == 0 && len >= 2) part.mDataSize = Dma::Stream::DataSize::HalfWord;
+    else part.mDataSize = Dma::Stream::DataSize::Byte;
+    unsigned int shift = static_cast<unsigned int>(part.mDataSize);
+    part.mCount = std::min(len >> shift, MAX_COUNT);
+
+    // Where both ends get to the alignment of a burst together, a short head takes them there.
+    uint32_t head = (FIFO_BYTES - (dest & (FIFO_BYTES - 1))) & (FIFO_BYTES - 1);
+    if (head != 0 && (fill || ((dest ^ src) & (FIFO_BYTES - 1)) == 0) && len >= head + FIFO_BYTES)
+    {
+        part.mCount = std::min(part.mCount, head >> shift);
+    }
+
+    // A burst fills the FIFO, and must not cross a 1KB boundary. Aligned to its size it can't, the rest
+    // of the count is left for the next part.
+    unsigned int beats = FIFO_BYTES >> shift;
+    part.mBurst = Dma::Stream::BurstLength::Single;
+    if ((align & (FIFO_BYTES - 1)) == 0 && part.mCount >= beats)
+    {
+        part.mBurst = beats == 4 ? Dma::Stream::BurstLength::Beats4 : beats == 8 ? Dma::Stream::BurstLength::Beats8 : Dma::Stream::BurstLength::Beats16;
+        part.mCount -= part.mCount % beats;
+    }
+    return part;
+}
+
+void AsyncMemcpy::dmaCallback(Dma::Stream *stream, Dma::Stream::Callback::Reason reason)
+{
+    for (unsigned int i = 0; i < mStreamCount; ++i)
+    {
+        Runner& runner = mRunners[i];
+        if (runner.mStream != stream || !runner.mBusy) continue;
+        Job& job = runner.mJob;
+        if (reason == Reason::TransferComplete)
+        {
+            job.mDest += runner.mPartLen;
+            if (!job.mFill) job.mSrc += runner.mPartLen;
+            job.mLen -= runner.mPartLen;
+            if (job.mLen > 0)
+            {
+                startPart(runner);
+                return;
+            }
+            if (job.mEvent != nullptr) job.mEvent->setResult(System::Event::Result::Success);
+        }
+        else
+        {
+            // the stream is stopped, the rest of the job is left
+            if (job.mEvent != nullptr) job.mEvent->setResult(System::Event::Result::DataFail);
+        }
+        if (job.mEvent != nullptr) System::instance()->postEvent(job.mEvent);
+        runner.mBusy = false;
+        if (mQueue.pop(job)) startJob(runner);
+        return;
+    }
+}
+
+bool AsyncMemcpy::add(const AsyncMemcpy::Job &job)
+{
+    if (job.mLen == 0)
+    {
+        if (job.mEvent != nullptr)
+        {
+            job.mEvent->setResult(System::Event::Result::Success);
+            System::instance()->postEvent(job.mEvent);
+        }
+        return true;
+    }
+    // the interrupt of a stream takes the next job as well
+    uint32_t mask = interrupt_disable();
+    bool success = false;
+    for (unsigned int i = 0; i < mStreamCount && !success; ++i)
+    {
+        if (!mRunners[i].mBusy && mQueue.used() == 0)
+        {
+            mRunners[i].mJob = job;
+            startJob(mRunners[i]);
+            success = true;
+        }
+    }
+    if (!success) success = mQueue.push(job);
+    interrupt_restore(mask);
+    return success;
+}
+
+void AsyncMemcpy::startJob(AsyncMemcpy::Runner &runner)
+{
+    runner.mBusy = true;
+    if (runner.mJob.mFill)
+    {
+        // the DMA reads the value from there, whatever data size it uses
+        runner.mPattern = 0x01010101u * runner.mJob.mValue;
+        runner.mJob.mSrc = reinterpret_cast<const uint8_t*>(&runner.mPattern);
+    }
+    startPart(runner);
+}
+
+void AsyncMemcpy::startPart(AsyncMemcpy::Runner &runner)
+{
+    Job& job = runner.mJob;
+    Part part = nextPart(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(job.mDest)), static_cast<uint32_t>(reinterpret_cast<uintptr_t>(job.mSrc)), job.mLen, job.mFill);
+    runner.mPartLen = part.bytes();
+    Dma::Stream* stream = runner.mStream;
+    // the source is on the peripheral port, which takes the data size of the memory port
+    stream->config(Dma::Stream::Direction::MemoryToMemory, !job.mFill, true, part.mDataSize, part.mDataSize, job.mFill ? Dma::Stream::BurstLength::Single : part.mBurst, part.mBurst);
+    stream->setAddress(Dma::Stream::End::MemoryToMemorySource, reinterpret_cast<System::BaseAddress>(job.mSrc));
+    stream->setAddress(Dma::Stream::End::MemoryToMemoryDestination, reinterpret_cast<System::BaseAddress>(job.mDest));
+    stream->setTransferCount(part.mCount);
+    stream->start();
+}
+
+template class StaticCircularBuffer<AsyncMemcpy::Job, AsyncMemcpy::QUEUE_SIZE>;
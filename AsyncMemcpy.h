@@ -0,0 +1,81 @@
+#ifndef ASYNCMEMCPY_H
+#define ASYNCMEMCPY_H
+
+#include "Dma.h"
+#include "StaticCircularBuffer.h"
+
+#include <cstdint>
+
+// Copies and fills memory with the memory to memory streams of DMA2 while the CPU goes on, DMA1 can't do
+// that. Jobs wait in a queue, the next free stream takes them in order and the event of a job is posted
+// when it is done, with DataFail if the DMA had a bus error. The widest data size and burst the alignment
+// allows are used, a job runs in several parts when it is longer than NDTR can count, has unaligned ends
+// or needs a head to get to the alignment of a burst.
+// The DMA can't get to the CCM RAM at 0x10000000 where the stack is, the data has to be on the heap or
+// static, the flash works as source.
+class AsyncMemcpy : public Dma::Stream::Callback
+{
+public:
+    static const unsigned int MAX_STREAMS = 2;
+    static const unsigned int QUEUE_SIZE = 16;
+    // what NDTR can count
+    static const unsigned int MAX_COUNT = 0xffff;
+    // the DMA FIFO, a burst fills it up
+    static const unsigned int FIFO_BYTES = Dma::Stream::FIFO_BYTES;
+
+    struct Part
+    {
+        Dma::Stream::DataSize mDataSize;
+        Dma::Stream::BurstLength mBurst;
+        // in mDataSize units
+        unsigned int mCount;
+
+        unsigned int bytes() const { return mCount << static_cast<unsigned int>(mDataSize); }
+    };
+
+    AsyncMemcpy();
+
+    // a stream of DMA2 with its interrupt, all of them are set up for memory to memory
+    void addStream(Dma::Stream* stream);
+
+    bool memcpy(void* dest, const void* src, unsigned int len, System::Event* event);
+    bool memset(void* dest, uint8_t value, unsigned int len, System::Event* event);
+    // no jobs waiting or running
+    bool idle();
+
+    // the part a job of len bytes left starts with
+    static Part nextPart(uint32_t dest, uint32_t src, unsigned int len, bool fill);
+
+    virtual void dmaCallback(Dma::Stream* stream, Reason reason);
+
+private:
+    struct Job
+    {
+        uint8_t* mDest;
+        const uint8_t* mSrc;
+        unsigned int mLen;
+        System::Event* mEvent;
+        bool mFill;
+        uint8_t mValue;
+    };
+
+    struct Runner
+    {
+        Dma::Stream* mStream;
+        Job mJob;
+        bool mBusy;
+        unsigned int mPartLen;
+        // the source of a fill, the value in every byte
+        uint32_t mPattern;
+    };
+
+    StaticCircularBuffer<Job, QUEUE_SIZE> mQueue;
+    Runner mRunners[MAX_STREAMS];
+    unsigned int mStreamCount;
+
+    bool add(const Job& job);
+    void startJob(Runner& runner);
+    void startPart(Runner& runner);
+};
+
+#endif // ASYNCMEMCPY_H
@@ -0,0 +1,173 @@
+#include "BipBuffer.h"
+#include "atomic.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+template<typename T>
+BipBuffer<T>::BipBuffer(unsigned int size) :
+    mSize(size),
+    mBuffer(new T[size]),
+    mAStart(0),
+    mAEnd(0),
+    mBEnd(0),
+    mBInUse(false),
+    mReserveB(false),
+    mReserveStart(0),
+    mReserved(0)
+{
+}
+
+template<typename T>
+BipBuffer<T>::~BipBuffer()
+{
+    delete[] mBuffer;
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::used()
+{
+    uint32_t primask = interrupt_disable();
+    unsigned int used = mAEnd - mAStart + mBEnd;
+    interrupt_restore(primask);
+    return used;
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::free()
+{
+    uint32_t primask = interrupt_disable();
+    unsigned int free = mBInUse ? mAStart - mBEnd : mSize - mAEnd + mAStart;
+    interrupt_restore(primask);
+    return free;
+}
+
+template<typename T>
+bool BipBuffer<T>::push(T elem)
+{
+    return write(&elem, 1) == 1;
+}
+
+template<typename T>
+bool BipBuffer<T>::pop(T &elem)
+{
+    return read(&elem, 1) == 1;
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::write(const T *data, unsigned int len)
+{
+    unsigned int totalLen = 0;
+    while (len > 0)
+    {
+        T* dest;
+        unsigned int partLen = reserve(dest, len);
+        if (partLen == 0) break;
+        std::memcpy(dest, data, partLen * sizeof(T));
+        commit(partLen);
+        data += partLen;
+        len -= partLen;
+        totalLen += partLen;
+    }
+    return totalLen;
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::read(T *data, unsigned int len)
+{
+    unsigned int totalLen = 0;
+    while (len > 0)
+    {
+        const T* src;
+        unsigned int partLen = std::min(peek(src), len);
+        if (partLen == 0) break;
+        std::memcpy(data, src, partLen * sizeof(T));
+        release(partLen);
+        data += partLen;
+        len -= partLen;
+        totalLen += partLen;
+    }
+    return totalLen;
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::reserve(T *&data, unsigned int len)
+{
+    unsigned int free;
+    uint32_t primask = interrupt_disable();
+    if (mBInUse)
+    {
+        mReserveB = true;
+        free = mAStart - mBEnd;
+    }
+    else
+    {
+        unsigned int behindA = mSize - mAEnd;
+        // B can only start once there is something read from A
+        mReserveB = behindA < len && behindA < mAStart;
+        free = mReserveB ? mAStart : behindA;
+    }
+    mReserveStart = mReserveB ? mBEnd : mAEnd;
+    mReserved = std::min(free, len);
+    data = mBuffer + mReserveStart;
+    interrupt_restore(primask);
+    return mReserved;
+}
+
+template<typename T>
+void BipBuffer<T>::commit(unsigned int len)
+{
+    uint32_t primask = interrupt_disable();
+    // if A got read up in the meantime, B became A
+    if (mReserveB && mBEnd == mReserveStart && (mBInUse || mReserveStart == 0))
+    {
+        mBEnd += len;
+        mBInUse = mBEnd != 0;
+        if (mAStart == mAEnd) swap();
+    }
+    else
+    {
+        mAEnd += len;
+    }
+    mReserved = 0;
+    interrupt_restore(primask);
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::peek(const T *&data)
+{
+    uint32_t primask = interrupt_disable();
+    data = mBuffer + mAStart;
+    unsigned int len = mAEnd - mAStart;
+    interrupt_restore(primask);
+    return len;
+}
+
+template<typename T>
+unsigned int BipBuffer<T>::release(unsigned int len)
+{
+    uint32_t primask = interrupt_disable();
+    len = std::min(len, mAEnd - mAStart);
+    mAStart += len;
+    if (mAStart == mAEnd)
+    {
+        if (mBInUse) swap();
+        // all free, unless the producer is still writing behind A
+        else if (mReserved == 0) mAStart = mAEnd = 0;
+    }
+    interrupt_restore(primask);
+    return len;
+}
+
+template<typename T>
+void BipBuffer<T>::swap()
+{
+    mAStart = 0;
+    mAEnd = mBEnd;
+    mBEnd = 0;
+    mBInUse = false;
+}
+
+template class BipBuffer<char>;
+template class BipBuffer<uint16_t>;
@@ -0,0 +1,49 @@
+#ifndef BIPBUFFER_H
+#define BIPBUFFER_H
+
+#include "Fifo.h"
+
+// Bipartite buffer: the data is kept in up to two regions, A and behind it in time B at the start of the
+// memory, instead of wrapping around at the end of the memory. A reservation that doesn't fit behind A
+// starts B, so whatever gets written or reserved in one piece stays contiguous and peek() returns all
+// of A, which is what a DMA transfer needs. The price is the space left at the end of A until A is read.
+// Producer and consumer may be on different interrupt levels, the regions only change with interrupts disabled.
+template<typename T>
+class BipBuffer : public Fifo<T>
+{
+public:
+    BipBuffer(unsigned int size);
+    virtual ~BipBuffer();
+
+    virtual unsigned int used();
+    virtual unsigned int free();
+    unsigned int size() { return mSize; }
+
+    virtual bool push(T elem);
+    virtual bool pop(T &elem);
+    virtual unsigned int write(const T* data, unsigned int len);
+    virtual unsigned int read(T* data, unsigned int len);
+
+    // the place that fits len, or the larger one if none does
+    virtual unsigned int reserve(T*& data, unsigned int len = ~0u);
+    virtual void commit(unsigned int len);
+    virtual unsigned int peek(const T*& data);
+    virtual unsigned int release(unsigned int len);
+
+private:
+    unsigned int mSize;
+    T* mBuffer;
+    volatile unsigned int mAStart;
+    volatile unsigned int mAEnd;
+    volatile unsigned int mBEnd;
+    volatile bool mBInUse;
+    // the last reserve(), behind A or behind B, mReserved is 0 once it got committed
+    bool mReserveB;
+    unsigned int mReserveStart;
+    volatile unsigned int mReserved;
+
+    // A is read, B takes its place
+    void swap();
+};
+
+#endif // BIPBUFFER_H
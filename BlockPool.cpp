@@ -0,0 +1,85 @@
+#include "BlockPool.h"
+#include "atomic.h"
+
+const unsigned int BlockPool::CLASS_COUNT;
+const unsigned int BlockPool::MIN_BLOCK_SHIFT;
+const unsigned int BlockPool::MAX_BLOCK_SIZE;
+const unsigned int BlockPool::PAGE_SIZE;
+const unsigned int BlockPool::MAX_PAGES;
+
+unsigned int BlockPool::sizeClass(std::size_t size)
+{
+    if (size <= (1u << MIN_BLOCK_SHIFT)) return 0;
+    return 32 - __builtin_clz(static_cast<uint32_t>(size - 1)) - MIN_BLOCK_SHIFT;
+}
+
+void* BlockPool::alloc(std::size_t size)
+{
+    if (size > MAX_BLOCK_SIZE)
+    {
+        ++mLarge;
+        return nullptr;
+    }
+    unsigned int sizeClass = BlockPool::sizeClass(size);
+    uint32_t primask = interrupt_disable();
+    if (mFree[sizeClass] == nullptr && !grow(sizeClass))
+    {
+        interrupt_restore(primask);
+        return nullptr;
+    }
+    Block* block = mFree[sizeClass];
+    mFree[sizeClass] = block->mNext;
+    if (++mUsed[sizeClass] > mMaxUsed[sizeClass]) mMaxUsed[sizeClass] = mUsed[sizeClass];
+    interrupt_restore(primask);
+    return block;
+}
+
+bool BlockPool::free(void *mem)
+{
+    char* p = static_cast<char*>(mem);
+    if (mStart == nullptr || p < mStart) return false;
+    std::size_t page = (p - mStart) / PAGE_SIZE;
+    if (page >= MAX_PAGES || mPageClass[page] == 0) return false;
+    unsigned int sizeClass = mPageClass[page] - 1;
+    Block* block = static_cast<Block*>(mem);
+    uint32_t primask = interrupt_disable();
+    block->mNext = mFree[sizeClass];
+    mFree[sizeClass] = block;
+    --mUsed[sizeClass];
+    interrupt_restore(primask);
+    return true;
+}
+
+bool BlockPool::grow(unsigned int sizeClass)
+{
+    char* end = mSource(0);
+    if (end == nullptr) return false;
+    if (mStart == nullptr)
+    {
+        // the pages are counted from here, aligned like malloc() does
+        unsigned int pad = -reinterpret_cast<uintptr_t>(end) & 7;
+        if (pad != 0) mSource(pad);
+        mStart = end + pad;
+        end = mStart;
+    }
+    // malloc() takes from the same source, so skip to the next page boundary
+    unsigned int pad = (PAGE_SIZE - (end - mStart) % PAGE_SIZE) % PAGE_SIZE;
+    std::size_t page = (end + pad - mStart) / PAGE_SIZE;
+    if (page >= MAX_PAGES) return false;
+    char* start = mSource(pad + PAGE_SIZE);
+    if (start == nullptr) return false;
+    start += pad;
+
+    unsigned int size = blockSize(sizeClass);
+    // linked backwards, so the blocks get handed out in address order
+    for (unsigned int i = PAGE_SIZE / size; i > 0; --i)
+    {
+        Block* block = reinterpret_cast<Block*>(start + (i - 1) * size);
+        block->mNext = mFree[sizeClass];
+        mFree[sizeClass] = block;
+    }
+    mTotal[sizeClass] += PAGE_SIZE / size;
+    mPageClass[page] = sizeClass + 1;
+    ++mPages;
+    return true;
+}
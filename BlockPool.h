@@ -0,0 +1,73 @@
+#ifndef BLOCKPOOL_H
+#define BLOCKPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Allocator for small blocks in power of 2 size classes, every class has its own free list, so alloc()
+// and free() are O(1) and freed blocks are reused by the next block of the same class, which keeps the
+// heap from fragmenting.
+// Pages are taken from the source (System::increaseHeap() on the target) when a class runs out of blocks
+// and are never given back. A page table tells which class a block belongs to, so blocks don't carry a header.
+// The object has no state that needs construction at runtime, so it can serve operator new before the
+// static constructors ran.
+class BlockPool
+{
+public:
+    // hands out size bytes, with size 0 just the current end
+    typedef char* (*Source)(unsigned int size);
+
+    static const unsigned int CLASS_COUNT = 5;
+    static const unsigned int MIN_BLOCK_SHIFT = 4;
+    static const unsigned int MAX_BLOCK_SIZE = 1 << (MIN_BLOCK_SHIFT + CLASS_COUNT - 1);
+    static const unsigned int PAGE_SIZE = 1024;
+    static const unsigned int MAX_PAGES = 128;
+
+    constexpr BlockPool(Source source) :
+        mSource(source),
+        mStart(nullptr),
+        mPages(0),
+        mLarge(0),
+        mFree(),
+        mUsed(),
+        mMaxUsed(),
+        mTotal(),
+        mPageClass()
+    { }
+
+    // nullptr if the block is larger than MAX_BLOCK_SIZE or the page table is full
+    void* alloc(std::size_t size);
+    // false if the block is not from the pool
+    bool free(void* mem);
+
+    static unsigned int sizeClass(std::size_t size);
+    static unsigned int blockSize(unsigned int sizeClass) { return 1 << (MIN_BLOCK_SHIFT + sizeClass); }
+
+    unsigned int used(unsigned int sizeClass) const { return mUsed[sizeClass]; }
+    unsigned int maxUsed(unsigned int sizeClass) const { return mMaxUsed[sizeClass]; }
+    unsigned int total(unsigned int sizeClass) const { return mTotal[sizeClass]; }
+    unsigned int pages() const { return mPages; }
+    // number of blocks that were too large for the pool
+    unsigned int large() const { return mLarge; }
+
+private:
+    struct Block
+    {
+        Block* mNext;
+    };
+
+    Source mSource;
+    char* mStart;
+    unsigned int mPages;
+    unsigned int mLarge;
+    Block* mFree[CLASS_COUNT];
+    unsigned int mUsed[CLASS_COUNT];
+    unsigned int mMaxUsed[CLASS_COUNT];
+    unsigned int mTotal[CLASS_COUNT];
+    // class + 1 of each page, 0 for memory not belonging to the pool
+    uint8_t mPageClass[MAX_PAGES];
+
+    bool grow(unsigned int sizeClass);
+};
+
+#endif // BLOCKPOOL_H
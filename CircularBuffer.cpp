@@ -141,6 +141,15 @@ T *CircularBuffer<T>::bufferPointer()
     return mBuffer;
 }
 
+template<typename T>
+bool CircularBuffer<T>::rewind()
+{
+    if (used() != 0) return false;
+    mRead = mBuffer;
+    mWrite = mBuffer;
+    return true;
+}
+
 template<typename T>
 unsigned int CircularBuffer<T>::getContBuffer(const T *&data)
 {
@@ -160,6 +169,21 @@ unsigned int CircularBuffer<T>::skip(unsigned int len)
     return len;
 }
 
+template<typename T>
+unsigned int CircularBuffer<T>::reserve(T *&data, unsigned int len)
+{
+    data = const_cast<T*>(mWrite);
+    return std::min(static_cast<unsigned int>((mBuffer + mSize) - mWrite), std::min(len, free()));
+}
+
+template<typename T>
+void CircularBuffer<T>::commit(unsigned int len)
+{
+    mWrite += len;
+    align(mWrite);
+    atomic_add(&mUsed, len);
+}
+
 template<typename T>
 unsigned int CircularBuffer<T>::writePart(const T *data, unsigned int len)
 {
@@ -19,35 +19,47 @@
 #ifndef CIRCULARBUFFER_H
 #define CIRCULARBUFFER_H
 
+#include "Fifo.h"
+
 #include <algorithm>
 #include <cstring>
 
 template<typename T>
-class CircularBuffer
+class CircularBuffer : public Fifo<T>
 {
 public:
     CircularBuffer(unsigned int size);
-    ~CircularBuffer();
+    virtual ~CircularBuffer();
 
-    inline unsigned int used() { return mUsed;}
-    inline unsigned int free() { return mSize - used(); }
+    virtual unsigned int used() { return mUsed;}
+    virtual unsigned int free() { return mSize - used(); }
     inline unsigned int size() { return mSize; }
 
-    bool push(T elem);
-    bool pop(T &elem);
+    virtual bool push(T elem);
+    virtual bool pop(T &elem);
     bool front(T elem);
     bool back(T &elem);
-    unsigned int write(const T* data, unsigned int len);
-    unsigned int read(T* data, unsigned int len);
+    virtual unsigned int write(const T* data, unsigned int len);
+    virtual unsigned int read(T* data, unsigned int len);
     T operator[](int index);
 
     T *writePointer();
     T* readPointer();
     T* bufferPointer();
+    // starts over at the beginning of the memory, only when empty
+    bool rewind();
 
     unsigned int getContBuffer(const T*& data);
     unsigned int skip(unsigned int len);
 
+    // For writing in place, like DMA or a formatter does: the largest contiguous free part, at most len.
+    // What got written there becomes readable with commit().
+    virtual unsigned int reserve(T*& data, unsigned int len = ~0u);
+    virtual void commit(unsigned int len);
+    // the same for reading, the largest contiguous used part, release() frees it
+    virtual unsigned int peek(const T*& data) { return getContBuffer(data); }
+    virtual unsigned int release(unsigned int len) { return skip(len); }
+
 protected:
     unsigned int mSize;
     T* mBuffer;
@@ -0,0 +1,41 @@
+#include "Cobs.h"
+
+unsigned int Cobs::encode(const uint8_t *data, unsigned int len, uint8_t *out)
+{
+    // each block starts with the distance to the next 0, the 0 itself is left out
+    unsigned int code = 0;
+    unsigned int pos = 1;
+    uint8_t count = 1;
+    for (unsigned int i = 0; i < len; ++i)
+    {
+        if (data[i] != 0)
+        {
+            out[pos++] = data[i];
+            if (++count != 0xff) continue;
+        }
+        out[code] = count;
+        code = pos++;
+        count = 1;
+    }
+    out[code] = count;
+    return pos;
+}
+
+int Cobs::decode(const uint8_t *data, unsigned int len, uint8_t *out)
+{
+    unsigned int pos = 0;
+    unsigned int outPos = 0;
+    while (pos < len)
+    {
+        uint8_t code = data[pos++];
+        if (code == 0 || pos + code - 1 > len) return -1;
+        for (unsigned int i = 1; i < code; ++i)
+        {
+            if (data[pos] == 0) return -1;
+            out[outPos++] = data[pos++];
+        }
+        // a full block doesn't end with a 0, neither does the last one
+        if (code != 0xff && pos < len) out[outPos++] = 0;
+    }
+    return outPos;
+}
@@ -0,0 +1,18 @@
+#ifndef COBS_H
+#define COBS_H
+
+#include <cstdint>
+
+// Consistent Overhead Byte Stuffing: takes the 0 bytes out of the data for at most one byte more per 254,
+// so a 0 can mark where a frame ends.
+class Cobs
+{
+public:
+    static unsigned int maxEncodedSize(unsigned int len) { return len + len / 254 + 1; }
+    // out needs room for maxEncodedSize(len), the result is the length without the delimiter
+    static unsigned int encode(const uint8_t* data, unsigned int len, uint8_t* out);
+    // out needs room for len bytes, the result is the decoded length or -1 if data isn't valid
+    static int decode(const uint8_t* data, unsigned int len, uint8_t* out);
+};
+
+#endif // COBS_H
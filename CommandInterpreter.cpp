@@ -19,27 +19,34 @@
 #include "CommandInterpreter.h"
 #include "sw/images.h"
 
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <algorithm>
 #include <strings.h>
 
-CommandInterpreter::CommandInterpreter(StmSystem& system) :
+const uint64_t CommandInterpreter::STATUS_PERIOD_NS = 40000000;
+
+CommandInterpreter::CommandInterpreter(System& system, Stream<char>& console, ClockControl& rcc) :
     mSystem(system),
+    mConsole(console),
+    mRcc(rcc),
     mLineLen(0),
     mState(State::Input),
     mCommandTime(false),
     mReadChar(0),
-    mCharReceived(*this),
+    mCharReceived(*this, System::Event::Priority::Low),
     mHistory(64),
     mHistoryIndex(0),
     mEscapeLen(0),
     mFirstSpace(0),
     mFbIndex(0),
     mFbIndexOffset(1),
-    mTickEvent(*this, 40)
+    mTickEvent(*this, System::Event::Priority::Low)
 {
     strcpy(mPrompt, "# ");
+    mSystem.setEventName(&mCharReceived, "console");
+    mSystem.setEventName(&mTickEvent, "status");
 }
 
 CommandInterpreter::~CommandInterpreter()
@@ -58,7 +65,7 @@ void CommandInterpreter::feed()
             break;
         case '\r':
         case '\n':
-            mSystem.mDebug.write("\r\n", 2);
+            mConsole.write("\r\n", 2);
             if (mHistoryIndex != 0)
             {
                 strcpy(mLine, mHistory[mHistoryIndex]);
@@ -86,7 +93,7 @@ void CommandInterpreter::feed()
             break;
         case 18:    // Ctrl+R
             printf("\nResetting clock\n");
-            mSystem.mRcc.resetClock();
+            mRcc.resetClock();
             mSystem.printInfo();
             printLine();
             break;
@@ -107,7 +114,7 @@ void CommandInterpreter::feed()
                 else if (mFirstSpace == 0) mFirstSpace = mLineLen;
             }
             if (mLineLen < MAX_LINE_LEN) mLine[mLineLen++] = mReadChar;
-            mSystem.mDebug.write(&mReadChar, 1);
+            mConsole.write(&mReadChar, 1);
             break;
         }
     }
@@ -188,10 +195,10 @@ void CommandInterpreter::add(Command* cmd)
     mCmd.push_back(cmd);
 }
 
-void CommandInterpreter::start()
+void CommandInterpreter::start(bool status)
 {
-    mSystem.mDebug.read(&mReadChar, 1, &mCharReceived);
-    mSystem.mSysTick.addRepeatingEvent(&mTickEvent);
+    mConsole.read(&mReadChar, 1, &mCharReceived);
+    if (status) mSystem.postEvent(&mTickEvent);
     printLine();
 }
 
@@ -341,7 +348,7 @@ void CommandInterpreter::eventCallback(System::Event* event)
             printLine();
         }
         feed();
-        mSystem.mDebug.read(&mReadChar, 1, &mCharReceived);
+        mConsole.read(&mReadChar, 1, &mCharReceived);
     }
     else if (event == &mTickEvent)
     {
@@ -350,37 +357,47 @@ void CommandInterpreter::eventCallback(System::Event* event)
         if (s != ps)
         {
             ps = s;
-            uint32_t te = mSystem.timeInEvent() / 1000000;
-            uint32_t ti = mSystem.timeInInterrupt() / 1000000;
-            uint32_t ic = mSystem.interruptCount();
-            uint32_t ec = mSystem.eventCount();
+            unsigned long te = mSystem.timeInEvent() / 1000000;
+            unsigned long ti = mSystem.timeInInterrupt() / 1000000;
+            unsigned long ic = mSystem.interruptCount();
+            unsigned long ec = mSystem.eventCount();
             printf("\x1b[s\x1b[;H%4u:%02u:%02u, %10lu.%03lus in %10lu Events, %10lu.%03lus in %10lu IRQs\x1b[K\x1b[u", s / 3600, (s / 60) % 60, s % 60,
                    te / 1000, te % 1000, ec,
                    ti / 1000, ti % 1000, ic);
             fflush(nullptr);
             System::instance()->debugMsg(((s % 64) < 32) ? "#" : ".", 1);
         }
+        mSystem.postEventAfter(&mTickEvent, STATUS_PERIOD_NS);
     }
 }
 
 void CommandInterpreter::printLine()
 {
-    mSystem.mDebug.write("\r", 1);
+    mConsole.write("\r", 1);
     if (mHistoryIndex == 0)
     {
-        mSystem.mDebug.write(mPrompt, strlen(mPrompt));
-        mSystem.mDebug.write(mLine, mLineLen);
+        mConsole.write(mPrompt, strlen(mPrompt));
+        mConsole.write(mLine, mLineLen);
     }
     else
     {
-        char buf[16];
-        int len = sprintf(buf, "(%i) ", mHistoryIndex);
-        mSystem.mDebug.write(buf, len);
+        char* data;
+        if (mConsole.writeReserve(data, 16) == 16)
+        {
+            // formatted straight into the FIFO
+            mConsole.writeCommit(sprintf(data, "(%i) ", mHistoryIndex));
+        }
+        else
+        {
+            char buf[16];
+            int len = sprintf(buf, "(%i) ", mHistoryIndex);
+            mConsole.write(buf, len);
+        }
         char* p = mHistory[mHistoryIndex];
-        mSystem.mDebug.write(p, strlen(p));
+        mConsole.write(p, strlen(p));
     }
     static const char* CLEAR_LINE = "\x1b[0K";
-    mSystem.mDebug.write(CLEAR_LINE, 4);
+    mConsole.write(CLEAR_LINE, 4);
 }
 
 CommandInterpreter::Command *CommandInterpreter::findCommand(const char *name, unsigned int len, CommandInterpreter::Possibilities &possible)
@@ -19,12 +19,16 @@
 #ifndef COMMANDINTERPRETER_H
 #define COMMANDINTERPRETER_H
 
-#include "Serial.h"
-#include "StmSystem.h"
+#include "System.h"
+#include "Stream.h"
+#include "ClockControl.h"
 #include "CircularBuffer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
+// The shell on the console, it only talks to the console stream and the System, so it runs on the host as well.
 class CommandInterpreter : public System::Event::Callback
 {
 public:
@@ -71,12 +75,13 @@ public:
     iterator begin() { return mCmd.begin(); }
     iterator end() { return mCmd.end(); }
 
-    CommandInterpreter(StmSystem& system);
+    CommandInterpreter(System& system, Stream<char>& console, ClockControl& rcc);
     ~CommandInterpreter();
 
     void feed();
     void add(Command *cmd);
-    void start();
+    // the status line in the top row of the terminal comes every 40ms, without it the screen is left alone
+    void start(bool status = true);
     void printUsage(Command* cmd);
     void printArguments(Command* cmd, bool summary);
     void printAliases(Command* cmd);
@@ -94,7 +99,7 @@ private:
         void append(const char* string)
         {
             unsigned int stringLen = strlen(string);
-            strncpy(mString + mLen, string, std::min(sizeof(mString) - 1 - mLen, stringLen));
+            strncpy(mString + mLen, string, std::min(static_cast<unsigned int>(sizeof(mString)) - 1 - mLen, stringLen));
             mLen += stringLen;
             if (mLen < sizeof(mString) - 1) mString[mLen++] = ' ';
             mString[mLen] = 0;
@@ -108,7 +113,11 @@ private:
         unsigned int mLen;
         unsigned int mCount;
     };
-    StmSystem& mSystem;
+    static const uint64_t STATUS_PERIOD_NS;
+
+    System& mSystem;
+    Stream<char>& mConsole;
+    ClockControl& mRcc;
     std::vector<Command*> mCmd;
     char mLine[MAX_LINE_LEN];
     unsigned int mLineLen;
@@ -125,7 +134,7 @@ private:
     Argument mArguments[MAX_ARG_LEN];
     int mFbIndex;
     int mFbIndexOffset;
-    SysTickControl::RepeatingEvent mTickEvent;
+    System::Event mTickEvent;
 
 
     void printLine();
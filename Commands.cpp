@@ -1,15 +1,37 @@
 #include "Commands.h"
-#include "hw/ds18b20.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <strings.h>
 
+// Binary dumps must not lose anything, the console drops what doesn't fit. Each piece waits until the
+// UART made room for it, so it has to fit into the console FIFO.
+static void dump(StmSystem& system, const void* data, unsigned int len)
+{
+    while (system.mDebug.writeFree() < len) system.nspin(1000);
+    static_cast<System&>(system).consoleWrite(static_cast<const char*>(data), len);
+}
+
 char const * const CmdHelp::NAME[] = { "help", "?" };
 char const * const CmdHelp::ARGV[] = { "os:command" };
 
 char const * const CmdInfo::NAME[] = { "info" };
 char const * const CmdInfo::ARGV[] = { nullptr };
 
+char const * const CmdTop::NAME[] = { "top" };
+char const * const CmdTop::ARGV[] = { "os:reset" };
+
+char const * const CmdTrace::NAME[] = { "trace" };
+char const * const CmdTrace::ARGV[] = { "os:command" };
+
+char const * const CmdLog::NAME[] = { "log" };
+char const * const CmdLog::ARGV[] = { nullptr };
+
+const unsigned int CmdMemcpy::MAX_SIZE;
+char const * const CmdMemcpy::NAME[] = { "memcpy" };
+char const * const CmdMemcpy::ARGV[] = { "ou:size" };
+
 char const * const CmdFunc::NAME[] = { "func" };
 char const * const CmdFunc::ARGV[] = { "s:function" };
 
@@ -19,8 +41,9 @@ char const * const CmdRead::ARGV[] = { "Au:address", "Vou:count" };
 char const * const CmdWrite::NAME[] = { "write", "wb", "wh", "ww" };
 char const * const CmdWrite::ARGV[] = { "Au:address", "Vu:data" };
 
+const unsigned int CmdLis::SAMPLES;
 char const * const CmdLis::NAME[] = { "lis" };
-char const * const CmdLis::ARGV[] = { nullptr };
+char const * const CmdLis::ARGV[] = { "os:mode" };
 
 char const * const CmdPin::NAME[] = { "pin" };
 char const * const CmdPin::ARGV[] = { "Ps:pin", "Vob:value" };
@@ -156,7 +179,189 @@ bool CmdInfo::execute(CommandInterpreter &interpreter, int argc, const CommandIn
 }
 
 
-CmdFunc::CmdFunc(StmSystem &system) : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mSystem(system)
+CmdTop::CmdTop(StmSystem &system) : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mSystem(system)
+{
+}
+
+#ifdef PROFILER
+static void printProfile(const char* name, const Profiler::Entry& entry, uint64_t elapsed)
+{
+    unsigned int permille = elapsed != 0 ? entry.mTotalNs * 1000 / elapsed : 0;
+    printf("%-12s %8lu %10llu %3u.%u %8lu %8lu ", name, entry.mCount, entry.mTotalNs / 1000, permille / 10, permille % 10,
+           static_cast<uint32_t>(entry.mTotalNs / entry.mCount / 1000), entry.mMaxNs / 1000);
+    unsigned int last = Profiler::bucket(entry.mMaxNs);
+    for (unsigned int i = 0; i <= last; ++i) printf(" %u", entry.mHistogram[i]);
+    printf("\n");
+}
+#endif
+
+bool CmdTop::execute(CommandInterpreter &interpreter, int argc, const CommandInterpreter::Argument *argv)
+{
+#ifdef PROFILER
+    Profiler& profiler = mSystem.profiler();
+    if (argc == 2)
+    {
+        if (strcmp("reset", argv[1].value.s) == 0) profiler.reset(mSystem.ns());
+        else printf("Unknown option, allowed is: reset\n");
+        return true;
+    }
+
+    uint64_t elapsed = mSystem.ns() - profiler.start();
+    std::vector<Profiler::Entry*> events;
+    for (unsigned int i = 0; i < Profiler::MAX_EVENTS; ++i)
+    {
+        Profiler::Entry* entry = profiler.event(i);
+        if (entry != nullptr && entry->mCount != 0) events.push_back(entry);
+    }
+    std::sort(events.begin(), events.end(), [](const Profiler::Entry* a, const Profiler::Entry* b) { return a->mTotalNs > b->mTotalNs; });
+
+    printf("%llu ms since reset, histogram buckets are <%lu ns and doubling from there.\n", elapsed / 1000000, Profiler::bucketLimit(0));
+    printf("%-12s %8s %10s %5s %8s %8s  histogram\n", "EVENT", "COUNT", "TOTAL us", "CPU%", "AVG us", "MAX us");
+    for (Profiler::Entry* entry : events)
+    {
+        char name[16];
+        if (entry->mName == nullptr) sprintf(name, "%p", entry->mKey);
+        printProfile(entry->mName != nullptr ? entry->mName : name, *entry, elapsed);
+    }
+    if (profiler.eventsLost() != 0) printf("%lu events not recorded, table full.\n", profiler.eventsLost());
+
+    printf("%-12s %8s %10s %5s %8s %8s  histogram\n", "IRQ", "COUNT", "TOTAL us", "CPU%", "AVG us", "MAX us");
+    for (unsigned int i = 0; i < Profiler::MAX_INTERRUPTS; ++i)
+    {
+        Profiler::Entry* entry = profiler.interrupt(i);
+        if (entry->mCount == 0) continue;
+        char name[16];
+        sprintf(name, "%u", i);
+        printProfile(name, *entry, elapsed);
+    }
+#else
+    printf("Profiler not available, build with PROFILER=1.\n");
+#endif
+    return true;
+}
+
+
+CmdTrace::CmdTrace(StmSystem &system) : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mSystem(system)
+{
+}
+
+bool CmdTrace::execute(CommandInterpreter &interpreter, int argc, const CommandInterpreter::Argument *argv)
+{
+#ifdef TRACE
+    Trace& trace = mSystem.trace();
+    if (argc == 2)
+    {
+        if (strcmp("start", argv[1].value.s) == 0) trace.enable(true);
+        else if (strcmp("stop", argv[1].value.s) == 0) trace.enable(false);
+        else if (strcmp("reset", argv[1].value.s) == 0) trace.reset();
+        else printf("Unknown command, allowed are: start, stop, reset\n");
+        return true;
+    }
+
+    // nothing must be written to the ring while it is read
+    bool enabled = trace.enabled();
+    trace.enable(false);
+    Trace::Header header;
+    trace.header(header, mSystem.mRcc.clock(ClockControl::Clock::System));
+    dump(mSystem, &header, sizeof(header));
+    for (unsigned int i = 0; i < header.mCount; ++i)
+    {
+        dump(mSystem, &trace.record(i), sizeof(Trace::Record));
+    }
+    printf("\n%lu records, %lu lost.\n", header.mCount, header.mLost);
+    trace.enable(enabled);
+#else
+    printf("Trace not available, build with TRACE=1.\n");
+#endif
+    return true;
+}
+
+
+CmdLog::CmdLog(StmSystem &system) : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mSystem(system)
+{
+}
+
+bool CmdLog::execute(CommandInterpreter &interpreter, int argc, const CommandInterpreter::Argument *argv)
+{
+    Log& log = mSystem.log();
+    // what comes in from now on is left for the next time
+    Log::Header header;
+    log.header(header, mSystem.mRcc.clock(ClockControl::Clock::System), log.available());
+    dump(mSystem, &header, sizeof(header));
+    uint32_t buffer[64];
+    for (unsigned int done = 0; done < header.mCount; )
+    {
+        unsigned int len = log.read(buffer, std::min<unsigned int>(header.mCount - done, sizeof(buffer) / sizeof(buffer[0])));
+        if (len == 0) break;
+        dump(mSystem, buffer, len * sizeof(buffer[0]));
+        done += len;
+    }
+    printf("\n%lu words, %lu lost.\n", header.mCount, header.mLost);
+    return true;
+}
+
+
+CmdMemcpy::CmdMemcpy(StmSystem &system) :
+    Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])),
+    mSystem(system),
+    mSrc(nullptr),
+    mDest(nullptr)
+{
+}
+
+bool CmdMemcpy::execute(CommandInterpreter &interpreter, int argc, const CommandInterpreter::Argument *argv)
+{
+    // on the heap, the DMA doesn't get to the stack in the CCM RAM
+    if (mSrc == nullptr)
+    {
+        mSrc = new uint8_t[MAX_SIZE + 1];
+        mDest = new uint8_t[MAX_SIZE + 1];
+        for (unsigned int i = 0; i <= MAX_SIZE; ++i) mSrc[i] = static_cast<uint8_t>(i * 7);
+    }
+    printf("bytes      memcpy       DMA    memset       DMA  (cycles)\n");
+    if (argc == 2)
+    {
+        compare(std::min(argv[1].value.u, MAX_SIZE), 0);
+        return true;
+    }
+    for (unsigned int size = 16; size <= MAX_SIZE; size *= 4) compare(size, 0);
+    // bytes only
+    compare(1024, 1);
+    return true;
+}
+
+void CmdMemcpy::compare(unsigned int size, unsigned int offset)
+{
+    Dwt& dwt = mSystem.mDwt;
+    AsyncMemcpy& async = mSystem.mMemcpy;
+    uint32_t start = dwt.cycles();
+    std::memcpy(mDest + offset, mSrc, size);
+    uint32_t cpuCopy = dwt.cycles() - start;
+    std::memset(mDest, 0, MAX_SIZE + 1);
+    start = dwt.cycles();
+    async.memcpy(mDest + offset, mSrc, size, nullptr);
+    while (!async.idle()) { }
+    uint32_t dmaCopy = dwt.cycles() - start;
+    bool same = std::memcmp(mDest + offset, mSrc, size) == 0;
+
+    start = dwt.cycles();
+    std::memset(mDest + offset, 0x55, size);
+    uint32_t cpuFill = dwt.cycles() - start;
+    start = dwt.cycles();
+    async.memset(mDest + offset, 0xaa, size, nullptr);
+    while (!async.idle()) { }
+    uint32_t dmaFill = dwt.cycles() - start;
+    for (unsigned int i = 0; i < size; ++i) same = same && mDest[offset + i] == 0xaa;
+    printf("%5u%s %9lu %9lu %9lu %9lu%s\n", size, offset != 0 ? "+1" : "  ", cpuCopy, dmaCopy, cpuFill, dmaFill, same ? "" : "  WRONG DATA");
+}
+
+
+CmdFunc::CmdFunc(StmSystem &system) :
+    Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])),
+    mSystem(system),
+    mTempPin(system.mGpioB, Gpio::Index::Pin11),
+    mTemp(mTempPin),
+    mTempEvent(*this)
 {
 }
 
@@ -169,11 +374,9 @@ bool CmdFunc::execute(CommandInterpreter &interpreter, int argc, const CommandIn
     else if (strcmp("temp", argv[1].value.s) == 0)
     {
         mSystem.mRcc.enable(ClockControl::Function::GpioB);
-        Gpio::Pin pin(mSystem.mGpioE, Gpio::Index::Pin11);
         mSystem.mGpioB.configOutput(Gpio::Index::Pin11, Gpio::OutputType::OpenDrain, Gpio::Pull::Up);
-        Ds18b20 temp(pin);
-        int t = temp.temp();
-        printf("%u.%u\n", t / 16, 1000 * (t % 16) / 16);
+        // the result comes with the event
+        mTemp.measure(&mTempEvent);
     }
     else
     {
@@ -182,8 +385,28 @@ bool CmdFunc::execute(CommandInterpreter &interpreter, int argc, const CommandIn
     return true;
 }
 
+void CmdFunc::eventCallback(System::Event *event)
+{
+    if (event->result() == System::Event::Result::DataSuccess)
+    {
+        int t = mTemp.temp();
+        unsigned a = t < 0 ? -t : t;
+        printf("%s%u.%03u\n", t < 0 ? "-" : "", a / 16, 1000 * (a % 16) / 16);
+    }
+    else
+    {
+        printf("No device found.\n");
+    }
+}
+
 
-CmdLis::CmdLis(LIS302DL &lis) : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mLis(lis), mEvent(*this), mEnabled(false)
+CmdLis::CmdLis(LIS302DL &lis, Telemetry *telemetry) :
+    Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])),
+    mLis(lis),
+    mTelemetry(telemetry),
+    mEvent(*this),
+    mEnabled(false),
+    mBinary(false)
 {
     mLis.setDataReadyEvent(&mEvent);
 }
@@ -193,10 +416,13 @@ bool CmdLis::execute(CommandInterpreter &interpreter, int argc, const CommandInt
     if (mEnabled)
     {
         mLis.disable();
+        mLis.stopSampling();
         mEnabled = false;
     }
     else
     {
+        mBinary = argc == 2 && strcmp("bin", argv[1].value.s) == 0 && mTelemetry != nullptr;
+        if (mBinary) mLis.startSampling(mSamples[0], mSamples[1], SAMPLES, this);
         mLis.enable();
         (void)mLis.x();
         (void)mLis.y();
@@ -208,6 +434,8 @@ bool CmdLis::execute(CommandInterpreter &interpreter, int argc, const CommandInt
 
 void CmdLis::eventCallback(System::Event *event)
 {
+    // the samples come in blocks
+    if (mBinary) return;
     int x, y, z;
     x = mLis.x();
     y = mLis.y();
@@ -218,6 +446,11 @@ void CmdLis::eventCallback(System::Event *event)
     fflush(nullptr);
 }
 
+void CmdLis::bufferComplete(unsigned int index, void *data, unsigned int len)
+{
+    mTelemetry->send(Telemetry::Type::Acceleration, data, len);
+}
+
 
 CmdPin::CmdPin(Gpio **gpio, unsigned int gpioCount) : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mGpio(gpio), mGpioCount(gpioCount)
 {
@@ -449,7 +682,7 @@ void CmdSdio::eventCallback(System::Event *event)
 }
 
 
-CmdMotor::CmdMotor() : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mEvent(*this), mMotorCount(0)
+CmdMotor::CmdMotor() : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mEvent(*this, System::Event::Priority::High), mMotorCount(0)
 {
 }
 
@@ -9,6 +9,7 @@
 #include "sw/sdcard.h"
 #include "hw/tlc5940.h"
 #include "hw/hcsr04.h"
+#include "hw/ds18b20.h"
 
 #include <cstdio>
 #include <vector>
@@ -43,16 +44,74 @@ private:
     StmSystem& mSystem;
 };
 
-class CmdFunc : public CommandInterpreter::Command
+class CmdTop : public CommandInterpreter::Command
+{
+public:
+    CmdTop(StmSystem& system);
+    virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv);
+    virtual const char* helpText() const { return "Shows time spent per event and interrupt, or resets the statistic."; }
+private:
+    static char const * const NAME[];
+    static char const * const ARGV[];
+    StmSystem& mSystem;
+};
+
+class CmdTrace : public CommandInterpreter::Command
+{
+public:
+    CmdTrace(StmSystem& system);
+    virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv);
+    virtual const char* helpText() const { return "Dumps the interrupt and event trace in binary for tools/tracedecode, or starts, stops or resets it."; }
+private:
+    static char const * const NAME[];
+    static char const * const ARGV[];
+    StmSystem& mSystem;
+};
+
+class CmdLog : public CommandInterpreter::Command
+{
+public:
+    CmdLog(StmSystem& system);
+    virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv);
+    virtual const char* helpText() const { return "Dumps the records of LOG_...() in binary for tools/logdecode and frees them."; }
+private:
+    static char const * const NAME[];
+    static char const * const ARGV[];
+    StmSystem& mSystem;
+};
+
+class CmdMemcpy : public CommandInterpreter::Command
+{
+public:
+    CmdMemcpy(StmSystem& system);
+    virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv);
+    virtual const char* helpText() const { return "Compares memcpy and memset with the DMA, in cycles until the data is there."; }
+private:
+    static const unsigned int MAX_SIZE = 16384;
+    static char const * const NAME[];
+    static char const * const ARGV[];
+    StmSystem& mSystem;
+    uint8_t* mSrc;
+    uint8_t* mDest;
+
+    void compare(unsigned int size, unsigned int offset);
+};
+
+class CmdFunc : public CommandInterpreter::Command, public System::Event::Callback
 {
 public:
     CmdFunc(StmSystem& system);
     virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv);
     virtual const char* helpText() const { return "Execute a function and show the result."; }
+protected:
+    virtual void eventCallback(System::Event* event);
 private:
     static char const * const NAME[];
     static char const * const ARGV[];
     StmSystem& mSystem;
+    Gpio::Pin mTempPin;
+    Ds18b20 mTemp;
+    System::Event mTempEvent;
 };
 
 class CmdRead : public CommandInterpreter::Command
@@ -80,20 +139,26 @@ private:
     static char const * const ARGV[];
 };
 
-class CmdLis : public CommandInterpreter::Command, public System::Event::Callback
+class CmdLis : public CommandInterpreter::Command, public System::Event::Callback, public Device::DoubleBufferCallback
 {
 public:
-    CmdLis(LIS302DL& lis);
+    CmdLis(LIS302DL& lis, Telemetry* telemetry = nullptr);
     virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv);
-    virtual const char* helpText() const { return "Show LIS302DL info."; }
+    virtual const char* helpText() const { return "Show LIS302DL info, with bin as telemetry frames."; }
 protected:
     virtual void eventCallback(System::Event* event);
+    virtual void bufferComplete(unsigned int index, void* data, unsigned int len);
 private:
+    // per telemetry frame
+    static const unsigned int SAMPLES = 16;
     static char const * const NAME[];
     static char const * const ARGV[];
     LIS302DL& mLis;
+    Telemetry* mTelemetry;
     System::Event mEvent;
     bool mEnabled;
+    bool mBinary;
+    int8_t mSamples[2][3 * SAMPLES];
 };
 
 class CmdPin : public CommandInterpreter::Command
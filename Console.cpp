@@ -0,0 +1,95 @@
+#include "Console.h"
+#include "atomic.h"
+
+#include <algorithm>
+
+const unsigned int Console::CHUNK_SIZE;
+
+Console::Console(unsigned int size, Overflow overflow) :
+    mRing(size),
+    mOverflow(overflow),
+    mChunkStart(0),
+    mChunkEnd(0),
+    mDropped(0),
+    mOverflows(0)
+{
+}
+
+Console::~Console()
+{
+}
+
+bool Console::pop(char &elem)
+{
+    if (mChunkStart != mChunkEnd)
+    {
+        elem = mChunk[mChunkStart++];
+        return true;
+    }
+    uint32_t primask = interrupt_disable();
+    bool success = mRing.pop(elem);
+    interrupt_restore(primask);
+    return success;
+}
+
+unsigned int Console::write(const char *data, unsigned int len)
+{
+    unsigned int written = mRing.write(data, len);
+    if (written == len || mOverflow == Overflow::Block) return written;
+    ++mOverflows;
+    if (mOverflow == Overflow::Drop)
+    {
+        mDropped += len - written;
+        return len;
+    }
+    // the newest data is kept, as much of it as the ring holds
+    unsigned int rest = len - written;
+    if (rest > mRing.size())
+    {
+        mDropped += rest - mRing.size();
+        // past what got written and what doesn't fit either
+        data += len - mRing.size();
+        rest = mRing.size();
+    }
+    else
+    {
+        data += written;
+    }
+    // the reader must not take from the ring in between
+    uint32_t primask = interrupt_disable();
+    if (rest > mRing.free()) mDropped += mRing.skip(rest - mRing.free());
+    interrupt_restore(primask);
+    mRing.write(data, rest);
+    return len;
+}
+
+unsigned int Console::read(char *data, unsigned int len)
+{
+    unsigned int chunkLen = std::min(len, mChunkEnd - mChunkStart);
+    std::copy(mChunk + mChunkStart, mChunk + mChunkStart + chunkLen, data);
+    mChunkStart += chunkLen;
+    uint32_t primask = interrupt_disable();
+    unsigned int ringLen = mRing.read(data + chunkLen, len - chunkLen);
+    interrupt_restore(primask);
+    return chunkLen + ringLen;
+}
+
+unsigned int Console::peek(const char *&data)
+{
+    if (mChunkStart == mChunkEnd)
+    {
+        uint32_t primask = interrupt_disable();
+        mChunkStart = 0;
+        mChunkEnd = mRing.read(mChunk, CHUNK_SIZE);
+        interrupt_restore(primask);
+    }
+    data = mChunk + mChunkStart;
+    return mChunkEnd - mChunkStart;
+}
+
+unsigned int Console::release(unsigned int len)
+{
+    len = std::min(len, mChunkEnd - mChunkStart);
+    mChunkStart += len;
+    return len;
+}
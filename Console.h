@@ -0,0 +1,49 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "Fifo.h"
+#include "CircularBuffer.h"
+
+// Write FIFO for the console, so printf() doesn't have to wait for the UART. What doesn't fit goes by the
+// overflow policy: Block leaves it to the writer (Stream tries again until everything is in), Drop throws
+// away what doesn't fit and OverwriteOldest throws away the oldest data to make room.
+// What gets sent is copied out of the ring into a chunk of its own first, so the oldest data can go even
+// while a DMA transfer is going on.
+class Console : public Fifo<char>
+{
+public:
+    enum class Overflow { Block, Drop, OverwriteOldest };
+    static const unsigned int CHUNK_SIZE = 128;
+
+    Console(unsigned int size, Overflow overflow = Overflow::Drop);
+    virtual ~Console();
+
+    void setOverflow(Overflow overflow) { mOverflow = overflow; }
+    // bytes that got thrown away and the writes that lost some
+    unsigned int dropped() { return mDropped; }
+    unsigned int overflows() { return mOverflows; }
+
+    virtual unsigned int used() { return mRing.used() + mChunkEnd - mChunkStart; }
+    virtual unsigned int free() { return mRing.free(); }
+
+    virtual bool push(char elem) { return write(&elem, 1) == 1; }
+    virtual bool pop(char &elem);
+    virtual unsigned int write(const char* data, unsigned int len);
+    virtual unsigned int read(char* data, unsigned int len);
+
+    virtual unsigned int reserve(char*& data, unsigned int len = ~0u) { return mRing.reserve(data, len); }
+    virtual void commit(unsigned int len) { mRing.commit(len); }
+    virtual unsigned int peek(const char*& data);
+    virtual unsigned int release(unsigned int len);
+
+private:
+    CircularBuffer<char> mRing;
+    Overflow mOverflow;
+    char mChunk[CHUNK_SIZE];
+    volatile unsigned int mChunkStart;
+    volatile unsigned int mChunkEnd;
+    unsigned int mDropped;
+    unsigned int mOverflows;
+};
+
+#endif // CONSOLE_H
@@ -0,0 +1,27 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <cstdint>
+
+// CRC-32 the way the CRC unit of the STM32 computes it: polynomial 0x04c11db7, starting with 0xffffffff,
+// over 32 bit words, most significant bit first and without a final XOR. The words are taken as they are in
+// memory, a partial word at the end is filled up with 0.
+// This one works with a table, CrcUnit gets the same result from the hardware.
+class Crc
+{
+public:
+    static const uint32_t INITIAL = 0xffffffff;
+
+    virtual ~Crc() { }
+
+    virtual uint32_t compute(const void* data, unsigned int len);
+
+    static uint32_t update(uint32_t crc, uint32_t word);
+    // the little endian word at data, len < 4 fills it up with 0
+    static uint32_t word(const uint8_t* data, unsigned int len = 4);
+
+private:
+    static const uint32_t TABLE[256];
+};
+
+#endif // CRC_H
@@ -0,0 +1,23 @@
+#include "CrcUnit.h"
+
+CrcUnit::CrcUnit(System::BaseAddress base) :
+    mBase(reinterpret_cast<volatile CRC*>(base))
+{
+    static_assert(sizeof(CRC) == 0x0c, "Struct has wrong size, compiler problem.");
+}
+
+uint32_t CrcUnit::compute(const void *data, unsigned int len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    mBase->CR.RESET = 1;
+    if ((reinterpret_cast<uintptr_t>(p) & 3) == 0)
+    {
+        for (const uint32_t* w = reinterpret_cast<const uint32_t*>(p); len >= 4; len -= 4, p += 4) mBase->DR = *w++;
+    }
+    else
+    {
+        for (; len >= 4; len -= 4, p += 4) mBase->DR = word(p);
+    }
+    if (len > 0) mBase->DR = word(p, len);
+    return mBase->DR;
+}
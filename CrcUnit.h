@@ -0,0 +1,30 @@
+#ifndef CRCUNIT_H
+#define CRCUNIT_H
+
+#include "Crc.h"
+#include "System.h"
+
+// The CRC unit of the STM32, a word per cycle instead of a table lookup per byte.
+// There is only one, so it must not be used from an interrupt while compute() runs somewhere else.
+class CrcUnit : public Crc
+{
+public:
+    CrcUnit(System::BaseAddress base);
+
+    virtual uint32_t compute(const void* data, unsigned int len);
+
+private:
+    struct CRC
+    {
+        uint32_t DR;
+        uint32_t IDR;
+        struct __CR
+        {
+            uint32_t RESET : 1;
+            uint32_t __RESERVED0 : 31;
+        }   CR;
+    };
+    volatile CRC* mBase;
+};
+
+#endif // CRCUNIT_H
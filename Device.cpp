@@ -20,7 +20,9 @@
 
 Device::Device() :
     mDmaWrite(nullptr),
-    mDmaRead(nullptr)
+    mDmaRead(nullptr),
+    mDoubleBufferCallback(nullptr),
+    mDoubleBufferLength(0)
 {
 
 }
@@ -51,7 +53,13 @@ void Device::configInterrupt(InterruptController::Line* interrupt)
 
 void Device::dmaCallback(Dma::Stream* stream, Dma::Stream::Callback::Reason reason)
 {
-    if (stream == mDmaWrite)
+    if (reason == Dma::Stream::Callback::Reason::HalfTransfer)
+    {
+        // the transfer goes on
+        if (stream == mDmaWrite) dmaWriteHalfComplete();
+        else if (stream == mDmaRead) dmaReadHalfComplete();
+    }
+    else if (stream == mDmaWrite)
     {
         if (reason != Dma::Stream::Callback::Reason::TransferComplete)
         {
@@ -61,6 +69,12 @@ void Device::dmaCallback(Dma::Stream* stream, Dma::Stream::Callback::Reason reas
         }
         dmaWriteComplete();
     }
+    else if (stream == mDmaRead && mDoubleBufferCallback != nullptr &&
+             (reason == Dma::Stream::Callback::Reason::Memory0Complete || reason == Dma::Stream::Callback::Reason::Memory1Complete))
+    {
+        unsigned int index = reason == Dma::Stream::Callback::Reason::Memory0Complete ? 0 : 1;
+        mDoubleBufferCallback->bufferComplete(index, mDoubleBuffer[index], mDoubleBufferLength);
+    }
     else if (stream == mDmaRead)
     {
         if (reason != Dma::Stream::Callback::Reason::TransferComplete)
@@ -73,3 +87,28 @@ void Device::dmaCallback(Dma::Stream* stream, Dma::Stream::Callback::Reason reas
     }
 }
 
+bool Device::startDoubleBuffer(void *buffer0, void *buffer1, unsigned int len, Device::DoubleBufferCallback *callback)
+{
+    if (mDmaRead == nullptr || !mDmaRead->complete() || len == 0 || len > 0xffff) return false;
+    mDoubleBufferCallback = callback;
+    mDoubleBuffer[0] = buffer0;
+    mDoubleBuffer[1] = buffer1;
+    mDoubleBufferLength = len;
+    mDmaRead->setAddress(Dma::Stream::End::Memory0, reinterpret_cast<System::BaseAddress>(buffer0));
+    mDmaRead->setAddress(Dma::Stream::End::Memory1, reinterpret_cast<System::BaseAddress>(buffer1));
+    mDmaRead->setTransferCount(len);
+    mDmaRead->setDoubleBuffer(true);
+    mDmaRead->setHalfTransferInterrupt(false);
+    mDmaRead->start();
+    return true;
+}
+
+void Device::stopDoubleBuffer()
+{
+    if (mDmaRead != nullptr && mDoubleBufferCallback != nullptr)
+    {
+        mDmaRead->stop();
+        mDmaRead->setDoubleBuffer(false);
+    }
+    mDoubleBufferCallback = nullptr;
+}
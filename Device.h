@@ -28,13 +28,27 @@ public:
     Device();
     enum Part { Read = 1, Write = 2, All = 3 };
 
+    // Reading for good into two buffers with the double buffer mode of the DMA, gets the one that just
+    // got full. It can be processed until the other one is full as well, after that it gets overwritten.
+    class DoubleBufferCallback
+    {
+    public:
+        virtual ~DoubleBufferCallback() { }
+        virtual void bufferComplete(unsigned int index, void* data, unsigned int len) = 0;
+    };
+
     virtual void enable(Part part) = 0;
     virtual void disable(Part part) = 0;
     virtual void dmaReadComplete() = 0;
     virtual void dmaWriteComplete() = 0;
+    // Circular streams with the half transfer interrupt: the first half can be processed while the second
+    // one fills, the complete one comes for the second half.
+    virtual void dmaReadHalfComplete() { }
+    virtual void dmaWriteHalfComplete() { }
 
     virtual void configDma(Dma::Stream* write, Dma::Stream* read);
     virtual void configInterrupt(InterruptController::Line* interrupt);
+    virtual void stopDoubleBuffer();
 
 protected:
     InterruptController::Line* mInterrupt;
@@ -43,6 +57,14 @@ protected:
 
     virtual void dmaCallback(Dma::Stream* stream, Dma::Stream::Callback::Reason reason);
 
+    // sets up and starts the read stream, the device has to request the transfers
+    bool startDoubleBuffer(void* buffer0, void* buffer1, unsigned int len, DoubleBufferCallback* callback);
+    bool doubleBuffer() { return mDoubleBufferCallback != nullptr; }
+
+private:
+    DoubleBufferCallback* mDoubleBufferCallback;
+    void* mDoubleBuffer[2];
+    unsigned int mDoubleBufferLength;
 
 };
 
@@ -18,7 +18,9 @@
 
 #include "Dma.h"
 
-Dma::Dma(unsigned int base) :
+const unsigned int Dma::Stream::FIFO_BYTES;
+
+Dma::Dma(System::BaseAddress base) :
     mBase(reinterpret_cast<volatile DMA*>(base))
 {
     static_assert(sizeof(DMA) == 0xd0, "Struct has wrong size, compiler problem.");
@@ -64,7 +66,9 @@ Dma::Stream::Stream(Dma &dma, Dma::Stream::StreamIndex stream, Dma::Stream::Chan
     mPeripheral(0),
     mMemory0(0),
     mMemory1(0),
-    mCount(0)
+    mCount(0),
+    mTuneMemory(false),
+    mSegment(nullptr)
 {
     mStreamConfig.CR = 0;
     mStreamConfig.BITS.CHSEL = mChannel;
@@ -89,6 +93,21 @@ Dma::Stream::~Stream()
 void Dma::Stream::start()
 {
     waitReady();
+    mSegment = nullptr;
+    program();
+}
+
+void Dma::Stream::program()
+{
+    if (mTuneMemory && mStreamConfig.BITS.DIR != static_cast<uint32_t>(Direction::MemoryToMemory))
+    {
+        // both memories of the double buffer mode go with the same setting
+        System::BaseAddress address = mMemory0 | (mStreamConfig.BITS.DBM ? mMemory1 : 0);
+        MemoryPort port = memoryPort(static_cast<DataSize>(mStreamConfig.BITS.PSIZE), static_cast<uint32_t>(address), mCount);
+        mStreamConfig.BITS.MSIZE = static_cast<uint32_t>(port.mDataSize);
+        mStreamConfig.BITS.MBURST = static_cast<uint32_t>(port.mBurst);
+        mFifoConfig.BITS.FTH = static_cast<uint32_t>(port.mThreshold);
+    }
     mDma.mBase->STREAM[mStream].M0AR = mMemory0;
     mDma.mBase->STREAM[mStream].M1AR = mMemory1;
     mDma.mBase->STREAM[mStream].PAR = mPeripheral;
@@ -98,6 +117,22 @@ void Dma::Stream::start()
     mDma.mBase->STREAM[mStream].CR.BITS.EN = 1;
 }
 
+void Dma::Stream::stop()
+{
+    mSegment = nullptr;
+    mDma.mBase->STREAM[mStream].CR.BITS.EN = 0;
+}
+
+void Dma::Stream::startChain(Dma::Stream::Segment *first)
+{
+    if (first == nullptr) return;
+    waitReady();
+    mSegment = first;
+    mMemory0 = first->mMemory;
+    mCount = first->mCount;
+    program();
+}
+
 void Dma::Stream::waitReady()
 {
     if (mDma.mBase->STREAM[mStream].CR.BITS.EN)
@@ -118,6 +153,12 @@ void Dma::Stream::setPriority(Dma::Stream::Priority priority)
     mStreamConfig.BITS.PL = static_cast<uint32_t>(priority);
 }
 
+void Dma::Stream::setChannel(Dma::Stream::ChannelIndex channel)
+{
+    mChannel = static_cast<uint8_t>(channel);
+    mStreamConfig.BITS.CHSEL = mChannel;
+}
+
 void Dma::Stream::setDataSize(Dma::Stream::End end, Dma::Stream::DataSize dataSize)
 {
     if (end == End::Memory) mStreamConfig.BITS.MSIZE = static_cast<uint32_t>(dataSize);
@@ -166,25 +207,51 @@ void Dma::Stream::interruptCallback(InterruptController::Index index)
     // get and clear interrupt flags
     uint8_t status = mDma.getInterruptStatus(mStream);
     mDma.clearInterruptStatus(mStream, status);
-    if (mCallback != nullptr)
+    if (mCallback != nullptr || mSegment != nullptr)
     {
         Callback::Reason reason = Callback::Reason::TransferComplete;
         // someone cares about our result so lets find it
+        bool halfTransfer = (status & HalfTransfer) != 0 && (status & TransferComplete) == 0;
         bool fifoError = (status & FifoError) != 0;
         bool directModeError = (status & DirectModeError) != 0;
         bool transferError = (status & TransferError) != 0;
 
+        // Only comes with the half transfer interrupt enabled, the transfer goes on.
+        if (halfTransfer) reason = Callback::Reason::HalfTransfer;
+
+        // CT already points to the next memory, the one before is complete.
+        if ((status & TransferComplete) != 0 && mStreamConfig.BITS.DBM)
+        {
+            reason = mDma.mBase->STREAM[mStream].CR.BITS.CT ? Callback::Reason::Memory0Complete : Callback::Reason::Memory1Complete;
+        }
+
         // This can only happen in peripheral to memory transfer with no memory increase.
         // It means that 1 transfer didn't happen and there will be 2 successive transfers
         if (directModeError) reason = Callback::Reason::DirectModeError;
 
         // In direct transfer FIFO error signals an over/underrun and isn't serios, so we can ignore it.
         // In FIFO mode this is fatal (as no data has been transmitted) and caused by wrong configuration of FIFO.
-        if (fifoError && !mDma.mBase->STREAM[mStream].FCR.BITS.DMDIS) reason = Callback::Reason::FifoError;
+        if (fifoError && mDma.mBase->STREAM[mStream].FCR.BITS.DMDIS) reason = Callback::Reason::FifoError;
 
         // A bus errror triggers this as well as a write to memory register during a transfer, pretty fatal.
-        if (transferError) reason = Callback::Reason::DirectModeError;
-        mCallback->dmaCallback(this, reason);
+        if (transferError) reason = Callback::Reason::TransferError;
+
+        // The next segment of a chain starts before anything else, an error ends the chain.
+        bool complete = reason == Callback::Reason::TransferComplete && (status & TransferComplete) != 0;
+        if (mSegment != nullptr && (complete || (reason != Callback::Reason::TransferComplete && reason != Callback::Reason::HalfTransfer)))
+        {
+            Segment* done = mSegment;
+            mSegment = complete ? done->mNext : nullptr;
+            if (mSegment != nullptr)
+            {
+                mMemory0 = mSegment->mMemory;
+                mCount = mSegment->mCount;
+                program();
+            }
+            if (complete && done->mCallback != nullptr) done->mCallback->segmentComplete(this, done);
+            if (mSegment != nullptr) return;
+        }
+        if (mCallback != nullptr) mCallback->dmaCallback(this, reason);
     }
 }
 
@@ -211,12 +278,35 @@ void Dma::Stream::setFlowControl(Dma::Stream::FlowControl flowControl)
 
 void Dma::Stream::setCircular(bool circular)
 {
-    mDma.mBase->STREAM[mStream].CR.BITS.CIRC = circular ? 1 : 0;
+    mStreamConfig.BITS.CIRC = circular ? 1 : 0;
+}
+
+void Dma::Stream::setHalfTransferInterrupt(bool enable)
+{
+    mStreamConfig.BITS.HTIE = enable ? 1 : 0;
+}
+
+uint16_t Dma::Stream::remaining()
+{
+    return mDma.mBase->STREAM[mStream].NDTR;
+}
+
+void Dma::Stream::setDoubleBuffer(bool enable)
+{
+    mStreamConfig.BITS.DBM = enable ? 1 : 0;
+    // starts with Memory0
+    mStreamConfig.BITS.CT = 0;
+}
+
+Dma::Stream::End Dma::Stream::currentMemory()
+{
+    return mDma.mBase->STREAM[mStream].CR.BITS.CT ? End::Memory1 : End::Memory0;
 }
 
 
 void Dma::Stream::configFifo(Dma::Stream::FifoThreshold threshold)
 {
+    mTuneMemory = threshold == FifoThreshold::Auto;
     if (threshold == FifoThreshold::Disable)
     {
         mFifoConfig.BITS.DMDIS = 0;
@@ -224,6 +314,28 @@ void Dma::Stream::configFifo(Dma::Stream::FifoThreshold threshold)
     else
     {
         mFifoConfig.BITS.DMDIS = 1;
-        mFifoConfig.BITS.FTH = static_cast<uint32_t>(threshold);
+        if (!mTuneMemory) mFifoConfig.BITS.FTH = static_cast<uint32_t>(threshold);
+    }
+}
+
+Dma::Stream::MemoryPort Dma::Stream::memoryPort(Dma::Stream::DataSize peripheralDataSize, uint32_t address, unsigned int count)
+{
+    unsigned int peripheralShift = static_cast<unsigned int>(peripheralDataSize);
+    uint32_t bytes = count << peripheralShift;
+    // the memory address and the length have to be aligned to the data size
+    unsigned int shift = static_cast<unsigned int>(DataSize::Word);
+    while (shift > peripheralShift && ((address | bytes) & ((1u << shift) - 1)) != 0) --shift;
+    MemoryPort port = { static_cast<DataSize>(shift), BurstLength::Single, FifoThreshold::Quater };
+    for (unsigned int beats = 16; beats >= 4; beats /= 2)
+    {
+        uint32_t burst = beats << shift;
+        if (burst <= FIFO_BYTES && ((address | bytes) & (burst - 1)) == 0)
+        {
+            port.mBurst = beats == 4 ? BurstLength::Beats4 : beats == 8 ? BurstLength::Beats8 : BurstLength::Beats16;
+            // the threshold is one burst
+            port.mThreshold = burst == 4 ? FifoThreshold::Quater : burst == 8 ? FifoThreshold::Half : FifoThreshold::Full;
+            break;
+        }
     }
+    return port;
 }
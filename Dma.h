@@ -28,7 +28,7 @@ class Dma
 {
 public:
     enum InterruptFlag { FifoError = 1, DirectModeError = 4, TransferError = 8, HalfTransfer = 16, TransferComplete = 32 };
-    Dma(unsigned int base);
+    Dma(System::BaseAddress base);
 
 private:
 
@@ -105,26 +105,61 @@ public:
         enum class Priority { Low, Medium, High, VeryHigh };
         enum class BurstLength { Single, Beats4, Beats8, Beats16 };
         enum class FlowControl { Dma, Sdio };
-        enum class FifoThreshold { Quater = 0, Half = 1, ThreeQuater = 2, Full = 3, Disable = 4 };
+        // Auto picks the threshold with the memory data size and burst for each transfer
+        enum class FifoThreshold { Quater = 0, Half = 1, ThreeQuater = 2, Full = 3, Disable = 4, Auto = 5 };
         enum class End { Memory = 0, Peripheral = 1, MemoryToMemoryDestination = 0, MemoryToMemorySource = 1, Memory0 = 0, Memory1 = 2 };
 
+        static const unsigned int FIFO_BYTES = 16;
+
+        struct MemoryPort
+        {
+            DataSize mDataSize;
+            BurstLength mBurst;
+            FifoThreshold mThreshold;
+        };
+
         class Callback
         {
         public:
-            enum class Reason { TransferComplete, TransferError, FifoError, DirectModeError };
+            // in double buffer mode the transfer complete tells which memory the DMA is done with
+            enum class Reason { TransferComplete, HalfTransfer, TransferError, FifoError, DirectModeError, Memory0Complete, Memory1Complete };
             Callback() { }
             virtual ~Callback() { }
             virtual void dmaCallback(Stream* stream, Reason reason) = 0;
         };
 
+        // A piece of a chain, only the memory address and the count change from one to the next.
+        struct Segment
+        {
+            class Callback
+            {
+            public:
+                // from the interrupt, the next segment runs already
+                virtual void segmentComplete(Stream* stream, Segment* segment) = 0;
+            };
+
+            System::BaseAddress mMemory;
+            uint16_t mCount;
+            Segment* mNext;
+            Callback* mCallback;
+        };
+
         Stream(Dma& dma, StreamIndex stream, ChannelIndex channel, InterruptController::Line* interrupt);
         ~Stream();
 
         void start();
+        void stop();
+        // The DMA has no linked list mode, the transfer complete interrupt starts the next segment of the chain
+        // instead, with the setup of the stream and the FIFO tuned for it. The callback of the stream gets
+        // the transfer complete of the last one, or the error that stopped the chain. Not for circular or double
+        // buffer mode.
+        void startChain(Segment* first);
         void waitReady();
 
         void setBurstLength(End end, BurstLength burstLength);
         void setPriority(Priority priority);
+        // the request of another peripheral on the same stream, when it is handed over
+        void setChannel(ChannelIndex channel);
         void setDataSize(End end, DataSize dataSize);
         void setIncrement(End end, bool increment);
         void setDirection(Direction direction);
@@ -134,9 +169,22 @@ public:
         uint16_t transferCount();
         void setFlowControl(FlowControl flowControl);
         void setCircular(bool circular);
+        void setHalfTransferInterrupt(bool enable);
+        // transfers left, in circular mode it starts over with transferCount() when it gets to 0
+        uint16_t remaining();
+        // Memory0 and Memory1 take turns, the other one can be processed while the DMA fills one of them.
+        // The hardware runs it circular by itself.
+        void setDoubleBuffer(bool enable);
+        // the memory the DMA works on right now, Memory0 or Memory1
+        End currentMemory();
 
         void config(Direction direction, bool peripheralIncrement, bool memoryIncrement, DataSize peripheralDataSize, DataSize memoryDataSize, BurstLength peripheralBurst, BurstLength memoryBurst);
         void configFifo(FifoThreshold threshold);
+        // The memory side with the fewest AHB cycles for count items of the peripheral data size at address:
+        // the FIFO packs them into the widest size the address and the length allow, and bursts as long as
+        // fit the FIFO. Legal by RM0090 table 48, a burst ends on the threshold, doesn't cross 1KB and the
+        // length is a multiple of it.
+        static MemoryPort memoryPort(DataSize peripheralDataSize, uint32_t address, unsigned int count);
 
         virtual void interruptCallback(InterruptController::Index index);
 
@@ -155,6 +203,12 @@ public:
         uint16_t mCount;
         Dma::__STREAM::__CR mStreamConfig;
         Dma::__STREAM::__FCR mFifoConfig;
+        // FifoThreshold::Auto
+        bool mTuneMemory;
+        // the one running of a chain
+        Segment* mSegment;
+
+        void program();
     };
 
 };
@@ -0,0 +1,251 @@
+#include "DmaManager.h"
+#include "atomic.h"
+
+#include <algorithm>
+#include <cstdio>
+
+typedef Dma::Stream::StreamIndex S;
+typedef Dma::Stream::ChannelIndex C;
+typedef DmaManager::Request R;
+
+const DmaManager::Mapping DmaManager::MAPPING[] =
+{
+    { R::Spi1Rx, 2, S::Stream0, C::Channel3 }, { R::Spi1Rx, 2, S::Stream2, C::Channel3 },
+    { R::Spi1Tx, 2, S::Stream3, C::Channel3 }, { R::Spi1Tx, 2, S::Stream5, C::Channel3 },
+    { R::Spi2Rx, 1, S::Stream3, C::Channel0 },
+    { R::Spi2Tx, 1, S::Stream4, C::Channel0 },
+    { R::Spi3Rx, 1, S::Stream0, C::Channel0 }, { R::Spi3Rx, 1, S::Stream2, C::Channel0 },
+    { R::Spi3Tx, 1, S::Stream5, C::Channel0 }, { R::Spi3Tx, 1, S::Stream7, C::Channel0 },
+    { R::I2c1Rx, 1, S::Stream0, C::Channel1 }, { R::I2c1Rx, 1, S::Stream5, C::Channel1 },
+    { R::I2c1Tx, 1, S::Stream6, C::Channel1 }, { R::I2c1Tx, 1, S::Stream7, C::Channel1 },
+    { R::I2c2Rx, 1, S::Stream2, C::Channel7 }, { R::I2c2Rx, 1, S::Stream3, C::Channel7 },
+    { R::I2c2Tx, 1, S::Stream7, C::Channel7 },
+    { R::I2c3Rx, 1, S::Stream2, C::Channel3 },
+    { R::I2c3Tx, 1, S::Stream4, C::Channel3 },
+    { R::Usart1Rx, 2, S::Stream2, C::Channel4 }, { R::Usart1Rx, 2, S::Stream5, C::Channel4 },
+    { R::Usart1Tx, 2, S::Stream7, C::Channel4 },
+    { R::Usart2Rx, 1, S::Stream5, C::Channel4 },
+    { R::Usart2Tx, 1, S::Stream6, C::Channel4 },
+    { R::Usart3Rx, 1, S::Stream1, C::Channel4 },
+    { R::Usart3Tx, 1, S::Stream3, C::Channel4 }, { R::Usart3Tx, 1, S::Stream4, C::Channel7 },
+    { R::Uart4Rx, 1, S::Stream2, C::Channel4 },
+    { R::Uart4Tx, 1, S::Stream4, C::Channel4 },
+    { R::Uart5Rx, 1, S::Stream0, C::Channel4 },
+    { R::Uart5Tx, 1, S::Stream7, C::Channel4 },
+    { R::Usart6Rx, 2, S::Stream1, C::Channel5 }, { R::Usart6Rx, 2, S::Stream2, C::Channel5 },
+    { R::Usart6Tx, 2, S::Stream6, C::Channel5 }, { R::Usart6Tx, 2, S::Stream7, C::Channel5 },
+    { R::Sdio, 2, S::Stream3, C::Channel4 }, { R::Sdio, 2, S::Stream6, C::Channel4 },
+    { R::Adc1, 2, S::Stream0, C::Channel0 }, { R::Adc1, 2, S::Stream4, C::Channel0 },
+    { R::Adc2, 2, S::Stream2, C::Channel1 }, { R::Adc2, 2, S::Stream3, C::Channel1 },
+    { R::Adc3, 2, S::Stream0, C::Channel2 }, { R::Adc3, 2, S::Stream1, C::Channel2 },
+    { R::Dac1, 1, S::Stream5, C::Channel7 },
+    { R::Dac2, 1, S::Stream6, C::Channel7 },
+    { R::Dcmi, 2, S::Stream1, C::Channel1 }, { R::Dcmi, 2, S::Stream7, C::Channel1 },
+    { R::CrypIn, 2, S::Stream6, C::Channel2 },
+    { R::CrypOut, 2, S::Stream5, C::Channel2 },
+    { R::HashIn, 2, S::Stream7, C::Channel2 },
+    // the channel doesn't matter without a peripheral, the streams no peripheral above tries first come first
+    { R::MemoryToMemory, 2, S::Stream4, C::Channel0 }, { R::MemoryToMemory, 2, S::Stream5, C::Channel0 },
+    { R::MemoryToMemory, 2, S::Stream1, C::Channel0 }, { R::MemoryToMemory, 2, S::Stream6, C::Channel0 },
+    { R::MemoryToMemory, 2, S::Stream7, C::Channel0 }, { R::MemoryToMemory, 2, S::Stream3, C::Channel0 },
+    { R::MemoryToMemory, 2, S::Stream2, C::Channel0 }, { R::MemoryToMemory, 2, S::Stream0, C::Channel0 },
+};
+
+const unsigned int DmaManager::MAPPING_SIZE = sizeof(DmaManager::MAPPING) / sizeof(DmaManager::MAPPING[0]);
+const unsigned int DmaManager::STREAMS;
+const unsigned int DmaManager::MAX_CONFLICTS;
+
+DmaManager::Share::Share(const Mapping &mapping, const char *owner, Dma::Stream::Priority priority, Callback *callback, unsigned int slot, Dma::Stream *stream) :
+    mMapping(mapping),
+    mOwner(owner),
+    mPriority(priority),
+    mCallback(callback),
+    mSlot(slot),
+    mStream(stream),
+    mNext(nullptr)
+{
+}
+
+DmaManager::DmaManager(Dma &dma1, Dma &dma2, InterruptController &nvic, const InterruptController::Index *interrupts) :
+    mDma1(dma1),
+    mDma2(dma2),
+    mNvic(nvic),
+    mInterrupts(interrupts),
+    mConflictCount(0)
+{
+    for (Slot& slot : mSlots)
+    {
+        slot.mStream = nullptr;
+        slot.mOwner = nullptr;
+        slot.mMapping = nullptr;
+        slot.mShares = 0;
+        slot.mHolder = nullptr;
+        slot.mWaiting = nullptr;
+    }
+}
+
+Dma::Stream* DmaManager::claim(DmaManager::Request request, const char *owner)
+{
+    const Mapping* m;
+    for (unsigned int i = 0; (m = mapping(request, i)) != nullptr; ++i)
+    {
+        Slot& slot = mSlots[slotIndex(*m)];
+        if (slot.mOwner == nullptr && slot.mShares == 0)
+        {
+            slot.mOwner = owner;
+            slot.mMapping = m;
+            return stream(*m);
+        }
+    }
+    conflict(owner);
+    return nullptr;
+}
+
+void DmaManager::release(Dma::Stream *stream)
+{
+    for (Slot& slot : mSlots)
+    {
+        if (slot.mStream == stream && slot.mOwner != nullptr)
+        {
+            stream->stop();
+            // no interrupts left over for the owner before
+            stream->setCallback(nullptr);
+            slot.mOwner = nullptr;
+            slot.mMapping = nullptr;
+        }
+    }
+}
+
+DmaManager::Share* DmaManager::share(DmaManager::Request request, const char *owner, Dma::Stream::Priority priority, DmaManager::Share::Callback *callback)
+{
+    // a free stream, otherwise the one with the fewest users
+    const Mapping* best = nullptr;
+    const Mapping* m;
+    for (unsigned int i = 0; (m = mapping(request, i)) != nullptr; ++i)
+    {
+        const Slot& slot = mSlots[slotIndex(*m)];
+        if (slot.mOwner != nullptr) continue;
+        if (best == nullptr || slot.mShares < mSlots[slotIndex(*best)].mShares) best = m;
+    }
+    if (best == nullptr)
+    {
+        conflict(owner);
+        return nullptr;
+    }
+    unsigned int index = slotIndex(*best);
+    ++mSlots[index].mShares;
+    return new Share(*best, owner, priority, callback, index, stream(*best));
+}
+
+bool DmaManager::acquire(DmaManager::Share *share)
+{
+    Slot& slot = mSlots[share->mSlot];
+    uint32_t mask = interrupt_disable();
+    bool granted = slot.mHolder == share;
+    if (slot.mHolder == nullptr)
+    {
+        grant(share);
+        granted = true;
+    }
+    else if (!granted)
+    {
+        // after the ones with the same priority, once
+        Share** next = &slot.mWaiting;
+        while (*next != nullptr && *next != share && (*next)->mPriority >= share->mPriority) next = &(*next)->mNext;
+        if (*next != share)
+        {
+            share->mNext = *next;
+            *next = share;
+        }
+    }
+    interrupt_restore(mask);
+    return granted;
+}
+
+void DmaManager::release(DmaManager::Share *share)
+{
+    Slot& slot = mSlots[share->mSlot];
+    Share* next = nullptr;
+    uint32_t mask = interrupt_disable();
+    if (slot.mHolder == share)
+    {
+        next = slot.mWaiting;
+        slot.mHolder = nullptr;
+        if (next != nullptr)
+        {
+            slot.mWaiting = next->mNext;
+            next->mNext = nullptr;
+            grant(next);
+        }
+    }
+    else
+    {
+        Share** waiting = &slot.mWaiting;
+        while (*waiting != nullptr && *waiting != share) waiting = &(*waiting)->mNext;
+        if (*waiting == share) *waiting = share->mNext;
+        share->mNext = nullptr;
+    }
+    interrupt_restore(mask);
+    if (next != nullptr && next->mCallback != nullptr) next->mCallback->dmaGranted(next, next->mStream);
+}
+
+void DmaManager::report()
+{
+    for (unsigned int i = 0; i < STREAMS; ++i)
+    {
+        const Slot& slot = mSlots[i];
+        if (slot.mOwner != nullptr)
+        {
+            printf("DMA%u stream %u channel %u: %s\n", i / 8 + 1, i % 8, static_cast<unsigned int>(slot.mMapping->mChannel), slot.mOwner);
+        }
+        else if (slot.mShares > 0)
+        {
+            printf("DMA%u stream %u: shared by %u\n", i / 8 + 1, i % 8, slot.mShares);
+        }
+    }
+    for (unsigned int i = 0; i < std::min(mConflictCount, MAX_CONFLICTS); ++i) printf("DMA conflict: no stream left for %s\n", mConflicts[i]);
+    if (mConflictCount > MAX_CONFLICTS) printf("DMA conflict: %u more\n", mConflictCount - MAX_CONFLICTS);
+}
+
+const DmaManager::Mapping* DmaManager::mapping(DmaManager::Request request, unsigned int index)
+{
+    for (const Mapping& m : MAPPING)
+    {
+        if (m.mRequest == request && index-- == 0) return &m;
+    }
+    return nullptr;
+}
+
+unsigned int DmaManager::slotIndex(const DmaManager::Mapping &mapping)
+{
+    return (mapping.mDma - 1) * 8 + static_cast<unsigned int>(mapping.mStream);
+}
+
+Dma::Stream* DmaManager::stream(const DmaManager::Mapping &mapping)
+{
+    unsigned int index = slotIndex(mapping);
+    Slot& slot = mSlots[index];
+    if (slot.mStream == nullptr)
+    {
+        InterruptController::Line* line = mInterrupts != nullptr ? new InterruptController::Line(mNvic, mInterrupts[index]) : nullptr;
+        slot.mStream = new Dma::Stream(mapping.mDma == 1 ? mDma1 : mDma2, mapping.mStream, mapping.mChannel, line);
+    }
+    else
+    {
+        slot.mStream->setChannel(mapping.mChannel);
+    }
+    return slot.mStream;
+}
+
+void DmaManager::conflict(const char *owner)
+{
+    if (mConflictCount < MAX_CONFLICTS) mConflicts[mConflictCount] = owner;
+    ++mConflictCount;
+}
+
+void DmaManager::grant(DmaManager::Share *share)
+{
+    mSlots[share->mSlot].mHolder = share;
+    share->mStream->setChannel(share->mMapping.mChannel);
+    share->mStream->setPriority(share->mPriority);
+}
@@ -0,0 +1,117 @@
+#ifndef DMAMANAGER_H
+#define DMAMANAGER_H
+
+#include "Dma.h"
+#include "InterruptController.h"
+
+#include <cstdint>
+
+// Hands out the streams of DMA1 and DMA2 by the request mapping of the STM32F407 (RM0090 tables 42 and 43),
+// instead of hard coded stream and channel pairs. A claim gets the first free stream that serves the request.
+// When there is none left it is a conflict, it is recorded and printed by report().
+// A stream that isn't claimed can be shared, the users take turns with acquire() and release(), the highest
+// priority waiting gets it next, with its channel and priority set.
+// The timers and the I2S extensions are left out of the table, there are no drivers for them.
+class DmaManager
+{
+public:
+    enum class Request
+    {
+        Spi1Rx, Spi1Tx, Spi2Rx, Spi2Tx, Spi3Rx, Spi3Tx,
+        I2c1Rx, I2c1Tx, I2c2Rx, I2c2Tx, I2c3Rx, I2c3Tx,
+        Usart1Rx, Usart1Tx, Usart2Rx, Usart2Tx, Usart3Rx, Usart3Tx, Uart4Rx, Uart4Tx, Uart5Rx, Uart5Tx, Usart6Rx, Usart6Tx,
+        Sdio, Adc1, Adc2, Adc3, Dac1, Dac2, Dcmi, CrypIn, CrypOut, HashIn,
+        // DMA2 only
+        MemoryToMemory,
+    };
+
+    struct Mapping
+    {
+        Request mRequest;
+        // 1 or 2
+        uint8_t mDma;
+        Dma::Stream::StreamIndex mStream;
+        Dma::Stream::ChannelIndex mChannel;
+    };
+    static const Mapping MAPPING[];
+    static const unsigned int MAPPING_SIZE;
+    static const unsigned int STREAMS = 16;
+    static const unsigned int MAX_CONFLICTS = 8;
+
+    class Share
+    {
+    public:
+        class Callback
+        {
+        public:
+            // from release() of the user before, that can be in an interrupt
+            virtual void dmaGranted(Share* share, Dma::Stream* stream) = 0;
+        };
+
+        Dma::Stream* stream() { return mStream; }
+        const char* owner() const { return mOwner; }
+    private:
+        Share(const Mapping& mapping, const char* owner, Dma::Stream::Priority priority, Callback* callback, unsigned int slot, Dma::Stream* stream);
+
+        const Mapping& mMapping;
+        const char* mOwner;
+        Dma::Stream::Priority mPriority;
+        Callback* mCallback;
+        unsigned int mSlot;
+        Dma::Stream* mStream;
+        // waiting for the stream, by priority
+        Share* mNext;
+
+        friend class DmaManager;
+    };
+
+    // the interrupts of the streams, DMA1 stream 0 to 7 and then DMA2
+    DmaManager(Dma& dma1, Dma& dma2, InterruptController& nvic, const InterruptController::Index* interrupts);
+
+    // A stream for the request alone, nullptr if all of them are taken.
+    Dma::Stream* claim(Request request, const char* owner);
+    // the stream can be claimed or shared again
+    void release(Dma::Stream* stream);
+
+    // A stream the request takes turns on, nullptr if all of them are claimed.
+    Share* share(Request request, const char* owner, Dma::Stream::Priority priority, Share::Callback* callback);
+    // True if the stream is the one of the share now, otherwise it waits for dmaGranted().
+    bool acquire(Share* share);
+    // gives it to the next one waiting, or takes the share out of the waiting ones
+    void release(Share* share);
+
+    unsigned int conflicts() const { return mConflictCount; }
+    // the streams in use and the conflicts
+    void report();
+
+    // where the request can go
+    static const Mapping* mapping(Request request, unsigned int index);
+
+private:
+    struct Slot
+    {
+        Dma::Stream* mStream;
+        // for a claim
+        const char* mOwner;
+        const Mapping* mMapping;
+        unsigned int mShares;
+        Share* mHolder;
+        Share* mWaiting;
+    };
+
+    Dma& mDma1;
+    Dma& mDma2;
+    InterruptController& mNvic;
+    const InterruptController::Index* mInterrupts;
+    Slot mSlots[STREAMS];
+    // the owners that didn't get a stream
+    const char* mConflicts[MAX_CONFLICTS];
+    unsigned int mConflictCount;
+
+    static unsigned int slotIndex(const Mapping& mapping);
+    Dma::Stream* stream(const Mapping& mapping);
+    void conflict(const char* owner);
+    void grant(Share* share);
+};
+
+#endif // DMAMANAGER_H
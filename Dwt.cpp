@@ -0,0 +1,18 @@
+#include "Dwt.h"
+
+Dwt::Dwt(System::BaseAddress base, System::BaseAddress coreDebug) :
+    mBase(reinterpret_cast<volatile DWT*>(base)),
+    mCoreDebug(reinterpret_cast<volatile CoreDebug*>(coreDebug))
+{
+    static_assert(sizeof(DWT) == 0x20, "Struct has wrong size, compiler problem.");
+    static_assert(sizeof(CoreDebug) == 0x10, "Struct has wrong size, compiler problem.");
+    enableCycleCounter();
+}
+
+void Dwt::enableCycleCounter()
+{
+    // the DWT is powered down without the trace enable
+    mCoreDebug->DEMCR.TRCENA = 1;
+    mBase->CYCCNT = 0;
+    mBase->CTRL.CYCCNTENA = 1;
+}
@@ -0,0 +1,82 @@
+#ifndef DWT_H
+#define DWT_H
+
+#include "System.h"
+
+// Data watchpoint and trace unit, only its cycle counter is used.
+// The counter runs from construction on, so whatever is built after it (Timebase) starts from a running one.
+class Dwt
+{
+public:
+    Dwt(System::BaseAddress base, System::BaseAddress coreDebug);
+
+    uint32_t cycles() const { return mBase->CYCCNT; }
+    const volatile uint32_t* cycleCounter() const { return &mBase->CYCCNT; }
+
+private:
+    struct DWT
+    {
+        struct __CTRL
+        {
+            uint32_t CYCCNTENA : 1;
+            uint32_t POSTPRESET : 4;
+            uint32_t POSTINIT : 4;
+            uint32_t CYCTAP : 1;
+            uint32_t SYNCTAP : 2;
+            uint32_t PCSAMPLENA : 1;
+            uint32_t __RESERVED0 : 3;
+            uint32_t EXCTRCENA : 1;
+            uint32_t CPIEVTENA : 1;
+            uint32_t EXCEVTENA : 1;
+            uint32_t SLEEPEVTENA : 1;
+            uint32_t LSUEVTENA : 1;
+            uint32_t FOLDEVTENA : 1;
+            uint32_t CYCEVTENA : 1;
+            uint32_t __RESERVED1 : 1;
+            uint32_t NOPRFCNT : 1;
+            uint32_t NOCYCCNT : 1;
+            uint32_t NOEXTTRIG : 1;
+            uint32_t NOTRCPKT : 1;
+            uint32_t NUMCOMP : 4;
+        }   CTRL;
+        uint32_t CYCCNT;
+        uint32_t CPICNT;
+        uint32_t EXCCNT;
+        uint32_t SLEEPCNT;
+        uint32_t LSUCNT;
+        uint32_t FOLDCNT;
+        uint32_t PCSR;
+    };
+    struct CoreDebug
+    {
+        uint32_t DHCSR;
+        uint32_t DCRSR;
+        uint32_t DCRDR;
+        struct __DEMCR
+        {
+            uint32_t VC_CORERESET : 1;
+            uint32_t __RESERVED0 : 3;
+            uint32_t VC_MMERR : 1;
+            uint32_t VC_NOCPERR : 1;
+            uint32_t VC_CHKERR : 1;
+            uint32_t VC_STATERR : 1;
+            uint32_t VC_BUSERR : 1;
+            uint32_t VC_INTERR : 1;
+            uint32_t VC_HARDERR : 1;
+            uint32_t __RESERVED1 : 5;
+            uint32_t MON_EN : 1;
+            uint32_t MON_PEND : 1;
+            uint32_t MON_STEP : 1;
+            uint32_t MON_REQ : 1;
+            uint32_t __RESERVED2 : 4;
+            uint32_t TRCENA : 1;
+            uint32_t __RESERVED3 : 7;
+        }   DEMCR;
+    };
+    volatile DWT* mBase;
+    volatile CoreDebug* mCoreDebug;
+
+    void enableCycleCounter();
+};
+
+#endif // DWT_H
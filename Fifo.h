@@ -0,0 +1,27 @@
+#ifndef FIFO_H
+#define FIFO_H
+
+// What Stream needs from the buffer behind it, so it can be a CircularBuffer or a BipBuffer.
+template<typename T>
+class Fifo
+{
+public:
+    virtual ~Fifo() { }
+
+    virtual unsigned int used() = 0;
+    virtual unsigned int free() = 0;
+
+    virtual bool push(T elem) = 0;
+    virtual bool pop(T &elem) = 0;
+    virtual unsigned int write(const T* data, unsigned int len) = 0;
+    virtual unsigned int read(T* data, unsigned int len) = 0;
+
+    // contiguous memory to write to, at most len, what got written there becomes readable with commit()
+    virtual unsigned int reserve(T*& data, unsigned int len = ~0u) = 0;
+    virtual void commit(unsigned int len) = 0;
+    // contiguous memory to read from, release() frees it
+    virtual unsigned int peek(const T*& data) = 0;
+    virtual unsigned int release(unsigned int len) = 0;
+};
+
+#endif // FIFO_H
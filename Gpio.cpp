@@ -18,7 +18,7 @@
 
 #include "Gpio.h"
 
-Gpio::Gpio(unsigned int base) :
+Gpio::Gpio(unsigned long base) :
     mBase(reinterpret_cast<volatile GPIO*>(base))
 {
     static_assert(sizeof(GPIO) == 0x28, "Struct has wrong size, compiler problem.");
@@ -91,7 +91,7 @@ public:
 
     };
 
-    Gpio(unsigned int base);
+    Gpio(unsigned long base);
     ~Gpio();
 
     bool get(Index index);
@@ -19,15 +19,16 @@
 #include "InterruptController.h"
 #include "System.h"
 
-InterruptController::InterruptController(unsigned int base, std::size_t vectorSize) :
+InterruptController::InterruptController(unsigned long base, std::size_t vectorSize) :
     mBase(reinterpret_cast<volatile NVIC*>(base))
 {
     static_assert(sizeof(NVIC) == 0xe04, "Struct has wrong size, compiler problem.");
-    mHandler = new Callback*[vectorSize];
+    mHandler = new Callback*[vectorSize]();
 }
 
 InterruptController::~InterruptController()
 {
+    delete[] mHandler;
 }
 
 void InterruptController::handle(Index index)
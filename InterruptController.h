@@ -27,7 +27,7 @@ public:
     typedef std::uint8_t Index;
     enum class Priority { Highest, Prio1, Prio2, High, Prio4, MediumHigh, Prio6, Medium, Prio8, MediumLow, Prio10, Low, Prio12, Prio13, Prio14, Lowest };
 
-    InterruptController(unsigned int base, std::size_t vectorSize);
+    InterruptController(unsigned long base, std::size_t vectorSize);
     ~InterruptController();
 
     void handle(Index index);
@@ -0,0 +1,65 @@
+#include "LockFreeQueue.h"
+#include "System.h"
+#include "atomic.h"
+
+#include <cassert>
+
+template<typename T>
+LockFreeQueue<T>::LockFreeQueue(unsigned int size) :
+    mSize(size),
+    mMask(size - 1),
+    mWrite(0),
+    mRead(0)
+{
+    assert((size & (size - 1)) == 0);
+    mSlot = new Slot[mSize];
+    for (unsigned int i = 0; i < mSize; ++i) mSlot[i].mSequence = i;
+}
+
+template<typename T>
+LockFreeQueue<T>::~LockFreeQueue()
+{
+    delete [] mSlot;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::push(T elem)
+{
+    uint32_t pos = mWrite;
+    Slot* slot;
+    while (true)
+    {
+        slot = &mSlot[pos & mMask];
+        int32_t diff = static_cast<int32_t>(slot->mSequence - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange(&mWrite, pos, pos + 1)) break;
+        }
+        // the consumer didn't release this slot yet
+        else if (diff < 0) return false;
+        pos = mWrite;
+    }
+    slot->mElem = elem;
+    atomic_barrier();
+    slot->mSequence = pos + 1;
+    return true;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::pop(T &elem)
+{
+    uint32_t pos = mRead;
+    Slot* slot = &mSlot[pos & mMask];
+    // empty or the producer is not done yet
+    if (static_cast<int32_t>(slot->mSequence - (pos + 1)) < 0) return false;
+    atomic_barrier();
+    elem = slot->mElem;
+    atomic_barrier();
+    slot->mSequence = pos + mSize;
+    mRead = pos + 1;
+    return true;
+}
+
+template class LockFreeQueue<System::Event*>;
+// for the tests
+template class LockFreeQueue<uint32_t>;
@@ -0,0 +1,38 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <cstdint>
+
+// Bounded queue for many producers (interrupts on any level, main loop) and a single consumer (main loop).
+// Producers claim a slot with a compare and exchange on the write position and publish it by updating
+// the sequence number of the slot, so no interrupts have to be disabled. The size must be a power of 2.
+template<typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue(unsigned int size);
+    ~LockFreeQueue();
+
+    // used() includes slots that are claimed but not yet published
+    inline unsigned int used() { return mWrite - mRead; }
+    inline unsigned int free() { return mSize - used(); }
+    inline unsigned int size() { return mSize; }
+
+    bool push(T elem);
+    bool pop(T &elem);
+
+private:
+    struct Slot
+    {
+        volatile uint32_t mSequence;
+        T mElem;
+    };
+
+    unsigned int mSize;
+    uint32_t mMask;
+    Slot* mSlot;
+    volatile uint32_t mWrite;
+    volatile uint32_t mRead;
+};
+
+#endif // LOCKFREEQUEUE_H
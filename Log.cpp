@@ -0,0 +1,93 @@
+#include "Log.h"
+#include "atomic.h"
+
+#include <cstring>
+
+const unsigned int Log::SIZE;
+const unsigned int Log::RECORD_WORDS;
+const char Log::MAGIC[4] = { 'L', 'O', 'G', '1' };
+
+static const uint32_t NO_COUNTER = 0;
+
+Log::Log() :
+    mWrite(0),
+    mRead(0),
+    mLost(0),
+    mCounter(&NO_COUNTER)
+{
+    static_assert(sizeof(Header) == 16, "Struct has wrong size, compiler problem.");
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2.");
+    for (unsigned int i = 0; i < SIZE; ++i) mRing[i] = 0;
+}
+
+unsigned int Log::put(uint32_t *data, unsigned long long arg)
+{
+    data[0] = static_cast<uint32_t>(arg);
+    data[1] = static_cast<uint32_t>(arg >> 32);
+    return 2;
+}
+
+unsigned int Log::put(uint32_t *data, double arg)
+{
+    std::memcpy(data, &arg, sizeof(arg));
+    return 2;
+}
+
+void Log::add(Log::Level level, const char *format, const uint32_t *data, unsigned int count)
+{
+    unsigned int size = RECORD_WORDS + count;
+    uint32_t pos;
+    do
+    {
+        pos = mWrite;
+        if (pos + size - mRead > SIZE)
+        {
+            uint32_t lost;
+            do
+            {
+                lost = mLost;
+            }   while (!atomic_compare_exchange(&mLost, lost, lost + 1));
+            return;
+        }
+    }   while (!atomic_compare_exchange(&mWrite, pos, pos + size));
+    mRing[(pos + 1) & (SIZE - 1)] = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(format));
+    mRing[(pos + 2) & (SIZE - 1)] = *mCounter;
+    for (unsigned int i = 0; i < count; ++i) mRing[(pos + RECORD_WORDS + i) & (SIZE - 1)] = data[i];
+    // the header goes last, up to here the reader stops in front of the record
+    mRing[pos & (SIZE - 1)] = recordHeader(level, count);
+}
+
+unsigned int Log::available() const
+{
+    uint32_t pos = mRead;
+    uint32_t header;
+    while (pos != mWrite && (header = mRing[pos & (SIZE - 1)]) != 0) pos += RECORD_WORDS + recordArgWords(header);
+    return pos - mRead;
+}
+
+unsigned int Log::read(uint32_t *data, unsigned int len)
+{
+    unsigned int count = 0;
+    uint32_t header;
+    while (mRead != mWrite && (header = mRing[mRead & (SIZE - 1)]) != 0)
+    {
+        unsigned int size = RECORD_WORDS + recordArgWords(header);
+        if (count + size > len) break;
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            data[count++] = mRing[(mRead + i) & (SIZE - 1)];
+            // cleared before the writers can have it again
+            mRing[(mRead + i) & (SIZE - 1)] = 0;
+        }
+        mRead += size;
+    }
+    return count;
+}
+
+void Log::header(Log::Header &header, uint32_t clock, uint32_t count) const
+{
+    std::memcpy(header.mMagic, MAGIC, sizeof(header.mMagic));
+    header.mClock = clock;
+    header.mCount = count;
+    header.mLost = mLost;
+}
@@ -0,0 +1,127 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstdint>
+
+// Deferred logging: a LOG_...() call only stores the address of its format string, the cycle counter and
+// the raw arguments in a ring of words, tools/logdecode does the formatting on the host. The format strings
+// go into the section logstr, which the linker script keeps in the ELF file but not in the flash.
+// The arguments are 32 bit words like on the STM32, long long and double take 2 of them. %s only gets the
+// address of the string, the decoder shows that instead of the text.
+// A record is only written if there is room for it, otherwise it is counted as lost. read() takes the
+// complete ones out while new ones are coming in, this is what the log command dumps.
+// The levels above LOG_LEVEL are compiled out, build with "make LOG_LEVEL=4" to get all of them.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// writes to the given Log, the System one is used by the LOG_...() macros below
+#define LOG_TO(log, level, ...) \
+    do \
+    { \
+        static const char logFormat[] __attribute__((section("logstr"), used)) = LOG_FORMAT(__VA_ARGS__, ""); \
+        (log).write(level, logFormat, __VA_ARGS__); \
+    }   while (false)
+#define LOG_FORMAT(format, ...) format
+#define LOG(level, ...) LOG_TO(System::instance()->log(), level, __VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG(Log::Level::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do { } while (false)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) LOG(Log::Level::Warning, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) do { } while (false)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG(Log::Level::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do { } while (false)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG(Log::Level::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do { } while (false)
+#endif
+
+class Log
+{
+public:
+    enum class Level : uint8_t { Error = LOG_LEVEL_ERROR, Warning, Info, Debug };
+
+    static const unsigned int SIZE = 1024;
+    // header, format and cycle counter, followed by the arguments
+    static const unsigned int RECORD_WORDS = 3;
+    static const char MAGIC[4];
+
+    // starts a dump, followed by mCount words of records, little endian as the STM32 writes it
+    struct Header
+    {
+        char mMagic[4];
+        uint32_t mClock;
+        uint32_t mCount;
+        uint32_t mLost;
+    };
+
+    // never 0, that's how the reader sees a record isn't complete yet
+    static uint32_t recordHeader(Level level, unsigned int argWords) { return static_cast<uint32_t>(level) << 24 | argWords; }
+    static Level recordLevel(uint32_t header) { return static_cast<Level>(header >> 24); }
+    static unsigned int recordArgWords(uint32_t header) { return header & 0xffff; }
+
+    Log();
+
+    // counts with clock Hz, without one all records have the time 0
+    void setCounter(const volatile uint32_t* counter) { mCounter = counter; }
+
+    // the macros pass the format string twice, the one in logstr and the literal, which isn't used
+    template<typename... Args>
+    __attribute__((always_inline)) void write(Level level, const char* format, const char*, Args... args)
+    {
+        uint32_t data[2 * sizeof...(Args) + 1];
+        unsigned int count = pack(data, args...);
+        add(level, format, sizeof...(Args) != 0 ? data : nullptr, count);
+    }
+
+    // words of complete records waiting to be read
+    unsigned int available() const;
+    // takes out whole records, oldest first, as many as fit into len words
+    unsigned int read(uint32_t* data, unsigned int len);
+    uint32_t lost() const { return mLost; }
+    void header(Header& header, uint32_t clock, uint32_t count) const;
+
+private:
+    volatile uint32_t mRing[SIZE];
+    volatile uint32_t mWrite;
+    volatile uint32_t mRead;
+    volatile uint32_t mLost;
+    const volatile uint32_t* mCounter;
+
+    void add(Level level, const char* format, const uint32_t* data, unsigned int count);
+
+    static unsigned int pack(uint32_t*) { return 0; }
+    template<typename T, typename... Args>
+    static unsigned int pack(uint32_t* data, T arg, Args... args)
+    {
+        unsigned int len = put(data, arg);
+        return len + pack(data + len, args...);
+    }
+    static unsigned int put(uint32_t* data, int arg) { *data = arg; return 1; }
+    static unsigned int put(uint32_t* data, unsigned int arg) { *data = arg; return 1; }
+    static unsigned int put(uint32_t* data, long arg) { *data = arg; return 1; }
+    static unsigned int put(uint32_t* data, unsigned long arg) { *data = arg; return 1; }
+    static unsigned int put(uint32_t* data, long long arg) { return put(data, static_cast<unsigned long long>(arg)); }
+    static unsigned int put(uint32_t* data, unsigned long long arg);
+    static unsigned int put(uint32_t* data, double arg);
+    static unsigned int put(uint32_t* data, const void* arg) { *data = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg)); return 1; }
+};
+
+#endif // LOG_H
@@ -0,0 +1,93 @@
+#include "PriorityQueue.h"
+#include "System.h"
+#include "atomic.h"
+
+template<typename T, unsigned int COUNT>
+PriorityQueue<T, COUNT>::PriorityQueue(unsigned int size, unsigned int maxSkip) :
+    mMaxSkip(maxSkip)
+{
+    for (unsigned int p = 0; p < COUNT; ++p)
+    {
+        mQueue[p] = new LockFreeQueue<T>(size);
+        mSkipped[p] = 0;
+    }
+    resetStatistic();
+}
+
+template<typename T, unsigned int COUNT>
+PriorityQueue<T, COUNT>::~PriorityQueue()
+{
+    for (unsigned int p = 0; p < COUNT; ++p) delete mQueue[p];
+}
+
+template<typename T, unsigned int COUNT>
+bool PriorityQueue<T, COUNT>::push(T elem, unsigned int priority)
+{
+    if (priority >= COUNT) priority = COUNT - 1;
+    if (!mQueue[priority]->push(elem))
+    {
+        atomic_add(&mOverflow[priority], 1);
+        return false;
+    }
+    uint32_t used = mQueue[priority]->used();
+    uint32_t maxUsed = mMaxUsed[priority];
+    while (used > maxUsed && !atomic_compare_exchange(&mMaxUsed[priority], maxUsed, used)) maxUsed = mMaxUsed[priority];
+    return true;
+}
+
+template<typename T, unsigned int COUNT>
+bool PriorityQueue<T, COUNT>::pop(T &elem)
+{
+    unsigned int selected = COUNT;
+    for (unsigned int p = 0; p < COUNT; ++p)
+    {
+        if (mQueue[p]->used() == 0) continue;
+        if (selected == COUNT) selected = p;
+        else if (mSkipped[p] >= mMaxSkip)
+        {
+            // this one waited long enough, serve it before the higher classes
+            selected = p;
+            break;
+        }
+    }
+    if (selected == COUNT) return false;
+
+    // used() counts slots that are claimed but not published yet, then the others go first
+    unsigned int served = selected;
+    if (!mQueue[selected]->pop(elem))
+    {
+        served = COUNT;
+        for (unsigned int p = 0; p < COUNT && served == COUNT; ++p)
+        {
+            if (p != selected && mQueue[p]->used() != 0 && mQueue[p]->pop(elem)) served = p;
+        }
+        if (served == COUNT) return false;
+    }
+
+    for (unsigned int p = 0; p < COUNT; ++p)
+    {
+        if (p == served || mQueue[p]->used() == 0) mSkipped[p] = 0;
+        else ++mSkipped[p];
+    }
+    return true;
+}
+
+template<typename T, unsigned int COUNT>
+unsigned int PriorityQueue<T, COUNT>::used()
+{
+    unsigned int used = 0;
+    for (unsigned int p = 0; p < COUNT; ++p) used += mQueue[p]->used();
+    return used;
+}
+
+template<typename T, unsigned int COUNT>
+void PriorityQueue<T, COUNT>::resetStatistic()
+{
+    for (unsigned int p = 0; p < COUNT; ++p)
+    {
+        mMaxUsed[p] = mQueue[p]->used();
+        mOverflow[p] = 0;
+    }
+}
+
+template class PriorityQueue<System::Event*, System::Event::PRIORITY_COUNT>;
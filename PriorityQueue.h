@@ -0,0 +1,36 @@
+#ifndef PRIORITYQUEUE_H
+#define PRIORITYQUEUE_H
+
+#include "LockFreeQueue.h"
+
+#include <cstdint>
+
+// A set of FIFOs, one per priority class (0 is the highest).
+// pop() always serves the highest non-empty class, but a lower class that was passed over
+// maxSkip times in a row gets served once, so it can't starve.
+// push() can be called from any interrupt, pop() only from a single consumer.
+template<typename T, unsigned int COUNT>
+class PriorityQueue
+{
+public:
+    PriorityQueue(unsigned int size, unsigned int maxSkip);
+    ~PriorityQueue();
+
+    bool push(T elem, unsigned int priority);
+    bool pop(T& elem);
+
+    unsigned int used();
+    inline unsigned int used(unsigned int priority) { return mQueue[priority]->used(); }
+    inline unsigned int maxUsed(unsigned int priority) { return mMaxUsed[priority]; }
+    inline unsigned int overflow(unsigned int priority) { return mOverflow[priority]; }
+    void resetStatistic();
+
+private:
+    LockFreeQueue<T>* mQueue[COUNT];
+    unsigned int mMaxSkip;
+    unsigned int mSkipped[COUNT];
+    volatile uint32_t mMaxUsed[COUNT];
+    volatile int32_t mOverflow[COUNT];
+};
+
+#endif // PRIORITYQUEUE_H
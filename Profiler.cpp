@@ -0,0 +1,85 @@
+#include "Profiler.h"
+
+#include <cstring>
+
+const unsigned int Profiler::HISTOGRAM_SIZE;
+const unsigned int Profiler::HISTOGRAM_SHIFT;
+const unsigned int Profiler::MAX_EVENTS;
+const unsigned int Profiler::MAX_INTERRUPTS;
+
+Profiler::Profiler()
+{
+    std::memset(mEvent, 0, sizeof(mEvent));
+    std::memset(mInterrupt, 0, sizeof(mInterrupt));
+    reset(0);
+}
+
+void Profiler::eventDone(const void *event, uint32_t ns)
+{
+    Entry* entry = find(event, true);
+    if (entry != nullptr) add(*entry, ns);
+    else ++mEventsLost;
+}
+
+void Profiler::interruptDone(unsigned int index, uint32_t ns)
+{
+    if (index < MAX_INTERRUPTS) add(mInterrupt[index], ns);
+}
+
+void Profiler::setName(const void *event, const char *name)
+{
+    Entry* entry = find(event, true);
+    if (entry != nullptr) entry->mName = name;
+}
+
+void Profiler::reset(uint64_t now)
+{
+    // keep the keys and names, the events are still around
+    for (Entry& entry : mEvent) clear(entry);
+    for (Entry& entry : mInterrupt) clear(entry);
+    mEventsLost = 0;
+    mStart = now;
+}
+
+Profiler::Entry* Profiler::find(const void *event, bool create)
+{
+    // open addressing, events never go away so there is no need for deleting entries
+    unsigned int hash = (reinterpret_cast<uintptr_t>(event) >> 2) % MAX_EVENTS;
+    for (unsigned int i = 0; i < MAX_EVENTS; ++i)
+    {
+        Entry& entry = mEvent[(hash + i) % MAX_EVENTS];
+        if (entry.mKey == event) return &entry;
+        if (entry.mKey == nullptr)
+        {
+            if (!create) return nullptr;
+            entry.mKey = event;
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+unsigned int Profiler::bucket(uint32_t ns)
+{
+    ns >>= HISTOGRAM_SHIFT;
+    if (ns == 0) return 0;
+    unsigned int bucket = 32 - __builtin_clz(ns);
+    return bucket < HISTOGRAM_SIZE ? bucket : HISTOGRAM_SIZE - 1;
+}
+
+void Profiler::add(Entry &entry, uint32_t ns)
+{
+    ++entry.mCount;
+    entry.mTotalNs += ns;
+    if (ns > entry.mMaxNs) entry.mMaxNs = ns;
+    uint16_t& count = entry.mHistogram[bucket(ns)];
+    if (count != 0xffff) ++count;
+}
+
+void Profiler::clear(Entry &entry)
+{
+    entry.mCount = 0;
+    entry.mMaxNs = 0;
+    entry.mTotalNs = 0;
+    std::memset(entry.mHistogram, 0, sizeof(entry.mHistogram));
+}
@@ -0,0 +1,54 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+
+// Call count, total and maximum time and a log2 histogram of the time spent per event and per interrupt.
+// System only owns one when built with PROFILER defined (make PROFILER=1), otherwise the hooks in the
+// event loop and in System::handleInterrupt are compiled out.
+class Profiler
+{
+public:
+    static const unsigned int HISTOGRAM_SIZE = 16;
+    // the first bucket holds everything below 2^HISTOGRAM_SHIFT ns, every further one doubles
+    static const unsigned int HISTOGRAM_SHIFT = 10;
+    static const unsigned int MAX_EVENTS = 32;
+    static const unsigned int MAX_INTERRUPTS = 82;
+
+    struct Entry
+    {
+        const void* mKey;
+        const char* mName;
+        uint32_t mCount;
+        uint32_t mMaxNs;
+        uint64_t mTotalNs;
+        uint16_t mHistogram[HISTOGRAM_SIZE];
+    };
+
+    Profiler();
+
+    void eventDone(const void* event, uint32_t ns);
+    void interruptDone(unsigned int index, uint32_t ns);
+    void setName(const void* event, const char* name);
+    void reset(uint64_t now);
+
+    Entry* event(unsigned int i) { return (i < MAX_EVENTS && mEvent[i].mKey != nullptr) ? &mEvent[i] : nullptr; }
+    Entry* interrupt(unsigned int i) { return (i < MAX_INTERRUPTS) ? &mInterrupt[i] : nullptr; }
+    Entry* find(const void* event, bool create);
+    uint32_t eventsLost() { return mEventsLost; }
+    uint64_t start() { return mStart; }
+
+    static unsigned int bucket(uint32_t ns);
+    static uint32_t bucketLimit(unsigned int bucket) { return 1u << (HISTOGRAM_SHIFT + bucket); }
+
+private:
+    Entry mEvent[MAX_EVENTS];
+    Entry mInterrupt[MAX_INTERRUPTS];
+    uint32_t mEventsLost;
+    uint64_t mStart;
+
+    void add(Entry& entry, uint32_t ns);
+    void clear(Entry& entry);
+};
+
+#endif // PROFILER_H
@@ -124,7 +124,7 @@ void Serial::configDma(Dma::Stream *write, Dma::Stream *read)
     {
         mDmaWrite->config(Dma::Stream::Direction::MemoryToPeripheral, false, true, Dma::Stream::DataSize::Byte, Dma::Stream::DataSize::Byte, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
         mDmaWrite->setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(&mBase->DR));
-        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::ThreeQuater);
+        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Auto);
         mBase->CR3.DMAT = 1;
     }
     else
@@ -135,13 +135,60 @@ void Serial::configDma(Dma::Stream *write, Dma::Stream *read)
     {
         mDmaRead->config(Dma::Stream::Direction::PeripheralToMemory, false, true, Dma::Stream::DataSize::Byte, Dma::Stream::DataSize::Byte, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
         mDmaRead->setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(&mBase->DR));
-        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Quater);
+        // direct mode, what the DMA counts as transferred has to be in memory already
+        mDmaRead->configFifo(Dma::Stream::FifoThreshold::Disable);
         mBase->CR3.DMAR = 1;
     }
     else
     {
         mBase->CR3.DMAR = 0;
     }
+    // the next readTrigger() starts the new stream
+    mBase->CR1.IDLEIE = 0;
+}
+
+bool Serial::readDoubleBuffer(char *buffer0, char *buffer1, unsigned int len, Device::DoubleBufferCallback *callback)
+{
+    if (mDmaRead == nullptr) return false;
+    if (mBase->CR1.IDLEIE)
+    {
+        // hand out what the circular stream got so far
+        mBase->CR1.IDLEIE = 0;
+        mDmaRead->stop();
+        waitReadStopped();
+        Stream<char>::readDmaPosition(mDmaRead->transferCount() - mDmaRead->remaining());
+    }
+    return startDoubleBuffer(buffer0, buffer1, len, callback);
+}
+
+void Serial::stopDoubleBuffer()
+{
+    if (!doubleBuffer()) return;
+    Device::stopDoubleBuffer();
+    waitReadStopped();
+    readTrigger();
+}
+
+void Serial::flush()
+{
+    mBase->CR1.TCIE = 0;
+    Dma::Stream* dma = mDmaWrite;
+    if (dma != nullptr)
+    {
+        // its interrupt might not come any more, the USART has to keep on requesting though
+        while (!dma->complete()) System::instance()->nspin(1000);
+    }
+    configDma(nullptr, nullptr);
+    configInterrupt(nullptr);
+    if (dma != nullptr && writeDmaPending())
+    {
+        // goes on with writeSync()
+        Stream<char>::writeDmaComplete(dma->transferCount());
+    }
+    else
+    {
+        writeSync();
+    }
 }
 
 void Serial::interruptCallback(InterruptController::Index index)
@@ -179,6 +226,13 @@ void Serial::interruptCallback(InterruptController::Index index)
         // we have to read the data even though the STM tells us that there is nothing to read (RXNE = 0)
         (void)mBase->DR;
     }
+    if (sr.bits.IDLE && mBase->CR1.IDLEIE)
+    {
+        // reading DR after SR clears the flag, unless there is a new byte, then the DMA does it
+        if (!sr.bits.RXNE) (void)mBase->DR;
+        // the line went quiet, hand out what came in so far
+        Stream<char>::readDmaPosition(mDmaRead->transferCount() - mDmaRead->remaining());
+    }
     if (sr.bits.RXNE && mBase->CR1.RXNEIE)
     {
         // check if we need to read another byte, if not disable the interrupt
@@ -204,7 +258,14 @@ void Serial::interruptCallback(InterruptController::Index index)
 
 void Serial::dmaReadComplete()
 {
-    Stream<char>::readDmaComplete(mDmaRead->transferCount());
+    // circular, the transfer goes on
+    if (mBase->CR1.IDLEIE) Stream<char>::readDmaPosition(mDmaRead->transferCount() - mDmaRead->remaining());
+    else Stream<char>::readDmaComplete(mDmaRead->transferCount());
+}
+
+void Serial::dmaReadHalfComplete()
+{
+    if (mBase->CR1.IDLEIE) Stream<char>::readDmaPosition(mDmaRead->transferCount() - mDmaRead->remaining());
 }
 
 void Serial::dmaWriteComplete()
@@ -225,6 +286,11 @@ void Serial::waitTransmitComplete()
     }
 }
 
+void Serial::waitReadStopped()
+{
+    while (!mDmaRead->complete()) System::instance()->nspin(1000);
+}
+
 void Serial::waitReceiveNotEmpty()
 {
     while (!mBase->SR.bits.RXNE)
@@ -250,12 +316,26 @@ void Serial::readTrigger()
     {
         if (!mDmaRead->complete()) return;
         char* data;
-        unsigned int len;
+        unsigned int len = readDmaCircular(data);
+        if (len > 0)
+        {
+            // runs for good, the half and complete transfer interrupts and the idle line tell how far it got
+            mDmaRead->setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(data));
+            mDmaRead->setTransferCount(len);
+            mDmaRead->setCircular(true);
+            mDmaRead->setHalfTransferInterrupt(true);
+            mDmaRead->start();
+            mBase->CR1.IDLEIE = 1;
+            return;
+        }
         readDmaBuffer(data, len);
         if (len > 0)
         {
-            mDmaRead->setAddress(Dma::Stream::End::Memory, reinterpret_cast<uint32_t>(data));
+            // the circular stream might have run before
+            mDmaRead->setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(data));
             mDmaRead->setTransferCount(len);
+            mDmaRead->setCircular(false);
+            mDmaRead->setHalfTransferInterrupt(false);
             mDmaRead->start();
         }
     }
@@ -298,7 +378,7 @@ void Serial::writeTrigger()
         writeDmaBuffer(data, len);
         if (len > 0)
         {
-            mDmaWrite->setAddress(Dma::Stream::End::Memory, reinterpret_cast<uint32_t>(data));
+            mDmaWrite->setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(data));
             mDmaWrite->setTransferCount(len);
             mBase->SR.bits.TC = 0;
             mDmaWrite->start();
@@ -52,11 +52,19 @@ public:
     virtual void disable(Device::Part part);
 
     void configDma(Dma::Stream *write, Dma::Stream *read);
+    // Takes the read stream away from the FIFO, the reads wait until stopDoubleBuffer().
+    bool readDoubleBuffer(char* buffer0, char* buffer1, unsigned int len, Device::DoubleBufferCallback* callback);
+    // the FIFO gets the read stream back
+    virtual void stopDoubleBuffer();
+    // For trap handlers: waits for the DMA transfer going on and sends the rest busy waiting, DMA and
+    // interrupts stay off from then on.
+    void flush();
 protected:
     virtual void clockCallback(ClockControl::Callback::Reason reason, uint32_t newClock);
     virtual void interruptCallback(InterruptController::Index index);
 
     virtual void dmaReadComplete();
+    virtual void dmaReadHalfComplete();
     virtual void dmaWriteComplete();
 
 private:
@@ -157,6 +165,8 @@ private:
 
     void waitTransmitComplete();
     void waitReceiveNotEmpty();
+    // a stopped stream keeps EN set until its last transfer is done
+    void waitReadStopped();
 
     virtual void readPrepare();
     virtual void readSync();
@@ -1,14 +1,23 @@
 #include "Spi.h"
+#include "atomic.h"
 
+const uint16_t Spi::MODE_MASK;
+const uint16_t Spi::BR_MASK;
+const unsigned Spi::BR_SHIFT;
+const uint16_t Spi::NO_MODE;
 
 Spi::Spi(System::BaseAddress base, ClockControl *clockControl, ClockControl::Clock clock) :
     mBase(reinterpret_cast<volatile SPI*>(base)),
     mClockControl(clockControl),
     mClock(clock),
-    mTransferBuffer(64)
+    mSpeed(0),
+    mTransferBuffer(64),
+    mDoubleBufferTransfer(nullptr),
+    mMode(NO_MODE),
+    mWordSize(WordSize::Bits8),
+    mClockChanges(0)
 {
     static_assert(sizeof(SPI) == 0x24, "Struct has wrong size, compiler problem.");
-    //mBase->CR1.DFF = (sizeof(T) == 1) ? 0 : 1;
 }
 
 
@@ -18,46 +27,86 @@ void Spi::setMasterSlave(Spi::MasterSlave masterSlave)
     switch (masterSlave)
     {
     case Spi::MasterSlave::Master:
-        mBase->CR1.SSM = 1;
-        mBase->CR1.SSI = 1;
-        mBase->CR1.MSTR = 1;
+        mBase->CR1.BITS.SSM = 1;
+        mBase->CR1.BITS.SSI = 1;
+        mBase->CR1.BITS.MSTR = 1;
         break;
     case Spi::MasterSlave::Slave:
-        mBase->CR1.SSM = 1;
-        mBase->CR1.SSI = 0;
-        mBase->CR1.MSTR = 1;
+        mBase->CR1.BITS.SSM = 1;
+        mBase->CR1.BITS.SSI = 0;
+        mBase->CR1.BITS.MSTR = 1;
         break;
     case Spi::MasterSlave::MasterNssOut:
-        mBase->CR1.SSM = 0;
+        mBase->CR1.BITS.SSM = 0;
         mBase->CR2.SSOE = 1;
-        mBase->CR1.MSTR = 1;
+        mBase->CR1.BITS.MSTR = 1;
         break;
     case Spi::MasterSlave::MasterNssIn:
-        mBase->CR1.SSM = 0;
+        mBase->CR1.BITS.SSM = 0;
         mBase->CR2.SSOE = 0;
-        mBase->CR1.MSTR = 1;
+        mBase->CR1.BITS.MSTR = 1;
         break;
     }
 }
 
 void Spi::enable(Device::Part part)
 {
-    mBase->CR1.SPE = 1;
+    mBase->CR1.BITS.SPE = 1;
 }
 
 void Spi::disable(Device::Part part)
 {
-    mBase->CR1.SPE = 0;
+    mBase->CR1.BITS.SPE = 0;
+    // the next transfer switches it on again
+    mMode = NO_MODE;
 }
 
 bool Spi::transfer(Transfer *transfer)
 {
+    // the event loop and the interrupts of the chips queue transfers, the DMA interrupts start the next one
+    uint32_t primask = interrupt_disable();
     bool success = mTransferBuffer.push(transfer);
     //printf("PUSH\n", ((transfer->mReadData != nullptr) ? "R" : "-"), transfer->mReadData, ((transfer->mWriteData != nullptr) ? "W" : "-"), transfer->mWriteData, transfer->mLength);
     if (mBase->CR2.RXDMAEN == 0 && mBase->CR2.TXDMAEN == 0) nextTransfer();
+    interrupt_restore(primask);
     return success;
 }
 
+bool Spi::readDoubleBuffer(Spi::Transfer *transfer, uint8_t *buffer1, Device::DoubleBufferCallback *callback)
+{
+    if (mDmaWrite == nullptr || mDmaRead == nullptr || transfer->mWriteData == nullptr || transfer->mWordSize != WordSize::Bits8) return false;
+    if (mBase->CR2.RXDMAEN || mBase->CR2.TXDMAEN || mTransferBuffer.used() != 0) return false;
+    if (transfer->mChip != nullptr) transfer->mChip->prepare();
+    if (transfer->mChipSelect != nullptr) transfer->mChipSelect->select();
+    config(transfer);
+    if (!startDoubleBuffer(transfer->mReadData, buffer1, transfer->mLength, callback))
+    {
+        if (transfer->mChipSelect != nullptr) transfer->mChipSelect->deselect();
+        return false;
+    }
+    mDoubleBufferTransfer = transfer;
+    mBase->CR2.RXDMAEN = 1;
+    // the receiving stream is ready before the first clock
+    mBase->CR2.TXDMAEN = 1;
+    mDmaWrite->setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(transfer->mWriteData));
+    mDmaWrite->setTransferCount(transfer->mLength);
+    mDmaWrite->setCircular(true);
+    mDmaWrite->start();
+    return true;
+}
+
+void Spi::stopDoubleBuffer()
+{
+    if (mDoubleBufferTransfer == nullptr) return;
+    mDmaWrite->stop();
+    mDmaWrite->setCircular(false);
+    Device::stopDoubleBuffer();
+    if (mDoubleBufferTransfer->mChipSelect != nullptr) mDoubleBufferTransfer->mChipSelect->deselect();
+    mDoubleBufferTransfer = nullptr;
+    // goes on with the ones that came in meanwhile, or switches DMA off
+    nextTransfer();
+}
+
 void Spi::nextTransfer()
 {
     Transfer* t;
@@ -73,13 +122,12 @@ void Spi::nextTransfer()
         //printf("SPI POP %s(%08x)%s(%08x) %i bytes\n", ((t->mReadData != nullptr) ? "R" : "-"), t->mReadData, ((t->mWriteData != nullptr) ? "W" : "-"), t->mWriteData, t->mLength);
         if (t->mChip != nullptr) t->mChip->prepare();
         if (t->mChipSelect != nullptr) t->mChipSelect->select();
-        setSpeed(t->mMaxSpeed);
-        config(t->mClockPolarity, t->mClockPhase, t->mEndianess);
+        config(t);
         if (mDmaRead != nullptr && t->mReadData != nullptr)
         {
             mBase->CR2.RXDMAEN = 1;
-            mDmaRead->setAddress(Dma::Stream::End::Memory, reinterpret_cast<uint32_t>(t->mReadData));
-            mDmaRead->setTransferCount(t->mLength);
+            mDmaRead->setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(t->mReadData));
+            mDmaRead->setTransferCount(t->mLength >> static_cast<unsigned>(t->mWordSize));
             mDmaRead->start();
         }
         if (mDmaWrite != nullptr && t->mWriteData != nullptr)
@@ -87,8 +135,8 @@ void Spi::nextTransfer()
 //            for (int i = 0; i < t->mLength; ++i) printf("%02x ", t->mWriteData[i]);
 //            printf("\n");
             mBase->CR2.TXDMAEN = 1;
-            mDmaWrite->setAddress(Dma::Stream::End::Memory, reinterpret_cast<uint32_t>(t->mWriteData));
-            mDmaWrite->setTransferCount(t->mLength);
+            mDmaWrite->setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(t->mWriteData));
+            mDmaWrite->setTransferCount(t->mLength >> static_cast<unsigned>(t->mWordSize));
             mDmaWrite->start();
         }
     }
@@ -124,24 +172,27 @@ void Spi::configDma(Dma::Stream *write, Dma::Stream *read)
 {
     Device::configDma(write, read);
     Dma::Stream::DataSize dataSize = Dma::Stream::DataSize::Byte;
+    mWordSize = WordSize::Bits8;
     if (Device::mDmaWrite != nullptr)
     {
         mDmaWrite->config(Dma::Stream::Direction::MemoryToPeripheral, false, true, dataSize, dataSize, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
         mDmaWrite->setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(&mBase->DR));
-        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Quater);
+        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Auto);
     }
     if (Device::mDmaRead != nullptr)
     {
         mDmaRead->config(Dma::Stream::Direction::PeripheralToMemory, false, true, dataSize, dataSize, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
         mDmaRead->setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(&mBase->DR));
-        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Quater);
+        mDmaRead->configFifo(Dma::Stream::FifoThreshold::Auto);
     }
 }
 
 
 void Spi::clockCallback(ClockControl::Callback::Reason reason, uint32_t newClock)
 {
-    if (reason == ClockControl::Callback::Reason::Changed) setSpeed(mSpeed);
+    if (reason != ClockControl::Callback::Reason::Changed) return;
+    ++mClockChanges;
+    if (mMode != NO_MODE) setMode((mMode & ~BR_MASK) | prescaler(mSpeed));
 }
 
 
@@ -154,19 +205,24 @@ void Spi::dmaReadComplete()
 {
     //printf("RX DONE\n");
     Transfer* t;
+    uint32_t primask = interrupt_disable();
     if (mTransferBuffer.pop(t))
     {
         if (t->mChipSelect != nullptr) t->mChipSelect->deselect();
         if (t->mEvent != nullptr) System::instance()->postEvent(t->mEvent);
         nextTransfer();
     }
+    interrupt_restore(primask);
 }
 
 
 void Spi::dmaWriteComplete()
 {
     //printf("TX DONE\n");
+    // the clock for the double buffer, it goes round
+    if (mDoubleBufferTransfer != nullptr) return;
     Transfer* t;
+    uint32_t primask = interrupt_disable();
     if (mTransferBuffer.back(t))
     {
         if (t->mReadData == nullptr)
@@ -177,6 +233,7 @@ void Spi::dmaWriteComplete()
             nextTransfer();
         }
     }
+    interrupt_restore(primask);
 }
 
 void Spi::waitTransmitComplete()
@@ -198,24 +255,69 @@ void Spi::waitReceiveNotEmpty()
     }
 }
 
-uint32_t Spi::setSpeed(uint32_t maxSpeed)
+uint16_t Spi::prescaler(uint32_t maxSpeed)
 {
     uint32_t clock = mClockControl->clock(mClock);
     uint32_t divider = (clock + maxSpeed - 1) / maxSpeed;
     uint32_t br = 0;
     while ((2u << br) < divider) ++br;
     if (br > 7) br = 7;
-    mBase->CR1.BR = br;
-    mSpeed = maxSpeed;
-    return clock / (2 << br);
+    return static_cast<uint16_t>(br << BR_SHIFT);
 }
 
-void Spi::config(Spi::ClockPolarity clockPolarity, Spi::ClockPhase clockPhase, Spi::Endianess endianess)
+uint16_t Spi::mode(const Transfer *transfer)
 {
-    mBase->CR1.SPE = 0;
-    mBase->CR1.CPOL = static_cast<uint32_t>(clockPolarity);
-    mBase->CR1.CPHA = static_cast<uint32_t>(clockPhase);
-    mBase->CR1.LSBFIRST = static_cast<uint32_t>(endianess);
-    mBase->CR1.SPE = 1;
+    Chip* chip = transfer->mChip;
+    if (chip != nullptr && chip->mMaxSpeed == transfer->mMaxSpeed && chip->mClockChanges == mClockChanges &&
+            chip->mClockPolarity == transfer->mClockPolarity && chip->mClockPhase == transfer->mClockPhase &&
+            chip->mEndianess == transfer->mEndianess && chip->mWordSize == transfer->mWordSize)
+    {
+        return chip->mMode;
+    }
+    SPI::__CR1 cr1;
+    cr1.CR1 = prescaler(transfer->mMaxSpeed);
+    cr1.BITS.CPOL = static_cast<uint16_t>(transfer->mClockPolarity);
+    cr1.BITS.CPHA = static_cast<uint16_t>(transfer->mClockPhase);
+    cr1.BITS.LSBFIRST = static_cast<uint16_t>(transfer->mEndianess);
+    cr1.BITS.DFF = static_cast<uint16_t>(transfer->mWordSize);
+    if (chip != nullptr)
+    {
+        chip->mMaxSpeed = transfer->mMaxSpeed;
+        chip->mClockPolarity = transfer->mClockPolarity;
+        chip->mClockPhase = transfer->mClockPhase;
+        chip->mEndianess = transfer->mEndianess;
+        chip->mWordSize = transfer->mWordSize;
+        chip->mClockChanges = mClockChanges;
+        chip->mMode = cr1.CR1;
+    }
+    return cr1.CR1;
 }
 
+void Spi::setMode(uint16_t mode)
+{
+    // only while the SPI is off
+    mBase->CR1.BITS.SPE = 0;
+    mBase->CR1.CR1 = (mBase->CR1.CR1 & ~MODE_MASK) | mode;
+    mBase->CR1.BITS.SPE = 1;
+    mMode = mode;
+}
+
+void Spi::config(const Transfer *transfer)
+{
+    mSpeed = transfer->mMaxSpeed;
+    uint16_t m = mode(transfer);
+    if (m != mMode) setMode(m);
+    if (transfer->mWordSize != mWordSize)
+    {
+        // only the setup of the streams, it goes to the registers with start()
+        Dma::Stream::DataSize dataSize = transfer->mWordSize == WordSize::Bits16 ? Dma::Stream::DataSize::HalfWord : Dma::Stream::DataSize::Byte;
+        Dma::Stream* streams[] = { mDmaWrite, mDmaRead };
+        for (Dma::Stream* stream : streams)
+        {
+            if (stream == nullptr) continue;
+            stream->setDataSize(Dma::Stream::End::Peripheral, dataSize);
+            stream->setDataSize(Dma::Stream::End::Memory, dataSize);
+        }
+        mWordSize = transfer->mWordSize;
+    }
+}
@@ -16,6 +16,8 @@ public:
     // Selects the transition for data capture
     enum class ClockPhase { FirstTransition = 0, SecondTransition = 1 };
     enum class Endianess { MsbFirst = 0, LsbFirst = 0 };
+    // DFF, 16 bit frames go with halfwords from memory as they are, the DMA moves half as many
+    enum class WordSize { Bits8 = 0, Bits16 = 1 };
 
     class ChipSelect
     {
@@ -31,27 +33,44 @@ public:
     public:
         const uint8_t* mWriteData;
         uint8_t* mReadData;
+        // in bytes, even for 16 bit frames
         unsigned mLength;
         ChipSelect* mChipSelect;
         ClockPolarity mClockPolarity;
         ClockPhase mClockPhase;
         Endianess mEndianess;
+        WordSize mWordSize;
         uint32_t mMaxSpeed;
         System::Event* mEvent;
         Chip* mChip;
     };
 
+    // Keeps the CR1 bits of its transfers, as long as their settings and the clock stay the same the bus
+    // doesn't have to work them out again, and when the chip before had the same it leaves CR1 alone.
     class Chip
     {
     public:
         Chip(Spi& spi) :
-            mSpi(spi)
+            mSpi(spi),
+            mMaxSpeed(0),
+            mClockChanges(0),
+            mMode(0)
         { }
 
         virtual bool transfer(Transfer* transfer) { transfer->mChip = this; return mSpi.transfer(transfer); }
         virtual void prepare() { }
     private:
         Spi& mSpi;
+        // the settings mMode was made for, no speed for none yet
+        uint32_t mMaxSpeed;
+        ClockPolarity mClockPolarity;
+        ClockPhase mClockPhase;
+        Endianess mEndianess;
+        WordSize mWordSize;
+        unsigned mClockChanges;
+        uint16_t mMode;
+
+        friend class Spi;
     };
 
     Spi(System::BaseAddress base, ClockControl* clockControl, ClockControl::Clock clock);
@@ -61,7 +80,13 @@ public:
     virtual void enable(Device::Part part);
     virtual void disable(Device::Part part);
 
+    // also from interrupts, like the data ready one of a chip
     bool transfer(Transfer* transfer);
+    // Keeps the chip selected and reads for good, mReadData and buffer1 take turns. mWriteData is sent
+    // over and over for the clock. Only when no other transfer is going on, the ones that come in wait
+    // until stopDoubleBuffer(). 8 bit frames only.
+    bool readDoubleBuffer(Transfer* transfer, uint8_t* buffer1, Device::DoubleBufferCallback* callback);
+    virtual void stopDoubleBuffer();
 
     void configDma(Dma::Stream *write, Dma::Stream *read);
 protected:
@@ -74,22 +99,26 @@ protected:
 private:
     struct SPI
     {
-        struct __CR1
+        union __CR1
         {
-            uint16_t CPHA : 1;
-            uint16_t CPOL : 1;
-            uint16_t MSTR : 1;
-            uint16_t BR : 3;
-            uint16_t SPE : 1;
-            uint16_t LSBFIRST : 1;
-            uint16_t SSI : 1;
-            uint16_t SSM : 1;
-            uint16_t RXONLY : 1;
-            uint16_t DFF : 1;
-            uint16_t CRCNEXT : 1;
-            uint16_t CRCEN : 1;
-            uint16_t BIDIOE : 1;
-            uint16_t BIDIMODE : 1;
+            struct __UNNAMED
+            {
+                uint16_t CPHA : 1;
+                uint16_t CPOL : 1;
+                uint16_t MSTR : 1;
+                uint16_t BR : 3;
+                uint16_t SPE : 1;
+                uint16_t LSBFIRST : 1;
+                uint16_t SSI : 1;
+                uint16_t SSM : 1;
+                uint16_t RXONLY : 1;
+                uint16_t DFF : 1;
+                uint16_t CRCNEXT : 1;
+                uint16_t CRCEN : 1;
+                uint16_t BIDIOE : 1;
+                uint16_t BIDIMODE : 1;
+            } BITS;
+            uint16_t CR1;
         }   CR1;
         uint16_t __RESERVED0;
         struct __CR2
@@ -150,16 +179,32 @@ private:
         }   I2SPR;
         uint16_t __RESERVED8;
     };
+    // the bits of CR1 a transfer sets: CPHA, CPOL, BR, LSBFIRST and DFF
+    static const uint16_t MODE_MASK = 0x08bb;
+    static const uint16_t BR_MASK = 0x0038;
+    static const unsigned BR_SHIFT = 3;
+    // not a mode, CR1 gets written by the next transfer
+    static const uint16_t NO_MODE = 0xffff;
+
     volatile SPI* mBase;
     ClockControl* mClockControl;
     ClockControl::Clock mClock;
     uint32_t mSpeed;
     CircularBuffer<Transfer*> mTransferBuffer;
+    Transfer* mDoubleBufferTransfer;
+    // what CR1 has now
+    uint16_t mMode;
+    // what the DMA streams are set up for
+    WordSize mWordSize;
+    // the modes of the chips made before are out of date
+    unsigned mClockChanges;
 
     void waitTransmitComplete();
     void waitReceiveNotEmpty();
-    uint32_t setSpeed(uint32_t maxSpeed);
-    void config(Spi::ClockPolarity clockPolarity, Spi::ClockPhase clockPhase, Spi::Endianess endianess);
+    uint16_t prescaler(uint32_t maxSpeed);
+    uint16_t mode(const Transfer* transfer);
+    void setMode(uint16_t mode);
+    void config(const Transfer* transfer);
     void nextTransfer();
     void writeSync();
 };
@@ -0,0 +1,148 @@
+#ifndef STATICCIRCULARBUFFER_H
+#define STATICCIRCULARBUFFER_H
+
+#include "atomic.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// CircularBuffer with the size N known at compile time, a power of 2, and the memory inside the object.
+// Read and write position run freely and get masked for the index, the writer only changes the write
+// position and the reader only the read position, so there is no shared counter and for a single writer
+// and a single reader no locking.
+template<typename T, unsigned int N>
+class StaticCircularBuffer
+{
+    static_assert(N != 0 && (N & (N - 1)) == 0, "Size must be a power of 2.");
+
+public:
+    StaticCircularBuffer() : mWrite(0), mRead(0) { }
+
+    inline unsigned int used() { return mWrite - mRead; }
+    inline unsigned int free() { return N - used(); }
+    inline unsigned int size() { return N; }
+
+    bool push(T elem);
+    bool pop(T &elem);
+    bool back(T &elem);
+    unsigned int write(const T* data, unsigned int len);
+    unsigned int read(T* data, unsigned int len);
+    // counted from the read position, or from the write position if negative
+    T operator[](int index);
+
+    unsigned int getContBuffer(const T*& data);
+    unsigned int skip(unsigned int len);
+
+    unsigned int reserve(T*& data, unsigned int len = ~0u);
+    void commit(unsigned int len);
+    unsigned int peek(const T*& data) { return getContBuffer(data); }
+    unsigned int release(unsigned int len) { return skip(len); }
+
+private:
+    static const unsigned int MASK = N - 1;
+
+    T mBuffer[N];
+    volatile uint32_t mWrite;
+    volatile uint32_t mRead;
+};
+
+// here and not in a .cpp, so the users instantiate it for their own element types
+template<typename T, unsigned int N>
+const unsigned int StaticCircularBuffer<T, N>::MASK;
+
+template<typename T, unsigned int N>
+bool StaticCircularBuffer<T, N>::push(T elem)
+{
+    if (free() == 0) return false;
+    mBuffer[mWrite & MASK] = elem;
+    // the element has to be there before the reader sees it
+    atomic_barrier();
+    ++mWrite;
+    return true;
+}
+
+template<typename T, unsigned int N>
+bool StaticCircularBuffer<T, N>::pop(T &elem)
+{
+    if (used() == 0) return false;
+    elem = mBuffer[mRead & MASK];
+    atomic_barrier();
+    ++mRead;
+    return true;
+}
+
+template<typename T, unsigned int N>
+bool StaticCircularBuffer<T, N>::back(T &elem)
+{
+    if (used() == 0) return false;
+    elem = mBuffer[mRead & MASK];
+    return true;
+}
+
+template<typename T, unsigned int N>
+unsigned int StaticCircularBuffer<T, N>::write(const T *data, unsigned int len)
+{
+    len = std::min(len, free());
+    unsigned int index = mWrite & MASK;
+    unsigned int part = std::min(len, N - index);
+    std::memcpy(mBuffer + index, data, part * sizeof(T));
+    std::memcpy(mBuffer, data + part, (len - part) * sizeof(T));
+    atomic_barrier();
+    mWrite += len;
+    return len;
+}
+
+template<typename T, unsigned int N>
+unsigned int StaticCircularBuffer<T, N>::read(T *data, unsigned int len)
+{
+    len = std::min(len, used());
+    unsigned int index = mRead & MASK;
+    unsigned int part = std::min(len, N - index);
+    std::memcpy(data, mBuffer + index, part * sizeof(T));
+    std::memcpy(data + part, mBuffer, (len - part) * sizeof(T));
+    atomic_barrier();
+    mRead += len;
+    return len;
+}
+
+template<typename T, unsigned int N>
+T StaticCircularBuffer<T, N>::operator [](int index)
+{
+    if (index < 0) return mBuffer[(mWrite + index) & MASK];
+    return mBuffer[(mRead + index) & MASK];
+}
+
+template<typename T, unsigned int N>
+unsigned int StaticCircularBuffer<T, N>::getContBuffer(const T *&data)
+{
+    unsigned int index = mRead & MASK;
+    data = mBuffer + index;
+    return std::min(used(), N - index);
+}
+
+template<typename T, unsigned int N>
+unsigned int StaticCircularBuffer<T, N>::skip(unsigned int len)
+{
+    len = std::min(len, used());
+    atomic_barrier();
+    mRead += len;
+    return len;
+}
+
+template<typename T, unsigned int N>
+unsigned int StaticCircularBuffer<T, N>::reserve(T *&data, unsigned int len)
+{
+    unsigned int index = mWrite & MASK;
+    data = mBuffer + index;
+    return std::min(std::min(len, free()), N - index);
+}
+
+template<typename T, unsigned int N>
+void StaticCircularBuffer<T, N>::commit(unsigned int len)
+{
+    atomic_barrier();
+    mWrite += len;
+}
+
+#endif // STATICCIRCULARBUFFER_H
@@ -21,6 +21,14 @@
 
 #include <cstdio>
 
+static const InterruptController::Index DMA_INTERRUPTS[DmaManager::STREAMS] =
+{
+    StmSystem::InterruptIndex::DMA1_Stream0, StmSystem::InterruptIndex::DMA1_Stream1, StmSystem::InterruptIndex::DMA1_Stream2, StmSystem::InterruptIndex::DMA1_Stream3,
+    StmSystem::InterruptIndex::DMA1_Stream4, StmSystem::InterruptIndex::DMA1_Stream5, StmSystem::InterruptIndex::DMA1_Stream6, StmSystem::InterruptIndex::DMA1_Stream7,
+    StmSystem::InterruptIndex::DMA2_Stream0, StmSystem::InterruptIndex::DMA2_Stream1, StmSystem::InterruptIndex::DMA2_Stream2, StmSystem::InterruptIndex::DMA2_Stream3,
+    StmSystem::InterruptIndex::DMA2_Stream4, StmSystem::InterruptIndex::DMA2_Stream5, StmSystem::InterruptIndex::DMA2_Stream6, StmSystem::InterruptIndex::DMA2_Stream7,
+};
+
 StmSystem::StmSystem() :
     System(BaseAddress::SCB),
     mGpioA(BaseAddress::GPIOA),
@@ -39,6 +47,7 @@ StmSystem::StmSystem() :
     mSysCfg(BaseAddress::SYSCFG),
     mDma1(BaseAddress::DMA1),
     mDma2(BaseAddress::DMA2),
+    mDmaManager(mDma1, mDma2, mNvic, DMA_INTERRUPTS),
 //    mUsart1(BaseAddress::USART1, &mRcc, ClockControl::Clock::APB2),
     mUsart2(BaseAddress::USART2, &mRcc, ClockControl::Clock::APB1),
 //    mUsart3(BaseAddress::USART3, &mRcc, ClockControl::Clock::APB1),
@@ -46,6 +55,9 @@ StmSystem::StmSystem() :
 //    mUart5(BaseAddress::UART5, &mRcc, ClockControl::Clock::APB1),
 //    mUsart6(BaseAddress::USART6, &mRcc, ClockControl::Clock::APB2),
     mDebug(mUsart2),
+    mConsole(nullptr),
+    mCrc(BaseAddress::CRC),
+    mTelemetry(mDebug, mCrc),
     mSpi1(BaseAddress::SPI1, &mRcc, ClockControl::Clock::APB2),
     mSpi2(BaseAddress::SPI2, &mRcc, ClockControl::Clock::APB1),
     mSpi3(BaseAddress::SPI3, &mRcc, ClockControl::Clock::APB1),
@@ -54,6 +66,8 @@ StmSystem::StmSystem() :
     mI2C3(BaseAddress::I2C3, &mRcc, ClockControl::Clock::APB1),
     mFlash(BaseAddress::FLASH, mRcc, Flash::AccessSize::x32),
     mFpu(BaseAddress::FPU),
+    mDwt(BaseAddress::DWT, BaseAddress::COREDEBUG),
+    mTimebase(mDwt.cycleCounter(), &mRcc),
     mIWdg(BaseAddress::IWDG),
     mDisplayRs(mGpioE, Gpio::Index::Pin7),
     mDisplayE(mGpioE, Gpio::Index::Pin8),
@@ -72,8 +86,7 @@ StmSystem::~StmSystem()
 
 void StmSystem::handleTrap(System::TrapIndex index, unsigned int* stackPointer)
 {
-    mDebug.configDma(nullptr, nullptr);
-    mDebug.configInterrupt(nullptr);
+    mDebug.flush();
     System::handleTrap(index, stackPointer);
     // wait for last byte to be written
     for (int i = 0; i < 10000; ++i);
@@ -86,20 +99,21 @@ void StmSystem::init()
     mRcc.enable(ClockControl::Function::Usart2);
     mRcc.enable(ClockControl::Function::GpioA);
     mRcc.enable(ClockControl::Function::Dma1);
+    mRcc.enable(ClockControl::Function::Dma2);
+    mRcc.enable(ClockControl::Function::Crc);
 
 //    mDebug.config(9600);
     mDebug.config(921600);//, Serial::Parity::Odd, Serial::WordLength::Nine);
-    mDebug.configDma(new Dma::Stream(mDma1, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4,
-                                     new InterruptController::Line(mNvic, InterruptIndex::DMA1_Stream6)),
-                     nullptr
-//                     new Dma::Stream(mDma1, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel4,
-//                                                          new InterruptController::Line(mNvic, InterruptIndex::DMA1_Stream5))
-                     );
+    mDebug.configDma(mDmaManager.claim(DmaManager::Request::Usart2Tx, "USART2 TX"), mDmaManager.claim(DmaManager::Request::Usart2Rx, "USART2 RX"));
     mNvic.setPriotity(InterruptIndex::DMA1_Stream6, InterruptController::Priority::Lowest);
     mNvic.setPriotity(InterruptIndex::DMA1_Stream5, InterruptController::Priority::Low);
     mDebug.configInterrupt(new InterruptController::Line(mNvic, InterruptIndex::USART2));
     mDebug.readFifo(256);
-    mDebug.writeFifo(256);
+    mMemcpy.addStream(mDmaManager.claim(DmaManager::Request::MemoryToMemory, "memcpy"));
+    mMemcpy.addStream(mDmaManager.claim(DmaManager::Request::MemoryToMemory, "memcpy"));
+    // printf() doesn't wait for the UART, what doesn't fit gets dropped
+    mConsole = new Console(1024, Console::Overflow::Drop);
+    mDebug.writeFifo(mConsole);
     mDebug.enable(Device::All);
 
     // USART2 TX
@@ -114,6 +128,10 @@ void StmSystem::init()
     // Be careful with prefetch, it does nasty things...
     //mFlash.set(Flash::Feature::Prefetch, true);
     mFpu.enable(FpuControl::AccessPrivileges::Full);
+#ifdef TRACE
+    trace().setCounter(mDwt.cycleCounter());
+#endif
+    log().setCounter(mDwt.cycleCounter());
 
     mRcc.enable(ClockControl::Function::GpioE);
     mGpioE.configOutput(Gpio::Index::Pin7, Gpio::OutputType::PushPull, Gpio::Pull::None, Gpio::Speed::Medium);
@@ -127,6 +145,21 @@ void StmSystem::init()
     System::instance()->debugMsg("READY:", 6);
 }
 
+void StmSystem::usleep(unsigned int us)
+{
+    uint64_t end = mTimebase.ns() + us * 1000ull;
+    while (mTimebase.ns() < end)
+    {
+    }
+}
+
+void StmSystem::handleSysTick()
+{
+    mSysTick.tick();
+    // SysTick comes at least once per second, often enough to catch the cycle counter overflow
+    mTimebase.update();
+}
+
 void StmSystem::consoleRead(char *msg, unsigned int len)
 {
     mDebug.read(msg, len);
@@ -167,7 +200,19 @@ void StmSystem::printInfo()
                 mRcc.clock(ClockControl::Clock::APB2) / 1000000);
     std::printf("BOGOMIPS: %lu.%lu\n", bogoMips() / 1000000, bogoMips() % 1000000);
     std::printf("RAM     : %luk heap free, %luk heap used, %luk bss used, %lik data used.\n", (memFree() + 512) / 1024, (memUsed() + 512) / 1024, (memBssUsed() + 512) / 1024, (memDataUsed() + 512) / 1024);
+    std::printf("POOL    : %u pages, %u large blocks, used/max/total blocks per size:", blockPool().pages(), blockPool().large());
+    for (unsigned int i = 0; i < BlockPool::CLASS_COUNT; ++i)
+    {
+        std::printf(" %u %u/%u/%u", BlockPool::blockSize(i), blockPool().used(i), blockPool().maxUsed(i), blockPool().total(i));
+    }
+    std::printf(".\n");
     std::printf("STACK   : %luk free, %luk used, %luk max used.\n", (stackFree() + 512) / 1024, (stackUsed() + 512) / 1024, (stackMaxUsed() + 512) / 1024);
+    std::printf("EVENTS  : %lu dispatched, queued/max/overflow high %lu/%lu/%lu, normal %lu/%lu/%lu, low %lu/%lu/%lu.\n", eventCount(),
+                eventQueueUsed(Event::Priority::High), eventQueueMaxUsed(Event::Priority::High), eventQueueOverflow(Event::Priority::High),
+                eventQueueUsed(Event::Priority::Normal), eventQueueMaxUsed(Event::Priority::Normal), eventQueueOverflow(Event::Priority::Normal),
+                eventQueueUsed(Event::Priority::Low), eventQueueMaxUsed(Event::Priority::Low), eventQueueOverflow(Event::Priority::Low));
+    std::printf("CONSOLE : %u bytes dropped in %u overflows, %u telemetry frames sent, %u dropped.\n", mConsole->dropped(), mConsole->overflows(),
+                mTelemetry.sent(), mTelemetry.dropped());
     std::printf("BUILD   : %s\n", GIT_VERSION);
     std::printf("DATE    : %s\n", BUILD_DATE);
 }
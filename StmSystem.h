@@ -27,10 +27,17 @@
 #include "ExternalInterrupt.h"
 #include "SysCfg.h"
 #include "Dma.h"
+#include "DmaManager.h"
+#include "AsyncMemcpy.h"
 #include "Serial.h"
+#include "Console.h"
+#include "CrcUnit.h"
+#include "Telemetry.h"
 #include "Flash.h"
 #include "SysTickControl.h"
 #include "FpuControl.h"
+#include "Dwt.h"
+#include "Timebase.h"
 #include "Spi.h"
 #include "i2c.h"
 #include "IndependentWatchdog.h"
@@ -43,8 +50,11 @@ public:
     {
         enum Address : System::BaseAddress
         {
+            COREDEBUG = 0xe000edf0,
+            CRC = 0x40023000,
             DMA1 = 0x40026000,
             DMA2 = 0x40026400,
+            DWT = 0xe0001000,
             EXTI = 0x40013c00,
             FLASH = 0x40023c00,
             FPU = 0xe000ed88,
@@ -199,6 +209,10 @@ public:
     SysCfg mSysCfg;
     Dma mDma1;
     Dma mDma2;
+    // all the streams of mDma1 and mDma2 come from there
+    DmaManager mDmaManager;
+    // with streams 4 and 5 of DMA2
+    AsyncMemcpy mMemcpy;
 //    Serial mUsart1;
     Serial mUsart2;
 //    Serial mUsart3;
@@ -206,6 +220,11 @@ public:
 //    Serial mUart5;
 //    Serial mUsart6;
     Serial& mDebug;
+    // the write FIFO of mDebug
+    Console* mConsole;
+    CrcUnit mCrc;
+    // binary frames on mDebug, next to the shell
+    Telemetry mTelemetry;
     Spi mSpi1;
     Spi mSpi2;
     Spi mSpi3;
@@ -214,6 +233,8 @@ public:
     I2C mI2C3;
     Flash mFlash;
     FpuControl mFpu;
+    Dwt mDwt;
+    Timebase mTimebase;
     IndependentWatchdog mIWdg;
 
     Gpio::Pin mDisplayRs;
@@ -231,14 +252,16 @@ public:
     virtual inline void handleInterrupt(uint32_t index) { mNvic.handle(index); }
     virtual void handleTrap(System::TrapIndex index, unsigned int* stackPointer);
 
-    void printInfo();
-    virtual void usleep(unsigned int us) { mSysTick.usleep(us); }
-    virtual uint64_t ns() { return mSysTick.ns(); }
-    virtual void handleSysTick() { mSysTick.tick(); }
+    virtual void printInfo();
+    virtual void usleep(unsigned int us);
+    virtual uint64_t ns() { return mTimebase.ns(); }
+    virtual void nspin(uint16_t ns) { mTimebase.nspin(ns); }
+    virtual void handleSysTick();
 protected:
     virtual void consoleRead(char *msg, unsigned int len);
     virtual void consoleWrite(const char *msg, unsigned int len);
     virtual void debugMsg(const char *msg, unsigned int len);
+    virtual void setWakeup(uint64_t delay) { mSysTick.wakeup((delay + 999999) / 1000000); }
 
 private:
     void init();
@@ -17,6 +17,7 @@
  */
 
 #include "Stream.h"
+#include "atomic.h"
 
 template<typename T>
 Stream<T>::Stream() :
@@ -26,9 +27,17 @@ Stream<T>::Stream() :
     mReadEvent(*this),
     mWriteData(nullptr),
     mWriteCount(0),
+    mWriteDmaCount(0),
     mWriteCompleteEvent(nullptr),
     mReadFifo(nullptr),
-    mWriteFifo(nullptr)
+    mWriteFifo(nullptr),
+    mReadFifoType(FifoType::Circular),
+    mReadDmaPos(0),
+    mReadPosted(false),
+    mWriteQueue(),
+    mWriteQueueDepth(0),
+    mWriteQueueMaxUsed(0),
+    mWriteQueueOverflow(0)
 {
 }
 
@@ -80,6 +89,18 @@ bool Stream<T>::write(const T *data, unsigned int count)
 template<typename T>
 bool Stream<T>::write(const T *data, unsigned int count, System::Event *completeEvent)
 {
+    // the one going on must not complete in between
+    uint32_t primask = interrupt_disable();
+    if (mWriteData != nullptr)
+    {
+        WriteRequest request = { data, count, completeEvent };
+        bool queued = count != 0 && mWriteQueue.used() < mWriteQueueDepth && mWriteQueue.push(request);
+        if (!queued) ++mWriteQueueOverflow;
+        else if (mWriteQueue.used() > mWriteQueueMaxUsed) mWriteQueueMaxUsed = mWriteQueue.used();
+        interrupt_restore(primask);
+        return queued;
+    }
+    interrupt_restore(primask);
     mWriteCompleteEvent = completeEvent;
     if (!writeProlog(data, count))
     {
@@ -94,7 +115,7 @@ bool Stream<T>::write(const T *data, unsigned int count, System::Event *complete
 }
 
 template<typename T>
-void Stream<T>::readFifo(unsigned int size)
+void Stream<T>::readFifo(unsigned int size, FifoType type)
 {
     if (mReadFifo != nullptr)
     {
@@ -103,23 +124,41 @@ void Stream<T>::readFifo(unsigned int size)
     }
     if (size > 0)
     {
-        mReadFifo = new CircularBuffer<T>(size);
+        mReadFifo = createFifo(size, type);
+        mReadFifoType = type;
         readTrigger();
     }
 }
 
 template<typename T>
-void Stream<T>::writeFifo(unsigned int size)
+void Stream<T>::writeFifo(unsigned int size, FifoType type)
+{
+    writeFifo(size > 0 ? createFifo(size, type) : nullptr);
+}
+
+template<typename T>
+void Stream<T>::writeFifo(Fifo<T> *fifo)
 {
     if (mWriteFifo != nullptr)
     {
         delete mWriteFifo;
-        mWriteFifo = nullptr;
-    }
-    if (size > 0)
-    {
-        mWriteFifo = new CircularBuffer<T>(size);
     }
+    mWriteFifo = fifo;
+}
+
+template<typename T>
+unsigned int Stream<T>::writeReserve(T *&data, unsigned int count)
+{
+    if (mWriteFifo == nullptr) return 0;
+    return mWriteFifo->reserve(data, count);
+}
+
+template<typename T>
+void Stream<T>::writeCommit(unsigned int count)
+{
+    if (mWriteFifo == nullptr || count == 0) return;
+    mWriteFifo->commit(count);
+    writeTrigger();
 }
 
 template<typename T>
@@ -127,14 +166,17 @@ void Stream<T>::readDmaComplete(unsigned int count)
 {
     if (mReadFifo != nullptr)
     {
-
+        // the DMA wrote into the FIFO directly
+        mReadFifo->commit(count);
+        System::instance()->postEvent(&mReadEvent);
+        readTrigger();
     }
     else
     {
         mReadData += count;
         mReadCount -= count;
+        if (mReadCount == 0) readEpilog();
     }
-    if (mReadCount == 0) readEpilog();
 }
 
 template<typename T>
@@ -170,9 +212,8 @@ void Stream<T>::readDmaBuffer(T *&data, unsigned int &count)
 {
     if (mReadFifo != nullptr)
     {
-        data = mReadFifo->writePointer();
-        if (mReadFifo->free() > 0) count = 1;
-        else count = 0;
+        // a byte at a time, there is no way to end the transfer early when less comes in
+        count = mReadFifo->reserve(data, 1);
     }
     else
     {
@@ -181,12 +222,52 @@ void Stream<T>::readDmaBuffer(T *&data, unsigned int &count)
     }
 }
 
+template<typename T>
+unsigned int Stream<T>::readDmaCircular(T *&data)
+{
+    if (mReadFifo == nullptr || mReadFifoType != FifoType::Circular) return 0;
+    CircularBuffer<T>* fifo = static_cast<CircularBuffer<T>*>(mReadFifo);
+    // the DMA starts at the beginning of the memory, so does a new or an empty FIFO
+    if (fifo->writePointer() != fifo->bufferPointer() && !fifo->rewind()) return 0;
+    data = fifo->bufferPointer();
+    mReadDmaPos = 0;
+    return fifo->size();
+}
+
+template<typename T>
+void Stream<T>::readDmaPosition(unsigned int pos)
+{
+    CircularBuffer<T>* fifo = static_cast<CircularBuffer<T>*>(mReadFifo);
+    unsigned int size = fifo->size();
+    // called from the DMA and the peripheral interrupt
+    uint32_t primask = interrupt_disable();
+    unsigned int count = (pos + size - mReadDmaPos) % size;
+    mReadDmaPos = pos % size;
+    if (count != 0)
+    {
+        if (count > fifo->free())
+        {
+            // the DMA went over the oldest data, what is left is the newest
+            fifo->release(count - fifo->free());
+            readResult(System::Event::Result::OverrunError);
+        }
+        fifo->commit(count);
+        if (!mReadPosted)
+        {
+            mReadPosted = true;
+            System::instance()->postEvent(&mReadEvent);
+        }
+    }
+    interrupt_restore(primask);
+}
+
 template<typename T>
 void Stream<T>::writeDmaComplete(unsigned int count)
 {
+    mWriteDmaCount = 0;
     if (mWriteFifo != nullptr)
     {
-        mWriteFifo->skip(count);
+        mWriteFifo->release(count);
         if (mWriteFifo->used() != 0) writeTrigger();
     }
     else
@@ -218,6 +299,13 @@ bool Stream<T>::write(T &data)
         return true;
     }
     writeEpilog();
+    // the next one from the queue goes on right away
+    if (mWriteFifo == nullptr && mWriteCount != 0)
+    {
+        data = *mWriteData++;
+        --mWriteCount;
+        return true;
+    }
     return false;
 }
 
@@ -226,13 +314,14 @@ void Stream<T>::writeDmaBuffer(const T *&data, unsigned int &count)
 {
     if (mWriteFifo != nullptr)
     {
-        count = mWriteFifo->getContBuffer(data);
+        count = mWriteFifo->peek(data);
     }
     else
     {
         data = mWriteData;
         count = mWriteCount;
     }
+    mWriteDmaCount = count;
 }
 
 template<typename T>
@@ -240,6 +329,7 @@ void Stream<T>::eventCallback(System::Event *event)
 {
     if (event == &mReadEvent)
     {
+        mReadPosted = false;
         readFromFifo(mReadData, mReadCount);
         if (mReadCount == 0 && mReadData != nullptr) readEpilog();
     }
@@ -283,7 +373,10 @@ void Stream<T>::readFromFifo(T *&data, volatile unsigned int &count)
 {
     if (mReadFifo != nullptr && data != nullptr && count != 0)
     {
+        // readDmaPosition() drops the oldest data from the interrupt when the DMA overran it
+        uint32_t primask = interrupt_disable();
         int len = mReadFifo->read(data, count);
+        interrupt_restore(primask);
         count -= len;
         data += len;
     }
@@ -323,6 +416,17 @@ void Stream<T>::writeEpilog()
         System::instance()->postEvent(mWriteCompleteEvent);
         mWriteCompleteEvent = nullptr;
     }
+    WriteRequest request;
+    if (mWriteQueue.pop(request))
+    {
+        // chained, so the line doesn't wait for the event loop
+        mWriteCompleteEvent = request.mCompleteEvent;
+        writeResult(System::Event::Result::Success);
+        mWriteCount = request.mCount;
+        mWriteData = request.mData;
+        writePrepare();
+        writeTrigger();
+    }
 }
 
 template<typename T>
@@ -337,6 +441,18 @@ void Stream<T>::writeToFifo(const T *&data, unsigned int &count)
     }
 }
 
+template<typename T>
+Fifo<T>* Stream<T>::createFifo(unsigned int size, FifoType type)
+{
+    if (type == FifoType::Bip) return new BipBuffer<T>(size);
+    return new CircularBuffer<T>(size);
+}
+
+template<typename T>
+const unsigned int Stream<T>::WRITE_QUEUE_SIZE;
+
 template class Stream<char>;
 template class Stream<uint16_t>;
+template class StaticCircularBuffer<Stream<char>::WriteRequest, Stream<char>::WRITE_QUEUE_SIZE>;
+template class StaticCircularBuffer<Stream<uint16_t>::WriteRequest, Stream<uint16_t>::WRITE_QUEUE_SIZE>;
 
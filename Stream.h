@@ -21,12 +21,19 @@
 
 #include "System.h"
 #include "CircularBuffer.h"
+#include "BipBuffer.h"
+#include "StaticCircularBuffer.h"
 #include "Dma.h"
 
+#include <algorithm>
+
 template<typename T>
 class Stream : public System::Event::Callback
 {
 public:
+    // BipBuffer keeps what gets written in one piece contiguous, so DMA transfers don't get split at the end of the memory
+    enum class FifoType { Circular, Bip };
+
     Stream();
     ~Stream();
     bool read(T* data, unsigned int count);
@@ -35,8 +42,23 @@ public:
     bool write(const T* data, unsigned int count);
     bool write(const T* data, unsigned int count, System::Event* completeEvent);
 
-    virtual void readFifo(unsigned int size);
-    virtual void writeFifo(unsigned int size);
+    virtual void readFifo(unsigned int size, FifoType type = FifoType::Circular);
+    virtual void writeFifo(unsigned int size, FifoType type = FifoType::Circular);
+    // a FIFO of another kind, like Console, the Stream owns it from then on
+    void writeFifo(Fifo<T>* fifo);
+    // writes in place into the write FIFO, like a formatter does, the result is the space there is, 0 without a FIFO
+    unsigned int writeReserve(T*& data, unsigned int count);
+    void writeCommit(unsigned int count);
+    // room in the write FIFO, a write() of up to that much doesn't wait, 0 without a FIFO
+    unsigned int writeFree() { return mWriteFifo != nullptr ? mWriteFifo->free() : 0; }
+    // Writes with a completeEvent that come while one is going on wait in a queue of up to depth requests,
+    // the data is not copied. When one completes the next one gets started right there, without the event loop.
+    static const unsigned int WRITE_QUEUE_SIZE = 8;
+    void writeQueue(unsigned int depth) { mWriteQueueDepth = std::min(depth, WRITE_QUEUE_SIZE); }
+    unsigned int writeQueueUsed() { return mWriteQueue.used(); }
+    unsigned int writeQueueMaxUsed() { return mWriteQueueMaxUsed; }
+    // writes that got refused, because one was going on and the queue was full
+    unsigned int writeQueueOverflow() { return mWriteQueueOverflow; }
 protected:
     virtual void readPrepare() = 0;
     virtual void readSync() = 0;
@@ -47,6 +69,10 @@ protected:
     void readResult(System::Event::Result result);
     bool read(T data);
     void readDmaBuffer(T*& data, unsigned int& count);
+    // For a DMA running circular over the memory of the read FIFO, the result is its size, 0 if the FIFO
+    // can't be used like that. readDmaPosition() tells where the DMA is and publishes what it wrote since.
+    unsigned int readDmaCircular(T*& data);
+    void readDmaPosition(unsigned int pos);
 
     virtual void writePrepare() = 0;
     virtual void writeSync() = 0;
@@ -57,19 +83,37 @@ protected:
     void writeResult(System::Event::Result result);
     bool write(T& data);
     void writeDmaBuffer(const T*& data, unsigned int& count);
+    // a transfer from writeDmaBuffer() is going on, writeDmaComplete() didn't come yet
+    bool writeDmaPending() { return mWriteDmaCount != 0; }
 
     virtual void eventCallback(System::Event *event);
 
 private:
+    struct WriteRequest
+    {
+        const T* mData;
+        unsigned int mCount;
+        System::Event* mCompleteEvent;
+    };
+
     T* mReadData;
     volatile unsigned int mReadCount;
     System::Event* mReadCompleteEvent;
     System::Event mReadEvent;
     const T* mWriteData;
     volatile int mWriteCount;
+    volatile unsigned int mWriteDmaCount;
     System::Event* mWriteCompleteEvent;
-    CircularBuffer<T>* mReadFifo;
-    CircularBuffer<T>* mWriteFifo;
+    Fifo<T>* mReadFifo;
+    Fifo<T>* mWriteFifo;
+    FifoType mReadFifoType;
+    unsigned int mReadDmaPos;
+    // mReadEvent is queued already, the next burst gets picked up with it
+    volatile bool mReadPosted;
+    StaticCircularBuffer<WriteRequest, WRITE_QUEUE_SIZE> mWriteQueue;
+    unsigned int mWriteQueueDepth;
+    unsigned int mWriteQueueMaxUsed;
+    unsigned int mWriteQueueOverflow;
 
     bool readProlog(T* data, unsigned int count);
     void readEpilog();
@@ -78,6 +122,7 @@ private:
     bool writeProlog(const T* data, unsigned int count);
     void writeEpilog();
     void writeToFifo(const T *&data, unsigned int &count);
+    static Fifo<T>* createFifo(unsigned int size, FifoType type);
 };
 
 #endif // STREAM_H
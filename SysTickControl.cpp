@@ -17,6 +17,7 @@
  */
 
 #include "SysTickControl.h"
+#include "atomic.h"
 
 
 SysTickControl::SysTickControl(System::BaseAddress base, ClockControl *clock) :
@@ -25,12 +26,15 @@ SysTickControl::SysTickControl(System::BaseAddress base, ClockControl *clock) :
     mSingleCountTime(1),
     mCountPerMs(1),
     mMilliseconds(0),
-    mNextTick(-1)
+    mExtraCount(0),
+    mNextTick(-1),
+    mMaxTick(1000),
+    mTickCount(0)
 {
     static_assert(sizeof(STK) == 0x10, "Struct has wrong size, compiler problem.");
     clock->addChangeHandler(this);
     config();
-    setNextTick(1000);
+    setNextTick(mMaxTick);
 }
 
 void SysTickControl::enable()
@@ -47,16 +51,26 @@ void SysTickControl::disable()
 void SysTickControl::setNextTick(unsigned ms)
 {
     disable();
-    mBase->RELOAD = ms * mCountPerMs - 1;
+    // end the period on a ms boundary
+    mBase->RELOAD = ms * mCountPerMs - mExtraCount - 1;
     mNextTick = ms;
     enable();
 }
 
+void SysTickControl::passed(uint32_t counts)
+{
+    counts += mExtraCount;
+    unsigned ms = counts / mCountPerMs;
+    mExtraCount = counts % mCountPerMs;
+    mMilliseconds += ms;
+    mWheel.advance(ms);
+}
+
 void SysTickControl::addRepeatingEvent(SysTickControl::RepeatingEvent *event)
 {
     if (event != nullptr)
     {
-        mRepeatingEvents.push_back(event);
+        addTimer(event, event->ms(), event->ms());
     }
 }
 
@@ -64,22 +78,62 @@ void SysTickControl::removeRepeatingEvent(SysTickControl::RepeatingEvent *event)
 {
     if (event != nullptr)
     {
+        removeTimer(event);
+    }
+}
 
-        //mRepeatingEvents.erase();
+void SysTickControl::addTimer(TimerWheel::Timer *timer, unsigned ms, unsigned period)
+{
+    uint32_t primask = interrupt_disable();
+    if (System::instance()->sysTickPending())
+    {
+        // the period is over, but tick() didn't advance the wheel yet, it will also pick up the new timer
+        mWheel.add(timer, mNextTick + ms, period);
+    }
+    else
+    {
+        // the wheel is at the start of the current period, ms counts from now.
+        // VAL is 0 until the first count after setNextTick(), the period just started then.
+        uint32_t val = mBase->VAL;
+        uint32_t counts = val != 0 ? mBase->RELOAD - val : 0;
+        ms += (mExtraCount + counts) / mCountPerMs;
+        mWheel.add(timer, ms, period);
+        if (ms < mNextTick)
+        {
+            // Expires before the programmed tick, start a shorter period. The counter stops first, so what it
+            // counted since VAL was read belongs to the period that ends here and nothing gets lost.
+            disable();
+            if (!System::instance()->sysTickPending())
+            {
+                val = mBase->VAL;
+                passed(val != 0 ? mBase->RELOAD - val : 0);
+                ++mTickCount;
+                setNextTick(mWheel.next(mMaxTick));
+            }
+            else
+            {
+                // it ran out meanwhile, tick() takes it from here
+                mBase->CTRL.ENABLE = 1;
+            }
+        }
     }
+    interrupt_restore(primask);
+}
+
+void SysTickControl::removeTimer(TimerWheel::Timer *timer)
+{
+    uint32_t primask = interrupt_disable();
+    mWheel.remove(timer);
+    interrupt_restore(primask);
 }
 
 // IRQ callback
 void SysTickControl::tick()
 {
-    unsigned nextTick = 1000;
-    mMilliseconds += mNextTick;
-    for (auto& iter : mRepeatingEvents)
-    {
-        iter->millisecondsPassed(mNextTick);
-        if (iter->msRemain() < nextTick) nextTick = iter->msRemain();
-    }
-    setNextTick(nextTick);
+    // the counter already started over, so add what passed since then
+    passed(mBase->RELOAD + 1 + mBase->RELOAD - mBase->VAL);
+    ++mTickCount;
+    setNextTick(mWheel.next(mMaxTick));
 }
 
 void SysTickControl::usleep(unsigned int us)
@@ -96,13 +150,16 @@ uint64_t SysTickControl::ns()
 {
     uint32_t ms;
     uint32_t count;
+    unsigned tickCount;
     do
     {
+        tickCount = mTickCount;
         mBase->CTRL.COUNTFLAG = 0;
         count = mBase->VAL;
         ms = mMilliseconds;
-    }   while (mBase->CTRL.COUNTFLAG);
-    uint64_t val = mBase->RELOAD - count;
+        count = mBase->RELOAD - count + mExtraCount;
+    }   while (mBase->CTRL.COUNTFLAG || tickCount != mTickCount);
+    uint64_t val = count;
     val *= mSingleCountTime;
     val += ms * static_cast<uint64_t>(1000000);
     return val;
@@ -110,26 +167,33 @@ uint64_t SysTickControl::ns()
 
 void SysTickControl::clockCallback(ClockControl::Callback::Reason reason, uint32_t newClock)
 {
-    if (reason == ClockControl::Callback::Reason::Changed) config();
+    if (reason == ClockControl::Callback::Reason::AboutToChange)
+    {
+        uint32_t primask = interrupt_disable();
+        passed(mBase->RELOAD - mBase->VAL);
+        mExtraCount = 0;
+        ++mTickCount;
+        interrupt_restore(primask);
+    }
+    else if (reason == ClockControl::Callback::Reason::Changed)
+    {
+        config();
+        setNextTick(mWheel.next(mMaxTick));
+    }
 }
 
 void SysTickControl::config()
 {
     mCountPerMs = mClock->clock(ClockControl::Clock::AHB) / 8000;
     mSingleCountTime = 1000000 / mCountPerMs;
+    mMaxTick = 0xffffff / mCountPerMs;
+    if (mMaxTick > 1000) mMaxTick = 1000;
     mBase->CTRL.CLKSOURCE = 0;
     mBase->CTRL.TICKINT = 1;
 }
 
 
-
-void SysTickControl::RepeatingEvent::millisecondsPassed(unsigned ms)
+void SysTickControl::TimerEvent::expired()
 {
-    mMsFromStart += ms;
-    if (mMsFromStart >= mMs)
-    {
-        System::instance()->postEvent(this);
-        mMsFromStart -= mMs;
-        if (mMsFromStart >= mMs) mMsFromStart = 0;
-    }
+    System::instance()->postEvent(this);
 }
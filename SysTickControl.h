@@ -22,23 +22,31 @@
 #include "System.h"
 #include "ClockControl.h"
 #include "InterruptController.h"
+#include "TimerWheel.h"
 
 class SysTickControl : ClockControl::Callback
 {
 public:
-    class RepeatingEvent : public System::Event
+    // gets posted when the timer expires
+    class TimerEvent : public System::Event, public TimerWheel::Timer
     {
     public:
-        RepeatingEvent(Callback& callback, int ms) : System::Event(callback), mMs(ms), mMsFromStart(0)
+        TimerEvent(Callback& callback, Priority priority = Priority::Normal) : System::Event(callback, priority)
+        { }
+
+    protected:
+        virtual void expired();
+    };
+
+    class RepeatingEvent : public TimerEvent
+    {
+    public:
+        RepeatingEvent(Callback& callback, int ms, Priority priority = Priority::Normal) : TimerEvent(callback, priority), mMs(ms)
         { }
 
-        void millisecondsPassed(unsigned ms);
         unsigned ms() const { return mMs; }
-        unsigned msRemain() const { return mMs - mMsFromStart; }
     private:
         unsigned mMs;
-
-        unsigned mMsFromStart;
     };
 
     SysTickControl(System::BaseAddress base, ClockControl* clock);
@@ -46,6 +54,11 @@ public:
 
     void addRepeatingEvent(RepeatingEvent* event);
     void removeRepeatingEvent(RepeatingEvent* event);
+    // expires ms from now, then every period ms if period is not 0. Not from interrupts with higher priority than SysTick.
+    void addTimer(TimerWheel::Timer* timer, unsigned ms, unsigned period = 0);
+    void removeTimer(TimerWheel::Timer* timer);
+    // makes sure there is a tick in ms, to wake up from WFI
+    void wakeup(unsigned ms) { addTimer(&mWakeup, ms); }
 
     void tick();
 
@@ -56,6 +69,13 @@ protected:
     virtual void clockCallback(ClockControl::Callback::Reason reason, uint32_t newClock);
 
 private:
+    // the tick is all it takes
+    class Wakeup : public TimerWheel::Timer
+    {
+    protected:
+        virtual void expired() { }
+    };
+
     struct STK
     {
         struct __CTRL
@@ -82,13 +102,20 @@ private:
     unsigned mSingleCountTime;
     uint32_t mCountPerMs;
     unsigned mMilliseconds;
+    // counts of the last periods that didn't add up to a full ms
+    uint32_t mExtraCount;
     unsigned mNextTick;
-    std::vector<RepeatingEvent*> mRepeatingEvents;
+    // the longest period the 24 bit RELOAD allows
+    unsigned mMaxTick;
+    volatile unsigned mTickCount;
+    TimerWheel mWheel;
+    Wakeup mWakeup;
 
     void config();
     void enable();
     void disable();
     void setNextTick(unsigned ms);
+    void passed(uint32_t counts);
 };
 
 #endif // SYSTICKCONTROL_H
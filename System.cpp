@@ -17,6 +17,7 @@
  */
 
 #include "System.h"
+#include "atomic.h"
 
 #include <cstdio>
 #include <cstring>
@@ -30,6 +31,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#if __arm__
 extern "C"
 {
 
@@ -64,7 +66,14 @@ void __attribute__((interrupt)) Isr()
 
 void __attribute__((interrupt)) SysTick()
 {
+#ifdef TRACE
+    // 15 is the exception number of SysTick
+    System::instance()->trace().record(Trace::Type::InterruptEnter, 15);
     System::instance()->handleSysTick();
+    System::instance()->trace().record(Trace::Type::InterruptExit, 15);
+#else
+    System::instance()->handleSysTick();
+#endif
 }
 
 extern void (* const gIsrVectorTable[])(void);
@@ -203,7 +212,8 @@ void _exit(int v)
 
 void *operator new(std::size_t size)
 {
-    return malloc(size);
+    void* mem = System::blockPool().alloc(size);
+    return mem != nullptr ? mem : malloc(size);
 }
 
 void *operator new[](std::size_t size)
@@ -213,7 +223,7 @@ void *operator new[](std::size_t size)
 
 void operator delete(void *mem)
 {
-    free(mem);
+    if (!System::blockPool().free(mem)) free(mem);
 }
 
 void operator delete[](void *mem)
@@ -236,10 +246,18 @@ namespace std
     }
 }
 
+#endif  // __arm__
+
 System* System::mSystem;
 char* System::mHeapEnd;
+BlockPool System::mBlockPool(System::increaseHeap);
 const unsigned int System::STACK_MAGIC;
+const unsigned int System::EVENT_QUEUE_SIZE;
+const unsigned int System::EVENT_MAX_SKIP;
+const unsigned int System::Event::PRIORITY_COUNT;
+const uint64_t System::NO_DEADLINE;
 
+#if __arm__
 void System::initStack()
 {
     unsigned int* p = reinterpret_cast<unsigned int*>(&__stack_start);
@@ -309,6 +327,52 @@ uint32_t System::stackMaxUsed()
     }
     return (reinterpret_cast<unsigned int*>(&__stack_end) - p) * sizeof(unsigned int);
 }
+#else
+// there are no linker symbols on the host and the heap belongs to the C library
+void System::initStack()
+{
+}
+
+char* System::increaseHeap(unsigned int incr)
+{
+    return nullptr;
+}
+
+uint32_t System::memFree()
+{
+    return 0;
+}
+
+uint32_t System::memUsed()
+{
+    return 0;
+}
+
+uint32_t System::memDataUsed()
+{
+    return 0;
+}
+
+uint32_t System::memBssUsed()
+{
+    return 0;
+}
+
+uint32_t System::stackFree()
+{
+    return 0;
+}
+
+uint32_t System::stackUsed()
+{
+    return 0;
+}
+
+uint32_t System::stackMaxUsed()
+{
+    return 0;
+}
+#endif  // __arm__
 
 uint64_t System::timeInInterrupt()
 {
@@ -323,21 +387,106 @@ uint64_t System::timeInEvent()
 
 void System::postEvent(Event *event)
 {
-    __asm("cpsid i");
-    if (!mSystem->mEventQueue.push(event)) printf("Could not push event %p.\n", event);
-    __asm("cpsie i");
+#ifdef TRACE
+    mSystem->mTrace.record(Trace::Type::EventPost, event);
+#endif
+    if (!mSystem->mEventQueue.push(event, static_cast<unsigned int>(event->priority()))) printf("Could not push event %p.\n", event);
+}
+
+void System::postEventAt(Event *event, uint64_t deadline)
+{
+    uint32_t primask = interrupt_disable();
+    cancelEvent(event);
+    event->mDeadline = deadline;
+    // behind the ones with the same deadline, so they get posted in order
+    Event** next = &mTimedEvents;
+    while (*next != nullptr && (*next)->mDeadline <= deadline) next = &(*next)->mNextTimed;
+    event->mNextTimed = *next;
+    *next = event;
+    interrupt_restore(primask);
+}
+
+bool System::cancelEvent(Event *event)
+{
+    bool found = false;
+    uint32_t primask = interrupt_disable();
+    for (Event** next = &mTimedEvents; *next != nullptr; next = &(*next)->mNextTimed)
+    {
+        if (*next == event)
+        {
+            *next = event->mNextTimed;
+            event->mNextTimed = nullptr;
+            found = true;
+            break;
+        }
+    }
+    interrupt_restore(primask);
+    return found;
+}
+
+uint64_t System::postTimedEvents()
+{
+    uint64_t now = ns();
+    uint32_t primask = interrupt_disable();
+    while (mTimedEvents != nullptr && mTimedEvents->mDeadline <= now)
+    {
+        Event* event = mTimedEvents;
+        mTimedEvents = event->mNextTimed;
+        event->mNextTimed = nullptr;
+        postEvent(event);
+    }
+    uint64_t next = mTimedEvents != nullptr ? mTimedEvents->mDeadline : NO_DEADLINE;
+    interrupt_restore(primask);
+    return next;
 }
 
 bool System::waitForEvent(Event *&event)
 {
     uint64_t start = ns();
+    uint64_t deadline = postTimedEvents();
     while (mEventQueue.used() == 0)
     {
-        __asm("wfi");
+        if (deadline != NO_DEADLINE)
+        {
+            uint64_t now = ns();
+            if (deadline <= now)
+            {
+                deadline = postTimedEvents();
+                continue;
+            }
+            setWakeup(deadline - now);
+        }
+        waitForInterrupt();
+        deadline = postTimedEvents();
     }
-    ++mEventCount;
     mTimeIdle += ns() - start;
-    return mEventQueue.pop(event);
+    bool popped = mEventQueue.pop(event);
+    if (popped) ++mEventCount;
+    return popped;
+}
+
+void System::dispatchEvent(Event *event)
+{
+#ifdef TRACE
+    mTrace.record(Trace::Type::EventDispatch, event);
+#endif
+#ifdef PROFILER
+    uint64_t start = ns();
+    event->callback();
+    mProfiler.eventDone(event, ns() - start);
+#else
+    event->callback();
+#endif
+#ifdef TRACE
+    mTrace.record(Trace::Type::EventDone, event);
+#endif
+}
+
+void System::waitForInterrupt()
+{
+#if __arm__
+    __asm("wfi");
+#endif
 }
 
 void System::updateBogoMips()
@@ -362,7 +511,8 @@ void System::nspin(uint16_t ns)
 System::System(BaseAddress base) :
     mBase(reinterpret_cast<volatile SCB*>(base)),
     mBogoMips(0),
-    mEventQueue(128),
+    mEventQueue(EVENT_QUEUE_SIZE, EVENT_MAX_SKIP),
+    mTimedEvents(nullptr),
     mTimeInInterrupt(0),
     mTimeIdle(0),
     mEventCount(0),
@@ -381,6 +531,7 @@ System::System(BaseAddress base) :
 
 System::~System()
 {
+    mSystem = nullptr;
 }
 
 // The stack looks like this: (FPSCR, S15-S0) xPSR, PC, LR, R12, R3, R2, R1, R0
@@ -422,7 +573,7 @@ void System::handleTrap(TrapIndex index, unsigned int* stackPointer)
         if (mBase->CFSR.MUNSTKERR) printf("  Unstacking for return from exception fault.\n");
         if (mBase->CFSR.DACCVIOL) printf("  Data access violation.\n");
         if (mBase->CFSR.IACCVIOL) printf("  Instruction access violation.\n");
-        if (mBase->CFSR.MMARVALID) printf("  At address %08lx (%lu).\n", mBase->MMFAR, mBase->MMFAR);
+        if (mBase->CFSR.MMARVALID) printf("  At address %08lx (%lu).\n", static_cast<unsigned long>(mBase->MMFAR), static_cast<unsigned long>(mBase->MMFAR));
         break;
     case TrapIndex::BusFault:
         if (mBase->CFSR.LSPERR) printf("  Floating point lazy state preservation.\n");
@@ -430,7 +581,7 @@ void System::handleTrap(TrapIndex index, unsigned int* stackPointer)
         if (mBase->CFSR.UNSTKERR) printf("  Unstacking for return from exception fault.\n");
         if (mBase->CFSR.IMPRECISERR) printf("  Imprecise data bus error.\n");
         if (mBase->CFSR.IBUSERR) printf("  Instruction bus error.\n");
-        if (mBase->CFSR.BFARVALID) printf("  At address %08lx (%lu).\n", mBase->BFAR, mBase->BFAR);
+        if (mBase->CFSR.BFARVALID) printf("  At address %08lx (%lu).\n", static_cast<unsigned long>(mBase->BFAR), static_cast<unsigned long>(mBase->BFAR));
         break;
     case TrapIndex::UsageFault:
         if (mBase->CFSR.DIVBYZERO) printf("  Divide by zero.\n");
@@ -470,7 +621,7 @@ void System::handleTrap(TrapIndex index, unsigned int* stackPointer)
         {"xPSR", 7},
     };
 
-    printf("Stack (0x%08x):\n", reinterpret_cast<unsigned int>(stackPointer));
+    printf("Stack (%p):\n", stackPointer);
 
     int i = 0;
     for (const Register& reg : REGISTER)
@@ -483,9 +634,20 @@ void System::handleTrap(TrapIndex index, unsigned int* stackPointer)
 void System::handleInterrupt()
 {
     uint64_t start = ns();
-    handleInterrupt(mBase->ICSR.VECTACTIVE - 16);
-    mTimeInInterrupt += ns() - start;
+    uint32_t index = mBase->ICSR.VECTACTIVE - 16;
+#ifdef TRACE
+    mTrace.record(Trace::Type::InterruptEnter, index + 16);
+#endif
+    handleInterrupt(index);
+#ifdef TRACE
+    mTrace.record(Trace::Type::InterruptExit, index + 16);
+#endif
+    uint64_t time = ns() - start;
+    mTimeInInterrupt += time;
     ++mInterruptCount;
+#ifdef PROFILER
+    mProfiler.interruptDone(index, time);
+#endif
 }
 
 void System::printWarning(const char *component, const char *message)
@@ -20,7 +20,12 @@
 #define SYSTEM_H
 
 #include "ExternalInterrupt.h"
+#include "BlockPool.h"
 #include "CircularBuffer.h"
+#include "PriorityQueue.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "Log.h"
 #include <cstdint>
 #include <queue>
 #include <memory>
@@ -48,21 +53,31 @@ public:
     {
     public:
         enum class Result { Success, ParityError, FramingError, NoiseDetected, OverrunError, LineBreak, CommandResponse, CommandSent, CommandCrcFail, CommandTimeout, DataSuccess, DataFail };
+        enum class Priority { High, Normal, Low };
+        static const unsigned int PRIORITY_COUNT = 3;
         class Callback
         {
         public:
             virtual void eventCallback(Event* event) = 0;
         };
 
-        Event(Callback& callback) : mCallback(callback) { }
+        Event(Callback& callback, Priority priority = Priority::Normal) : mPriority(priority), mCallback(callback), mDeadline(0), mNextTimed(nullptr) { }
 
         void callback() { mCallback.eventCallback(this); }
 
         void setResult(Result result) { mResult = result; }
         Result result() { return mResult; }
+        void setPriority(Priority priority) { mPriority = priority; }
+        Priority priority() { return mPriority; }
     private:
         Result mResult;
+        Priority mPriority;
         Callback& mCallback;
+        // for postEventAt(), the list of waiting events is sorted by the deadline
+        uint64_t mDeadline;
+        Event* mNextTimed;
+
+        friend class System;
     };
 
     enum class TrapIndex
@@ -88,6 +103,8 @@ public:
 
     static inline System* instance() { return mSystem; }
     static char* increaseHeap(unsigned int incr);
+    // serves the small blocks of operator new
+    static BlockPool& blockPool() { return mBlockPool; }
     static void initStack();
     template <class T>
     static inline void setRegister(volatile T* reg, uint32_t value) { *reinterpret_cast<volatile uint32_t*>(reg) = value; }
@@ -95,9 +112,12 @@ public:
 
     virtual void handleTrap(TrapIndex index, unsigned int *stackPointer);
     void handleTrap(unsigned int* stackPointer) { handleTrap(static_cast<TrapIndex>(mBase->ICSR.VECTACTIVE), stackPointer); }
+    bool sysTickPending() { return mBase->ICSR.PENDSTSET; }
 
     void handleInterrupt();
 
+    // clocks, memory, events and the like on the console, nothing unless the system knows more
+    virtual void printInfo() { }
     void printWarning(const char* component, const char* message);
     void printError(const char* component, const char* message);
     template<typename T>
@@ -115,17 +135,61 @@ public:
     uint64_t timeInEvent();
     uint32_t interruptCount() { return mInterruptCount; }
     uint32_t eventCount() { return mEventCount; }
+    uint32_t eventQueueUsed(Event::Priority priority) { return mEventQueue.used(static_cast<unsigned int>(priority)); }
+    uint32_t eventQueueMaxUsed(Event::Priority priority) { return mEventQueue.maxUsed(static_cast<unsigned int>(priority)); }
+    uint32_t eventQueueOverflow(Event::Priority priority) { return mEventQueue.overflow(static_cast<unsigned int>(priority)); }
+#ifdef PROFILER
+    Profiler& profiler() { return mProfiler; }
+#endif
+    // name shown for the event by the profiler, does nothing without PROFILER
+    void setEventName(const Event* event, const char* name)
+    {
+#ifdef PROFILER
+        mProfiler.setName(event, name);
+#endif
+    }
+
+#ifdef TRACE
+    Trace& trace() { return mTrace; }
+#endif
+    // where the LOG_...() macros write to
+    Log& log() { return mLog; }
+    // puts marker into the trace, does nothing without TRACE
+    void traceMarker(uint32_t marker)
+    {
+#ifdef TRACE
+        mTrace.record(Trace::Type::Marker, marker);
+#endif
+    }
 
     void postEvent(Event* event);
+    // posts the event once ns() reached the deadline, never before. The event loop sleeps until then,
+    // it gets woken up by a SysTick on the next ms boundary unless an interrupt comes earlier.
+    void postEventAt(Event* event, uint64_t deadline);
+    void postEventAfter(Event* event, uint64_t delay) { postEventAt(event, ns() + delay); }
+    // false if the event was not waiting for its deadline
+    bool cancelEvent(Event* event);
     bool waitForEvent(Event*& event);
+    void dispatchEvent(Event* event);
+    bool eventPending() { return mEventQueue.used() != 0; }
 
     void updateBogoMips();
     uint32_t bogoMips() { return mBogoMips; }
-    void nspin(uint16_t ns);
+    // busy waits, with the bogoMips() unless there is something better
+    virtual void nspin(uint16_t ns);
 
 protected:
     System(BaseAddress base);
-    ~System();
+    virtual ~System();
+
+    static const uint64_t NO_DEADLINE = ~0ull;
+
+    // sleeps until the next interrupt got handled
+    virtual void waitForInterrupt();
+    // waitForInterrupt() has to return after delay ns at the latest, without it a timed event can be up to a SysTick period late
+    virtual void setWakeup(uint64_t /*delay*/) { }
+    // posts the events that are due, returns the deadline of the next one or NO_DEADLINE
+    uint64_t postTimedEvents();
 
 private:
     struct SCB
@@ -256,16 +320,28 @@ private:
     };
 
     static const unsigned int STACK_MAGIC = 0xACE01234;
+    static const unsigned int EVENT_QUEUE_SIZE = 128;
+    // number of times a lower priority event can be passed over before it gets dispatched anyway
+    static const unsigned int EVENT_MAX_SKIP = 16;
     static System* mSystem;
     static char* mHeapEnd;
+    static BlockPool mBlockPool;
 
     volatile SCB* mBase;
     uint32_t mBogoMips;
-    CircularBuffer<Event*> mEventQueue;
+    PriorityQueue<Event*, Event::PRIORITY_COUNT> mEventQueue;
+    Event* mTimedEvents;
     uint64_t mTimeInInterrupt;
     uint64_t mTimeIdle;
     uint32_t mEventCount;
     uint32_t mInterruptCount;
+#ifdef PROFILER
+    Profiler mProfiler;
+#endif
+#ifdef TRACE
+    Trace mTrace;
+#endif
+    Log mLog;
 };
 
 #endif
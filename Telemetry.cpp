@@ -0,0 +1,40 @@
+#include "Telemetry.h"
+
+#include <cstring>
+
+const unsigned int Telemetry::MAX_PAYLOAD;
+const unsigned int Telemetry::HEADER_SIZE;
+const unsigned int Telemetry::CRC_SIZE;
+const unsigned int Telemetry::MAX_FRAME;
+
+Telemetry::Telemetry(Stream<char> &stream, Crc &crc) :
+    mStream(stream),
+    mCrc(crc),
+    mSequence(0),
+    mSent(0),
+    mDropped(0)
+{
+}
+
+bool Telemetry::send(Telemetry::Type type, const void *payload, unsigned int len)
+{
+    if (len > MAX_PAYLOAD) return false;
+    mFrame[0] = static_cast<uint8_t>(type);
+    // counts dropped frames as well, so they show up as gap
+    mFrame[1] = mSequence++;
+    std::memcpy(mFrame + HEADER_SIZE, payload, len);
+    len += HEADER_SIZE;
+    uint32_t crc = mCrc.compute(mFrame, len);
+    for (unsigned int i = 0; i < CRC_SIZE; ++i) mFrame[len++] = crc >> (i * 8);
+
+    mEncoded[0] = 0;
+    len = Cobs::encode(mFrame, len, mEncoded + 1) + 1;
+    mEncoded[len++] = 0;
+    if (mStream.writeFree() < len || !mStream.write(reinterpret_cast<const char*>(mEncoded), len))
+    {
+        ++mDropped;
+        return false;
+    }
+    ++mSent;
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Stream.h"
+#include "Crc.h"
+#include "Cobs.h"
+
+// Binary frames on the console line, next to the text of the shell. A frame is the type, a sequence number,
+// the payload and the CRC-32 of all that (see Crc), COBS encoded with a 0 before and after it. The text has
+// no 0 bytes, that's how tools/telemetrydecode tells both apart. A frame only goes out whole: if the write
+// FIFO of the stream doesn't have room for it, it is dropped and the decoder sees the sequence number gap.
+class Telemetry
+{
+public:
+    enum class Type : uint8_t
+    {
+        Raw,
+        // int8_t x, y and z, like LIS302DL gives them, as many samples as fit
+        Acceleration,
+        // uint32_t distances in mm, like HcSr04 gives them
+        Distance,
+    };
+
+    static const unsigned int MAX_PAYLOAD = 240;
+    // type and sequence number in front, CRC at the end, little endian
+    static const unsigned int HEADER_SIZE = 2;
+    static const unsigned int CRC_SIZE = 4;
+    static const unsigned int MAX_FRAME = HEADER_SIZE + MAX_PAYLOAD + CRC_SIZE;
+
+    Telemetry(Stream<char>& stream, Crc& crc);
+
+    // there's room for a payload of len, for those that would rather wait than have it dropped
+    bool ready(unsigned int len) { return mStream.writeFree() >= Cobs::maxEncodedSize(HEADER_SIZE + len + CRC_SIZE) + 2; }
+    bool send(Type type, const void* payload, unsigned int len);
+    unsigned int sent() { return mSent; }
+    unsigned int dropped() { return mDropped; }
+
+private:
+    Stream<char>& mStream;
+    Crc& mCrc;
+    uint8_t mSequence;
+    unsigned int mSent;
+    unsigned int mDropped;
+    // word aligned for the CRC unit
+    alignas(4) uint8_t mFrame[MAX_FRAME];
+    uint8_t mEncoded[MAX_FRAME + MAX_FRAME / 254 + 3];
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,86 @@
+#include "Timebase.h"
+#include "atomic.h"
+
+const unsigned int Timebase::SHIFT;
+
+Timebase::Timebase(const volatile uint32_t *counter, ClockControl *clock) :
+    mCounter(counter),
+    mClock(clock),
+    mHigh(0),
+    mLow(*counter),
+    mBaseCycles(*counter),
+    mBaseNs(0)
+{
+    config();
+    clock->addChangeHandler(this);
+}
+
+Timebase::~Timebase()
+{
+    mClock->removeChangeHandler(this);
+}
+
+uint64_t Timebase::extend()
+{
+    uint32_t low = *mCounter;
+    if (low < mLow) ++mHigh;
+    mLow = low;
+    return (static_cast<uint64_t>(mHigh) << 32) | low;
+}
+
+uint64_t Timebase::cycles()
+{
+    uint32_t primask = interrupt_disable();
+    uint64_t cycles = extend();
+    interrupt_restore(primask);
+    return cycles;
+}
+
+uint64_t Timebase::ns()
+{
+    uint32_t primask = interrupt_disable();
+    uint64_t ns = mBaseNs + cyclesToNs(extend() - mBaseCycles, mMultiplier);
+    interrupt_restore(primask);
+    return ns;
+}
+
+void Timebase::update()
+{
+    uint32_t primask = interrupt_disable();
+    // rebasing drops the fraction of a ns, so only once per second, which also keeps the multiplication from overflowing
+    if (extend() - mBaseCycles >= mHz) rebase();
+    interrupt_restore(primask);
+}
+
+void Timebase::nspin(uint32_t ns)
+{
+    uint32_t cycles = nsToCycles(ns, mInverse);
+    uint32_t start = *mCounter;
+    while (*mCounter - start < cycles)
+    {
+    }
+}
+
+void Timebase::rebase()
+{
+    uint64_t cycles = extend();
+    mBaseNs += cyclesToNs(cycles - mBaseCycles, mMultiplier);
+    mBaseCycles = cycles;
+}
+
+void Timebase::config()
+{
+    // the cycle counter runs with the core, which is the AHB clock
+    mHz = mClock->clock(ClockControl::Clock::AHB);
+    mMultiplier = multiplier(mHz);
+    mInverse = inverse(mHz);
+}
+
+void Timebase::clockCallback(ClockControl::Callback::Reason reason, uint32_t newClock)
+{
+    uint32_t primask = interrupt_disable();
+    // what passed until now at the old clock, the switch itself is counted at the old clock as well
+    rebase();
+    if (reason == ClockControl::Callback::Reason::Changed) config();
+    interrupt_restore(primask);
+}
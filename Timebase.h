@@ -0,0 +1,53 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "ClockControl.h"
+
+#include <cstdint>
+
+// Monotonic ns time from a free running 32 bit cycle counter (DWT CYCCNT on the target), extended to 64 bit.
+// The conversion is a multiply and a shift with a multiplier for the current clock, ClockControl tells
+// about changes and the time continues from where it was.
+// update() has to be called at least every 2^32 cycles (25s at 168MHz) to catch the overflow, SysTick does.
+class Timebase : public ClockControl::Callback
+{
+public:
+    static const unsigned int SHIFT = 24;
+
+    // ns per cycle << SHIFT
+    static constexpr uint64_t multiplier(uint32_t clock) { return ((1000000000ull << SHIFT) + clock / 2) / clock; }
+    static constexpr uint64_t cyclesToNs(uint64_t cycles, uint64_t multiplier) { return (cycles * multiplier) >> SHIFT; }
+    // cycles per ns << 32, rounded up when converting so a spin is never shorter than asked for
+    static constexpr uint64_t inverse(uint32_t clock) { return (static_cast<uint64_t>(clock) << 32) / 1000000000; }
+    static constexpr uint32_t nsToCycles(uint32_t ns, uint64_t inverse) { return (ns * inverse + 0xffffffff) >> 32; }
+
+    Timebase(const volatile uint32_t* counter, ClockControl* clock);
+    ~Timebase();
+
+    uint64_t cycles();
+    uint64_t ns();
+    void update();
+    // busy waits, directly on the counter
+    void nspin(uint32_t ns);
+
+protected:
+    virtual void clockCallback(ClockControl::Callback::Reason reason, uint32_t newClock);
+
+private:
+    const volatile uint32_t* mCounter;
+    ClockControl* mClock;
+    uint32_t mHigh;
+    uint32_t mLow;
+    // the time of the last rebase, the conversion starts from there
+    uint64_t mBaseCycles;
+    uint64_t mBaseNs;
+    uint32_t mHz;
+    uint64_t mMultiplier;
+    uint64_t mInverse;
+
+    uint64_t extend();
+    void rebase();
+    void config();
+};
+
+#endif // TIMEBASE_H
@@ -0,0 +1,140 @@
+#include "TimerWheel.h"
+
+#include <cstring>
+
+const unsigned int TimerWheel::LEVEL_COUNT;
+const unsigned int TimerWheel::SLOT_BITS;
+const unsigned int TimerWheel::SLOT_COUNT;
+
+TimerWheel::TimerWheel() :
+    mNow(0),
+    mCount(0)
+{
+    std::memset(mSlot, 0, sizeof(mSlot));
+    std::memset(mUsed, 0, sizeof(mUsed));
+}
+
+void TimerWheel::add(Timer *timer, uint32_t ms, uint32_t period)
+{
+    if (timer->mActive) unlink(timer);
+    // the current slot is already done, so the earliest is the next one
+    if (ms == 0) ms = 1;
+    timer->mExpire = mNow + ms;
+    timer->mPeriod = period;
+    insert(timer);
+}
+
+void TimerWheel::remove(Timer *timer)
+{
+    if (timer->mActive) unlink(timer);
+}
+
+void TimerWheel::advance(uint32_t ms)
+{
+    while (ms > 0)
+    {
+        // jump straight to the next slot with timers or the next cascade, whatever comes first
+        uint32_t step = next(ms);
+        mNow += step;
+        ms -= step;
+        unsigned int index = mNow & (SLOT_COUNT - 1);
+        if (index == 0)
+        {
+            // the higher levels first, so their timers can move down more than one level
+            unsigned int level = 1;
+            while (level < LEVEL_COUNT - 1 && ((mNow >> (SLOT_BITS * level)) & (SLOT_COUNT - 1)) == 0) ++level;
+            for (; level > 0; --level) cascade(level);
+        }
+        expireSlot();
+    }
+}
+
+uint32_t TimerWheel::next(uint32_t max)
+{
+    unsigned int index = mNow & (SLOT_COUNT - 1);
+    uint32_t next = max;
+    if (mUsed[0] != 0)
+    {
+        // rotate so bit 0 is the slot after the current one
+        uint64_t used = (index == SLOT_COUNT - 1) ? mUsed[0] : (mUsed[0] >> (index + 1)) | (mUsed[0] << (SLOT_COUNT - 1 - index));
+        uint32_t ms = __builtin_ctzll(used) + 1;
+        if (ms < next) next = ms;
+    }
+    if ((mUsed[1] | mUsed[2] | mUsed[3]) != 0)
+    {
+        uint32_t ms = SLOT_COUNT - index;
+        if (ms < next) next = ms;
+    }
+    return next;
+}
+
+void TimerWheel::insert(Timer *timer)
+{
+    uint64_t delta = timer->mExpire - mNow;
+    unsigned int level = 0;
+    while (level < LEVEL_COUNT - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) ++level;
+    uint64_t expire = timer->mExpire;
+    if (delta >= (1ull << (SLOT_BITS * LEVEL_COUNT)))
+    {
+        // too far away, park it in the last slot it can reach, it gets sorted again when it is cascaded
+        expire = mNow + (1ull << (SLOT_BITS * LEVEL_COUNT)) - 1;
+    }
+    unsigned int slot = (expire >> (SLOT_BITS * level)) & (SLOT_COUNT - 1);
+    timer->mLevel = level;
+    timer->mSlot = slot;
+    timer->mPrev = nullptr;
+    timer->mNext = mSlot[level][slot];
+    if (timer->mNext != nullptr) timer->mNext->mPrev = timer;
+    mSlot[level][slot] = timer;
+    mUsed[level] |= 1ull << slot;
+    timer->mActive = true;
+    ++mCount;
+}
+
+void TimerWheel::unlink(Timer *timer)
+{
+    if (timer->mPrev != nullptr) timer->mPrev->mNext = timer->mNext;
+    else
+    {
+        mSlot[timer->mLevel][timer->mSlot] = timer->mNext;
+        if (timer->mNext == nullptr) mUsed[timer->mLevel] &= ~(1ull << timer->mSlot);
+    }
+    if (timer->mNext != nullptr) timer->mNext->mPrev = timer->mPrev;
+    timer->mNext = timer->mPrev = nullptr;
+    timer->mActive = false;
+    --mCount;
+}
+
+void TimerWheel::cascade(unsigned int level)
+{
+    unsigned int slot = (mNow >> (SLOT_BITS * level)) & (SLOT_COUNT - 1);
+    Timer* timer = mSlot[level][slot];
+    mSlot[level][slot] = nullptr;
+    mUsed[level] &= ~(1ull << slot);
+    while (timer != nullptr)
+    {
+        Timer* next = timer->mNext;
+        --mCount;
+        insert(timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::expireSlot()
+{
+    unsigned int slot = mNow & (SLOT_COUNT - 1);
+    // the callbacks can add and remove timers, so always take the first one again
+    Timer* timer;
+    while ((timer = mSlot[0][slot]) != nullptr)
+    {
+        unlink(timer);
+        if (timer->mPeriod != 0)
+        {
+            timer->mExpire += timer->mPeriod;
+            // we fell behind, don't try to catch up
+            if (timer->mExpire <= mNow) timer->mExpire = mNow + timer->mPeriod;
+            insert(timer);
+        }
+        timer->expired();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <cstdint>
+
+// Hierarchical timer wheel with ms resolution: 4 levels of 64 slots each, level n holding the timers
+// expiring within 64^(n+1) ms. Timers are linked into their slot, so adding, removing and expiring is O(1),
+// when a level 0 round is over the next slot of the level above is cascaded down.
+// Timers further away than 64^4 ms (~4.6h) are parked in the top level and re-sorted when they get cascaded.
+class TimerWheel
+{
+public:
+    class Timer
+    {
+    public:
+        Timer() : mNext(nullptr), mPrev(nullptr), mExpire(0), mPeriod(0), mLevel(0), mSlot(0), mActive(false) { }
+        virtual ~Timer() { }
+
+        bool active() const { return mActive; }
+        uint32_t period() const { return mPeriod; }
+        uint64_t expire() const { return mExpire; }
+
+    protected:
+        // called from the context calling TimerWheel::advance(), repeating timers are already rearmed
+        virtual void expired() = 0;
+
+    private:
+        Timer* mNext;
+        Timer* mPrev;
+        uint64_t mExpire;
+        uint32_t mPeriod;
+        uint8_t mLevel;
+        uint8_t mSlot;
+        bool mActive;
+
+        friend class TimerWheel;
+    };
+
+    static const unsigned int LEVEL_COUNT = 4;
+    static const unsigned int SLOT_BITS = 6;
+    static const unsigned int SLOT_COUNT = 1 << SLOT_BITS;
+
+    TimerWheel();
+
+    // expire in ms (at least 1) from now, then every period ms if period is not 0
+    void add(Timer* timer, uint32_t ms, uint32_t period = 0);
+    void remove(Timer* timer);
+    void advance(uint32_t ms);
+    // ms until advance() has something to do, but at most max
+    uint32_t next(uint32_t max);
+
+    uint64_t now() const { return mNow; }
+    unsigned int count() const { return mCount; }
+
+private:
+    Timer* mSlot[LEVEL_COUNT][SLOT_COUNT];
+    uint64_t mUsed[LEVEL_COUNT];
+    uint64_t mNow;
+    unsigned int mCount;
+
+    void insert(Timer* timer);
+    void unlink(Timer* timer);
+    void cascade(unsigned int level);
+    void expireSlot();
+};
+
+#endif // TIMERWHEEL_H
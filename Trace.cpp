@@ -0,0 +1,50 @@
+#include "Trace.h"
+#include "atomic.h"
+
+#include <cstring>
+
+const unsigned int Trace::SIZE;
+const unsigned int Trace::DATA_BITS;
+const uint32_t Trace::DATA_MASK;
+const unsigned int Trace::OFFSET_BITS;
+const uint32_t Trace::OFFSET_MASK;
+const char Trace::MAGIC[4] = { 'T', 'R', 'C', '1' };
+
+static const uint32_t NO_COUNTER = 0;
+
+Trace::Trace() :
+    mWrite(0),
+    mEnabled(true),
+    mCounter(&NO_COUNTER)
+{
+    static_assert(sizeof(Record) == 8, "Struct has wrong size, compiler problem.");
+    static_assert(sizeof(Header) == 16, "Struct has wrong size, compiler problem.");
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2.");
+    std::memset(mRecord, 0, sizeof(mRecord));
+}
+
+void Trace::add(Trace::Type type, uint32_t data)
+{
+    uint32_t pos;
+    do
+    {
+        pos = mWrite;
+    }   while (!atomic_compare_exchange(&mWrite, pos, pos + 1));
+    // an interrupt coming in right here ends up in a later slot with an earlier time, the decoder takes care of that
+    Record& record = mRecord[pos & (SIZE - 1)];
+    record.mCycles = *mCounter;
+    record.mInfo = (static_cast<uint32_t>(type) << DATA_BITS) | (data & DATA_MASK);
+}
+
+void Trace::reset()
+{
+    mWrite = 0;
+}
+
+void Trace::header(Trace::Header &header, uint32_t clock) const
+{
+    std::memcpy(header.mMagic, MAGIC, sizeof(header.mMagic));
+    header.mClock = clock;
+    header.mCount = count();
+    header.mLost = lost();
+}
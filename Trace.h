@@ -0,0 +1,75 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+
+// Ring of the last SIZE interrupt entries/exits, event posts/dispatches and user markers, each with the
+// cycle counter at that moment. record() can be called from any context, the slot is claimed lock free,
+// when the ring is full the oldest records get overwritten.
+// System only owns one when built with TRACE defined (make TRACE=1). The trace command dumps it in binary,
+// tools/tracedecode turns a dump into a Chrome trace (chrome://tracing or ui.perfetto.dev).
+class Trace
+{
+public:
+    enum class Type : uint8_t { InterruptEnter, InterruptExit, EventPost, EventDispatch, EventDone, Marker };
+
+    static const unsigned int SIZE = 512;
+    static const unsigned int DATA_BITS = 28;
+    static const uint32_t DATA_MASK = (1 << DATA_BITS) - 1;
+    // addresses keep their region, the upper 8 bits, and the lower 20 bits, so flash, CCM, SRAM and the
+    // peripherals stay apart, address() expands them again
+    static const unsigned int OFFSET_BITS = 20;
+    static const uint32_t OFFSET_MASK = (1 << OFFSET_BITS) - 1;
+    static const char MAGIC[4];
+
+    // little endian, as the STM32 writes it
+    struct Record
+    {
+        uint32_t mCycles;
+        // type in the upper 4 bits, the exception number, the packed event address or the marker in the others
+        uint32_t mInfo;
+
+        Type type() const { return static_cast<Type>(mInfo >> DATA_BITS); }
+        uint32_t data() const { return mInfo & DATA_MASK; }
+    };
+    // starts a dump, followed by mCount records, oldest first
+    struct Header
+    {
+        char mMagic[4];
+        uint32_t mClock;
+        uint32_t mCount;
+        uint32_t mLost;
+    };
+
+    Trace();
+
+    // counts with clock Hz, without one all records have the time 0
+    void setCounter(const volatile uint32_t* counter) { mCounter = counter; }
+    void record(Type type, uint32_t data)
+    {
+        if (mEnabled) add(type, data);
+    }
+    void record(Type type, const void* data) { record(type, pack(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(data)))); }
+    static uint32_t pack(uint32_t address) { return ((address >> 24) << OFFSET_BITS) | (address & OFFSET_MASK); }
+    static uint32_t address(uint32_t data) { return ((data >> OFFSET_BITS) << 24) | (data & OFFSET_MASK); }
+    // stops recording, so the ring can be read consistently
+    void enable(bool enable) { mEnabled = enable; }
+    bool enabled() const { return mEnabled; }
+    void reset();
+
+    unsigned int count() const { return mWrite < SIZE ? mWrite : SIZE; }
+    uint32_t lost() const { return mWrite < SIZE ? 0 : mWrite - SIZE; }
+    // i = 0 is the oldest one
+    const Record& record(unsigned int i) const { return mRecord[(mWrite - count() + i) & (SIZE - 1)]; }
+    void header(Header& header, uint32_t clock) const;
+
+private:
+    Record mRecord[SIZE];
+    volatile uint32_t mWrite;
+    volatile bool mEnabled;
+    const volatile uint32_t* mCounter;
+
+    void add(Type type, uint32_t data);
+};
+
+#endif // TRACE_H
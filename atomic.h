@@ -37,12 +37,74 @@ static inline void atomic_add(volatile int32_t* v, int inc)
         : "r" (v), "Ir" (inc)
         : "cc");
 }
+
+// Stores desired in *v if it still contains expected, returns false (and leaves *v alone) otherwise.
+static inline bool atomic_compare_exchange(volatile uint32_t* v, uint32_t expected, uint32_t desired)
+{
+    uint32_t old;
+    unsigned long tmp;
+
+    do
+    {
+        __asm__ __volatile__("ldrex   %0, [%1]" : "=&r" (old) : "r" (v) : "memory");
+        if (old != expected)
+        {
+            __asm__ __volatile__("clrex" : : : "memory");
+            return false;
+        }
+        __asm__ __volatile__("strex   %0, %2, [%1]" : "=&r" (tmp) : "r" (v), "r" (desired) : "memory");
+    }   while (tmp != 0);
+    return true;
+}
+
+static inline void atomic_barrier()
+{
+    __asm__ __volatile__("dmb" : : : "memory");
+}
+
+// For the few places that really need a critical section, returns the previous state for interrupt_restore()
+static inline uint32_t interrupt_disable()
+{
+    uint32_t primask;
+    __asm__ __volatile__("mrs     %0, primask\n"
+                         "cpsid   i" : "=r" (primask) : : "memory");
+    return primask;
+}
+
+static inline void interrupt_restore(uint32_t primask)
+{
+    __asm__ __volatile__("msr     primask, %0" : : "r" (primask) : "memory");
+}
 #endif  // ARM
 
 #if __x86_64__ || __x86_32__ || __x86__
+#include <atomic>
+
 inline void atomic_add(volatile int32_t* v, int inc)
 {
-    *v += inc;
+    static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "std::atomic has wrong size, compiler problem.");
+    reinterpret_cast<volatile std::atomic<int32_t>*>(v)->fetch_add(inc);
+}
+
+inline bool atomic_compare_exchange(volatile uint32_t* v, uint32_t expected, uint32_t desired)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "std::atomic has wrong size, compiler problem.");
+    return reinterpret_cast<volatile std::atomic<uint32_t>*>(v)->compare_exchange_strong(expected, desired);
+}
+
+inline void atomic_barrier()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// there are no interrupts on the host
+inline uint32_t interrupt_disable()
+{
+    return 0;
+}
+
+inline void interrupt_restore(uint32_t primask)
+{
 }
 #endif  // X86
 
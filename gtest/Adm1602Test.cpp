@@ -0,0 +1,53 @@
+#include "../hw/adm1602.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#define SIZE_OF_GPIO 0x28
+
+// what init(), clear() and writing took before, busy waiting for the display
+static uint64_t blockingTime(unsigned int commands, unsigned int slowCommands)
+{
+    return 15000000ull + commands * 40000ull + slowCommands * 1600000ull;
+}
+
+TEST(Adm1602, sleepsWhileDisplayIsBusy)
+{
+    static const char TEXT[] = "Hello display!";
+    static const unsigned int TEXT_LEN = sizeof(TEXT) - 1;
+    HostSystem system;
+    uint32_t memory[SIZE_OF_GPIO / 4] = { };
+    Gpio gpio(reinterpret_cast<unsigned long>(memory));
+    Gpio::Pin rs(gpio, Gpio::Index::Pin7);
+    Gpio::Pin e(gpio, Gpio::Index::Pin8);
+    Gpio::Pin db4(gpio, Gpio::Index::Pin9);
+    Gpio::Pin db5(gpio, Gpio::Index::Pin10);
+    Gpio::Pin db6(gpio, Gpio::Index::Pin11);
+    Gpio::Pin db7(gpio, Gpio::Index::Pin12);
+    Adm1602 display(e, rs, db4, db5, db6, db7);
+
+    display.init();
+    display.clear();
+    display.write(TEXT, TEXT_LEN);
+    EXPECT_TRUE(display.busy());
+    uint64_t blocking = blockingTime(6 + TEXT_LEN, 1);
+    // the display needs the time anyway, it's not done before
+    system.run(blocking - 1000000);
+    EXPECT_TRUE(display.busy());
+    // every command waits up to the next ms
+    system.run((6 + 1 + TEXT_LEN) * 1000000ull);
+    EXPECT_FALSE(display.busy());
+
+    std::printf("CPU busy: blocking %lu us, queued %lu us\n",
+                static_cast<unsigned long>(blocking / 1000), static_cast<unsigned long>(system.busyTime() / 1000));
+    // what is left are the ns of the enable pulses
+    EXPECT_LT(system.busyTime() * 100, blocking);
+
+    // starts over after it went idle
+    display.moveTo(0x40);
+    EXPECT_TRUE(display.busy());
+    system.run(2000000);
+    EXPECT_FALSE(display.busy());
+}
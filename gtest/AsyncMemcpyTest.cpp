@@ -0,0 +1,326 @@
+#include "../AsyncMemcpy.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#define SIZE_OF_DMA 0xd0
+
+// register words
+enum
+{
+    DMA_ISR = 0,
+    DMA_IFCR = 2,
+    DMA_STREAM = 4,
+    DMA_STREAM_WORDS = 6,
+    DMA_NDTR = 1,
+    DMA_PAR = 2,
+    DMA_M0AR = 3,
+};
+
+static const uint32_t CR_EN = 1 << 0;
+static const uint32_t CR_PINC = 1 << 9;
+static const uint32_t CR_MINC = 1 << 10;
+
+typedef Dma::Stream::DataSize DataSize;
+typedef Dma::Stream::BurstLength BurstLength;
+
+// Does the memory to memory transfers of DMA2 from its registers. They only hold 32 bit addresses,
+// so these are looked up in the memory the test gives it.
+class Mover
+{
+public:
+    struct Transfer
+    {
+        unsigned int mStream;
+        unsigned int mBytes;
+        DataSize mDataSize;
+        BurstLength mBurst;
+    };
+
+    Mover() : mRegisters(new uint32_t[SIZE_OF_DMA / 4]()), mDma(reinterpret_cast<System::BaseAddress>(mRegisters)) { }
+    ~Mover() { delete[] mRegisters; }
+
+    void addMemory(void* memory, unsigned int size) { mMemory.push_back(Memory { static_cast<uint8_t*>(memory), size }); }
+
+    // the first enabled stream moves all its data and interrupts with the flags
+    bool step(uint8_t flags = Dma::TransferComplete)
+    {
+        for (unsigned int index = 0; index < 8; ++index)
+        {
+            uint32_t* stream = mRegisters + DMA_STREAM + index * DMA_STREAM_WORDS;
+            uint32_t cr = stream[0];
+            if ((cr & CR_EN) == 0) continue;
+            EXPECT_EQ(2, (cr >> 6) & 3) << "memory to memory";
+            EXPECT_TRUE((cr & CR_MINC) != 0);
+            EXPECT_EQ((cr >> 11) & 3, (cr >> 13) & 3) << "same data size on both ends";
+            unsigned int size = 1 << ((cr >> 13) & 3);
+            unsigned int bytes = stream[DMA_NDTR] * size;
+            Transfer transfer = { index, bytes, static_cast<DataSize>((cr >> 13) & 3), static_cast<BurstLength>((cr >> 23) & 3) };
+            mTransfers.push_back(transfer);
+            if (flags == Dma::TransferComplete)
+            {
+                bool increment = (cr & CR_PINC) != 0;
+                const uint8_t* src = map(stream[DMA_PAR], increment ? bytes : size);
+                uint8_t* dest = map(stream[DMA_M0AR], bytes);
+                EXPECT_EQ(0, stream[DMA_PAR] % size);
+                EXPECT_EQ(0, stream[DMA_M0AR] % size);
+                if (src != nullptr && dest != nullptr)
+                {
+                    for (unsigned int i = 0; i < bytes; i += size) std::memcpy(dest + i, src + (increment ? i : 0), size);
+                }
+            }
+            stream[0] &= ~CR_EN;
+            static const unsigned int SHIFT[] = { 0, 6, 16, 22 };
+            mRegisters[DMA_ISR + index / 4] = static_cast<uint32_t>(flags) << SHIFT[index % 4];
+            mStreams[index]->interruptCallback(0);
+            mRegisters[DMA_ISR + index / 4] = 0;
+            return true;
+        }
+        return false;
+    }
+
+    void run() { while (step()) { } }
+
+    uint32_t* mRegisters;
+    Dma mDma;
+    Dma::Stream* mStreams[8];
+    std::vector<Transfer> mTransfers;
+
+private:
+    struct Memory
+    {
+        uint8_t* mStart;
+        unsigned int mSize;
+    };
+    std::vector<Memory> mMemory;
+
+    uint8_t* map(uint32_t address, unsigned int bytes)
+    {
+        for (const Memory& memory : mMemory)
+        {
+            uint32_t start = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(memory.mStart));
+            if (address - start < memory.mSize && address - start + bytes <= memory.mSize) return memory.mStart + (address - start);
+        }
+        ADD_FAILURE() << "DMA to unknown address " << std::hex << address;
+        return nullptr;
+    }
+};
+
+class Jobs : public System::Event::Callback
+{
+public:
+    virtual void eventCallback(System::Event* event) { mDone.push_back(event); mResults.push_back(event->result()); }
+
+    std::vector<System::Event*> mDone;
+    std::vector<System::Event::Result> mResults;
+};
+
+// the DMA setup of a system with streams 4 and 5 of DMA2
+class AsyncMemcpyTest : public ::testing::Test
+{
+protected:
+    static const unsigned int DATA_SIZE = 400000;
+
+    virtual void SetUp()
+    {
+        mMemcpy = new AsyncMemcpy();
+        mMover.mStreams[4] = new Dma::Stream(mMover.mDma, Dma::Stream::StreamIndex::Stream4, Dma::Stream::ChannelIndex::Channel0, nullptr);
+        mMover.mStreams[5] = new Dma::Stream(mMover.mDma, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel0, nullptr);
+        mMemcpy->addStream(mMover.mStreams[4]);
+        mMemcpy->addStream(mMover.mStreams[5]);
+        mSrc = new uint8_t[DATA_SIZE];
+        mDest = new uint8_t[DATA_SIZE]();
+        for (unsigned int i = 0; i < DATA_SIZE; ++i) mSrc[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+        mMover.addMemory(mSrc, DATA_SIZE);
+        mMover.addMemory(mDest, DATA_SIZE);
+        // the pattern of a fill
+        mMover.addMemory(mMemcpy, sizeof(AsyncMemcpy));
+    }
+
+    virtual void TearDown()
+    {
+        delete mMemcpy;
+        delete mMover.mStreams[4];
+        delete mMover.mStreams[5];
+        delete[] mSrc;
+        delete[] mDest;
+    }
+
+    std::vector<unsigned int> bytes()
+    {
+        std::vector<unsigned int> bytes;
+        for (const Mover::Transfer& transfer : mMover.mTransfers) bytes.push_back(transfer.mBytes);
+        return bytes;
+    }
+
+    HostSystem mSystem;
+    Mover mMover;
+    AsyncMemcpy* mMemcpy;
+    uint8_t* mSrc;
+    uint8_t* mDest;
+    Jobs mJobs;
+};
+
+const unsigned int AsyncMemcpyTest::DATA_SIZE;
+
+TEST(AsyncMemcpy, nextPart)
+{
+    struct Case
+    {
+        uint32_t mDest;
+        uint32_t mSrc;
+        unsigned int mLen;
+        bool mFill;
+        DataSize mDataSize;
+        BurstLength mBurst;
+        unsigned int mCount;
+    };
+    static const Case CASES[] =
+    {
+        // NDTR can't count more, and a burst of 4 words must not be cut
+        { 0x20000000, 0x20010000, 300000, false, DataSize::Word, BurstLength::Beats4, 65532 },
+        { 0x20000001, 0x20010003, 150000, false, DataSize::Byte, BurstLength::Single, 65535 },
+        { 0x20000002, 0x20010006, 150000, false, DataSize::HalfWord, BurstLength::Single, 65535 },
+        { 0x20000004, 0x20010008, 150000, false, DataSize::Word, BurstLength::Single, 37500 },
+        { 0x20000010, 0x20010000, 40, false, DataSize::Word, BurstLength::Beats4, 8 },
+        // too short for a burst, then the tail
+        { 0x20000030, 0x20010020, 14, false, DataSize::Word, BurstLength::Single, 3 },
+        { 0x20000002, 0x20010002, 3, false, DataSize::HalfWord, BurstLength::Single, 1 },
+        { 0x20000000, 0x20010000, 1, false, DataSize::Byte, BurstLength::Single, 1 },
+        // both ends get to 16 bytes together with a head
+        { 0x20000005, 0x20010005, 1000, false, DataSize::Byte, BurstLength::Single, 11 },
+        { 0x20000008, 0x20010008, 1000, false, DataSize::Word, BurstLength::Single, 2 },
+        { 0x20000006, 0x20010006, 1000, false, DataSize::HalfWord, BurstLength::Single, 5 },
+        { 0x20000005, 0x20010005, 20, false, DataSize::Byte, BurstLength::Single, 20 },
+        // only the destination of a fill moves
+        { 0x20000004, 0x20010001, 8, true, DataSize::Word, BurstLength::Single, 2 },
+        { 0x20000001, 0x20010000, 37, true, DataSize::Byte, BurstLength::Single, 15 },
+        { 0x20000000, 0x20010003, 262144, true, DataSize::Word, BurstLength::Beats4, 65532 },
+    };
+    for (const Case& c : CASES)
+    {
+        AsyncMemcpy::Part part = AsyncMemcpy::nextPart(c.mDest, c.mSrc, c.mLen, c.mFill);
+        EXPECT_EQ(c.mDataSize, part.mDataSize) << std::hex << c.mDest << " " << c.mSrc << std::dec << " " << c.mLen;
+        EXPECT_EQ(c.mBurst, part.mBurst) << std::hex << c.mDest << " " << c.mSrc << std::dec << " " << c.mLen;
+        EXPECT_EQ(c.mCount, part.mCount) << std::hex << c.mDest << " " << c.mSrc << std::dec << " " << c.mLen;
+        EXPECT_LE(part.bytes(), c.mLen);
+    }
+}
+
+// the ends never get to the same alignment, bytes all the way, split by the NDTR limit
+TEST_F(AsyncMemcpyTest, splitUnaligned)
+{
+    System::Event event(mJobs);
+    ASSERT_TRUE(mMemcpy->memcpy(mDest + 3, mSrc + 2, 150000, &event));
+    EXPECT_FALSE(mMemcpy->idle());
+    mMover.run();
+    EXPECT_TRUE(mMemcpy->idle());
+    EXPECT_EQ(std::vector<unsigned int>({ 65535, 65535, 18930 }), bytes());
+    for (const Mover::Transfer& transfer : mMover.mTransfers) EXPECT_EQ(DataSize::Byte, transfer.mDataSize);
+    EXPECT_EQ(0, std::memcmp(mDest + 3, mSrc + 2, 150000));
+    EXPECT_EQ(0, mDest[2]);
+    EXPECT_EQ(0, mDest[150003]);
+
+    // the event comes through the event loop
+    EXPECT_TRUE(mJobs.mDone.empty());
+    mSystem.run(1000000);
+    ASSERT_EQ(1, mJobs.mDone.size());
+    EXPECT_EQ(System::Event::Result::Success, mJobs.mResults[0]);
+}
+
+TEST_F(AsyncMemcpyTest, splitAligned)
+{
+    System::Event event(mJobs);
+    ASSERT_TRUE(mMemcpy->memcpy(mDest, mSrc, 300000, &event));
+    mMover.run();
+    // 65532 words, the rest is a multiple of the burst
+    EXPECT_EQ(std::vector<unsigned int>({ 262128, 37872 }), bytes());
+    for (const Mover::Transfer& transfer : mMover.mTransfers)
+    {
+        EXPECT_EQ(DataSize::Word, transfer.mDataSize);
+        EXPECT_EQ(BurstLength::Beats4, transfer.mBurst);
+    }
+    EXPECT_EQ(0, std::memcmp(mDest, mSrc, 300000));
+    mSystem.run(1000000);
+    EXPECT_EQ(1, mJobs.mDone.size());
+}
+
+TEST_F(AsyncMemcpyTest, head)
+{
+    ASSERT_TRUE(mMemcpy->memcpy(mDest + 5, mSrc + 5, 1000, nullptr));
+    mMover.run();
+    EXPECT_EQ(std::vector<unsigned int>({ 11, 976, 12, 1 }), bytes());
+    ASSERT_EQ(4, mMover.mTransfers.size());
+    EXPECT_EQ(BurstLength::Beats4, mMover.mTransfers[1].mBurst);
+    EXPECT_EQ(0, std::memcmp(mDest + 5, mSrc + 5, 1000));
+    EXPECT_EQ(0, mDest[4]);
+    EXPECT_EQ(0, mDest[1005]);
+}
+
+TEST_F(AsyncMemcpyTest, fill)
+{
+    System::Event event(mJobs);
+    ASSERT_TRUE(mMemcpy->memset(mDest + 1, 0xa5, 37, &event));
+    mMover.run();
+    EXPECT_EQ(std::vector<unsigned int>({ 15, 16, 4, 2 }), bytes());
+    EXPECT_EQ(0, mDest[0]);
+    for (unsigned int i = 1; i < 38; ++i) EXPECT_EQ(0xa5, mDest[i]) << i;
+    EXPECT_EQ(0, mDest[38]);
+
+    // longer than NDTR can count in words
+    ASSERT_TRUE(mMemcpy->memset(mDest, 0x3c, 300000, &event));
+    mMover.run();
+    for (unsigned int i = 0; i < 300000; ++i) ASSERT_EQ(0x3c, mDest[i]) << i;
+    EXPECT_EQ(0, mDest[300000]);
+    mSystem.run(1000000);
+    EXPECT_EQ(2, mJobs.mDone.size());
+}
+
+// two streams run, the rest waits in order
+TEST_F(AsyncMemcpyTest, queue)
+{
+    System::Event events[5] = { System::Event(mJobs), System::Event(mJobs), System::Event(mJobs), System::Event(mJobs), System::Event(mJobs) };
+    // a single burst part each
+    for (unsigned int i = 0; i < 5; ++i) ASSERT_TRUE(mMemcpy->memcpy(mDest + i * 1024, mSrc + i * 512, 1024, &events[i]));
+    // nothing to do, done right away
+    System::Event empty(mJobs);
+    ASSERT_TRUE(mMemcpy->memcpy(mDest, mSrc, 0, &empty));
+
+    mMover.run();
+    EXPECT_TRUE(mMemcpy->idle());
+    for (unsigned int i = 0; i < 5; ++i) EXPECT_EQ(0, std::memcmp(mDest + i * 1024, mSrc + i * 512, 1024)) << i;
+    std::vector<unsigned int> streams;
+    for (const Mover::Transfer& transfer : mMover.mTransfers) streams.push_back(transfer.mStream);
+    // stream 4 takes the queue with it until it is empty
+    EXPECT_EQ(std::vector<unsigned int>({ 4, 4, 4, 4, 5 }), streams);
+
+    mSystem.run(1000000);
+    ASSERT_EQ(6, mJobs.mDone.size());
+    EXPECT_EQ(&empty, mJobs.mDone[0]);
+    EXPECT_EQ(&events[0], mJobs.mDone[1]);
+    EXPECT_EQ(&events[2], mJobs.mDone[2]);
+    EXPECT_EQ(&events[3], mJobs.mDone[3]);
+    EXPECT_EQ(&events[4], mJobs.mDone[4]);
+    EXPECT_EQ(&events[1], mJobs.mDone[5]);
+}
+
+// a bus error fails the job, the next one runs
+TEST_F(AsyncMemcpyTest, transferError)
+{
+    System::Event events[3] = { System::Event(mJobs), System::Event(mJobs), System::Event(mJobs) };
+    for (unsigned int i = 0; i < 3; ++i) ASSERT_TRUE(mMemcpy->memcpy(mDest + i * 100, mSrc, 100, &events[i]));
+    ASSERT_TRUE(mMover.step(Dma::TransferError));
+    mMover.run();
+    EXPECT_TRUE(mMemcpy->idle());
+    mSystem.run(1000000);
+    ASSERT_EQ(3, mJobs.mDone.size());
+    EXPECT_EQ(&events[0], mJobs.mDone[0]);
+    EXPECT_EQ(System::Event::Result::DataFail, mJobs.mResults[0]);
+    EXPECT_EQ(System::Event::Result::Success, mJobs.mResults[1]);
+    EXPECT_EQ(System::Event::Result::Success, mJobs.mResults[2]);
+    EXPECT_EQ(0, std::memcmp(mDest + 100, mSrc, 100));
+    EXPECT_EQ(0, std::memcmp(mDest + 200, mSrc, 100));
+}
@@ -0,0 +1,147 @@
+#include "../BipBuffer.h"
+#include "../CircularBuffer.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#define MODULO 251
+
+TEST(BipBuffer, contiguousWrite)
+{
+    BipBuffer<char> buffer(100);
+    char data[100];
+    for (int i = 0; i < 100; ++i) data[i] = i;
+    EXPECT_EQ(70, buffer.write(data, 70));
+    const char* readData;
+    EXPECT_EQ(70, buffer.peek(readData));
+    EXPECT_EQ(50, buffer.release(50));
+    EXPECT_EQ(20, buffer.used());
+    EXPECT_EQ(80, buffer.free());
+
+    // doesn't fit behind A, goes to the start of the memory in one piece
+    EXPECT_EQ(40, buffer.write(data, 40));
+    EXPECT_EQ(60, buffer.used());
+    // the space behind A is lost until A is read
+    EXPECT_EQ(10, buffer.free());
+    EXPECT_EQ(20, buffer.peek(readData));
+    EXPECT_EQ(50, readData[0]);
+    EXPECT_EQ(20, buffer.release(20));
+    EXPECT_EQ(40, buffer.peek(readData));
+    EXPECT_EQ(0, readData[0]);
+    EXPECT_EQ(39, readData[39]);
+    EXPECT_EQ(60, buffer.free());
+    EXPECT_EQ(40, buffer.release(100));
+    EXPECT_EQ(0, buffer.used());
+    EXPECT_EQ(100, buffer.free());
+
+    // fills the rest behind A before it starts over
+    EXPECT_EQ(60, buffer.write(data, 60));
+    EXPECT_EQ(30, buffer.release(30));
+    EXPECT_EQ(70, buffer.write(data, 100));
+    EXPECT_EQ(100, buffer.used());
+    EXPECT_FALSE(buffer.push(0));
+}
+
+TEST(BipBuffer, reserveWhileReading)
+{
+    BipBuffer<char> buffer(100);
+    char* data;
+    const char* readData;
+    EXPECT_EQ(60, buffer.reserve(data, 60));
+    buffer.commit(60);
+    // a DMA transfer into the space behind A, while A gets read up
+    char* dma;
+    EXPECT_EQ(30, buffer.reserve(dma, 30));
+    EXPECT_EQ(60, buffer.peek(readData));
+    EXPECT_EQ(60, buffer.release(60));
+    dma[0] = 'x';
+    buffer.commit(30);
+    EXPECT_EQ(30, buffer.peek(readData));
+    EXPECT_EQ(dma, readData);
+
+    // the same into B, which becomes A in the meantime
+    EXPECT_EQ(10, buffer.write("0123456789", 10));
+    EXPECT_EQ(20, buffer.release(20));
+    EXPECT_EQ(30, buffer.reserve(dma, 30));
+    EXPECT_EQ(buffer.peek(readData), 20);
+    EXPECT_EQ(buffer.reserve(dma, 30), 30);
+    dma[0] = 'y';
+    EXPECT_EQ(20, buffer.release(20));
+    buffer.commit(30);
+    EXPECT_EQ(30, buffer.peek(readData));
+    EXPECT_EQ('y', readData[0]);
+    EXPECT_EQ(30, buffer.release(30));
+    EXPECT_EQ(0, buffer.used());
+}
+
+TEST(BipBuffer, readWriteRandom)
+{
+    BipBuffer<char> buffer(1000);
+    unsigned int in = 0;
+    unsigned int out = 0;
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<int> dist(0, 300);
+    char buf[300];
+    for (int i = 0; i < 10000; ++i)
+    {
+        unsigned int len = dist(generator);
+        for (unsigned int j = 0; j < len; ++j) buf[j] = (in + j) % MODULO;
+        in += buffer.write(buf, len);
+
+        len = buffer.read(buf, dist(generator));
+        for (unsigned int j = 0; j < len; ++j) ASSERT_EQ((out + j) % MODULO, static_cast<unsigned char>(buf[j]));
+        out += len;
+        ASSERT_EQ(in - out, buffer.used());
+    }
+}
+
+// DMA sized chunks in and out, counting the transfers it takes, a chunk that gets split takes two
+template<class Buffer>
+static unsigned int transfers(Buffer& buffer, unsigned int chunk, unsigned int rounds, uint64_t& ns)
+{
+    unsigned int count = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < rounds; ++i)
+    {
+        for (unsigned int left = chunk; left > 0; )
+        {
+            char* data;
+            unsigned int len = buffer.reserve(data, left);
+            data[0] = i;
+            buffer.commit(len);
+            left -= len;
+            ++count;
+        }
+        // the reader is a chunk behind
+        while (buffer.used() > chunk)
+        {
+            const char* data;
+            buffer.release(std::min(buffer.peek(data), buffer.used() - chunk));
+            ++count;
+        }
+    }
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return count;
+}
+
+TEST(BipBuffer, benchmark)
+{
+    static const unsigned int ROUND_COUNT = 100000;
+    for (unsigned int chunk : { 64, 384 })
+    {
+        CircularBuffer<char> circular(1000);
+        BipBuffer<char> bip(1000);
+        uint64_t circularNs;
+        uint64_t bipNs;
+        unsigned int circularCount = transfers(circular, chunk, ROUND_COUNT, circularNs);
+        unsigned int bipCount = transfers(bip, chunk, ROUND_COUNT, bipNs);
+        std::printf("%u byte chunks: CircularBuffer %u transfers %lu ns, BipBuffer %u transfers %lu ns\n", chunk,
+                    circularCount, static_cast<unsigned long>(circularNs / ROUND_COUNT), bipCount, static_cast<unsigned long>(bipNs / ROUND_COUNT));
+        // one in and one out per chunk, the last one is still in
+        EXPECT_EQ(2 * ROUND_COUNT - 1, bipCount);
+        EXPECT_GT(circularCount, bipCount);
+    }
+}
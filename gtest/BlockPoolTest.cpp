@@ -0,0 +1,167 @@
+#include "../BlockPool.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <x86intrin.h>
+
+#define ARENA_SIZE (BlockPool::PAGE_SIZE * (BlockPool::MAX_PAGES + 8))
+
+// stands in for the heap, like System::increaseHeap()
+alignas(8) static char gArena[ARENA_SIZE];
+static unsigned int gArenaUsed;
+
+static char* arenaSource(unsigned int size)
+{
+    if (gArenaUsed + size > ARENA_SIZE) return nullptr;
+    char* end = gArena + gArenaUsed;
+    gArenaUsed += size;
+    return end;
+}
+
+TEST(BlockPool, sizeClass)
+{
+    EXPECT_EQ(0, BlockPool::sizeClass(0));
+    EXPECT_EQ(0, BlockPool::sizeClass(1));
+    EXPECT_EQ(0, BlockPool::sizeClass(16));
+    EXPECT_EQ(1, BlockPool::sizeClass(17));
+    EXPECT_EQ(1, BlockPool::sizeClass(32));
+    EXPECT_EQ(2, BlockPool::sizeClass(33));
+    EXPECT_EQ(BlockPool::CLASS_COUNT - 1, BlockPool::sizeClass(BlockPool::MAX_BLOCK_SIZE));
+    for (unsigned int i = 0; i < BlockPool::CLASS_COUNT; ++i) EXPECT_EQ(i, BlockPool::sizeClass(BlockPool::blockSize(i)));
+}
+
+TEST(BlockPool, allocFree)
+{
+    gArenaUsed = 0;
+    BlockPool pool(arenaSource);
+    void* first = pool.alloc(24);
+    ASSERT_NE(nullptr, first);
+    void* second = pool.alloc(24);
+    ASSERT_NE(nullptr, second);
+    EXPECT_EQ(32, static_cast<char*>(second) - static_cast<char*>(first));
+    EXPECT_EQ(2, pool.used(1));
+    EXPECT_EQ(BlockPool::PAGE_SIZE / 32, pool.total(1));
+    EXPECT_EQ(1, pool.pages());
+
+    EXPECT_TRUE(pool.free(first));
+    EXPECT_EQ(1, pool.used(1));
+    EXPECT_EQ(2, pool.maxUsed(1));
+    // the freed block is the next one handed out
+    EXPECT_EQ(first, pool.alloc(30));
+    EXPECT_TRUE(pool.free(first));
+    EXPECT_TRUE(pool.free(second));
+    EXPECT_EQ(0, pool.used(1));
+
+    // other classes get their own page
+    void* small = pool.alloc(3);
+    ASSERT_NE(nullptr, small);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(small) % 8);
+    EXPECT_EQ(2, pool.pages());
+    EXPECT_EQ(1, pool.used(0));
+    EXPECT_EQ(0, pool.used(1));
+    EXPECT_TRUE(pool.free(small));
+
+    // too large, and memory that is not from the pool
+    EXPECT_EQ(nullptr, pool.alloc(BlockPool::MAX_BLOCK_SIZE + 1));
+    EXPECT_EQ(1, pool.large());
+    int local;
+    EXPECT_FALSE(pool.free(&local));
+    EXPECT_FALSE(pool.free(nullptr));
+}
+
+TEST(BlockPool, sharedSource)
+{
+    gArenaUsed = 3;
+    BlockPool pool(arenaSource);
+    std::vector<void*> blocks;
+    for (unsigned int i = 0; i < 200; ++i)
+    {
+        // malloc() takes from the same source in between
+        if (i % 10 == 0) arenaSource(100 + i);
+        void* block = pool.alloc(i % BlockPool::MAX_BLOCK_SIZE + 1);
+        ASSERT_NE(nullptr, block);
+        EXPECT_EQ(0, reinterpret_cast<uintptr_t>(block) % 8);
+        std::memset(block, i, i % BlockPool::MAX_BLOCK_SIZE + 1);
+        blocks.push_back(block);
+    }
+    for (unsigned int i = 0; i < blocks.size(); ++i)
+    {
+        EXPECT_EQ(static_cast<char>(i), *static_cast<char*>(blocks[i]));
+        EXPECT_TRUE(pool.free(blocks[i]));
+    }
+    for (unsigned int i = 0; i < BlockPool::CLASS_COUNT; ++i) EXPECT_EQ(0, pool.used(i));
+}
+
+TEST(BlockPool, pageTableFull)
+{
+    gArenaUsed = 0;
+    BlockPool pool(arenaSource);
+    unsigned int count = 0;
+    while (pool.alloc(BlockPool::MAX_BLOCK_SIZE) != nullptr) ++count;
+    EXPECT_EQ(BlockPool::MAX_PAGES, pool.pages());
+    EXPECT_EQ(BlockPool::MAX_PAGES * BlockPool::PAGE_SIZE / BlockPool::MAX_BLOCK_SIZE, count);
+    EXPECT_EQ(count, pool.maxUsed(BlockPool::CLASS_COUNT - 1));
+}
+
+// Transfers, events and history lines coming and going, like the console and the drivers do
+TEST(BlockPool, benchmark)
+{
+    static const unsigned int LIVE_COUNT = 256;
+    static const unsigned int ROUND_COUNT = 200000;
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<unsigned int> sizes(4, BlockPool::MAX_BLOCK_SIZE / 2);
+    std::uniform_int_distribution<unsigned int> slots(0, LIVE_COUNT - 1);
+    std::vector<unsigned int> size(ROUND_COUNT);
+    std::vector<unsigned int> slot(ROUND_COUNT);
+    for (unsigned int i = 0; i < ROUND_COUNT; ++i)
+    {
+        size[i] = sizes(generator);
+        slot[i] = slots(generator);
+    }
+
+    gArenaUsed = 0;
+    BlockPool pool(arenaSource);
+    std::vector<void*> live(LIVE_COUNT, nullptr);
+    uint64_t poolWorst = 0;
+    uint64_t start = __rdtsc();
+    for (unsigned int i = 0; i < ROUND_COUNT; ++i)
+    {
+        uint64_t opStart = __rdtsc();
+        if (live[slot[i]] != nullptr) pool.free(live[slot[i]]);
+        live[slot[i]] = pool.alloc(size[i]);
+        uint64_t op = __rdtsc() - opStart;
+        if (op > poolWorst) poolWorst = op;
+        ASSERT_NE(nullptr, live[slot[i]]);
+    }
+    uint64_t poolCycles = __rdtsc() - start;
+    for (void*& block : live)
+    {
+        EXPECT_TRUE(pool.free(block));
+        block = nullptr;
+    }
+
+    uint64_t mallocWorst = 0;
+    start = __rdtsc();
+    for (unsigned int i = 0; i < ROUND_COUNT; ++i)
+    {
+        uint64_t opStart = __rdtsc();
+        std::free(live[slot[i]]);
+        live[slot[i]] = std::malloc(size[i]);
+        uint64_t op = __rdtsc() - opStart;
+        if (op > mallocWorst) mallocWorst = op;
+    }
+    uint64_t mallocCycles = __rdtsc() - start;
+    for (void* block : live) std::free(block);
+
+    std::printf("%u free+alloc: pool %lu cycles (worst %lu), malloc %lu cycles (worst %lu), pool pages %u\n", ROUND_COUNT,
+                static_cast<unsigned long>(poolCycles / ROUND_COUNT), static_cast<unsigned long>(poolWorst),
+                static_cast<unsigned long>(mallocCycles / ROUND_COUNT), static_cast<unsigned long>(mallocWorst), pool.pages());
+    // pages only get added for the high water mark, freed blocks are reused
+    for (unsigned int i = 0; i < BlockPool::CLASS_COUNT; ++i) EXPECT_LE(pool.maxUsed(i), pool.total(i));
+    EXPECT_LE(pool.pages(), 2 * LIVE_COUNT * BlockPool::MAX_BLOCK_SIZE / 2 / BlockPool::PAGE_SIZE + BlockPool::CLASS_COUNT);
+}
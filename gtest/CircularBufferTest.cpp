@@ -1,11 +1,12 @@
 #include "../CircularBuffer.h"
-#include "../CircularBuffer.cpp"
+#include "../StaticCircularBuffer.h"
 
 #include <gtest/gtest.h>
 
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
 #include <random>
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
@@ -323,3 +324,265 @@ TEST(CircularBuffer, bufferEmptyPushPop)
         EXPECT_EQ(size - free, mCircularBuffer->used());
     }
 }
+
+TEST(CircularBuffer, reserveCommitWrap)
+{
+    CircularBuffer<char> buffer(100);
+    char* data;
+    const char* readData;
+    EXPECT_EQ(0, buffer.peek(readData));
+    EXPECT_EQ(100, buffer.reserve(data));
+    EXPECT_EQ(30, buffer.reserve(data, 30));
+    for (int i = 0; i < 30; ++i) data[i] = i;
+    // nothing to read before the commit
+    EXPECT_EQ(0, buffer.used());
+    buffer.commit(30);
+    EXPECT_EQ(30, buffer.used());
+    EXPECT_EQ(30, buffer.peek(readData));
+    EXPECT_EQ(0, readData[0]);
+    EXPECT_EQ(29, readData[29]);
+    EXPECT_EQ(20, buffer.release(20));
+
+    // only up to the end of the memory, the rest after the wrap
+    char* first;
+    EXPECT_EQ(70, buffer.reserve(first, 80));
+    buffer.commit(70);
+    EXPECT_EQ(20, buffer.reserve(data, 80));
+    EXPECT_EQ(first - 30, data);
+    buffer.commit(20);
+    EXPECT_EQ(0, buffer.reserve(data));
+    EXPECT_EQ(0, buffer.free());
+    EXPECT_EQ(80, buffer.peek(readData));
+    EXPECT_EQ(20, readData[0]);
+    EXPECT_EQ(80, buffer.release(80));
+    EXPECT_EQ(20, buffer.peek(readData));
+    EXPECT_EQ(20, buffer.release(100));
+    EXPECT_EQ(0, buffer.used());
+}
+
+TEST(CircularBuffer, rewind)
+{
+    CircularBuffer<char> buffer(100);
+    char* data;
+    buffer.reserve(data, 30);
+    buffer.commit(30);
+    EXPECT_FALSE(buffer.rewind());
+    EXPECT_EQ(30, buffer.used());
+    buffer.release(30);
+    // a reserve gets the whole memory again
+    EXPECT_TRUE(buffer.rewind());
+    EXPECT_EQ(buffer.bufferPointer(), buffer.writePointer());
+    EXPECT_EQ(buffer.bufferPointer(), buffer.readPointer());
+    EXPECT_EQ(100, buffer.reserve(data));
+    EXPECT_EQ(buffer.bufferPointer(), data);
+    EXPECT_EQ(0, buffer.used());
+}
+
+TEST(CircularBuffer, reserveCommitRandom)
+{
+    CircularBuffer<char> buffer(MAX_SIZE);
+    unsigned int in = 0;
+    unsigned int out = 0;
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<int> dist(0, MAX_SIZE / 3);
+    for (int i = 0; i < 10000; ++i)
+    {
+        char* data;
+        unsigned int len = buffer.reserve(data, dist(generator));
+        for (unsigned int j = 0; j < len; ++j) data[j] = (in + j) % MODULO;
+        buffer.commit(len);
+        in += len;
+
+        const char* readData;
+        len = std::min(buffer.peek(readData), static_cast<unsigned int>(dist(generator)));
+        for (unsigned int j = 0; j < len; ++j) ASSERT_EQ((out + j) % MODULO, static_cast<unsigned char>(readData[j]));
+        EXPECT_EQ(len, buffer.release(len));
+        out += len;
+        EXPECT_EQ(in - out, buffer.used());
+    }
+}
+
+// a formatter, first into a buffer on the stack and then copied, or directly into the ring
+TEST(CircularBuffer, reserveCommitBenchmark)
+{
+    static const unsigned int ROUND_COUNT = 200000;
+    static const unsigned int LINE_LEN = 48;
+    CircularBuffer<char> buffer(MAX_SIZE);
+    char line[LINE_LEN];
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUND_COUNT; ++i)
+    {
+        for (unsigned int j = 0; j < LINE_LEN; ++j) line[j] = i + j;
+        buffer.write(line, LINE_LEN);
+        const char* data;
+        buffer.skip(buffer.getContBuffer(data));
+        buffer.skip(buffer.getContBuffer(data));
+    }
+    auto copied = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUND_COUNT; ++i)
+    {
+        char* data;
+        unsigned int len = buffer.reserve(data, LINE_LEN);
+        if (len < LINE_LEN)
+        {
+            // doesn't fit before the wrap, the formatter starts over behind it
+            buffer.commit(len);
+            buffer.release(len);
+            len = buffer.reserve(data, LINE_LEN);
+        }
+        for (unsigned int j = 0; j < LINE_LEN; ++j) data[j] = i + j;
+        buffer.commit(len);
+        const char* readData;
+        buffer.release(buffer.peek(readData));
+    }
+    auto inPlace = std::chrono::steady_clock::now();
+    EXPECT_EQ(0, buffer.used());
+    typedef std::chrono::nanoseconds ns;
+    std::printf("%u byte line: through write() %lu ns, reserve()/commit() %lu ns, %u bytes less copied\n", LINE_LEN,
+                static_cast<unsigned long>(std::chrono::duration_cast<ns>(copied - start).count() / ROUND_COUNT),
+                static_cast<unsigned long>(std::chrono::duration_cast<ns>(inPlace - copied).count() / ROUND_COUNT),
+                ROUND_COUNT * LINE_LEN);
+}
+
+#define STATIC_SIZE 128
+
+typedef StaticCircularBuffer<uint16_t, STATIC_SIZE> StaticBuffer;
+
+TEST(StaticCircularBuffer, pushPopWrap)
+{
+    StaticBuffer buffer;
+    EXPECT_EQ(STATIC_SIZE, buffer.size());
+    uint16_t out = 0;
+    uint16_t in = 0;
+    // the positions run over many rounds
+    for (int i = 0; i < 1000; ++i)
+    {
+        for (int pc = 0; pc < 100; ++pc) EXPECT_TRUE(buffer.push(in++));
+        EXPECT_EQ(100, buffer.used());
+        EXPECT_EQ(STATIC_SIZE - 100, buffer.free());
+        uint16_t back;
+        EXPECT_TRUE(buffer.back(back));
+        EXPECT_EQ(out, back);
+        EXPECT_EQ(out + 10, buffer[10]);
+        EXPECT_EQ(in - 1, buffer[-1]);
+        for (int pc = 0; pc < 100; ++pc)
+        {
+            uint16_t elem;
+            EXPECT_TRUE(buffer.pop(elem));
+            ASSERT_EQ(out++, elem);
+        }
+        uint16_t elem;
+        EXPECT_FALSE(buffer.pop(elem));
+    }
+    for (int pc = 0; pc < STATIC_SIZE; ++pc) EXPECT_TRUE(buffer.push(pc));
+    EXPECT_FALSE(buffer.push(0));
+}
+
+TEST(StaticCircularBuffer, readWriteRandom)
+{
+    StaticBuffer buffer;
+    unsigned int in = 0;
+    unsigned int out = 0;
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<int> dist(0, STATIC_SIZE + 10);
+    uint16_t buf[STATIC_SIZE + 10];
+    for (int i = 0; i < 10000; ++i)
+    {
+        unsigned int pushCount = dist(generator);
+        unsigned int free = buffer.free();
+        for (unsigned int pc = 0; pc < pushCount; ++pc) buf[pc] = (in + pc) % MODULO;
+        EXPECT_EQ(std::min(pushCount, free), buffer.write(buf, pushCount));
+        in += std::min(pushCount, free);
+        EXPECT_EQ(in - out, buffer.used());
+
+        unsigned int popCount = dist(generator);
+        unsigned int used = buffer.used();
+        EXPECT_EQ(std::min(popCount, used), buffer.read(buf, popCount));
+        for (unsigned int pc = 0; pc < std::min(popCount, used); ++pc) ASSERT_EQ((out++) % MODULO, buf[pc]);
+        EXPECT_EQ(in - out, buffer.used());
+    }
+}
+
+TEST(StaticCircularBuffer, contBufferSkip)
+{
+    StaticBuffer buffer;
+    const uint16_t* data;
+    EXPECT_EQ(0, buffer.getContBuffer(data));
+    uint16_t buf[STATIC_SIZE];
+    for (unsigned int i = 0; i < STATIC_SIZE; ++i) buf[i] = i;
+    EXPECT_EQ(100, buffer.write(buf, 100));
+    EXPECT_EQ(100, buffer.getContBuffer(data));
+    EXPECT_EQ(0, data[0]);
+    EXPECT_EQ(90, buffer.skip(90));
+    EXPECT_EQ(STATIC_SIZE, buffer.write(buf, STATIC_SIZE) + 10);
+    // up to the end of the memory, the rest comes with the next call
+    EXPECT_EQ(STATIC_SIZE - 90, buffer.getContBuffer(data));
+    EXPECT_EQ(90, data[0]);
+    EXPECT_EQ(STATIC_SIZE - 90, buffer.skip(STATIC_SIZE - 90));
+    EXPECT_EQ(90, buffer.getContBuffer(data));
+    EXPECT_EQ(28, data[0]);
+    EXPECT_EQ(90, buffer.skip(1000));
+    EXPECT_EQ(0, buffer.used());
+}
+
+TEST(StaticCircularBuffer, reserveCommit)
+{
+    StaticBuffer buffer;
+    uint16_t* data;
+    const uint16_t* readData;
+    EXPECT_EQ(100, buffer.reserve(data, 100));
+    for (int i = 0; i < 100; ++i) data[i] = i;
+    buffer.commit(100);
+    EXPECT_EQ(100, buffer.peek(readData));
+    EXPECT_EQ(99, readData[99]);
+    EXPECT_EQ(100, buffer.release(100));
+    EXPECT_EQ(STATIC_SIZE - 100, buffer.reserve(data));
+    buffer.commit(STATIC_SIZE - 100);
+    EXPECT_EQ(100, buffer.reserve(data));
+    EXPECT_EQ(STATIC_SIZE - 100, buffer.used());
+}
+
+template<class Buffer>
+static uint64_t throughput(Buffer& buffer, unsigned int chunk)
+{
+    static const unsigned int ROUND_COUNT = 200000;
+    uint16_t in[STATIC_SIZE];
+    uint16_t out[STATIC_SIZE];
+    for (unsigned int i = 0; i < STATIC_SIZE; ++i) in[i] = i;
+    unsigned int sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUND_COUNT; ++i)
+    {
+        if (chunk == 1)
+        {
+            buffer.push(in[i % STATIC_SIZE]);
+            buffer.push(in[i % STATIC_SIZE]);
+            buffer.pop(out[0]);
+            buffer.pop(out[1]);
+        }
+        else
+        {
+            buffer.write(in, chunk);
+            buffer.read(out, chunk);
+        }
+        sum += out[0];
+    }
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_EQ(0, buffer.used());
+    EXPECT_NE(1, sum);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / ROUND_COUNT;
+}
+
+TEST(StaticCircularBuffer, benchmark)
+{
+    CircularBuffer<uint16_t> dynamic(STATIC_SIZE);
+    StaticBuffer fixed;
+    // odd chunks, so the wrap comes at all positions
+    for (unsigned int chunk : { 1, 7, 48 })
+    {
+        uint64_t dynamicNs = throughput(dynamic, chunk);
+        uint64_t fixedNs = throughput(fixed, chunk);
+        std::printf("%u elements in and out: CircularBuffer %lu ns, StaticCircularBuffer %lu ns\n", chunk == 1 ? 2 : chunk,
+                    static_cast<unsigned long>(dynamicNs), static_cast<unsigned long>(fixedNs));
+    }
+}
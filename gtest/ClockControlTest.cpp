@@ -1,5 +1,4 @@
 #include "../ClockControl.h"
-#include "../ClockControl.cpp"
 
 #include <gtest/gtest.h>
 
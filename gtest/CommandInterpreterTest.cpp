@@ -0,0 +1,96 @@
+#include "../CommandInterpreter.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+// set <index> <on|off>, keeps what it got
+class Setting : public CommandInterpreter::Command
+{
+public:
+    Setting();
+
+    virtual bool execute(CommandInterpreter& interpreter, int argc, const CommandInterpreter::Argument* argv)
+    {
+        ++mCount;
+        mArgc = argc;
+        mIndex = argv[1].value.u;
+        mOn = argv[2].value.b;
+        return true;
+    }
+    virtual const char* helpText() const { return "Switch something."; }
+
+    unsigned int mCount;
+    int mArgc;
+    unsigned int mIndex;
+    bool mOn;
+
+private:
+    static char const * const NAME[];
+    static char const * const ARGV[];
+};
+
+char const * const Setting::NAME[] = { "set" };
+char const * const Setting::ARGV[] = { "u:index", "b:on" };
+
+Setting::Setting() : Command(NAME, sizeof(NAME) / sizeof(NAME[0]), ARGV, sizeof(ARGV) / sizeof(ARGV[0])), mCount(0), mArgc(0), mIndex(0), mOn(false)
+{
+}
+
+static const std::string PROMPT = "\r# \x1b[0K";
+
+TEST(CommandInterpreter, commandLine)
+{
+    HostSystem system;
+    system.setCaptureConsole(true);
+    HostConsole console(system);
+    CommandInterpreter interpreter(system, console, system.mRcc);
+    Setting* setting = new Setting();
+    interpreter.add(setting);
+    interpreter.start(false);
+    EXPECT_EQ(PROMPT, system.console());
+
+    system.console().clear();
+    console.type("set 0x2a on\r");
+    system.run(1000000);
+    ASSERT_EQ(1, setting->mCount);
+    EXPECT_EQ(3, setting->mArgc);
+    EXPECT_EQ(42, setting->mIndex);
+    EXPECT_TRUE(setting->mOn);
+    // echoed while typed, then a new line and a new prompt
+    EXPECT_EQ("set 0x2a on\r\n" + PROMPT, system.console());
+    EXPECT_EQ(0, system.typed());
+
+    // doesn't parse, the usage comes instead
+    console.type("set 7 maybe\r");
+    system.run(1000000);
+    EXPECT_EQ(1, setting->mCount);
+
+    // the line before that again, from the history
+    console.type("\x1b[A\x1b[A\r");
+    system.run(1000000);
+    ASSERT_EQ(2, setting->mCount);
+    EXPECT_EQ(42, setting->mIndex);
+}
+
+TEST(CommandInterpreter, typedAhead)
+{
+    HostSystem system;
+    system.setCaptureConsole(true);
+    HostConsole console(system);
+    CommandInterpreter interpreter(system, console, system.mRcc);
+    Setting* setting = new Setting();
+    interpreter.add(setting);
+
+    // waits for the interpreter to read it
+    console.type("set 1 off\rset 2 1\r");
+    system.run(1000000);
+    EXPECT_EQ(0, setting->mCount);
+    interpreter.start(false);
+    system.run(1000000);
+    EXPECT_EQ(2, setting->mCount);
+    EXPECT_EQ(2, setting->mIndex);
+    EXPECT_TRUE(setting->mOn);
+    EXPECT_EQ(0, system.typed());
+}
@@ -0,0 +1,171 @@
+#include "../Console.h"
+#include "SerialLine.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+// start, 8 data and stop bit at 115200 baud
+static const uint64_t SLOW_BYTE_NS = 86806;
+
+static std::string text(unsigned int len, unsigned int seed)
+{
+    std::string s;
+    for (unsigned int i = 0; i < len; ++i) s += static_cast<char>('a' + (i * 7 + seed) % 26);
+    return s;
+}
+
+static std::string drain(Console& console)
+{
+    std::string s;
+    const char* data;
+    unsigned int len;
+    while ((len = console.peek(data)) != 0)
+    {
+        s.append(data, len);
+        console.release(len);
+    }
+    return s;
+}
+
+TEST(Console, overflowPolicies)
+{
+    std::string line = text(20, 0);
+
+    Console block(16, Console::Overflow::Block);
+    EXPECT_EQ(16, block.write(line.data(), line.size()));
+    EXPECT_EQ(0, block.dropped());
+    EXPECT_EQ(line.substr(0, 16), drain(block));
+
+    Console drop(16, Console::Overflow::Drop);
+    EXPECT_EQ(line.size(), drop.write(line.data(), line.size()));
+    EXPECT_EQ(4, drop.dropped());
+    EXPECT_EQ(1, drop.overflows());
+    EXPECT_EQ(line.substr(0, 16), drain(drop));
+
+    Console overwrite(16, Console::Overflow::OverwriteOldest);
+    EXPECT_EQ(10, overwrite.write(line.data(), 10));
+    EXPECT_EQ(10, overwrite.write(line.data() + 10, 10));
+    EXPECT_EQ(4, overwrite.dropped());
+    EXPECT_EQ(line.substr(4), drain(overwrite));
+    // more than fits at all, the end of it is kept
+    EXPECT_EQ(line.size(), overwrite.write(line.data(), line.size()));
+    EXPECT_EQ(8, overwrite.dropped());
+    EXPECT_EQ(2, overwrite.overflows());
+    char buffer[32];
+    EXPECT_EQ(16, overwrite.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(line.substr(4), std::string(buffer, 16));
+    // an empty ring gets filled first, then the newest take its place
+    std::string longLine = text(40, 3);
+    EXPECT_EQ(longLine.size(), overwrite.write(longLine.data(), longLine.size()));
+    EXPECT_EQ(8 + 24, overwrite.dropped());
+    EXPECT_EQ(3, overwrite.overflows());
+    EXPECT_EQ(longLine.substr(24), drain(overwrite));
+}
+
+TEST(Console, overwriteWhileSending)
+{
+    std::string first = text(12, 0);
+    std::string second = text(12, 5);
+    Console console(16, Console::Overflow::OverwriteOldest);
+    console.write(first.data(), first.size());
+    // what the DMA is sending is out of the ring, it is not overwritten
+    const char* data;
+    ASSERT_EQ(first.size(), console.peek(data));
+    EXPECT_EQ(second.size(), console.write(second.data(), second.size()));
+    EXPECT_EQ(0, console.dropped());
+    EXPECT_EQ(first, std::string(data, first.size()));
+    console.release(first.size());
+    EXPECT_EQ(second, drain(console));
+
+    console.write(first.data(), first.size());
+    ASSERT_EQ(first.size(), console.peek(data));
+    console.write(first.data(), first.size());
+    console.write(second.data(), second.size());
+    EXPECT_EQ(8, console.dropped());
+    EXPECT_EQ(first, std::string(data, first.size()));
+    console.release(first.size());
+    EXPECT_EQ(first.substr(8) + second, drain(console));
+}
+
+// a line every millisecond, more than 115200 baud can take
+TEST(Console, slowLine)
+{
+    static const unsigned int LINES = 200;
+    static const unsigned int LINE_SIZE = 40;
+    static const unsigned int SIZE = 1024;
+    std::string all;
+    for (unsigned int i = 0; i < LINES; ++i) all += text(LINE_SIZE, i);
+    for (Console::Overflow overflow : { Console::Overflow::Drop, Console::Overflow::OverwriteOldest })
+    {
+        HostSystem system;
+        Line line(system, SLOW_BYTE_NS);
+        Dma dma(line.dma());
+        InterruptController::Line dmaInterrupt(system.mNvic, DMA_TX_INDEX);
+        Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+        line.setTxStream(&stream, &dmaInterrupt);
+        Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+        serial.config(115200);
+        serial.configDma(&stream, nullptr);
+        // the DMA sends from the console, so it goes on the heap
+        Console* console = new Console(SIZE, overflow);
+        serial.writeFifo(console);
+        serial.enable(Device::All);
+
+        for (unsigned int i = 0; i < LINES; ++i)
+        {
+            // returns right away, however much is waiting, with Block this would never get done
+            EXPECT_TRUE(serial.write(all.data() + i * LINE_SIZE, LINE_SIZE));
+            line.poll();
+            system.run(1000000);
+        }
+        system.run((SIZE + Console::CHUNK_SIZE) * SLOW_BYTE_NS + 1000000);
+
+        const std::string& sent = line.sent();
+        std::printf("%s: %u bytes written, %u sent, %u dropped in %u overflows\n",
+                    overflow == Console::Overflow::Drop ? "drop" : "overwrite oldest", static_cast<unsigned int>(all.size()),
+                    static_cast<unsigned int>(sent.size()), console->dropped(), console->overflows());
+        EXPECT_EQ(0, console->used());
+        EXPECT_LT(0, console->dropped());
+        EXPECT_EQ(all.size(), sent.size() + console->dropped());
+        ASSERT_LE(SIZE, sent.size());
+        // what goes first is in order, drop keeps the oldest and overwrite the newest
+        if (overflow == Console::Overflow::Drop) EXPECT_EQ(all.substr(0, SIZE), sent.substr(0, SIZE));
+        else EXPECT_EQ(all.substr(all.size() - SIZE), sent.substr(sent.size() - SIZE));
+    }
+}
+
+TEST(Console, flush)
+{
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_TX_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    line.setTxStream(&stream, &dmaInterrupt);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(&stream, nullptr);
+    Console* console = new Console(1024, Console::Overflow::Drop);
+    serial.writeFifo(console);
+    serial.enable(Device::All);
+
+    std::string all = text(3 * Console::CHUNK_SIZE + 10, 0);
+    serial.write(all.data(), all.size());
+    line.poll();
+    system.advance(10 * BYTE_NS);
+    EXPECT_TRUE(line.sent().empty());
+    // waits for the transfer and the ones it chains, nothing is sent twice
+    serial.flush();
+    EXPECT_EQ(all, line.sent());
+    EXPECT_EQ(0, console->used());
+
+    // from now on it's busy waiting, without DMA
+    line.transmitComplete();
+    std::string more = text(10, 3);
+    serial.write(more.data(), more.size());
+    EXPECT_EQ(more.back(), line.lastWritten());
+    EXPECT_EQ(0, console->used());
+    EXPECT_EQ(all, line.sent());
+}
@@ -0,0 +1,281 @@
+#include "../DmaManager.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <tuple>
+#include <vector>
+
+#define SIZE_OF_DMA 0xd0
+
+// register words
+enum
+{
+    DMA_STREAM = 4,
+    DMA_STREAM_WORDS = 6,
+};
+
+typedef DmaManager::Request Request;
+typedef Dma::Stream::StreamIndex StreamIndex;
+typedef Dma::Stream::ChannelIndex ChannelIndex;
+
+// the two controllers in plain memory
+class Controllers
+{
+public:
+    Controllers() :
+        mRegisters1(new uint32_t[SIZE_OF_DMA / 4]()),
+        mRegisters2(new uint32_t[SIZE_OF_DMA / 4]()),
+        mDma1(reinterpret_cast<System::BaseAddress>(mRegisters1)),
+        mDma2(reinterpret_cast<System::BaseAddress>(mRegisters2)),
+        mManager(mDma1, mDma2, mSystem.mNvic, nullptr)
+    {
+    }
+    ~Controllers() { delete[] mRegisters1; delete[] mRegisters2; }
+
+    // channel and priority the stream runs with, from its CR
+    unsigned int channel(unsigned int dma, unsigned int stream) { return (cr(dma, stream) >> 25) & 7; }
+    unsigned int priority(unsigned int dma, unsigned int stream) { return (cr(dma, stream) >> 16) & 3; }
+
+    HostSystem mSystem;
+    uint32_t* mRegisters1;
+    uint32_t* mRegisters2;
+    Dma mDma1;
+    Dma mDma2;
+    DmaManager mManager;
+
+private:
+    uint32_t cr(unsigned int dma, unsigned int stream) { return (dma == 1 ? mRegisters1 : mRegisters2)[DMA_STREAM + stream * DMA_STREAM_WORDS]; }
+};
+
+class Turns : public DmaManager::Share::Callback
+{
+public:
+    virtual void dmaGranted(DmaManager::Share* share, Dma::Stream* stream)
+    {
+        EXPECT_EQ(share->stream(), stream);
+        mGranted.push_back(share);
+    }
+
+    std::vector<DmaManager::Share*> mGranted;
+};
+
+// RM0090 tables 42 and 43
+TEST(DmaManager, mappingTable)
+{
+    struct Case
+    {
+        Request mRequest;
+        unsigned int mDma;
+        StreamIndex mStream;
+        ChannelIndex mChannel;
+    };
+    static const Case CASES[] =
+    {
+        { Request::Usart2Rx, 1, StreamIndex::Stream5, ChannelIndex::Channel4 },
+        { Request::Usart2Tx, 1, StreamIndex::Stream6, ChannelIndex::Channel4 },
+        { Request::Spi1Rx, 2, StreamIndex::Stream0, ChannelIndex::Channel3 },
+        { Request::Spi1Tx, 2, StreamIndex::Stream5, ChannelIndex::Channel3 },
+        { Request::Spi2Tx, 1, StreamIndex::Stream4, ChannelIndex::Channel0 },
+        { Request::Spi3Tx, 1, StreamIndex::Stream5, ChannelIndex::Channel0 },
+        { Request::Spi3Tx, 1, StreamIndex::Stream7, ChannelIndex::Channel0 },
+        { Request::I2c1Rx, 1, StreamIndex::Stream5, ChannelIndex::Channel1 },
+        { Request::I2c1Tx, 1, StreamIndex::Stream7, ChannelIndex::Channel1 },
+        { Request::I2c2Tx, 1, StreamIndex::Stream7, ChannelIndex::Channel7 },
+        { Request::Usart3Tx, 1, StreamIndex::Stream4, ChannelIndex::Channel7 },
+        { Request::Sdio, 2, StreamIndex::Stream3, ChannelIndex::Channel4 },
+        { Request::Sdio, 2, StreamIndex::Stream6, ChannelIndex::Channel4 },
+        { Request::Usart6Tx, 2, StreamIndex::Stream7, ChannelIndex::Channel5 },
+        { Request::Adc1, 2, StreamIndex::Stream4, ChannelIndex::Channel0 },
+        { Request::Dac2, 1, StreamIndex::Stream6, ChannelIndex::Channel7 },
+        { Request::HashIn, 2, StreamIndex::Stream7, ChannelIndex::Channel2 },
+    };
+    for (const Case& c : CASES)
+    {
+        bool found = false;
+        const DmaManager::Mapping* m;
+        for (unsigned int i = 0; (m = DmaManager::mapping(c.mRequest, i)) != nullptr; ++i)
+        {
+            found = found || (m->mDma == c.mDma && m->mStream == c.mStream && m->mChannel == c.mChannel);
+        }
+        EXPECT_TRUE(found) << "request " << static_cast<int>(c.mRequest) << " DMA" << c.mDma << " stream " << static_cast<int>(c.mStream);
+    }
+
+    // a stream has one request per channel, a request one or two streams
+    std::set<std::tuple<unsigned int, StreamIndex, ChannelIndex> > used;
+    for (unsigned int i = 0; i < DmaManager::MAPPING_SIZE; ++i)
+    {
+        const DmaManager::Mapping& m = DmaManager::MAPPING[i];
+        if (m.mRequest == Request::MemoryToMemory) continue;
+        EXPECT_TRUE(m.mDma == 1 || m.mDma == 2);
+        EXPECT_TRUE(used.insert(std::make_tuple(m.mDma, m.mStream, m.mChannel)).second) << "DMA" << static_cast<int>(m.mDma) << " stream " << static_cast<int>(m.mStream) << " channel " << static_cast<int>(m.mChannel);
+    }
+    for (int request = static_cast<int>(Request::Spi1Rx); request < static_cast<int>(Request::MemoryToMemory); ++request)
+    {
+        EXPECT_NE(nullptr, DmaManager::mapping(static_cast<Request>(request), 0)) << request;
+        EXPECT_EQ(nullptr, DmaManager::mapping(static_cast<Request>(request), 2)) << request;
+    }
+    // only DMA2 can do it, on any stream, the two for the memcpy ones are no peripheral's first try but CRYP OUT's
+    std::set<StreamIndex> memcpy;
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        const DmaManager::Mapping* m = DmaManager::mapping(Request::MemoryToMemory, i);
+        ASSERT_NE(nullptr, m);
+        EXPECT_EQ(2, m->mDma);
+        EXPECT_TRUE(memcpy.insert(m->mStream).second);
+        if (i >= 2) continue;
+        for (unsigned int j = 0; j < DmaManager::MAPPING_SIZE; ++j)
+        {
+            const DmaManager::Mapping& first = DmaManager::MAPPING[j];
+            if (first.mRequest == Request::MemoryToMemory || first.mRequest == Request::CrypOut) continue;
+            EXPECT_FALSE(first.mDma == 2 && first.mStream == m->mStream && DmaManager::mapping(first.mRequest, 0) == &first)
+                << "request " << static_cast<int>(first.mRequest) << " stream " << static_cast<int>(m->mStream);
+        }
+    }
+    EXPECT_EQ(nullptr, DmaManager::mapping(Request::MemoryToMemory, 8));
+}
+
+// the console, the memcpy streams and the car controller, which had SPI3 TX on stream 5 of DMA1 with USART2 RX
+TEST(DmaManager, claimSystem)
+{
+    Controllers controllers;
+    DmaManager& manager = controllers.mManager;
+    Dma::Stream* usart2Tx = manager.claim(Request::Usart2Tx, "USART2 TX");
+    Dma::Stream* usart2Rx = manager.claim(Request::Usart2Rx, "USART2 RX");
+    Dma::Stream* memcpy0 = manager.claim(Request::MemoryToMemory, "memcpy");
+    Dma::Stream* memcpy1 = manager.claim(Request::MemoryToMemory, "memcpy");
+    Dma::Stream* spi1Tx = manager.claim(Request::Spi1Tx, "SPI1 TX");
+    Dma::Stream* spi1Rx = manager.claim(Request::Spi1Rx, "SPI1 RX");
+    Dma::Stream* spi2Tx = manager.claim(Request::Spi2Tx, "SPI2 TX");
+    Dma::Stream* spi2Rx = manager.claim(Request::Spi2Rx, "SPI2 RX");
+    Dma::Stream* spi3Tx = manager.claim(Request::Spi3Tx, "SPI3 TX");
+    Dma::Stream* spi3Rx = manager.claim(Request::Spi3Rx, "SPI3 RX");
+    EXPECT_EQ(0, manager.conflicts());
+    std::set<Dma::Stream*> streams = { usart2Tx, usart2Rx, memcpy0, memcpy1, spi1Tx, spi1Rx, spi2Tx, spi2Rx, spi3Tx, spi3Rx };
+    EXPECT_EQ(10, streams.size());
+    EXPECT_EQ(0, streams.count(nullptr));
+
+    // DMA1 stream 7 channel 0
+    spi3Tx->start();
+    EXPECT_EQ(0, controllers.channel(1, 7));
+    usart2Rx->start();
+    EXPECT_EQ(4, controllers.channel(1, 5));
+    // DMA2 stream 0 channel 3, memcpy left it alone
+    spi1Rx->start();
+    EXPECT_EQ(3, controllers.channel(2, 0));
+    // and stream 1, the first one of USART6 RX and DCMI
+    Dma::Stream* usart6Rx = manager.claim(Request::Usart6Rx, "USART6 RX");
+    ASSERT_NE(nullptr, usart6Rx);
+    usart6Rx->start();
+    EXPECT_EQ(5, controllers.channel(2, 1));
+}
+
+TEST(DmaManager, conflict)
+{
+    Controllers controllers;
+    DmaManager& manager = controllers.mManager;
+    ASSERT_NE(nullptr, manager.claim(Request::I2c1Rx, "I2C1 RX"));
+    ASSERT_NE(nullptr, manager.claim(Request::I2c1Rx, "I2C1 RX again"));
+    EXPECT_EQ(nullptr, manager.claim(Request::I2c1Rx, "I2C1 RX once more"));
+    // stream 5 went to the second I2C1 RX
+    EXPECT_EQ(nullptr, manager.claim(Request::Usart2Rx, "USART2 RX"));
+    EXPECT_EQ(2, manager.conflicts());
+    // claimed streams aren't shared either
+    Turns turns;
+    EXPECT_EQ(nullptr, manager.share(Request::Dac1, "DAC1", Dma::Stream::Priority::Low, &turns));
+    EXPECT_EQ(3, manager.conflicts());
+    for (unsigned int i = 0; i < DmaManager::MAX_CONFLICTS; ++i) manager.claim(Request::Usart2Rx, "USART2 RX");
+    EXPECT_EQ(3 + DmaManager::MAX_CONFLICTS, manager.conflicts());
+}
+
+// an idle peripheral gives its stream back, the next one gets it with its own channel
+TEST(DmaManager, release)
+{
+    Controllers controllers;
+    DmaManager& manager = controllers.mManager;
+    Dma::Stream* spi3Rx = manager.claim(Request::Spi3Rx, "SPI3 RX");
+    ASSERT_NE(nullptr, spi3Rx);
+    spi3Rx->start();
+    EXPECT_EQ(0, controllers.channel(1, 0));
+
+    // SPI3 RX has stream 0, I2C1 RX gets the other one
+    Dma::Stream* i2c1Rx = manager.claim(Request::I2c1Rx, "I2C1 RX");
+    ASSERT_NE(nullptr, i2c1Rx);
+    EXPECT_NE(spi3Rx, i2c1Rx);
+    manager.release(i2c1Rx);
+    manager.release(spi3Rx);
+
+    Dma::Stream* again = manager.claim(Request::I2c1Rx, "I2C1 RX");
+    EXPECT_EQ(spi3Rx, again);
+    again->start();
+    EXPECT_EQ(1, controllers.channel(1, 0));
+    EXPECT_EQ(0, manager.conflicts());
+}
+
+// USART2 RX and DAC1 both only have stream 5 of DMA1, they take turns by priority
+TEST(DmaManager, share)
+{
+    Controllers controllers;
+    DmaManager& manager = controllers.mManager;
+    Turns turns;
+    DmaManager::Share* low = manager.share(Request::Usart2Rx, "USART2 RX", Dma::Stream::Priority::Low, &turns);
+    DmaManager::Share* high = manager.share(Request::Dac1, "DAC1", Dma::Stream::Priority::High, &turns);
+    DmaManager::Share* medium = manager.share(Request::Usart2Rx, "USART2 RX 2", Dma::Stream::Priority::Medium, &turns);
+    DmaManager::Share* gone = manager.share(Request::Dac1, "DAC1 2", Dma::Stream::Priority::VeryHigh, &turns);
+    ASSERT_NE(nullptr, low);
+    ASSERT_NE(nullptr, high);
+    ASSERT_NE(nullptr, medium);
+    ASSERT_NE(nullptr, gone);
+    Dma::Stream* stream = low->stream();
+    EXPECT_EQ(stream, high->stream());
+    EXPECT_EQ(stream, medium->stream());
+    // it's shared, a claim doesn't get it
+    EXPECT_EQ(nullptr, manager.claim(Request::Dac1, "DAC1 alone"));
+    EXPECT_EQ(1, manager.conflicts());
+
+    EXPECT_TRUE(manager.acquire(low));
+    EXPECT_TRUE(manager.acquire(low));
+    stream->start();
+    EXPECT_EQ(4, controllers.channel(1, 5));
+    EXPECT_EQ(static_cast<unsigned int>(Dma::Stream::Priority::Low), controllers.priority(1, 5));
+    EXPECT_FALSE(manager.acquire(medium));
+    EXPECT_FALSE(manager.acquire(high));
+    EXPECT_FALSE(manager.acquire(gone));
+    EXPECT_FALSE(manager.acquire(high));
+    // doesn't want it anymore
+    manager.release(gone);
+    EXPECT_TRUE(turns.mGranted.empty());
+
+    manager.release(low);
+    ASSERT_EQ(1, turns.mGranted.size());
+    EXPECT_EQ(high, turns.mGranted[0]);
+    stream->start();
+    EXPECT_EQ(7, controllers.channel(1, 5));
+    EXPECT_EQ(static_cast<unsigned int>(Dma::Stream::Priority::High), controllers.priority(1, 5));
+    EXPECT_FALSE(manager.acquire(low));
+
+    manager.release(high);
+    manager.release(medium);
+    manager.release(low);
+    EXPECT_EQ(std::vector<DmaManager::Share*>({ high, medium, low }), turns.mGranted);
+    EXPECT_TRUE(manager.acquire(gone));
+    EXPECT_EQ(3, turns.mGranted.size());
+}
+
+// a shared request goes to the stream with the fewest users
+TEST(DmaManager, shareSpread)
+{
+    Controllers controllers;
+    DmaManager& manager = controllers.mManager;
+    Turns turns;
+    DmaManager::Share* a = manager.share(Request::Spi3Tx, "a", Dma::Stream::Priority::Low, &turns);
+    DmaManager::Share* b = manager.share(Request::Spi3Tx, "b", Dma::Stream::Priority::Low, &turns);
+    DmaManager::Share* c = manager.share(Request::Spi3Tx, "c", Dma::Stream::Priority::Low, &turns);
+    ASSERT_NE(nullptr, c);
+    EXPECT_NE(a->stream(), b->stream());
+    EXPECT_EQ(a->stream(), c->stream());
+    EXPECT_TRUE(manager.acquire(a));
+    EXPECT_TRUE(manager.acquire(b));
+    EXPECT_FALSE(manager.acquire(c));
+}
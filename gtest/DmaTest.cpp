@@ -0,0 +1,518 @@
+#include "../Dma.h"
+#include "../Device.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#define SIZE_OF_DMA 0xd0
+
+// register words
+enum
+{
+    DMA_ISR = 0,
+    DMA_IFCR = 2,
+    DMA_STREAM = 4,
+    DMA_STREAM_WORDS = 6,
+    DMA_FCR = 5,
+};
+
+static const uint32_t CR_DBM = 1 << 18;
+static const uint32_t CR_CT = 1 << 19;
+static const uint32_t FCR_DMDIS = 1 << 2;
+static const uint32_t CR_DIR_M2P = 1 << 6;
+static const uint32_t CR_EN = 1 << 0;
+static const uint8_t ALL_FLAGS = 0x3d;
+
+// the reasons the stream called back with
+class Reasons : public Dma::Stream::Callback
+{
+public:
+    virtual void dmaCallback(Dma::Stream* stream, Reason reason) { mReasons.push_back(reason); }
+
+    std::vector<Reason> mReasons;
+};
+
+// Stream 3 sending to a peripheral, finish() does what the hardware does at the end of a transfer: the
+// data goes out, EN goes back to 0 and the interrupt comes with the flags. The registers only hold 32 bit
+// addresses, they are looked up in the memory the test gives it.
+class Wire
+{
+public:
+    struct Hop
+    {
+        uint32_t mAddress;
+        unsigned int mCount;
+        unsigned int mMemorySize;
+        // EN was set again when the interrupt returned
+        bool mRestarted;
+    };
+
+    Wire() :
+        mRegisters(new uint32_t[SIZE_OF_DMA / 4]()),
+        mDma(reinterpret_cast<System::BaseAddress>(mRegisters)),
+        mStream(mDma, Dma::Stream::StreamIndex::Stream3, Dma::Stream::ChannelIndex::Channel0, nullptr),
+        mInterruptNs(0)
+    {
+        mStream.config(Dma::Stream::Direction::MemoryToPeripheral, false, true, Dma::Stream::DataSize::Byte, Dma::Stream::DataSize::Byte, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
+        mStream.configFifo(Dma::Stream::FifoThreshold::Auto);
+    }
+    ~Wire() { delete[] mRegisters; }
+
+    void addMemory(const void* memory, unsigned int size) { mMemory.push_back(std::make_pair(static_cast<const uint8_t*>(memory), size)); }
+    uint32_t address(const void* memory) { return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(memory)); }
+    uint32_t& cr() { return mRegisters[DMA_STREAM + 3 * DMA_STREAM_WORDS]; }
+
+    bool finish(uint8_t flags = Dma::TransferComplete)
+    {
+        uint32_t* stream = mRegisters + DMA_STREAM + 3 * DMA_STREAM_WORDS;
+        if ((stream[0] & CR_EN) == 0) return false;
+        Hop hop = { stream[3], stream[1], 1u << ((stream[0] >> 13) & 3), false };
+        if ((flags & Dma::TransferComplete) != 0)
+        {
+            const uint8_t* data = map(hop.mAddress, hop.mCount);
+            if (data != nullptr) mOut.insert(mOut.end(), data, data + hop.mCount);
+        }
+        stream[0] &= ~CR_EN;
+        // stream 3 has its flags at bit 22 of LISR
+        mRegisters[DMA_ISR] = static_cast<uint32_t>(flags) << 22;
+        auto start = std::chrono::steady_clock::now();
+        mStream.interruptCallback(0);
+        mInterruptNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        mRegisters[DMA_ISR] = 0;
+        hop.mRestarted = (stream[0] & CR_EN) != 0;
+        mHops.push_back(hop);
+        return true;
+    }
+
+    uint32_t* mRegisters;
+    Dma mDma;
+    Dma::Stream mStream;
+    std::vector<uint8_t> mOut;
+    std::vector<Hop> mHops;
+    uint64_t mInterruptNs;
+
+private:
+    std::vector<std::pair<const uint8_t*, unsigned int> > mMemory;
+
+    const uint8_t* map(uint32_t address, unsigned int count)
+    {
+        for (const std::pair<const uint8_t*, unsigned int>& memory : mMemory)
+        {
+            uint32_t offset = address - this->address(memory.first);
+            if (offset < memory.second && offset + count <= memory.second) return memory.first + offset;
+        }
+        ADD_FAILURE() << "DMA from unknown address " << std::hex << address;
+        return nullptr;
+    }
+};
+
+class Segments : public Dma::Stream::Segment::Callback
+{
+public:
+    virtual void segmentComplete(Dma::Stream* stream, Dma::Stream::Segment* segment) { mDone.push_back(segment); }
+
+    std::vector<Dma::Stream::Segment*> mDone;
+};
+
+// a circular capture, like an ADC or audio input
+class Capture : public Device
+{
+public:
+    Capture() : mHalf(0), mComplete(0), mWriteHalf(0), mWriteComplete(0) { }
+
+    virtual void enable(Part part) { }
+    virtual void disable(Part part) { }
+    virtual void interruptCallback(InterruptController::Index index) { }
+    virtual void dmaReadComplete() { ++mComplete; }
+    virtual void dmaWriteComplete() { ++mWriteComplete; }
+    virtual void dmaReadHalfComplete() { ++mHalf; }
+    virtual void dmaWriteHalfComplete() { ++mWriteHalf; }
+    bool reading() { return mDmaRead != nullptr; }
+
+    unsigned int mHalf;
+    unsigned int mComplete;
+    unsigned int mWriteHalf;
+    unsigned int mWriteComplete;
+};
+
+// the flags of the streams are 6 bits each in LISR and HISR, 0 and 1 in the low half word, 2 and 3 in the high one
+TEST(Dma, interruptFlags)
+{
+    typedef Dma::Stream::Callback::Reason Reason;
+    struct Case
+    {
+        uint8_t mFlags;
+        uint32_t mCr;
+        uint32_t mFcr;
+        bool mDoubleBuffer;
+        Reason mReason;
+    };
+    static const Case CASES[] =
+    {
+        { Dma::TransferComplete, 0, 0, false, Reason::TransferComplete },
+        { Dma::HalfTransfer, 0, 0, false, Reason::HalfTransfer },
+        { Dma::HalfTransfer | Dma::TransferComplete, 0, 0, false, Reason::TransferComplete },
+        { Dma::TransferError, 0, 0, false, Reason::TransferError },
+        { Dma::TransferError | Dma::TransferComplete, 0, 0, false, Reason::TransferError },
+        { Dma::DirectModeError, 0, 0, false, Reason::DirectModeError },
+        // an over- or underrun in direct mode, the data is there
+        { Dma::FifoError | Dma::TransferComplete, 0, 0, false, Reason::TransferComplete },
+        { Dma::FifoError | Dma::TransferComplete, 0, FCR_DMDIS, false, Reason::FifoError },
+        { Dma::TransferComplete, CR_DBM | CR_CT, 0, true, Reason::Memory0Complete },
+        { Dma::TransferComplete, CR_DBM, 0, true, Reason::Memory1Complete },
+        { Dma::HalfTransfer, CR_DBM, 0, true, Reason::HalfTransfer },
+    };
+    static const unsigned int SHIFT[] = { 0, 6, 16, 22 };
+    uint32_t* registers = new uint32_t[SIZE_OF_DMA / 4]();
+    Dma dma(reinterpret_cast<System::BaseAddress>(registers));
+
+    for (unsigned int index = 0; index < 8; ++index)
+    {
+        Dma::Stream stream(dma, static_cast<Dma::Stream::StreamIndex>(index), Dma::Stream::ChannelIndex::Channel0, nullptr);
+        Reasons reasons;
+        stream.setCallback(&reasons);
+        uint32_t* cr = registers + DMA_STREAM + index * DMA_STREAM_WORDS;
+        for (const Case& c : CASES)
+        {
+            stream.setDoubleBuffer(c.mDoubleBuffer);
+            *cr = c.mCr;
+            cr[DMA_FCR] = c.mFcr;
+            // all the other streams of the register are busy as well
+            uint32_t mine = static_cast<uint32_t>(c.mFlags) << SHIFT[index % 4];
+            uint32_t others = 0;
+            for (unsigned int shift : SHIFT) others |= static_cast<uint32_t>(ALL_FLAGS) << shift;
+            others &= ~(0x3fu << SHIFT[index % 4]);
+            registers[DMA_ISR + index / 4] = mine | others;
+            registers[DMA_ISR + 1 - index / 4] = 0xffffffff;
+            registers[DMA_IFCR] = 0;
+            registers[DMA_IFCR + 1] = 0;
+
+            stream.interruptCallback(0);
+            // only its own flags are cleared
+            EXPECT_EQ(mine, registers[DMA_IFCR + index / 4]) << "stream " << index << " flags " << static_cast<unsigned int>(c.mFlags);
+            EXPECT_EQ(0, registers[DMA_IFCR + 1 - index / 4]);
+            ASSERT_FALSE(reasons.mReasons.empty());
+            EXPECT_EQ(c.mReason, reasons.mReasons.back()) << "stream " << index << " flags " << static_cast<unsigned int>(c.mFlags);
+        }
+        EXPECT_EQ(sizeof(CASES) / sizeof(CASES[0]), reasons.mReasons.size());
+    }
+    delete[] registers;
+}
+
+// the half transfer goes on to the device and doesn't count as an error
+TEST(Dma, halfTransferToDevice)
+{
+    HostSystem system;
+    uint32_t* registers = new uint32_t[SIZE_OF_DMA / 4]();
+    Dma dma(reinterpret_cast<System::BaseAddress>(registers));
+    Dma::Stream write(dma, Dma::Stream::StreamIndex::Stream1, Dma::Stream::ChannelIndex::Channel0, nullptr);
+    Dma::Stream read(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel0, nullptr);
+    Capture capture;
+    capture.configDma(&write, &read);
+
+    // stream 6 has its flags at bit 16 of HISR
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        registers[DMA_ISR + 1] = Dma::HalfTransfer << 16;
+        read.interruptCallback(0);
+        registers[DMA_ISR + 1] = Dma::TransferComplete << 16;
+        read.interruptCallback(0);
+    }
+    registers[DMA_ISR] = Dma::HalfTransfer << 6;
+    write.interruptCallback(0);
+    EXPECT_EQ(3, capture.mHalf);
+    EXPECT_EQ(3, capture.mComplete);
+    EXPECT_EQ(1, capture.mWriteHalf);
+    EXPECT_EQ(0, capture.mWriteComplete);
+    EXPECT_TRUE(capture.reading());
+
+    // a bus error ends it
+    registers[DMA_ISR + 1] = Dma::TransferError << 16;
+    read.interruptCallback(0);
+    EXPECT_FALSE(capture.reading());
+    EXPECT_EQ(4, capture.mComplete);
+    delete[] registers;
+}
+
+// every setting the tuning can come up with has to be allowed by the reference manual
+TEST(Dma, memoryPortLegal)
+{
+    typedef Dma::Stream::DataSize DataSize;
+    typedef Dma::Stream::BurstLength BurstLength;
+    typedef Dma::Stream::FifoThreshold FifoThreshold;
+    // RM0090 table 48, the memory bursts for each memory data size and FIFO threshold
+    static const std::set<std::tuple<DataSize, FifoThreshold, BurstLength> > ALLOWED =
+    {
+        std::make_tuple(DataSize::Byte, FifoThreshold::Quater, BurstLength::Beats4),
+        std::make_tuple(DataSize::Byte, FifoThreshold::Half, BurstLength::Beats4),
+        std::make_tuple(DataSize::Byte, FifoThreshold::Half, BurstLength::Beats8),
+        std::make_tuple(DataSize::Byte, FifoThreshold::ThreeQuater, BurstLength::Beats4),
+        std::make_tuple(DataSize::Byte, FifoThreshold::Full, BurstLength::Beats4),
+        std::make_tuple(DataSize::Byte, FifoThreshold::Full, BurstLength::Beats8),
+        std::make_tuple(DataSize::Byte, FifoThreshold::Full, BurstLength::Beats16),
+        std::make_tuple(DataSize::HalfWord, FifoThreshold::Half, BurstLength::Beats4),
+        std::make_tuple(DataSize::HalfWord, FifoThreshold::Full, BurstLength::Beats4),
+        std::make_tuple(DataSize::HalfWord, FifoThreshold::Full, BurstLength::Beats8),
+        std::make_tuple(DataSize::Word, FifoThreshold::Full, BurstLength::Beats4),
+    };
+    static const unsigned int BEATS[] = { 1, 4, 8, 16 };
+    static const unsigned int COUNTS[] = { 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 24, 31, 32, 48, 64, 100, 255, 256, 1000, 1024, 4096, 65535 };
+    unsigned int bursts = 0;
+    unsigned int packed = 0;
+    for (unsigned int peripheral = 0; peripheral < 3; ++peripheral)
+    {
+        for (uint32_t address = 0x20000000 + (1 << peripheral) * 0x1f8; address < 0x20000400 + 64; address += 1 << peripheral)
+        {
+            for (unsigned int count : COUNTS)
+            {
+                Dma::Stream::MemoryPort port = Dma::Stream::memoryPort(static_cast<DataSize>(peripheral), address, count);
+                unsigned int size = 1 << static_cast<unsigned int>(port.mDataSize);
+                unsigned int bytes = count << peripheral;
+                std::ostringstream where;
+                where << "peripheral " << (1 << peripheral) << " address " << std::hex << address << std::dec << " count " << count;
+                // packing and the alignment of the memory pointer
+                EXPECT_GE(size, 1u << peripheral) << where.str();
+                EXPECT_EQ(0, address % size) << where.str();
+                EXPECT_EQ(0, bytes % size) << where.str();
+                // it can't be wider
+                if (port.mDataSize != DataSize::Word)
+                {
+                    EXPECT_NE(0, (address | bytes) % (size * 2)) << where.str();
+                }
+                if (port.mBurst == BurstLength::Single) continue;
+                EXPECT_EQ(1, ALLOWED.count(std::make_tuple(port.mDataSize, port.mThreshold, port.mBurst))) << where.str();
+                unsigned int burst = BEATS[static_cast<unsigned int>(port.mBurst)] * size;
+                EXPECT_EQ(0, bytes % burst) << where.str();
+                for (uint32_t start = address; start < address + bytes; start += burst)
+                {
+                    ASSERT_EQ(start / 1024, (start + burst - 1) / 1024) << "crosses 1KB, " << where.str();
+                }
+                ++bursts;
+                if (size > (1u << peripheral)) ++packed;
+            }
+        }
+    }
+    // the aligned ones do get them
+    EXPECT_GT(bursts, 0);
+    EXPECT_GT(packed, 0);
+    Dma::Stream::MemoryPort port = Dma::Stream::memoryPort(DataSize::Byte, 0x20000010, 512);
+    EXPECT_EQ(DataSize::Word, port.mDataSize);
+    EXPECT_EQ(BurstLength::Beats4, port.mBurst);
+    EXPECT_EQ(FifoThreshold::Full, port.mThreshold);
+    port = Dma::Stream::memoryPort(DataSize::Byte, 0x20000002, 6);
+    EXPECT_EQ(DataSize::HalfWord, port.mDataSize);
+    EXPECT_EQ(BurstLength::Single, port.mBurst);
+    port = Dma::Stream::memoryPort(DataSize::Byte, 0x20000001, 512);
+    EXPECT_EQ(DataSize::Byte, port.mDataSize);
+    EXPECT_EQ(BurstLength::Single, port.mBurst);
+    port = Dma::Stream::memoryPort(DataSize::Byte, 0x20000008, 8);
+    EXPECT_EQ(DataSize::Word, port.mDataSize);
+    EXPECT_EQ(BurstLength::Single, port.mBurst);
+    port = Dma::Stream::memoryPort(DataSize::Byte, 0x20000004, 4);
+    EXPECT_EQ(DataSize::Word, port.mDataSize);
+    EXPECT_EQ(BurstLength::Single, port.mBurst);
+    port = Dma::Stream::memoryPort(DataSize::HalfWord, 0x20000008, 4);
+    EXPECT_EQ(DataSize::Word, port.mDataSize);
+    EXPECT_EQ(BurstLength::Single, port.mBurst);
+}
+
+// the automatic FIFO sets the memory side at start(), direct mode and fixed thresholds stay as they are
+TEST(Dma, memoryPortStart)
+{
+    HostSystem system;
+    uint32_t* registers = new uint32_t[SIZE_OF_DMA / 4]();
+    Dma dma(reinterpret_cast<System::BaseAddress>(registers));
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream3, Dma::Stream::ChannelIndex::Channel0, nullptr);
+    uint32_t* cr = registers + DMA_STREAM + 3 * DMA_STREAM_WORDS;
+    stream.config(Dma::Stream::Direction::MemoryToPeripheral, false, true, Dma::Stream::DataSize::Byte, Dma::Stream::DataSize::Byte, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
+    stream.configFifo(Dma::Stream::FifoThreshold::Auto);
+    stream.setAddress(Dma::Stream::End::Memory, 0x20000100);
+    stream.setTransferCount(64);
+    stream.start();
+    EXPECT_EQ(CR_DIR_M2P, *cr & (3 << 6));
+    // word, 4 beats, full
+    EXPECT_EQ(2, (*cr >> 13) & 3);
+    EXPECT_EQ(1, (*cr >> 23) & 3);
+    EXPECT_EQ(0, (*cr >> 11) & 3);
+    EXPECT_EQ(FCR_DMDIS | 3, cr[DMA_FCR] & 7);
+    *cr = 0;
+
+    stream.setAddress(Dma::Stream::End::Memory, 0x20000101);
+    stream.setTransferCount(3);
+    stream.start();
+    EXPECT_EQ(0, (*cr >> 13) & 3);
+    EXPECT_EQ(0, (*cr >> 23) & 3);
+    EXPECT_EQ(FCR_DMDIS | 0, cr[DMA_FCR] & 7);
+    *cr = 0;
+
+    // both memories count in double buffer mode
+    stream.setDoubleBuffer(true);
+    stream.setAddress(Dma::Stream::End::Memory0, 0x20000100);
+    stream.setAddress(Dma::Stream::End::Memory1, 0x20000204);
+    stream.setTransferCount(64);
+    stream.start();
+    EXPECT_EQ(2, (*cr >> 13) & 3);
+    EXPECT_EQ(0, (*cr >> 23) & 3);
+    *cr = 0;
+    stream.setDoubleBuffer(false);
+
+    stream.configFifo(Dma::Stream::FifoThreshold::ThreeQuater);
+    stream.setAddress(Dma::Stream::End::Memory, 0x20000100);
+    stream.start();
+    EXPECT_EQ(FCR_DMDIS | 2, cr[DMA_FCR] & 7);
+    *cr = 0;
+
+    stream.config(Dma::Stream::Direction::MemoryToPeripheral, false, true, Dma::Stream::DataSize::Byte, Dma::Stream::DataSize::Byte, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
+    stream.configFifo(Dma::Stream::FifoThreshold::Disable);
+    stream.start();
+    EXPECT_EQ(0, (*cr >> 13) & 3);
+    EXPECT_EQ(0, cr[DMA_FCR] & FCR_DMDIS);
+    delete[] registers;
+}
+
+// a header, the body and a CRC go out without the event loop in between
+TEST(Dma, chain)
+{
+    HostSystem system;
+    Wire wire;
+    Reasons reasons;
+    Segments segments;
+    wire.mStream.setCallback(&reasons);
+    uint8_t* data = new uint8_t[256];
+    for (unsigned int i = 0; i < 256; ++i) data[i] = static_cast<uint8_t>(i);
+    wire.addMemory(data, 256);
+
+    Dma::Stream::Segment crc = { wire.address(data + 200), 4, nullptr, &segments };
+    // no callback for the body
+    Dma::Stream::Segment body = { wire.address(data + 16), 128, &crc, nullptr };
+    Dma::Stream::Segment header = { wire.address(data + 1), 3, &body, &segments };
+    wire.mStream.startChain(&header);
+    while (wire.finish()) { }
+
+    std::vector<uint8_t> expected(data + 1, data + 4);
+    expected.insert(expected.end(), data + 16, data + 144);
+    expected.insert(expected.end(), data + 200, data + 204);
+    EXPECT_EQ(expected, wire.mOut);
+    ASSERT_EQ(3, wire.mHops.size());
+    // started again from the interrupt, each with its own memory side
+    EXPECT_TRUE(wire.mHops[0].mRestarted);
+    EXPECT_TRUE(wire.mHops[1].mRestarted);
+    EXPECT_FALSE(wire.mHops[2].mRestarted);
+    EXPECT_EQ(1, wire.mHops[0].mMemorySize);
+    EXPECT_EQ(4, wire.mHops[1].mMemorySize);
+    EXPECT_EQ(4, wire.mHops[2].mMemorySize);
+    EXPECT_EQ(std::vector<Dma::Stream::Segment*>({ &header, &crc }), segments.mDone);
+    // the stream callback only sees the end
+    ASSERT_EQ(1, reasons.mReasons.size());
+    EXPECT_EQ(Dma::Stream::Callback::Reason::TransferComplete, reasons.mReasons[0]);
+    EXPECT_EQ(4, wire.mStream.transferCount());
+    EXPECT_EQ(0, system.eventQueueUsed(System::Event::Priority::Normal));
+
+    // a plain transfer afterwards
+    wire.mStream.setAddress(Dma::Stream::End::Memory, wire.address(data));
+    wire.mStream.setTransferCount(8);
+    wire.mStream.start();
+    EXPECT_TRUE(wire.finish());
+    EXPECT_FALSE(wire.finish());
+    EXPECT_EQ(2, reasons.mReasons.size());
+    delete[] data;
+}
+
+TEST(Dma, chainError)
+{
+    HostSystem system;
+    Wire wire;
+    Reasons reasons;
+    Segments segments;
+    wire.mStream.setCallback(&reasons);
+    uint8_t* data = new uint8_t[64];
+    wire.addMemory(data, 64);
+    Dma::Stream::Segment third = { wire.address(data + 32), 8, nullptr, &segments };
+    Dma::Stream::Segment second = { wire.address(data + 16), 8, &third, &segments };
+    Dma::Stream::Segment first = { wire.address(data), 8, &second, &segments };
+    wire.mStream.startChain(&first);
+    // half transfers go on to the callback, the segment keeps running
+    wire.mRegisters[DMA_ISR] = Dma::HalfTransfer << 22;
+    wire.mStream.interruptCallback(0);
+    EXPECT_TRUE(wire.finish());
+    EXPECT_TRUE(wire.finish(Dma::TransferError));
+    EXPECT_FALSE(wire.finish());
+    EXPECT_EQ(std::vector<Dma::Stream::Segment*>({ &first }), segments.mDone);
+    EXPECT_EQ(std::vector<Dma::Stream::Callback::Reason>({ Dma::Stream::Callback::Reason::HalfTransfer, Dma::Stream::Callback::Reason::TransferError }), reasons.mReasons);
+
+    // stop() drops the rest as well
+    wire.mStream.startChain(&first);
+    wire.mStream.stop();
+    wire.cr() |= CR_EN;
+    EXPECT_TRUE(wire.finish());
+    EXPECT_FALSE(wire.finish());
+    EXPECT_EQ(Dma::Stream::Callback::Reason::TransferComplete, reasons.mReasons.back());
+    EXPECT_EQ(1, segments.mDone.size());
+    delete[] data;
+}
+
+// restarts the stream from an event, what a driver does without a chain
+class Restart : public Dma::Stream::Callback, public System::Event::Callback
+{
+public:
+    Restart(Dma::Stream& stream, uint32_t address) : mStream(stream), mAddress(address), mLeft(0), mEvent(*this) { }
+
+    virtual void dmaCallback(Dma::Stream* stream, Reason reason) { if (mLeft > 0) System::instance()->postEvent(&mEvent); }
+    virtual void eventCallback(System::Event* event)
+    {
+        --mLeft;
+        mStream.setAddress(Dma::Stream::End::Memory, mAddress);
+        mStream.setTransferCount(16);
+        mStream.start();
+    }
+
+    Dma::Stream& mStream;
+    uint32_t mAddress;
+    unsigned int mLeft;
+    System::Event mEvent;
+};
+
+// host time from the transfer complete interrupt to EN of the next segment, with the chain and through the event loop
+TEST(Dma, chainGap)
+{
+    static const unsigned int SEGMENTS = 10000;
+    HostSystem system;
+    Wire wire;
+    uint8_t* data = new uint8_t[16];
+    wire.addMemory(data, 16);
+    std::vector<Dma::Stream::Segment> chain(SEGMENTS);
+    for (unsigned int i = 0; i < SEGMENTS; ++i) chain[i] = { wire.address(data), 16, i + 1 < SEGMENTS ? &chain[i + 1] : nullptr, nullptr };
+    wire.mStream.startChain(&chain[0]);
+    while (wire.finish()) { }
+    ASSERT_EQ(SEGMENTS, wire.mHops.size());
+    uint64_t chained = wire.mInterruptNs / (SEGMENTS - 1);
+
+    Wire relay;
+    relay.addMemory(data, 16);
+    Restart restart(relay.mStream, relay.address(data));
+    relay.mStream.setCallback(&restart);
+    restart.mLeft = SEGMENTS;
+    restart.eventCallback(nullptr);
+    uint64_t loopNs = 0;
+    while (relay.finish())
+    {
+        if (system.eventQueueUsed(System::Event::Priority::Normal) == 0) continue;
+        System::Event* event;
+        auto dispatched = std::chrono::steady_clock::now();
+        system.waitForEvent(event);
+        system.dispatchEvent(event);
+        loopNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - dispatched).count();
+    }
+    ASSERT_EQ(SEGMENTS, relay.mHops.size());
+    uint64_t looped = (relay.mInterruptNs + loopNs) / (SEGMENTS - 1);
+    std::printf("%u segments: %lu ns from transfer complete to the next start in the interrupt, %lu ns through the event loop (host)\n",
+                SEGMENTS, static_cast<unsigned long>(chained), static_cast<unsigned long>(looped));
+    delete[] data;
+}
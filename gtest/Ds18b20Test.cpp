@@ -0,0 +1,189 @@
+#include "../hw/ds18b20.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#define SIZE_OF_GPIO 0x28
+
+// register words of the GPIO memory
+enum
+{
+    GPIO_IDR = 4,
+    GPIO_BSRR = 6,
+};
+
+// A DS18B20 on the wire, it follows the pin at every busy wait of the driver.
+// The driver changes the pin once per wait, the length of a low pulse tells a reset from a 0 or a 1,
+// the answers (presence, the bits read) are on the wire until the next wait.
+class Sensor : public HostSystem
+{
+public:
+    static const uint32_t PIN = 1 << 4;
+    static const uint64_t CONVERSION_NS = 750000000;
+
+    Sensor() :
+        mPresent(true),
+        mTemp(0),
+        mConvertEnd(0),
+        mConversions(0),
+        mLowSince(0),
+        mBitCount(0),
+        mByte(0),
+        mCommandCount(0),
+        mCommand(0),
+        mSendBit(0)
+    {
+        mGpio[GPIO_IDR] = PIN;
+    }
+
+    virtual void usleep(unsigned int us)
+    {
+        uint32_t bsrr = mGpio[GPIO_BSRR];
+        mGpio[GPIO_BSRR] = 0;
+        // released by us, pulled up
+        mGpio[GPIO_IDR] |= PIN;
+        if (bsrr & (PIN << 16)) mLowSince = ns();
+        else if (bsrr & PIN) released(ns() - mLowSince);
+        HostSystem::usleep(us);
+    }
+
+    uint32_t mGpio[SIZE_OF_GPIO / 4] = { };
+    bool mPresent;
+    int16_t mTemp;
+    uint64_t mConvertEnd;
+    unsigned int mConversions;
+
+private:
+    uint64_t mLowSince;
+    unsigned int mBitCount;
+    uint8_t mByte;
+    unsigned int mCommandCount;
+    uint8_t mCommand;
+    unsigned int mSendBit;
+
+    void released(uint64_t low)
+    {
+        if (!mPresent) return;
+        if (low >= 480000)
+        {
+            mGpio[GPIO_IDR] &= ~PIN;
+            mBitCount = 0;
+            mCommandCount = 0;
+            mCommand = 0;
+            mSendBit = 0;
+            return;
+        }
+        if (mCommand == 0x44)
+        {
+            // read slots get 0 while converting
+            if (ns() < mConvertEnd) mGpio[GPIO_IDR] &= ~PIN;
+        }
+        else if (mCommand == 0xbe)
+        {
+            // the scratchpad starts with the temperature, LSB first
+            if (((static_cast<uint16_t>(mTemp) >> (mSendBit++ % 16)) & 1) == 0) mGpio[GPIO_IDR] &= ~PIN;
+        }
+        else
+        {
+            mByte = (mByte >> 1) | (low < 15000 ? 0x80 : 0);
+            if (++mBitCount < 8) return;
+            mBitCount = 0;
+            // the first one is the ROM command
+            if (++mCommandCount == 2) received(mByte);
+        }
+    }
+
+    void received(uint8_t command)
+    {
+        mCommand = command;
+        if (command == 0x44)
+        {
+            ++mConversions;
+            mConvertEnd = ns() + CONVERSION_NS;
+        }
+    }
+};
+
+const uint32_t Sensor::PIN;
+const uint64_t Sensor::CONVERSION_NS;
+
+class Done : public System::Event::Callback
+{
+public:
+    Done(HostSystem& system) : mSystem(system), mEvent(*this), mCount(0), mTime(0) { }
+
+    HostSystem& mSystem;
+    System::Event mEvent;
+    unsigned int mCount;
+    uint64_t mTime;
+
+    virtual void eventCallback(System::Event* event)
+    {
+        ++mCount;
+        mTime = mSystem.ns();
+    }
+};
+
+TEST(Ds18b20, conversion)
+{
+    Sensor system;
+    system.mTemp = 0x0191;
+    Gpio gpio(reinterpret_cast<System::BaseAddress>(system.mGpio));
+    Gpio::Pin oneWire(gpio, Gpio::Index::Pin4);
+    Ds18b20 sensor(oneWire);
+    Done done(system);
+
+    sensor.measure(&done.mEvent);
+    EXPECT_EQ(1, system.mConversions);
+    system.run(2000000000);
+    ASSERT_EQ(1, done.mCount);
+    EXPECT_EQ(System::Event::Result::DataSuccess, done.mEvent.result());
+    // 25.0625 degrees C
+    EXPECT_EQ(0x0191, sensor.temp());
+    // found done by the first poll after the conversion
+    EXPECT_GE(done.mTime, system.mConvertEnd);
+    EXPECT_LT(done.mTime, system.mConvertEnd + 50000000 + 5000000);
+    // the event loop slept through the conversion, only the bus slots were busy waits
+    EXPECT_LT(system.busyTime(), 10000000);
+
+    system.mTemp = -0x0037;
+    sensor.measure(&done.mEvent);
+    system.run(2000000000);
+    ASSERT_EQ(2, done.mCount);
+    EXPECT_EQ(System::Event::Result::DataSuccess, done.mEvent.result());
+    EXPECT_EQ(-0x0037, sensor.temp());
+}
+
+TEST(Ds18b20, noSensor)
+{
+    Sensor system;
+    system.mPresent = false;
+    Gpio gpio(reinterpret_cast<System::BaseAddress>(system.mGpio));
+    Gpio::Pin oneWire(gpio, Gpio::Index::Pin4);
+    Ds18b20 sensor(oneWire);
+    Done done(system);
+
+    sensor.measure(&done.mEvent);
+    system.run(10000000);
+    ASSERT_EQ(1, done.mCount);
+    EXPECT_EQ(System::Event::Result::DataFail, done.mEvent.result());
+    EXPECT_EQ(0, system.mConversions);
+}
+
+TEST(Ds18b20, conversionTimeout)
+{
+    Sensor system;
+    Gpio gpio(reinterpret_cast<System::BaseAddress>(system.mGpio));
+    Gpio::Pin oneWire(gpio, Gpio::Index::Pin4);
+    Ds18b20 sensor(oneWire);
+    Done done(system);
+
+    sensor.measure(&done.mEvent);
+    // never gets done
+    system.mConvertEnd = ~0ull;
+    system.run(900000000);
+    EXPECT_EQ(0, done.mCount);
+    system.run(200000000);
+    ASSERT_EQ(1, done.mCount);
+    EXPECT_EQ(System::Event::Result::DataFail, done.mEvent.result());
+}
@@ -0,0 +1,261 @@
+#include "HostSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+const unsigned int HostSystem::RCC_SIZE;
+const unsigned int HostSystem::NVIC_SIZE;
+const unsigned int HostSystem::STK_SIZE;
+const unsigned int HostSystem::SCB_SIZE;
+const uint32_t HostSystem::EXTERNAL_CLOCK;
+const unsigned int HostSystem::INTERRUPT_COUNT;
+uint32_t HostSystem::sScb[SCB_SIZE / 4];
+
+// register words of the fake peripherals
+enum
+{
+    SCB_ICSR = 1,
+    NVIC_ISER = 0,
+    NVIC_ICER = 32,
+    STK_CTRL = 0,
+    STK_RELOAD = 1,
+    STK_VAL = 2,
+};
+
+static const uint32_t ICSR_VECTACTIVE = 0x1ff;
+static const uint32_t CTRL_ENABLE = 1 << 0;
+static const uint32_t CTRL_COUNTFLAG = 1 << 16;
+static const uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+HostSystem::Memory::Memory()
+{
+    std::memset(mRcc, 0, sizeof(mRcc));
+    std::memset(mNvic, 0, sizeof(mNvic));
+    std::memset(mStk, 0, sizeof(mStk));
+}
+
+HostSystem::HostSystem() :
+    System(reinterpret_cast<BaseAddress>(sScb)),
+    mMemory(),
+    mRcc(reinterpret_cast<BaseAddress>(mMemory.mRcc), EXTERNAL_CLOCK),
+    mNvic(reinterpret_cast<BaseAddress>(mMemory.mNvic), INTERRUPT_COUNT),
+    mSysTick(reinterpret_cast<BaseAddress>(mMemory.mStk), &mRcc),
+    mNow(0),
+    mRunEnd(NEVER),
+    mRunCount(0),
+    mEndOfRunFor(0),
+    mEndOfRunCount(0),
+    mEndOfRunPosted(false),
+    mEndOfRunCallback(),
+    mEndOfRun(mEndOfRunCallback, Event::Priority::Low),
+    mEventCost(0),
+    mBusyTime(0),
+    mSysTickStart(0),
+    mInInterrupt(false),
+    mCaptureConsole(false)
+{
+    std::memset(mEnabled, 0, sizeof(mEnabled));
+    syncSysTick();
+}
+
+HostSystem::~HostSystem()
+{
+}
+
+void HostSystem::consoleRead(char *msg, unsigned int len)
+{
+    unsigned int typed = std::min(len, static_cast<unsigned int>(mInput.size()));
+    mInput.copy(msg, typed);
+    mInput.erase(0, typed);
+    if (std::fread(msg + typed, 1, len - typed, stdin) != len - typed) std::memset(msg + typed, 0, len - typed);
+}
+
+void HostSystem::consoleWrite(const char *msg, unsigned int len)
+{
+    if (mCaptureConsole) mConsole.append(msg, len);
+    else std::fwrite(msg, 1, len, stdout);
+}
+
+void HostSystem::debugMsg(const char *msg, unsigned int len)
+{
+    consoleWrite(msg, len);
+}
+
+void HostSystem::raiseInterrupt(InterruptController::Index index, uint64_t at)
+{
+    mPending.insert(std::make_pair(at, index));
+}
+
+void HostSystem::advance(uint64_t ns)
+{
+    uint64_t end = mNow + ns;
+    // interrupts don't preempt each other, whatever comes up while in one is handled after it
+    if (!mInInterrupt)
+    {
+        while (handleNext(end))
+        {
+        }
+    }
+    else
+    {
+        syncSysTick();
+    }
+    mNow = end;
+    updateSysTick();
+}
+
+void HostSystem::run(uint64_t ns)
+{
+    mRunEnd = mNow + ns;
+    ++mRunCount;
+    while (mNow <= mRunEnd)
+    {
+        Event* event;
+        if (!waitForEvent(event)) continue;
+        if (event == &mEndOfRun)
+        {
+            ++mEndOfRunCount;
+            mEndOfRunPosted = false;
+            if (mEndOfRunFor == mRunCount) break;
+            continue;
+        }
+        uint64_t start = mNow;
+        dispatchEvent(event);
+        advance(mEventCost);
+        mBusyTime += mNow - start;
+    }
+    mRunEnd = NEVER;
+}
+
+void HostSystem::waitForInterrupt()
+{
+    if (handleNext(mRunEnd)) return;
+    if (mRunEnd == NEVER)
+    {
+        printError("HOST", "Waiting for an interrupt that never comes");
+        std::abort();
+    }
+    // slept until the end of the run
+    if (mNow < mRunEnd) mNow = mRunEnd;
+    updateSysTick();
+    mEndOfRunFor = mRunCount;
+    if (!mEndOfRunPosted)
+    {
+        mEndOfRunPosted = true;
+        postEvent(&mEndOfRun);
+    }
+}
+
+uint64_t HostSystem::sysTickCountNs()
+{
+    // SysTick counts with AHB / 8
+    return 8000000000ull / mRcc.clock(ClockControl::Clock::AHB);
+}
+
+void HostSystem::syncSysTick()
+{
+    uint32_t* stk = mMemory.mStk;
+    // setNextTick() restarts the counter by writing 0, the running counter never shows 0 here
+    if ((stk[STK_CTRL] & CTRL_ENABLE) && stk[STK_VAL] == 0)
+    {
+        mSysTickStart = mNow;
+        stk[STK_VAL] = stk[STK_RELOAD];
+    }
+}
+
+void HostSystem::updateSysTick()
+{
+    syncSysTick();
+    uint32_t* stk = mMemory.mStk;
+    if (!(stk[STK_CTRL] & CTRL_ENABLE)) return;
+    uint64_t counts = (mNow - mSysTickStart) / sysTickCountNs();
+    stk[STK_VAL] = counts < stk[STK_RELOAD] ? stk[STK_RELOAD] - counts : 1;
+}
+
+uint64_t HostSystem::nextSysTick()
+{
+    uint32_t* stk = mMemory.mStk;
+    if (!(stk[STK_CTRL] & CTRL_ENABLE)) return NEVER;
+    return mSysTickStart + (stk[STK_RELOAD] + 1ull) * sysTickCountNs();
+}
+
+void HostSystem::syncNvic()
+{
+    // ISER and ICER are write 1 to set/clear, the state is kept here
+    uint32_t* nvic = mMemory.mNvic;
+    for (unsigned int i = 0; i < sizeof(mEnabled) / sizeof(mEnabled[0]); ++i)
+    {
+        mEnabled[i] |= nvic[NVIC_ISER + i];
+        mEnabled[i] &= ~nvic[NVIC_ICER + i];
+        nvic[NVIC_ISER + i] = 0;
+        nvic[NVIC_ICER + i] = 0;
+    }
+}
+
+bool HostSystem::handleNext(uint64_t end)
+{
+    syncSysTick();
+    syncNvic();
+    uint64_t sysTick = nextSysTick();
+    // disabled interrupts stay pending until they get enabled
+    auto irq = mPending.begin();
+    while (irq != mPending.end() && !(mEnabled[irq->second / 32] & (1 << (irq->second % 32)))) ++irq;
+    uint64_t next = irq != mPending.end() ? irq->first : NEVER;
+    if (sysTick <= next) next = sysTick;
+    if (next == NEVER || next > end) return false;
+
+    if (next > mNow) mNow = next;
+    mInInterrupt = true;
+    if (next == sysTick)
+    {
+        // the counter starts over when it hits 0, even if the handler comes late
+        mSysTickStart = sysTick;
+        mMemory.mStk[STK_CTRL] |= CTRL_COUNTFLAG;
+        updateSysTick();
+        handleSysTick();
+    }
+    else
+    {
+        InterruptController::Index index = irq->second;
+        mPending.erase(irq);
+        sScb[SCB_ICSR] = (sScb[SCB_ICSR] & ~ICSR_VECTACTIVE) | (index + 16);
+        System::handleInterrupt();
+        sScb[SCB_ICSR] &= ~ICSR_VECTACTIVE;
+    }
+    mInInterrupt = false;
+    return true;
+}
+
+void HostConsole::type(const std::string& input)
+{
+    mSystem.type(input);
+    readTrigger();
+}
+
+void HostConsole::readSync()
+{
+    char c;
+    do
+    {
+        mSystem.consoleRead(&c, 1);
+    }   while (Stream<char>::read(c));
+}
+
+void HostConsole::readTrigger()
+{
+    char c;
+    while (mReading && mSystem.typed() > 0)
+    {
+        mSystem.consoleRead(&c, 1);
+        Stream<char>::read(c);
+    }
+}
+
+void HostConsole::writeSync()
+{
+    char c;
+    while (Stream<char>::write(c)) mSystem.consoleWrite(&c, 1);
+}
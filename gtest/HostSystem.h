@@ -0,0 +1,145 @@
+#ifndef HOSTSYSTEM_H
+#define HOSTSYSTEM_H
+
+#include "../System.h"
+#include "../ClockControl.h"
+#include "../InterruptController.h"
+#include "../SysTickControl.h"
+#include "../Stream.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// System for running the event loop and the drivers on the host.
+// Time is virtual, it only moves when the simulation moves it (advance(), run(), usleep() and the cost
+// charged per event), so runs are deterministic. Interrupts get injected at points in virtual time and
+// are handled through System::handleInterrupt() like on the target.
+// RCC, NVIC and SysTick live in plain memory, SysTick is simulated from its registers so SysTickControl
+// and everything built on its timers runs unmodified.
+class HostSystem : public System
+{
+public:
+    HostSystem();
+    virtual ~HostSystem();
+
+    virtual void handleInterrupt(uint32_t index) { mNvic.handle(index); }
+    virtual void consoleRead(char *msg, unsigned int len);
+    virtual void consoleWrite(const char *msg, unsigned int len);
+    virtual void debugMsg(const char *msg, unsigned int len);
+    virtual void handleSysTick() { mSysTick.tick(); }
+    // busy waiting, interrupts keep coming in the meantime
+    virtual void usleep(unsigned int us) { advance(us * 1000ull); }
+    virtual uint64_t ns() { return mNow; }
+    virtual void nspin(uint16_t ns) { advance(ns); }
+
+    void raiseInterrupt(InterruptController::Index index, uint64_t at);
+    void raiseInterrupt(InterruptController::Index index) { raiseInterrupt(index, mNow); }
+    // moves the clock, handling the interrupts and SysTicks on the way
+    void advance(uint64_t ns);
+    // the event loop of main() for ns of virtual time, through waitForEvent() like on the target
+    void run(uint64_t ns);
+    // without the ones that ended a run()
+    uint32_t eventCount() { return System::eventCount() - mEndOfRunCount; }
+    // virtual time each dispatched event takes
+    void setEventCost(uint64_t ns) { mEventCost = ns; }
+    // virtual time run() spent in events, busy waiting included, the rest of the time it was asleep
+    uint64_t busyTime() { return mBusyTime; }
+    // console output is collected in console() instead of going to stdout
+    void setCaptureConsole(bool capture) { mCaptureConsole = capture; }
+    std::string& console() { return mConsole; }
+    // console input, consoleRead() takes it before it waits for stdin
+    void type(const std::string& input) { mInput += input; }
+    unsigned int typed() { return mInput.size(); }
+
+private:
+    static const unsigned int RCC_SIZE = 0x88;
+    static const unsigned int NVIC_SIZE = 0xe04;
+    static const unsigned int STK_SIZE = 0x10;
+    static const unsigned int SCB_SIZE = 0x40;
+    static const uint32_t EXTERNAL_CLOCK = 8000000;
+    static const unsigned int INTERRUPT_COUNT = 82;
+    // the System base class needs it before any member gets constructed
+    static uint32_t sScb[SCB_SIZE / 4];
+
+    struct Memory
+    {
+        uint32_t mRcc[RCC_SIZE / 4];
+        uint32_t mNvic[NVIC_SIZE / 4];
+        uint32_t mStk[STK_SIZE / 4];
+        Memory();
+    }   mMemory;
+
+public:
+    ClockControl mRcc;
+    InterruptController mNvic;
+    SysTickControl mSysTick;
+
+protected:
+    virtual void waitForInterrupt();
+    virtual void setWakeup(uint64_t delay) { mSysTick.wakeup((delay + 999999) / 1000000); }
+
+private:
+    // posted by waitForInterrupt() when run() reached its end without anything else to do
+    class EndOfRun : public Event::Callback
+    {
+    public:
+        virtual void eventCallback(Event* /*event*/) { }
+    };
+
+    uint64_t mNow;
+    uint64_t mRunEnd;
+    uint32_t mRunCount;
+    // the run it was posted for, a run can also end while it is still queued
+    uint32_t mEndOfRunFor;
+    uint32_t mEndOfRunCount;
+    bool mEndOfRunPosted;
+    EndOfRun mEndOfRunCallback;
+    Event mEndOfRun;
+    uint64_t mEventCost;
+    uint64_t mBusyTime;
+    uint64_t mSysTickStart;
+    bool mInInterrupt;
+    bool mCaptureConsole;
+    std::string mConsole;
+    std::string mInput;
+    std::multimap<uint64_t, InterruptController::Index> mPending;
+    uint32_t mEnabled[(INTERRUPT_COUNT + 31) / 32];
+
+    // picks up what the driver wrote to the registers, before the time moves on
+    void syncSysTick();
+    void syncNvic();
+    void updateSysTick();
+    uint64_t nextSysTick();
+    uint64_t sysTickCountNs();
+    // handles the next SysTick or interrupt if it is due not later than end
+    bool handleNext(uint64_t end);
+};
+
+// The console as a Stream, like the UART of the target. Writes go out through consoleWrite() right away,
+// reads get what got type()d, a read that waits for it comes from stdin. Input stays typed until a read wants it.
+class HostConsole : public Stream<char>
+{
+public:
+    HostConsole(HostSystem& system) : mSystem(system), mReading(false) { }
+
+    // hands it to the read that is going on
+    void type(const std::string& input);
+
+protected:
+    virtual void readPrepare() { mReading = true; }
+    virtual void readSync();
+    virtual void readTrigger();
+    virtual void readDone() { mReading = false; }
+
+    virtual void writePrepare() { }
+    virtual void writeSync();
+    virtual void writeTrigger() { writeSync(); }
+    virtual void writeDone() { }
+
+private:
+    HostSystem& mSystem;
+    bool mReading;
+};
+
+#endif // HOSTSYSTEM_H
@@ -0,0 +1,202 @@
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+class Recorder : public System::Event::Callback
+{
+public:
+    Recorder(HostSystem& system) : mSystem(system) { }
+
+    HostSystem& mSystem;
+    std::vector<uint64_t> mTime;
+
+    virtual void eventCallback(System::Event* event) { mTime.push_back(mSystem.ns()); }
+};
+
+// posts its event from the interrupt, like a driver does
+class Peripheral : public InterruptController::Callback
+{
+public:
+    Peripheral(HostSystem& system, InterruptController::Index index, System::Event* event) :
+        mSystem(system),
+        mLine(system.mNvic, index),
+        mEvent(event),
+        mCount(0),
+        mTime(0)
+    {
+        mLine.setCallback(this);
+    }
+
+    HostSystem& mSystem;
+    InterruptController::Line mLine;
+    System::Event* mEvent;
+    unsigned int mCount;
+    uint64_t mTime;
+
+    virtual void interruptCallback(InterruptController::Index index)
+    {
+        ++mCount;
+        mTime = mSystem.ns();
+        mSystem.postEvent(mEvent);
+    }
+};
+
+// keeps the event loop busy by posting itself again
+class Flood : public System::Event::Callback
+{
+public:
+    Flood(HostSystem& system) : mSystem(system), mEvent(*this, System::Event::Priority::Low), mCount(0) { }
+
+    HostSystem& mSystem;
+    System::Event mEvent;
+    unsigned int mCount;
+
+    virtual void eventCallback(System::Event* event)
+    {
+        ++mCount;
+        mSystem.postEvent(&mEvent);
+    }
+};
+
+TEST(HostSystem, usleep)
+{
+    HostSystem system;
+    EXPECT_EQ(system.ns(), system.mSysTick.ns());
+    system.usleep(1500);
+    EXPECT_EQ(1500000, system.ns());
+    // SysTickControl sees the same time through its registers
+    EXPECT_EQ(1500000, system.mSysTick.ns());
+    system.advance(2500000000ull);
+    EXPECT_EQ(2501500000ull, system.ns());
+    EXPECT_EQ(2501500000ull, system.mSysTick.ns());
+}
+
+TEST(HostSystem, repeatingEvent)
+{
+    HostSystem system;
+    Recorder recorder(system);
+    SysTickControl::RepeatingEvent event(recorder, 10);
+    system.mSysTick.addRepeatingEvent(&event);
+    system.run(1000000000);
+    ASSERT_EQ(100, recorder.mTime.size());
+    for (unsigned int i = 0; i < recorder.mTime.size(); ++i) EXPECT_EQ((i + 1) * 10000000ull, recorder.mTime[i]);
+    EXPECT_EQ(100, system.eventCount());
+    system.mSysTick.removeRepeatingEvent(&event);
+    system.run(1000000000);
+    EXPECT_EQ(100, recorder.mTime.size());
+}
+
+TEST(HostSystem, timerShortensTick)
+{
+    HostSystem system;
+    Recorder slow(system);
+    Recorder fast(system);
+    SysTickControl::RepeatingEvent slowEvent(slow, 500);
+    SysTickControl::TimerEvent fastEvent(fast);
+    system.mSysTick.addRepeatingEvent(&slowEvent);
+    system.run(100000000);
+    // the programmed tick is 400ms away, the timer has to cut it short
+    system.mSysTick.addTimer(&fastEvent, 3);
+    system.run(900000000);
+    ASSERT_EQ(1, fast.mTime.size());
+    EXPECT_EQ(103000000, fast.mTime[0]);
+    ASSERT_EQ(2, slow.mTime.size());
+    EXPECT_EQ(500000000, slow.mTime[0]);
+    EXPECT_EQ(1000000000, slow.mTime[1]);
+    system.mSysTick.removeRepeatingEvent(&slowEvent);
+}
+
+TEST(HostSystem, interrupt)
+{
+    HostSystem system;
+    Recorder recorder(system);
+    System::Event event(recorder);
+    Peripheral device(system, 5, &event);
+
+    // stays pending while the line is disabled
+    system.raiseInterrupt(5, 2500000);
+    system.run(5000000);
+    EXPECT_EQ(0, device.mCount);
+    device.mLine.enable();
+    system.run(1000000);
+    EXPECT_EQ(1, device.mCount);
+    EXPECT_EQ(5000000, device.mTime);
+
+    system.raiseInterrupt(5, 8000000);
+    system.run(10000000);
+    EXPECT_EQ(2, device.mCount);
+    EXPECT_EQ(8000000, device.mTime);
+    ASSERT_EQ(2, recorder.mTime.size());
+    EXPECT_EQ(5000000, recorder.mTime[0]);
+    EXPECT_EQ(8000000, recorder.mTime[1]);
+    EXPECT_EQ(2, system.interruptCount());
+}
+
+TEST(HostSystem, latencyUnderFlood)
+{
+    static const uint64_t EVENT_COST = 1000000;
+    HostSystem system;
+    system.setEventCost(EVENT_COST);
+    Flood flood(system);
+    Recorder recorder(system);
+    System::Event event(recorder, System::Event::Priority::High);
+    Peripheral device(system, 7, &event);
+    device.mLine.enable();
+
+    for (unsigned int i = 0; i < 10; ++i) system.postEvent(&flood.mEvent);
+    for (uint64_t at = 10200000; at < 100000000; at += 10000000) system.raiseInterrupt(7, at);
+    system.run(100000000);
+
+    ASSERT_EQ(9, recorder.mTime.size());
+    // the interrupt comes in while a low priority event runs, the high one is next in line after it
+    for (unsigned int i = 0; i < recorder.mTime.size(); ++i) EXPECT_EQ(11000000 + i * 10000000ull, recorder.mTime[i]);
+    EXPECT_GT(flood.mCount, 80);
+}
+
+TEST(HostSystem, postEventAt)
+{
+    HostSystem system;
+    Recorder recorder(system);
+    System::Event first(recorder);
+    System::Event second(recorder);
+    System::Event cancelled(recorder);
+    system.postEventAfter(&second, 2500000);
+    system.postEventAt(&first, 1200000);
+    system.postEventAt(&cancelled, 1500000);
+    EXPECT_TRUE(system.cancelEvent(&cancelled));
+    EXPECT_FALSE(system.cancelEvent(&cancelled));
+    system.run(10000000);
+
+    // woken up by the tick on the next ms boundary, never early
+    ASSERT_EQ(2, recorder.mTime.size());
+    EXPECT_EQ(2000000, recorder.mTime[0]);
+    EXPECT_EQ(3000000, recorder.mTime[1]);
+    EXPECT_EQ(2, system.eventCount());
+    EXPECT_EQ(0, system.busyTime());
+
+    // posting it again moves it
+    system.postEventAfter(&first, 5000000);
+    system.postEventAfter(&first, 1000000);
+    system.run(10000000);
+    ASSERT_EQ(3, recorder.mTime.size());
+    EXPECT_EQ(11000000, recorder.mTime[2]);
+}
+
+TEST(HostSystem, postEventAtWhileBusy)
+{
+    static const uint64_t EVENT_COST = 300000;
+    HostSystem system;
+    system.setEventCost(EVENT_COST);
+    Flood flood(system);
+    Recorder recorder(system);
+    System::Event event(recorder, System::Event::Priority::High);
+    system.postEvent(&flood.mEvent);
+    system.postEventAt(&event, 1000000);
+    system.run(5000000);
+
+    // picked up by the loop between the events, without a tick
+    ASSERT_EQ(1, recorder.mTime.size());
+    EXPECT_EQ(1200000, recorder.mTime[0]);
+}
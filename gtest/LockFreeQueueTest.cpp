@@ -0,0 +1,178 @@
+#include "../LockFreeQueue.h"
+#include "../System.h"
+#include "../CircularBuffer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <x86intrin.h>
+
+#define QUEUE_SIZE 64
+#define PRODUCER_COUNT 4
+#define POST_COUNT 100000
+
+TEST(LockFreeQueue, pushPop)
+{
+    LockFreeQueue<uint32_t> queue(QUEUE_SIZE);
+    uint32_t value;
+    EXPECT_FALSE(queue.pop(value));
+    // go around a few times
+    for (unsigned int round = 0; round < 5; ++round)
+    {
+        for (uint32_t i = 0; i < QUEUE_SIZE; ++i)
+        {
+            EXPECT_EQ(i, queue.used());
+            EXPECT_TRUE(queue.push(round * QUEUE_SIZE + i)) << "Could not push enough elements";
+        }
+        EXPECT_FALSE(queue.push(0)) << "Could push too much elements";
+        EXPECT_EQ(0, queue.free());
+        for (uint32_t i = 0; i < QUEUE_SIZE; ++i)
+        {
+            EXPECT_TRUE(queue.pop(value));
+            EXPECT_EQ(round * QUEUE_SIZE + i, value);
+        }
+        EXPECT_FALSE(queue.pop(value));
+        EXPECT_EQ(0, queue.used());
+    }
+}
+
+static void produce(LockFreeQueue<uint32_t>* queue, uint32_t id)
+{
+    for (uint32_t i = 0; i < POST_COUNT; ++i)
+    {
+        while (!queue->push((id << 24) | i)) std::this_thread::yield();
+    }
+}
+
+TEST(LockFreeQueue, multipleProducer)
+{
+    LockFreeQueue<uint32_t> queue(QUEUE_SIZE);
+    std::vector<std::thread> producer;
+    for (uint32_t id = 0; id < PRODUCER_COUNT; ++id) producer.push_back(std::thread(produce, &queue, id));
+
+    uint32_t next[PRODUCER_COUNT] = { 0 };
+    unsigned int received = 0;
+    while (received < PRODUCER_COUNT * POST_COUNT)
+    {
+        uint32_t value;
+        if (!queue.pop(value))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t id = value >> 24;
+        ASSERT_LT(id, PRODUCER_COUNT);
+        // every producer's elements have to arrive complete and in order
+        ASSERT_EQ(next[id], value & 0xffffff);
+        ++next[id];
+        ++received;
+    }
+    for (std::thread& t : producer) t.join();
+    uint32_t value;
+    EXPECT_FALSE(queue.pop(value));
+    EXPECT_EQ(0, queue.used());
+}
+
+// On the target the old postEvent disabled all interrupts around CircularBuffer::push, on the host a mutex
+// stands in for that, as it is the only way to keep the other producers out.
+static std::mutex gMaskMutex;
+
+static void produceMasked(CircularBuffer<System::Event*>* queue, System::Event* event, uint64_t* cycles)
+{
+    uint64_t start = __rdtsc();
+    for (uint32_t i = 0; i < POST_COUNT; ++i)
+    {
+        while (true)
+        {
+            gMaskMutex.lock();
+            bool ok = queue->push(event);
+            gMaskMutex.unlock();
+            if (ok) break;
+            std::this_thread::yield();
+        }
+    }
+    *cycles = __rdtsc() - start;
+}
+
+static void produceLockFree(LockFreeQueue<System::Event*>* queue, System::Event* event, uint64_t* cycles)
+{
+    uint64_t start = __rdtsc();
+    for (uint32_t i = 0; i < POST_COUNT; ++i)
+    {
+        while (!queue->push(event)) std::this_thread::yield();
+    }
+    *cycles = __rdtsc() - start;
+}
+
+class NullCallback : public System::Event::Callback
+{
+public:
+    virtual void eventCallback(System::Event* event) { }
+};
+
+TEST(LockFreeQueue, benchmark)
+{
+    NullCallback callback;
+    System::Event event(callback);
+    uint64_t masked[PRODUCER_COUNT];
+    uint64_t lockFree[PRODUCER_COUNT];
+    System::Event* out;
+
+    // uncontended cost of a single post and dispatch
+    CircularBuffer<System::Event*> buffer(QUEUE_SIZE);
+    LockFreeQueue<System::Event*> queue(QUEUE_SIZE);
+    uint64_t start = __rdtsc();
+    for (uint32_t i = 0; i < POST_COUNT; ++i)
+    {
+        gMaskMutex.lock();
+        buffer.push(&event);
+        gMaskMutex.unlock();
+        buffer.pop(out);
+    }
+    uint64_t maskedSingle = __rdtsc() - start;
+    start = __rdtsc();
+    for (uint32_t i = 0; i < POST_COUNT; ++i)
+    {
+        queue.push(&event);
+        queue.pop(out);
+    }
+    uint64_t lockFreeSingle = __rdtsc() - start;
+    std::printf("single producer: masked %lu cycles, lock free %lu cycles per post\n",
+                static_cast<unsigned long>(maskedSingle / POST_COUNT), static_cast<unsigned long>(lockFreeSingle / POST_COUNT));
+
+    // contended, the consumer drains as fast as it can
+    std::vector<std::thread> producer;
+    for (unsigned int id = 0; id < PRODUCER_COUNT; ++id) producer.push_back(std::thread(produceMasked, &buffer, &event, &masked[id]));
+    for (unsigned int received = 0; received < PRODUCER_COUNT * POST_COUNT; )
+    {
+        gMaskMutex.lock();
+        bool ok = buffer.pop(out);
+        gMaskMutex.unlock();
+        if (ok) ++received;
+        else std::this_thread::yield();
+    }
+    for (std::thread& t : producer) t.join();
+    producer.clear();
+    for (unsigned int id = 0; id < PRODUCER_COUNT; ++id) producer.push_back(std::thread(produceLockFree, &queue, &event, &lockFree[id]));
+    for (unsigned int received = 0; received < PRODUCER_COUNT * POST_COUNT; )
+    {
+        if (queue.pop(out)) ++received;
+        else std::this_thread::yield();
+    }
+    for (std::thread& t : producer) t.join();
+
+    uint64_t maskedTotal = 0;
+    uint64_t lockFreeTotal = 0;
+    for (unsigned int id = 0; id < PRODUCER_COUNT; ++id)
+    {
+        maskedTotal += masked[id];
+        lockFreeTotal += lockFree[id];
+    }
+    std::printf("%u producers: masked %lu cycles, lock free %lu cycles per post\n", PRODUCER_COUNT,
+                static_cast<unsigned long>(maskedTotal / (PRODUCER_COUNT * POST_COUNT)), static_cast<unsigned long>(lockFreeTotal / (PRODUCER_COUNT * POST_COUNT)));
+    EXPECT_EQ(0, queue.used());
+    EXPECT_EQ(0, buffer.used());
+}
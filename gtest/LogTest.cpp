@@ -0,0 +1,218 @@
+#include "../Log.h"
+#include "../tools/LogDecoder.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <string>
+#include <vector>
+#include <x86intrin.h>
+
+// the linker puts them around the section, like the linker script of the firmware does for others
+extern const char __start_logstr[];
+extern const char __stop_logstr[];
+
+static uint32_t gLogCycles;
+
+// what the log command writes, with console output around it
+static std::vector<char> dump(Log& log, uint32_t clock)
+{
+    static const char PROMPT[] = "> log\n";
+    std::vector<char> data(PROMPT, PROMPT + sizeof(PROMPT) - 1);
+    Log::Header header;
+    log.header(header, clock, log.available());
+    const char* p = reinterpret_cast<const char*>(&header);
+    data.insert(data.end(), p, p + sizeof(header));
+    uint32_t buffer[16];
+    unsigned int len;
+    while ((len = log.read(buffer, 16)) != 0)
+    {
+        p = reinterpret_cast<const char*>(buffer);
+        data.insert(data.end(), p, p + len * sizeof(buffer[0]));
+    }
+    static const char DONE[] = "\n42 words, 0 lost.\n";
+    data.insert(data.end(), DONE, DONE + sizeof(DONE) - 1);
+    return data;
+}
+
+static void setStrings(LogDecoder& decoder)
+{
+    decoder.setStrings(__start_logstr, __stop_logstr - __start_logstr, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__start_logstr)));
+}
+
+TEST(Log, roundTrip)
+{
+    Log* log = new Log;
+    log->setCounter(&gLogCycles);
+    // starts right before the counter wraps
+    gLogCycles = 0xfffff000;
+    LOG_TO(*log, Log::Level::Info, "started\n");
+    gLogCycles += 0x2000;
+    LOG_TO(*log, Log::Level::Error, "I2C: error %d on %u, SR1 %04x %#X", -5, 7u, 0xbeefu, 255u);
+    LOG_TO(*log, Log::Level::Warning, "%lld %llu %5d|%-5d|%*d|", -1234567890123ll, 0xfedcba9876543210ull, 42, 42, 4, 7);
+    LOG_TO(*log, Log::Level::Debug, "%.3f %e %g %c%c 100%%", 3.14159, -2.5e-7, 1.0f, 'o', 'k');
+    LOG_TO(*log, Log::Level::Info, "%s", "on the STM32");
+    EXPECT_EQ(0, log->lost());
+
+    std::vector<char> data = dump(*log, 168000000);
+    EXPECT_EQ(0, log->available());
+    LogDecoder decoder;
+    setStrings(decoder);
+    ASSERT_TRUE(decoder.decode(data.data(), data.size()));
+    EXPECT_EQ(168000000, decoder.clock());
+    EXPECT_EQ(0, decoder.lost());
+    const std::vector<LogDecoder::Entry>& entries = decoder.entries();
+    ASSERT_EQ(5, entries.size());
+    EXPECT_EQ(Log::Level::Info, entries[0].mLevel);
+    EXPECT_EQ(Log::Level::Error, entries[1].mLevel);
+    EXPECT_EQ(Log::Level::Debug, entries[3].mLevel);
+    EXPECT_EQ(0, entries[0].mCycles);
+    EXPECT_EQ(0x2000, entries[1].mCycles);
+
+    char expected[128];
+    EXPECT_EQ("started", entries[0].mText);
+    std::snprintf(expected, sizeof(expected), "I2C: error %d on %u, SR1 %04x %#X", -5, 7u, 0xbeefu, 255u);
+    EXPECT_EQ(expected, entries[1].mText);
+    std::snprintf(expected, sizeof(expected), "%lld %llu %5d|%-5d|%*d|", -1234567890123ll, 0xfedcba9876543210ull, 42, 42, 4, 7);
+    EXPECT_EQ(expected, entries[2].mText);
+    std::snprintf(expected, sizeof(expected), "%.3f %e %g %c%c 100%%", 3.14159, -2.5e-7, 1.0f, 'o', 'k');
+    EXPECT_EQ(expected, entries[3].mText);
+    EXPECT_EQ(0, entries[4].mText.find("<string 0x"));
+
+    char* buffer = nullptr;
+    std::size_t size = 0;
+    FILE* out = open_memstream(&buffer, &size);
+    decoder.write(out);
+    std::fclose(out);
+    std::string text(buffer, size);
+    std::free(buffer);
+    EXPECT_NE(std::string::npos, text.find("[      48.762] E I2C: error -5 on 7, SR1 beef 0XFF\n"));
+
+    // cut off, and without the format strings
+    EXPECT_FALSE(decoder.decode(data.data(), data.size() - 30));
+    LogDecoder unknown;
+    ASSERT_TRUE(unknown.decode(data.data(), data.size()));
+    EXPECT_EQ(0, unknown.entries()[0].mText.find("<unknown format 0x"));
+    delete log;
+}
+
+TEST(Log, full)
+{
+    Log* log = new Log;
+    unsigned int count = 0;
+    // 3 words each
+    while (log->lost() == 0)
+    {
+        LOG_TO(*log, Log::Level::Info, "record %u", count);
+        ++count;
+    }
+    EXPECT_EQ(Log::SIZE / 4 + 1, count);
+    EXPECT_EQ(Log::SIZE / 4 * 4, log->available());
+
+    // only whole records come out, and they make room
+    uint32_t data[10];
+    EXPECT_EQ(8, log->read(data, 10));
+    EXPECT_EQ(0, data[Log::RECORD_WORDS]);
+    EXPECT_EQ(1, data[4 + Log::RECORD_WORDS]);
+    LOG_TO(*log, Log::Level::Info, "record %u", count);
+    LOG_TO(*log, Log::Level::Info, "record %u", count + 1);
+    LOG_TO(*log, Log::Level::Info, "record %u", count + 2);
+    EXPECT_EQ(2, log->lost());
+
+    std::vector<char> dumped = dump(*log, 1000000);
+    LogDecoder decoder;
+    setStrings(decoder);
+    ASSERT_TRUE(decoder.decode(dumped.data(), dumped.size()));
+    EXPECT_EQ(2, decoder.lost());
+    ASSERT_EQ(Log::SIZE / 4, decoder.entries().size());
+    EXPECT_EQ("record 2", decoder.entries().front().mText);
+    char expected[32];
+    std::sprintf(expected, "record %u", count + 1);
+    EXPECT_EQ(expected, decoder.entries().back().mText);
+    delete log;
+}
+
+// the format strings from a firmware image, with the section at address 0 like the linker script does it
+TEST(Log, readElf)
+{
+    static const char NAMES[] = "\0.shstrtab\0logstr\0";
+    static const char STRINGS[] = "first\0second %u\0";
+    std::vector<char> elf(sizeof(Elf32_Ehdr) + sizeof(NAMES) + sizeof(STRINGS));
+    Elf32_Ehdr header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS32;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_machine = EM_ARM;
+    header.e_shoff = elf.size();
+    header.e_shentsize = sizeof(Elf32_Shdr);
+    header.e_shnum = 3;
+    header.e_shstrndx = 1;
+    std::memcpy(elf.data(), &header, sizeof(header));
+    std::memcpy(elf.data() + sizeof(header), NAMES, sizeof(NAMES));
+    std::memcpy(elf.data() + sizeof(header) + sizeof(NAMES), STRINGS, sizeof(STRINGS));
+    Elf32_Shdr sections[3];
+    std::memset(sections, 0, sizeof(sections));
+    sections[1].sh_name = 1;
+    sections[1].sh_type = SHT_STRTAB;
+    sections[1].sh_offset = sizeof(header);
+    sections[1].sh_size = sizeof(NAMES);
+    sections[2].sh_name = 11;
+    sections[2].sh_type = SHT_PROGBITS;
+    sections[2].sh_offset = sizeof(header) + sizeof(NAMES);
+    sections[2].sh_size = sizeof(STRINGS);
+    const char* p = reinterpret_cast<const char*>(sections);
+    elf.insert(elf.end(), p, p + sizeof(sections));
+
+    LogDecoder decoder;
+    EXPECT_FALSE(decoder.readElf(elf.data(), elf.size() - 1));
+    ASSERT_TRUE(decoder.readElf(elf.data(), elf.size()));
+    Log::Header dumpHeader = { { 'L', 'O', 'G', '1' }, 1000000, 2 * Log::RECORD_WORDS + 1, 0 };
+    const uint32_t records[] = { Log::recordHeader(Log::Level::Info, 0), 0, 100, Log::recordHeader(Log::Level::Warning, 1), 6, 300, 12 };
+    std::vector<char> data(reinterpret_cast<const char*>(&dumpHeader), reinterpret_cast<const char*>(&dumpHeader) + sizeof(dumpHeader));
+    data.insert(data.end(), reinterpret_cast<const char*>(records), reinterpret_cast<const char*>(records) + sizeof(records));
+    ASSERT_TRUE(decoder.decode(data.data(), data.size()));
+    ASSERT_EQ(2, decoder.entries().size());
+    EXPECT_EQ("first", decoder.entries()[0].mText);
+    EXPECT_EQ("second 12", decoder.entries()[1].mText);
+    EXPECT_EQ(200, decoder.entries()[1].mCycles);
+}
+
+// what a driver would print, formatted right away against stored for the host
+TEST(Log, benchmark)
+{
+    static const unsigned int ROUND_COUNT = 2000;
+    static const unsigned int BATCH = 100;
+    Log* log = new Log;
+    char text[128];
+    unsigned int textSize = 0;
+    uint32_t words[Log::SIZE];
+    uint64_t logCycles = 0;
+    uint64_t printfCycles = 0;
+    for (unsigned int round = 0; round < ROUND_COUNT; ++round)
+    {
+        uint64_t start = __rdtsc();
+        for (unsigned int i = 0; i < BATCH; ++i)
+        {
+            LOG_TO(*log, Log::Level::Warning, "SDIO: CMD%u(%08x) failed, status %08x after %u us", i & 0x3f, round, 0x400 + i, i * 3);
+        }
+        logCycles += __rdtsc() - start;
+        // read out like the log command does, the UART sends it later
+        EXPECT_EQ(BATCH * 7, log->read(words, Log::SIZE));
+
+        start = __rdtsc();
+        for (unsigned int i = 0; i < BATCH; ++i)
+        {
+            textSize += std::snprintf(text, sizeof(text), "SDIO: CMD%u(%08x) failed, status %08x after %u us", i & 0x3f, round, 0x400 + i, i * 3);
+        }
+        printfCycles += __rdtsc() - start;
+    }
+    EXPECT_EQ(0, log->lost());
+    unsigned int calls = ROUND_COUNT * BATCH;
+    std::printf("%u calls: log %lu cycles and 28 bytes, snprintf %lu cycles and %u bytes per call\n", calls,
+                static_cast<unsigned long>(logCycles / calls), static_cast<unsigned long>(printfCycles / calls), textSize / calls);
+    EXPECT_LT(logCycles, printfCycles);
+    delete log;
+}
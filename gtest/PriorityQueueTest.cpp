@@ -0,0 +1,242 @@
+#include "../PriorityQueue.h"
+#include "../System.h"
+#include "../CircularBuffer.h"
+// the template code, for the probe type of the test
+#include "../LockFreeQueue.cpp"
+#include "../PriorityQueue.cpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <random>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
+#define QUEUE_SIZE 128
+#define MAX_SKIP 16
+
+typedef PriorityQueue<System::Event*, System::Event::PRIORITY_COUNT> EventQueue;
+
+class DummyCallback : public System::Event::Callback
+{
+public:
+    virtual void eventCallback(System::Event* event) { }
+};
+
+static DummyCallback gCallback;
+
+static unsigned int index(System::Event::Priority priority)
+{
+    return static_cast<unsigned int>(priority);
+}
+
+TEST(PriorityQueue, order)
+{
+    EventQueue queue(QUEUE_SIZE, MAX_SKIP);
+    System::Event low(gCallback, System::Event::Priority::Low);
+    System::Event normal(gCallback);
+    System::Event high(gCallback, System::Event::Priority::High);
+    EXPECT_EQ(System::Event::Priority::Normal, normal.priority());
+
+    EXPECT_TRUE(queue.push(&low, index(low.priority())));
+    EXPECT_TRUE(queue.push(&normal, index(normal.priority())));
+    EXPECT_TRUE(queue.push(&high, index(high.priority())));
+    EXPECT_EQ(3, queue.used());
+
+    System::Event* event;
+    EXPECT_TRUE(queue.pop(event));
+    EXPECT_EQ(&high, event);
+    EXPECT_TRUE(queue.pop(event));
+    EXPECT_EQ(&normal, event);
+    EXPECT_TRUE(queue.pop(event));
+    EXPECT_EQ(&low, event);
+    EXPECT_FALSE(queue.pop(event));
+    EXPECT_EQ(0, queue.used());
+}
+
+TEST(PriorityQueue, fifoInClass)
+{
+    EventQueue queue(QUEUE_SIZE, MAX_SKIP);
+    System::Event* events[10];
+    for (unsigned int i = 0; i < ARRAY_SIZE(events); ++i)
+    {
+        events[i] = new System::Event(gCallback);
+        EXPECT_TRUE(queue.push(events[i], index(System::Event::Priority::Normal)));
+    }
+    for (unsigned int i = 0; i < ARRAY_SIZE(events); ++i)
+    {
+        System::Event* event;
+        EXPECT_TRUE(queue.pop(event));
+        EXPECT_EQ(events[i], event);
+        delete events[i];
+    }
+}
+
+// Pops from the queue while its own push has claimed the slot and not published it yet, like another
+// core would.
+struct Probe
+{
+    static PriorityQueue<Probe, 2>* sQueue;
+    static bool sArmed;
+    static bool sPopped;
+    static unsigned int sValue;
+
+    unsigned int mValue;
+
+    Probe& operator=(const Probe& other)
+    {
+        mValue = other.mValue;
+        if (sArmed)
+        {
+            sArmed = false;
+            Probe elem;
+            sPopped = sQueue->pop(elem);
+            sValue = elem.mValue;
+        }
+        return *this;
+    }
+};
+
+PriorityQueue<Probe, 2>* Probe::sQueue;
+bool Probe::sArmed;
+bool Probe::sPopped;
+unsigned int Probe::sValue;
+
+TEST(PriorityQueue, unpublishedClass)
+{
+    PriorityQueue<Probe, 2> queue(QUEUE_SIZE, MAX_SKIP);
+    Probe::sQueue = &queue;
+    Probe low;
+    low.mValue = 2;
+    EXPECT_TRUE(queue.push(low, 1));
+    Probe high;
+    high.mValue = 1;
+    Probe::sArmed = true;
+    EXPECT_TRUE(queue.push(high, 0));
+    // the high class looked used, the low one was served instead
+    EXPECT_TRUE(Probe::sPopped);
+    EXPECT_EQ(2u, Probe::sValue);
+
+    Probe elem;
+    EXPECT_TRUE(queue.pop(elem));
+    EXPECT_EQ(1u, elem.mValue);
+    EXPECT_FALSE(queue.pop(elem));
+}
+
+TEST(PriorityQueue, statistic)
+{
+    EventQueue queue(QUEUE_SIZE, MAX_SKIP);
+    System::Event low(gCallback, System::Event::Priority::Low);
+    for (unsigned int i = 0; i < QUEUE_SIZE; ++i)
+    {
+        EXPECT_TRUE(queue.push(&low, index(low.priority())));
+    }
+    EXPECT_FALSE(queue.push(&low, index(low.priority())));
+    EXPECT_FALSE(queue.push(&low, index(low.priority())));
+    EXPECT_EQ(QUEUE_SIZE, queue.used(index(System::Event::Priority::Low)));
+    EXPECT_EQ(QUEUE_SIZE, queue.maxUsed(index(System::Event::Priority::Low)));
+    EXPECT_EQ(2, queue.overflow(index(System::Event::Priority::Low)));
+    EXPECT_EQ(0, queue.used(index(System::Event::Priority::High)));
+    EXPECT_EQ(0, queue.overflow(index(System::Event::Priority::High)));
+
+    System::Event* event;
+    EXPECT_TRUE(queue.pop(event));
+    queue.resetStatistic();
+    EXPECT_EQ(QUEUE_SIZE - 1, queue.maxUsed(index(System::Event::Priority::Low)));
+    EXPECT_EQ(0, queue.overflow(index(System::Event::Priority::Low)));
+}
+
+TEST(PriorityQueue, starvation)
+{
+    EventQueue queue(QUEUE_SIZE, MAX_SKIP);
+    System::Event low(gCallback, System::Event::Priority::Low);
+    System::Event high(gCallback, System::Event::Priority::High);
+    EXPECT_TRUE(queue.push(&low, index(low.priority())));
+    unsigned int dispatched = 0;
+    System::Event* event = nullptr;
+    // keep the high queue busy all the time, the low event still has to come through
+    while (event != &low)
+    {
+        EXPECT_TRUE(queue.push(&high, index(high.priority())));
+        EXPECT_TRUE(queue.pop(event));
+        ++dispatched;
+        ASSERT_LE(dispatched, MAX_SKIP + 1);
+    }
+    EXPECT_EQ(MAX_SKIP + 1, dispatched);
+}
+
+// Simulates a flood of low and normal priority events (console characters, repeating events) with the
+// occasional high priority event in between. Each dispatched event runs for 1..20us, a high priority event
+// posted while a handler runs has to wait for the end of it plus everything the queue serves first.
+static uint64_t floodLatency(bool prioritized, unsigned int& lost)
+{
+    static const unsigned int DISPATCH_COUNT = 100000;
+    EventQueue queue(QUEUE_SIZE, MAX_SKIP);
+    CircularBuffer<System::Event*> fifo(QUEUE_SIZE);
+    System::Event low(gCallback, System::Event::Priority::Low);
+    System::Event normal(gCallback, System::Event::Priority::Normal);
+    System::Event high(gCallback, System::Event::Priority::High);
+
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<int> lowBurst(0, 3);
+    std::uniform_int_distribution<int> normalBurst(0, 1);
+    std::uniform_int_distribution<int> highChance(0, 49);
+    std::uniform_int_distribution<int> handlerNs(1000, 20000);
+
+    uint64_t now = 0;
+    uint64_t running = 0;
+    uint64_t highPosted = 0;
+    bool highPending = false;
+    uint64_t worst = 0;
+    lost = 0;
+    for (unsigned int i = 0; i < DISPATCH_COUNT; ++i)
+    {
+        System::Event* posted[8];
+        unsigned int count = 0;
+        for (int n = lowBurst(generator); n > 0; --n) posted[count++] = &low;
+        for (int n = normalBurst(generator); n > 0; --n) posted[count++] = &normal;
+        if (!highPending && highChance(generator) == 0) posted[count++] = &high;
+        for (unsigned int n = 0; n < count; ++n)
+        {
+            bool ok = prioritized ? queue.push(posted[n], index(posted[n]->priority())) : fifo.push(posted[n]);
+            if (posted[n] == &high)
+            {
+                if (ok)
+                {
+                    // posted by an interrupt somewhere during the previous handler
+                    highPending = true;
+                    highPosted = now - std::uniform_int_distribution<uint64_t>(0, running)(generator);
+                }
+                else ++lost;
+            }
+        }
+
+        System::Event* event;
+        if (prioritized ? queue.pop(event) : fifo.pop(event))
+        {
+            if (event == &high)
+            {
+                worst = std::max(worst, now - highPosted);
+                highPending = false;
+            }
+            running = handlerNs(generator);
+            now += running;
+        }
+    }
+    return worst;
+}
+
+TEST(PriorityQueue, highLatencyUnderFlood)
+{
+    unsigned int fifoLost;
+    unsigned int prioLost;
+    uint64_t fifo = floodLatency(false, fifoLost);
+    uint64_t prio = floodLatency(true, prioLost);
+    std::printf("worst high priority dispatch latency: single fifo %luus (%u lost), priority queue %luus (%u lost)\n",
+                static_cast<unsigned long>(fifo / 1000), fifoLost, static_cast<unsigned long>(prio / 1000), prioLost);
+    // a pending high event waits for the running handler and at most one starved event of each lower class
+    EXPECT_LE(prio, System::Event::PRIORITY_COUNT * 20000u);
+    EXPECT_GT(prio, 0u);
+    EXPECT_EQ(0, prioLost);
+    EXPECT_LT(prio, fifo);
+}
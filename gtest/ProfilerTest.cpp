@@ -0,0 +1,99 @@
+#include "../Profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+TEST(Profiler, bucket)
+{
+    EXPECT_EQ(0, Profiler::bucket(0));
+    EXPECT_EQ(0, Profiler::bucket(Profiler::bucketLimit(0) - 1));
+    for (unsigned int i = 1; i < Profiler::HISTOGRAM_SIZE; ++i)
+    {
+        EXPECT_EQ(i, Profiler::bucket(Profiler::bucketLimit(i - 1)));
+        EXPECT_EQ(i, Profiler::bucket(Profiler::bucketLimit(i) - 1));
+    }
+    EXPECT_EQ(Profiler::HISTOGRAM_SIZE - 1, Profiler::bucket(0xffffffff));
+}
+
+TEST(Profiler, events)
+{
+    Profiler* profiler = new Profiler;
+    int events[4];
+    profiler->setName(&events[0], "first");
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+        profiler->eventDone(&events[0], 500);
+        profiler->eventDone(&events[1], 1000 * (i + 1));
+    }
+    profiler->eventDone(&events[2], 3000);
+
+    Profiler::Entry* entry = profiler->find(&events[0], false);
+    ASSERT_NE(nullptr, entry);
+    EXPECT_STREQ("first", entry->mName);
+    EXPECT_EQ(10, entry->mCount);
+    EXPECT_EQ(5000, entry->mTotalNs);
+    EXPECT_EQ(500, entry->mMaxNs);
+    EXPECT_EQ(10, entry->mHistogram[0]);
+
+    entry = profiler->find(&events[1], false);
+    ASSERT_NE(nullptr, entry);
+    EXPECT_EQ(nullptr, entry->mName);
+    EXPECT_EQ(10, entry->mCount);
+    EXPECT_EQ(55000, entry->mTotalNs);
+    EXPECT_EQ(10000, entry->mMaxNs);
+    // 1000 | 2000 | 3000, 4000 | 5000..8000 | 9000, 10000
+    EXPECT_EQ(1, entry->mHistogram[0]);
+    EXPECT_EQ(1, entry->mHistogram[1]);
+    EXPECT_EQ(2, entry->mHistogram[2]);
+    EXPECT_EQ(4, entry->mHistogram[3]);
+    EXPECT_EQ(2, entry->mHistogram[4]);
+
+    EXPECT_EQ(nullptr, profiler->find(&events[3], false));
+
+    profiler->reset(1234);
+    EXPECT_EQ(1234, profiler->start());
+    entry = profiler->find(&events[0], false);
+    ASSERT_NE(nullptr, entry);
+    EXPECT_STREQ("first", entry->mName);
+    EXPECT_EQ(0, entry->mCount);
+    EXPECT_EQ(0, entry->mTotalNs);
+    EXPECT_EQ(0, entry->mHistogram[0]);
+    delete profiler;
+}
+
+TEST(Profiler, eventTableFull)
+{
+    Profiler* profiler = new Profiler;
+    int events[Profiler::MAX_EVENTS + 3];
+    for (int& event : events) profiler->eventDone(&event, 100);
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < Profiler::MAX_EVENTS; ++i)
+    {
+        Profiler::Entry* entry = profiler->event(i);
+        ASSERT_NE(nullptr, entry);
+        EXPECT_EQ(1, entry->mCount);
+        ++count;
+    }
+    EXPECT_EQ(Profiler::MAX_EVENTS, count);
+    EXPECT_EQ(3, profiler->eventsLost());
+    delete profiler;
+}
+
+TEST(Profiler, interrupts)
+{
+    Profiler* profiler = new Profiler;
+    profiler->interruptDone(5, 200);
+    profiler->interruptDone(5, 3000000);
+    profiler->interruptDone(Profiler::MAX_INTERRUPTS, 200);
+    Profiler::Entry* entry = profiler->interrupt(5);
+    ASSERT_NE(nullptr, entry);
+    EXPECT_EQ(2, entry->mCount);
+    EXPECT_EQ(3000200, entry->mTotalNs);
+    EXPECT_EQ(3000000, entry->mMaxNs);
+    EXPECT_EQ(1, entry->mHistogram[0]);
+    EXPECT_EQ(1, entry->mHistogram[Profiler::bucket(3000000)]);
+    EXPECT_EQ(0, profiler->interrupt(4)->mCount);
+    EXPECT_EQ(nullptr, profiler->interrupt(Profiler::MAX_INTERRUPTS));
+    delete profiler;
+}
@@ -0,0 +1,178 @@
+#ifndef SERIALLINE_H
+#define SERIALLINE_H
+
+#include "../Serial.h"
+#include "HostSystem.h"
+
+#include <string>
+
+#define SIZE_OF_USART 0x1c
+#define SIZE_OF_DMA 0xd0
+
+// USART2 receives with DMA1 stream 5 and sends with stream 6
+static const InterruptController::Index DMA_INDEX = 16;
+static const InterruptController::Index DMA_TX_INDEX = 17;
+static const InterruptController::Index USART_INDEX = 38;
+static const unsigned int STREAM = 5;
+static const unsigned int TX_STREAM = 6;
+// start, 8 data and stop bit at 921600 baud
+static const uint64_t BYTE_NS = 10850;
+
+// register words
+enum
+{
+    USART_SR = 0,
+    USART_DR = 1,
+    DMA_HISR = 1,
+    DMA_CR = 4 + STREAM * 6,
+    DMA_NDTR = DMA_CR + 1,
+    DMA_M0AR = DMA_CR + 3,
+    DMA_M1AR = DMA_CR + 4,
+    DMA_TX_CR = 4 + TX_STREAM * 6,
+    DMA_TX_NDTR = DMA_TX_CR + 1,
+    DMA_TX_M0AR = DMA_TX_CR + 3,
+};
+
+static const uint32_t SR_IDLE = 1 << 4;
+static const uint32_t SR_TC = 1 << 6;
+static const uint32_t CR_EN = 1 << 0;
+static const uint32_t CR_HTIE = 1 << 3;
+static const uint32_t CR_TCIE = 1 << 4;
+static const uint32_t CR_CIRC = 1 << 8;
+static const uint32_t CR_DBM = 1 << 18;
+static const uint32_t CR_CT = 1 << 19;
+// the flags of stream 5 start at bit 6 of HISR, the ones of stream 6 at bit 16
+static const uint32_t HISR_MASK = 0x3f << 6;
+static const uint32_t HISR_HT = Dma::HalfTransfer << 6;
+static const uint32_t HISR_TC = Dma::TransferComplete << 6;
+static const uint32_t HISR_TX_MASK = 0x3f << 16;
+static const uint32_t HISR_TX_TC = Dma::TransferComplete << 16;
+
+// The USART and its DMA streams in plain memory, receive() does what the hardware does with a byte
+// coming in: the DMA writes it to memory and counts down NDTR. In double buffer mode it writes to the
+// memory CT points to and toggles CT when NDTR gets to 0, without circular mode EN goes back to 0 then.
+// The transmitting stream gets its interrupt through here: poll() sees it started and has the interrupt
+// come when the last byte is out, which is when the data gets picked up and EN goes back to 0.
+class Line : public InterruptController::Callback
+{
+public:
+    Line(HostSystem& system, uint64_t byteTime = BYTE_NS) :
+        mSystem(system),
+        mByteTime(byteTime),
+        mUsart(),
+        mDma(),
+        mSize(0),
+        mAddress(0),
+        mTxStream(nullptr),
+        mSending(false),
+        mStart(0),
+        mEnd(0),
+        mSendTime(0)
+    {
+        // the DMA registers are 32 bit, the heap of the host is not, it's all in the same 4GB though
+        char* probe = new char;
+        mHeap = reinterpret_cast<uintptr_t>(probe) & ~static_cast<uintptr_t>(0xffffffff);
+        delete probe;
+    }
+
+    System::BaseAddress usart() { return reinterpret_cast<System::BaseAddress>(mUsart); }
+    System::BaseAddress dma() { return reinterpret_cast<System::BaseAddress>(mDma); }
+    bool circular() { return (mDma[DMA_CR] & (CR_EN | CR_CIRC | CR_HTIE)) == (CR_EN | CR_CIRC | CR_HTIE); }
+    bool doubleBuffer() { return (mDma[DMA_CR] & (CR_EN | CR_DBM)) == (CR_EN | CR_DBM); }
+    unsigned int currentTarget() { return (mDma[DMA_CR] & CR_CT) != 0 ? 1 : 0; }
+
+    void receive(char c)
+    {
+        // the interrupts of the last byte are handled
+        mDma[DMA_HISR] &= ~HISR_MASK;
+        mUsart[USART_SR] = 0;
+        // NDTR starts over with what it was set up with, unless the stream got started somewhere else
+        if (mSize == 0 || mDma[DMA_M0AR] != mAddress)
+        {
+            mSize = mDma[DMA_NDTR];
+            mAddress = mDma[DMA_M0AR];
+        }
+        memory(mDma[currentTarget() ? DMA_M1AR : DMA_M0AR])[mSize - mDma[DMA_NDTR]] = c;
+        if (--mDma[DMA_NDTR] == 0)
+        {
+            mDma[DMA_HISR] |= HISR_TC;
+            if (mDma[DMA_CR] & CR_DBM) mDma[DMA_CR] ^= CR_CT;
+            // a single transfer is done
+            if (mDma[DMA_CR] & (CR_CIRC | CR_DBM)) mDma[DMA_NDTR] = mSize;
+            else mDma[DMA_CR] &= ~CR_EN;
+        }
+        else if (mDma[DMA_NDTR] == mSize / 2)
+        {
+            mDma[DMA_HISR] |= HISR_HT;
+        }
+        // the flags are set anyway, the interrupt only comes when it's enabled
+        if (((mDma[DMA_HISR] & HISR_TC) && (mDma[DMA_CR] & CR_TCIE)) || ((mDma[DMA_HISR] & HISR_HT) && (mDma[DMA_CR] & CR_HTIE)))
+        {
+            mSystem.raiseInterrupt(DMA_INDEX);
+        }
+    }
+
+    // nothing came in for a byte time
+    void idle()
+    {
+        mDma[DMA_HISR] &= ~HISR_MASK;
+        mUsart[USART_SR] = SR_IDLE;
+        mSystem.raiseInterrupt(USART_INDEX);
+    }
+
+    void setTxStream(Dma::Stream* stream, InterruptController::Line* interrupt)
+    {
+        mTxStream = stream;
+        interrupt->setCallback(this);
+    }
+
+    void poll()
+    {
+        if (mSending || !(mDma[DMA_TX_CR] & CR_EN)) return;
+        mSending = true;
+        if (mSent.empty()) mStart = mSystem.ns();
+        uint64_t time = mDma[DMA_TX_NDTR] * mByteTime;
+        mSendTime += time;
+        mSystem.raiseInterrupt(DMA_TX_INDEX, mSystem.ns() + time);
+    }
+
+    virtual void interruptCallback(InterruptController::Index index)
+    {
+        mSent.append(memory(mDma[DMA_TX_M0AR]), mDma[DMA_TX_NDTR]);
+        mDma[DMA_TX_NDTR] = 0;
+        mDma[DMA_TX_CR] &= ~CR_EN;
+        mDma[DMA_HISR] |= HISR_TX_TC;
+        mSending = false;
+        mEnd = mSystem.ns();
+        mTxStream->interruptCallback(index);
+        mDma[DMA_HISR] &= ~HISR_TX_MASK;
+        // chained
+        poll();
+    }
+
+    // sending without DMA: TC stays set and only the last byte written is left in DR
+    void transmitComplete() { mUsart[USART_SR] |= SR_TC; }
+    char lastWritten() { return static_cast<char>(mUsart[USART_DR]); }
+    std::string& sent() { return mSent; }
+    // from the first to the last byte, the time the line had nothing to send
+    uint64_t idleTime() { return mEnd - mStart - mSendTime; }
+
+private:
+    HostSystem& mSystem;
+    uint64_t mByteTime;
+    uint32_t mUsart[SIZE_OF_USART / 4];
+    uint32_t mDma[SIZE_OF_DMA / 4];
+    uint32_t mSize;
+    uint32_t mAddress;
+    uintptr_t mHeap;
+    Dma::Stream* mTxStream;
+    bool mSending;
+    uint64_t mStart;
+    uint64_t mEnd;
+    uint64_t mSendTime;
+    std::string mSent;
+
+    char* memory(uint32_t address) { return reinterpret_cast<char*>(mHeap | address); }
+};
+
+#endif // SERIALLINE_H
@@ -0,0 +1,402 @@
+#include "SerialLine.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const unsigned int FIFO_SIZE = 256;
+
+// reads chunk after chunk, like the console does
+class Reader : public System::Event::Callback
+{
+public:
+    Reader(Serial& serial, unsigned int chunk) :
+        mSerial(serial),
+        mEvent(*this),
+        mChunk(chunk),
+        mCount(0),
+        mOverrun(false)
+    { }
+
+    void start() { mSerial.read(mBuffer, mChunk, &mEvent); }
+
+    virtual void eventCallback(System::Event* event)
+    {
+        ++mCount;
+        if (event->result() == System::Event::Result::OverrunError) mOverrun = true;
+        mData.append(mBuffer, mChunk);
+        start();
+    }
+
+    Serial& mSerial;
+    System::Event mEvent;
+    unsigned int mChunk;
+    unsigned int mCount;
+    bool mOverrun;
+    std::string mData;
+    char mBuffer[FIFO_SIZE];
+};
+
+// writes the text in pieces, it takes a while to make up the next one after a write completed
+class Writer : public System::Event::Callback
+{
+public:
+    static const unsigned int PIECE = 64;
+    static const unsigned int WORK_US = 100;
+
+    Writer(HostSystem& system, Serial& serial, Line& line, const std::string& text) :
+        mSystem(system),
+        mSerial(serial),
+        mLine(line),
+        mText(text),
+        mPos(0),
+        mCount(0)
+    { }
+
+    bool write(System::Event* event)
+    {
+        if (mPos >= mText.size() || !mSerial.write(mText.data() + mPos, PIECE, event)) return false;
+        mPos += PIECE;
+        mLine.poll();
+        return true;
+    }
+    bool done() { return mCount * PIECE == mText.size(); }
+
+    virtual void eventCallback(System::Event* event)
+    {
+        ++mCount;
+        mSystem.usleep(WORK_US);
+        write(event);
+    }
+
+    HostSystem& mSystem;
+    Serial& mSerial;
+    Line& mLine;
+    const std::string& mText;
+    unsigned int mPos;
+    unsigned int mCount;
+};
+
+const unsigned int Writer::PIECE;
+const unsigned int Writer::WORK_US;
+
+// the buffers in the order they got full, and where the DMA was at that time
+class Halves : public Device::DoubleBufferCallback
+{
+public:
+    Halves(Line& line, Dma::Stream& stream) : mLine(line), mStream(stream) { }
+
+    virtual void bufferComplete(unsigned int index, void* data, unsigned int len)
+    {
+        mIndex.push_back(index);
+        mTarget.push_back(mLine.currentTarget());
+        mCurrent.push_back(mStream.currentMemory());
+        mData.push_back(std::string(static_cast<char*>(data), len));
+    }
+
+    Line& mLine;
+    Dma::Stream& mStream;
+    std::vector<unsigned int> mIndex;
+    std::vector<unsigned int> mTarget;
+    std::vector<Dma::Stream::End> mCurrent;
+    std::vector<std::string> mData;
+};
+
+// the order the writes completed in
+class Completions : public System::Event::Callback
+{
+public:
+    std::vector<System::Event*> mEvents;
+
+    virtual void eventCallback(System::Event* event) { mEvents.push_back(event); }
+};
+
+TEST(Serial, circularDmaReceive)
+{
+    static const unsigned int BURSTS[] = { 1, 31, 200, 600, 7, 1000, 161 };
+    static const unsigned int BURST_COUNT = sizeof(BURSTS) / sizeof(BURSTS[0]);
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    InterruptController::Line usartInterrupt(system.mNvic, USART_INDEX);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(nullptr, &stream);
+    serial.configInterrupt(&usartInterrupt);
+    serial.readFifo(FIFO_SIZE);
+    serial.enable(Device::All);
+    ASSERT_TRUE(line.circular());
+
+    Reader reader(serial, 16);
+    reader.start();
+    // the reader keeps up, but not byte by byte
+    system.setEventCost(20000);
+    std::string sent;
+    for (unsigned int burst = 0; burst < BURST_COUNT; ++burst)
+    {
+        for (unsigned int i = 0; i < BURSTS[burst]; ++i)
+        {
+            char c = static_cast<char>(sent.size() * 7 + burst);
+            sent += c;
+            line.receive(c);
+            system.run(BYTE_NS);
+        }
+        line.idle();
+        system.run(2000000);
+    }
+
+    EXPECT_EQ(0, sent.size() % reader.mChunk);
+    EXPECT_EQ(sent.size(), reader.mData.size());
+    EXPECT_TRUE(sent == reader.mData);
+    EXPECT_FALSE(reader.mOverrun);
+    unsigned int readEvents = system.eventCount() - reader.mCount;
+    std::printf("%u bytes in %u bursts: %u read events, %u reads\n", static_cast<unsigned int>(sent.size()), BURST_COUNT, readEvents, reader.mCount);
+    // an event per half of the FIFO and one for the end of each burst, instead of one per byte
+    EXPECT_LE(readEvents, sent.size() / (FIFO_SIZE / 2) + BURST_COUNT);
+}
+
+TEST(Serial, circularDmaOverrun)
+{
+    static const unsigned int COUNT = 400;
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    InterruptController::Line usartInterrupt(system.mNvic, USART_INDEX);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(nullptr, &stream);
+    serial.configInterrupt(&usartInterrupt);
+    serial.readFifo(FIFO_SIZE);
+    serial.enable(Device::All);
+
+    Reader reader(serial, FIFO_SIZE);
+    reader.start();
+    // the interrupts come, the events don't get to run
+    for (unsigned int i = 0; i < COUNT; ++i)
+    {
+        line.receive(static_cast<char>(i));
+        system.advance(BYTE_NS);
+    }
+    line.idle();
+    system.advance(BYTE_NS);
+    system.run(1000000);
+
+    ASSERT_LE(FIFO_SIZE, reader.mData.size());
+    EXPECT_TRUE(reader.mOverrun);
+    // what the DMA went over is lost, the newest data is kept
+    for (unsigned int i = 0; i < FIFO_SIZE; ++i) EXPECT_EQ(static_cast<char>(COUNT - FIFO_SIZE + i), reader.mData[i]);
+}
+
+TEST(Serial, doubleBufferReceive)
+{
+    static const unsigned int LEN = 32;
+    static const unsigned int COUNT = 5 * LEN + 10;
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    InterruptController::Line usartInterrupt(system.mNvic, USART_INDEX);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(nullptr, &stream);
+    serial.configInterrupt(&usartInterrupt);
+    serial.readFifo(FIFO_SIZE);
+    serial.enable(Device::All);
+
+    // the FIFO has the stream first, what it got is still read
+    Reader reader(serial, 4);
+    reader.start();
+    ASSERT_TRUE(line.circular());
+    for (char c : std::string("abcd")) line.receive(c);
+    char* buffers = new char[2 * LEN];
+    Halves halves(line, stream);
+    ASSERT_TRUE(serial.readDoubleBuffer(buffers, buffers + LEN, LEN, &halves));
+    EXPECT_FALSE(serial.readDoubleBuffer(buffers, buffers + LEN, LEN, &halves));
+    EXPECT_TRUE(line.doubleBuffer());
+    EXPECT_FALSE(line.circular());
+    EXPECT_EQ(0, line.currentTarget());
+    system.run(1000000);
+    EXPECT_EQ("abcd", reader.mData);
+
+    std::string sent;
+    for (unsigned int i = 0; i < COUNT; ++i)
+    {
+        char c = static_cast<char>(i * 3);
+        sent += c;
+        line.receive(c);
+        system.run(BYTE_NS);
+    }
+
+    // one after the other, the DMA went on with the other buffer each time
+    ASSERT_EQ(5, halves.mIndex.size());
+    for (unsigned int i = 0; i < halves.mIndex.size(); ++i)
+    {
+        EXPECT_EQ(i % 2, halves.mIndex[i]);
+        EXPECT_EQ(1 - i % 2, halves.mTarget[i]);
+        EXPECT_EQ(i % 2 == 0 ? Dma::Stream::End::Memory1 : Dma::Stream::End::Memory0, halves.mCurrent[i]);
+        EXPECT_TRUE(sent.substr(i * LEN, LEN) == halves.mData[i]) << "buffer " << i;
+    }
+    // the rest is on the way in the second one
+    EXPECT_EQ(1, line.currentTarget());
+    EXPECT_TRUE(std::equal(sent.begin() + 5 * LEN, sent.end(), buffers + LEN));
+
+    serial.stopDoubleBuffer();
+    EXPECT_FALSE(line.doubleBuffer());
+    EXPECT_EQ(4, reader.mData.size());
+
+    // the FIFO gets the stream back and the reads go on
+    EXPECT_TRUE(line.circular());
+    for (char c : std::string("efghijkl"))
+    {
+        line.receive(c);
+        system.run(BYTE_NS);
+    }
+    line.idle();
+    system.run(1000000);
+    EXPECT_EQ("abcdefghijkl", reader.mData);
+    EXPECT_EQ(5, halves.mIndex.size());
+    // nothing to stop, the stream stays as it is
+    serial.stopDoubleBuffer();
+    for (char c : std::string("mnop"))
+    {
+        line.receive(c);
+        system.run(BYTE_NS);
+    }
+    line.idle();
+    system.run(1000000);
+    EXPECT_EQ("abcdefghijklmnop", reader.mData);
+    delete[] buffers;
+}
+
+TEST(Serial, doubleBufferStopWithData)
+{
+    static const unsigned int LEN = 16;
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    InterruptController::Line usartInterrupt(system.mNvic, USART_INDEX);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(nullptr, &stream);
+    serial.configInterrupt(&usartInterrupt);
+    serial.readFifo(FIFO_SIZE);
+    serial.enable(Device::All);
+
+    // nobody reads yet, it stays in the FIFO
+    for (char c : std::string("abcd")) line.receive(c);
+    char* buffers = new char[2 * LEN];
+    Halves halves(line, stream);
+    ASSERT_TRUE(serial.readDoubleBuffer(buffers, buffers + LEN, LEN, &halves));
+    serial.stopDoubleBuffer();
+    // the circular stream can't start in the middle of the FIFO, it goes on a byte at a time
+    EXPECT_FALSE(line.circular());
+    EXPECT_FALSE(line.doubleBuffer());
+    for (char c : std::string("efgh"))
+    {
+        line.receive(c);
+        system.run(BYTE_NS);
+    }
+    Reader reader(serial, 8);
+    reader.start();
+    system.run(1000000);
+    EXPECT_EQ("abcdefgh", reader.mData);
+
+    for (char c : std::string("ijklmnop"))
+    {
+        line.receive(c);
+        system.run(BYTE_NS);
+    }
+    system.run(1000000);
+    EXPECT_EQ("abcdefghijklmnop", reader.mData);
+    delete[] buffers;
+}
+
+TEST(Serial, queuedDmaWrite)
+{
+    static const unsigned int DEPTH = 4;
+    std::string text;
+    for (unsigned int i = 0; i < 40 * Writer::PIECE; ++i) text += static_cast<char>(i * 13);
+    uint64_t idle[2];
+    for (unsigned int queued = 0; queued < 2; ++queued)
+    {
+        HostSystem system;
+        Line line(system);
+        Dma dma(line.dma());
+        InterruptController::Line dmaInterrupt(system.mNvic, DMA_TX_INDEX);
+        Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+        line.setTxStream(&stream, &dmaInterrupt);
+        Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+        serial.config(921600);
+        serial.configDma(&stream, nullptr);
+        if (queued) serial.writeQueue(DEPTH - 1);
+        serial.enable(Device::All);
+
+        Writer writer(system, serial, line, text);
+        System::Event events[DEPTH] = { System::Event(writer), System::Event(writer), System::Event(writer), System::Event(writer) };
+        unsigned int started = 0;
+        for (System::Event& event : events) if (writer.write(&event)) ++started;
+        EXPECT_EQ(queued ? DEPTH : 1, started);
+        for (unsigned int i = 0; i < 1000 && !writer.done(); ++i) system.run(1000000);
+
+        EXPECT_TRUE(writer.done());
+        EXPECT_TRUE(text == line.sent());
+        idle[queued] = line.idleTime();
+        if (queued)
+        {
+            EXPECT_EQ(DEPTH - 1, serial.writeQueueMaxUsed());
+            EXPECT_EQ(0, serial.writeQueueUsed());
+        }
+    }
+    std::printf("%u bytes in %u writes, line idle: one at a time %lu us, queued %lu us\n", static_cast<unsigned int>(text.size()),
+                static_cast<unsigned int>(text.size() / Writer::PIECE), static_cast<unsigned long>(idle[0] / 1000), static_cast<unsigned long>(idle[1] / 1000));
+    // one at a time the line waits for the next piece every time
+    EXPECT_LE((text.size() / Writer::PIECE - 1) * Writer::WORK_US * 1000, idle[0]);
+    EXPECT_EQ(0, idle[1]);
+}
+
+TEST(Serial, writeQueueOverflow)
+{
+    static const unsigned int COUNT = 5;
+    HostSystem system;
+    // Line only gets at memory on the heap
+    std::vector<char> text(10);
+    for (unsigned int i = 0; i < text.size(); ++i) text[i] = '0' + i;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_TX_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    line.setTxStream(&stream, &dmaInterrupt);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(&stream, nullptr);
+    serial.writeQueue(2);
+    serial.enable(Device::All);
+
+    Completions completions;
+    System::Event events[COUNT] = { System::Event(completions), System::Event(completions), System::Event(completions), System::Event(completions), System::Event(completions) };
+    // one going, two waiting, the rest refused
+    for (unsigned int i = 0; i < COUNT; ++i) EXPECT_EQ(i < 3, serial.write(text.data() + 2 * i, 2, &events[i]));
+    line.poll();
+    EXPECT_EQ(2, serial.writeQueueUsed());
+    EXPECT_EQ(2, serial.writeQueueOverflow());
+    system.run(1000000);
+
+    EXPECT_EQ("012345", line.sent());
+    ASSERT_EQ(3, completions.mEvents.size());
+    for (unsigned int i = 0; i < 3; ++i) EXPECT_EQ(&events[i], completions.mEvents[i]);
+    // with nothing going on, it doesn't wait in the queue
+    EXPECT_TRUE(serial.write(text.data(), 2, &events[0]));
+    EXPECT_EQ(0, serial.writeQueueUsed());
+    line.poll();
+    system.run(1000000);
+    EXPECT_EQ("01234501", line.sent());
+}
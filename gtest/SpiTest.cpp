@@ -0,0 +1,325 @@
+#include "../Spi.h"
+#include "../hw/lis302dl.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#define SIZE_OF_RCC 0x88
+#define SIZE_OF_DMA 0xd0
+#define SIZE_OF_SPI 0x24
+
+// register words
+enum
+{
+    RCC_CFGR = 2,
+    DMA_STREAM = 4,
+    DMA_STREAM_WORDS = 6,
+};
+
+static const uint16_t CR1_CPHA = 1 << 0;
+static const uint16_t CR1_CPOL = 1 << 1;
+static const uint16_t CR1_MSTR = 1 << 2;
+static const uint16_t CR1_BR_SHIFT = 3;
+static const uint16_t CR1_BR = 7 << CR1_BR_SHIFT;
+static const uint16_t CR1_SPE = 1 << 6;
+static const uint16_t CR1_DFF = 1 << 11;
+static const uint32_t CR_EN = 1 << 0;
+static const uint32_t CR_PSIZE_SHIFT = 11;
+static const uint32_t CR_PSIZE = 3 << CR_PSIZE_SHIFT;
+static const uint32_t CFGR_PPRE2_DIV2 = 4 << 13;
+
+// SPI1 on the 16MHz internal clock with DMA2 streams 0 and 3 in memory. complete() ends the transfer that
+// runs like the DMA does. SPE is a write of CR1 showing up: it is only set again when the mode changes,
+// written() takes it back to tell the next one.
+class Bus : public Spi
+{
+public:
+    Bus(uint16_t* registers, ClockControl& clock, uint32_t* dma) :
+        Spi(reinterpret_cast<System::BaseAddress>(registers), &clock, ClockControl::Clock::APB2),
+        mRegisters(registers),
+        mDmaRegisters(dma),
+        mDma(reinterpret_cast<System::BaseAddress>(dma)),
+        mRead(mDma, Dma::Stream::StreamIndex::Stream0, Dma::Stream::ChannelIndex::Channel3, nullptr),
+        mWrite(mDma, Dma::Stream::StreamIndex::Stream3, Dma::Stream::ChannelIndex::Channel3, nullptr)
+    {
+        setMasterSlave(MasterSlave::Master);
+        configDma(&mWrite, &mRead);
+    }
+
+    uint16_t cr1() { return mRegisters[0]; }
+    bool written()
+    {
+        bool spe = (mRegisters[0] & CR1_SPE) != 0;
+        mRegisters[0] &= ~CR1_SPE;
+        return spe;
+    }
+    void complete()
+    {
+        mDmaRegisters[DMA_STREAM + 0 * DMA_STREAM_WORDS] &= ~CR_EN;
+        mDmaRegisters[DMA_STREAM + 3 * DMA_STREAM_WORDS] &= ~CR_EN;
+        dmaCallback(&mWrite, Dma::Stream::Callback::Reason::TransferComplete);
+        dmaCallback(&mRead, Dma::Stream::Callback::Reason::TransferComplete);
+    }
+    void clockChanged() { clockCallback(ClockControl::Callback::Reason::Changed, 0); }
+    // the peripheral data size and NDTR the streams were started with
+    uint32_t readSize() { return (mDmaRegisters[DMA_STREAM + 0 * DMA_STREAM_WORDS] & CR_PSIZE) >> CR_PSIZE_SHIFT; }
+    uint32_t writeSize() { return (mDmaRegisters[DMA_STREAM + 3 * DMA_STREAM_WORDS] & CR_PSIZE) >> CR_PSIZE_SHIFT; }
+    uint32_t readCount() { return mDmaRegisters[DMA_STREAM + 0 * DMA_STREAM_WORDS + 1]; }
+    uint32_t writeCount() { return mDmaRegisters[DMA_STREAM + 3 * DMA_STREAM_WORDS + 1]; }
+
+    uint16_t* mRegisters;
+    uint32_t* mDmaRegisters;
+    Dma mDma;
+    Dma::Stream mRead;
+    Dma::Stream mWrite;
+};
+
+class Board
+{
+public:
+    Board() :
+        mClock(reinterpret_cast<System::BaseAddress>(mRcc), 8000000),
+        mBus(mSpi, mClock, mDma)
+    {
+    }
+
+    uint32_t mRcc[SIZE_OF_RCC / 4] = { };
+    uint16_t mSpi[SIZE_OF_SPI / 2] = { };
+    uint32_t mDma[SIZE_OF_DMA / 4] = { };
+    ClockControl mClock;
+    Bus mBus;
+};
+
+static void setup(Spi::Transfer& transfer, uint8_t* data, uint32_t maxSpeed, Spi::ClockPolarity polarity, Spi::ClockPhase phase)
+{
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.mWriteData = data;
+    transfer.mReadData = data;
+    transfer.mLength = 2;
+    transfer.mMaxSpeed = maxSpeed;
+    transfer.mClockPolarity = polarity;
+    transfer.mClockPhase = phase;
+    transfer.mEndianess = Spi::Endianess::MsbFirst;
+}
+
+TEST(Spi, sameChip)
+{
+    HostSystem system;
+    Board board;
+    Spi::Chip chip(board.mBus);
+    uint8_t* data = new uint8_t[2];
+    Spi::Transfer transfer;
+    setup(transfer, data, 1000000, Spi::ClockPolarity::HighWhenIdle, Spi::ClockPhase::SecondTransition);
+
+    unsigned writes = 0;
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(chip.transfer(&transfer));
+        if (board.mBus.written()) ++writes;
+        board.mBus.complete();
+    }
+    EXPECT_EQ(1u, writes);
+    // 16MHz / 16, the master bits stay
+    EXPECT_EQ(CR1_MSTR | CR1_CPOL | CR1_CPHA | (3 << CR1_BR_SHIFT), board.mBus.cr1() & (CR1_MSTR | CR1_CPOL | CR1_CPHA | CR1_BR));
+
+    // disabled in between, the next transfer switches it on again
+    board.mBus.disable(Device::All);
+    ASSERT_TRUE(chip.transfer(&transfer));
+    EXPECT_TRUE(board.mBus.written());
+    board.mBus.complete();
+    delete[] data;
+}
+
+TEST(Spi, chips)
+{
+    HostSystem system;
+    Board board;
+    Spi::Chip lis(board.mBus);
+    Spi::Chip other(board.mBus);
+    Spi::Chip display(board.mBus);
+    uint8_t* data = new uint8_t[2];
+    Spi::Transfer lisTransfer;
+    setup(lisTransfer, data, 10000000, Spi::ClockPolarity::HighWhenIdle, Spi::ClockPhase::SecondTransition);
+    Spi::Transfer otherTransfer = lisTransfer;
+    Spi::Transfer displayTransfer;
+    setup(displayTransfer, data, 1000000, Spi::ClockPolarity::LowWhenIdle, Spi::ClockPhase::FirstTransition);
+    Spi::Transfer plain = lisTransfer;
+
+    // the same mode on two chips and without one, nothing to write after the first
+    unsigned writes = 0;
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(lis.transfer(&lisTransfer));
+        if (board.mBus.written()) ++writes;
+        board.mBus.complete();
+        ASSERT_TRUE(other.transfer(&otherTransfer));
+        if (board.mBus.written()) ++writes;
+        board.mBus.complete();
+        ASSERT_TRUE(board.mBus.transfer(&plain));
+        if (board.mBus.written()) ++writes;
+        board.mBus.complete();
+    }
+    EXPECT_EQ(1u, writes);
+
+    // taking turns with another mode, every transfer has to write it
+    writes = 0;
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(display.transfer(&displayTransfer));
+        if (board.mBus.written()) ++writes;
+        EXPECT_EQ(3 << CR1_BR_SHIFT, board.mBus.cr1() & (CR1_CPOL | CR1_CPHA | CR1_BR));
+        board.mBus.complete();
+        ASSERT_TRUE(lis.transfer(&lisTransfer));
+        if (board.mBus.written()) ++writes;
+        EXPECT_EQ(CR1_CPOL | CR1_CPHA, board.mBus.cr1() & (CR1_CPOL | CR1_CPHA | CR1_BR));
+        board.mBus.complete();
+    }
+    EXPECT_EQ(20u, writes);
+
+    // a new setting in the transfer of a chip
+    displayTransfer.mMaxSpeed = 4000000;
+    ASSERT_TRUE(display.transfer(&displayTransfer));
+    EXPECT_TRUE(board.mBus.written());
+    EXPECT_EQ(1 << CR1_BR_SHIFT, board.mBus.cr1() & CR1_BR);
+    board.mBus.complete();
+    delete[] data;
+}
+
+TEST(Spi, clockChange)
+{
+    HostSystem system;
+    Board board;
+    Spi::Chip chip(board.mBus);
+    uint8_t* data = new uint8_t[2];
+    Spi::Transfer transfer;
+    setup(transfer, data, 1000000, Spi::ClockPolarity::LowWhenIdle, Spi::ClockPhase::FirstTransition);
+    ASSERT_TRUE(chip.transfer(&transfer));
+    board.mBus.complete();
+    EXPECT_EQ(3 << CR1_BR_SHIFT, board.mBus.cr1() & CR1_BR);
+
+    // APB2 at 8MHz, the speed of the last transfer is kept right away
+    board.mRcc[RCC_CFGR] |= CFGR_PPRE2_DIV2;
+    board.mBus.written();
+    board.mBus.clockChanged();
+    EXPECT_TRUE(board.mBus.written());
+    EXPECT_EQ(2 << CR1_BR_SHIFT, board.mBus.cr1() & CR1_BR);
+
+    // the chip works its mode out again, it is the one there already
+    ASSERT_TRUE(chip.transfer(&transfer));
+    EXPECT_FALSE(board.mBus.written());
+    EXPECT_EQ(2 << CR1_BR_SHIFT, board.mBus.cr1() & CR1_BR);
+    board.mBus.complete();
+    delete[] data;
+}
+
+// Reads of OutX through the driver, against plain transfers taking turns with another mode: their mode is
+// worked out and written for every one, like it was for all of them before the chips kept it.
+TEST(Spi, lisReadRate)
+{
+    static const unsigned int READS = 100000;
+    HostSystem system;
+    Board board;
+    Spi::Chip chip(board.mBus);
+    LIS302DL lis(chip);
+    uint8_t* data = new uint8_t[2];
+    Spi::Transfer lisTransfer;
+    setup(lisTransfer, data, 10000000, Spi::ClockPolarity::HighWhenIdle, Spi::ClockPhase::SecondTransition);
+    Spi::Transfer displayTransfer;
+    setup(displayTransfer, data, 1000000, Spi::ClockPolarity::LowWhenIdle, Spi::ClockPhase::FirstTransition);
+
+    unsigned writes = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < READS; ++i)
+    {
+        lis.x();
+        if (board.mBus.written()) ++writes;
+        board.mBus.complete();
+    }
+    double kept = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(1u, writes);
+
+    writes = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < READS; ++i)
+    {
+        board.mBus.transfer((i & 1) ? &lisTransfer : &displayTransfer);
+        if (board.mBus.written()) ++writes;
+        board.mBus.complete();
+    }
+    double written = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(READS, writes);
+    printf("2 byte LIS302DL reads: %.0f/s with the mode kept, %.0f/s with it worked out and written every time (host)\n", READS / kept, READS / written);
+    delete[] data;
+}
+
+TEST(Spi, wordSize)
+{
+    HostSystem system;
+    Board board;
+    Spi::Chip tlc(board.mBus);
+    Spi::Chip lis(board.mBus);
+    uint16_t* frames = new uint16_t[12];
+    Spi::Transfer tlcTransfer;
+    setup(tlcTransfer, reinterpret_cast<uint8_t*>(frames), 1000000, Spi::ClockPolarity::LowWhenIdle, Spi::ClockPhase::FirstTransition);
+    tlcTransfer.mLength = 24;
+    tlcTransfer.mWordSize = Spi::WordSize::Bits16;
+    Spi::Transfer lisTransfer = tlcTransfer;
+    lisTransfer.mWordSize = Spi::WordSize::Bits8;
+
+    ASSERT_TRUE(tlc.transfer(&tlcTransfer));
+    EXPECT_TRUE(board.mBus.written());
+    EXPECT_EQ(CR1_DFF, board.mBus.cr1() & CR1_DFF);
+    EXPECT_EQ(1u, board.mBus.readSize());
+    EXPECT_EQ(1u, board.mBus.writeSize());
+    EXPECT_EQ(12u, board.mBus.readCount());
+    EXPECT_EQ(12u, board.mBus.writeCount());
+    board.mBus.complete();
+
+    // kept like the rest of the mode
+    ASSERT_TRUE(tlc.transfer(&tlcTransfer));
+    EXPECT_FALSE(board.mBus.written());
+    EXPECT_EQ(12u, board.mBus.writeCount());
+    board.mBus.complete();
+
+    // back to bytes, only the frame size differs
+    ASSERT_TRUE(lis.transfer(&lisTransfer));
+    EXPECT_TRUE(board.mBus.written());
+    EXPECT_EQ(0, board.mBus.cr1() & CR1_DFF);
+    EXPECT_EQ(0u, board.mBus.readSize());
+    EXPECT_EQ(0u, board.mBus.writeSize());
+    EXPECT_EQ(24u, board.mBus.readCount());
+    EXPECT_EQ(24u, board.mBus.writeCount());
+    board.mBus.complete();
+    delete[] frames;
+}
+
+// A frame buffer of a display written out, the DMA requests of the SPI are what 16 bit frames save: the
+// bits on the wire are the same.
+TEST(Spi, frameBufferRequests)
+{
+    static const unsigned int FB_SIZE = 1024;
+    HostSystem system;
+    Board board;
+    Spi::Chip display(board.mBus);
+    uint16_t* fb = new uint16_t[FB_SIZE / 2];
+    Spi::Transfer transfer;
+    setup(transfer, reinterpret_cast<uint8_t*>(fb), 10000000, Spi::ClockPolarity::LowWhenIdle, Spi::ClockPhase::FirstTransition);
+    transfer.mReadData = nullptr;
+    transfer.mLength = FB_SIZE;
+
+    ASSERT_TRUE(display.transfer(&transfer));
+    uint32_t bytes = board.mBus.writeCount();
+    board.mBus.complete();
+    transfer.mWordSize = Spi::WordSize::Bits16;
+    ASSERT_TRUE(display.transfer(&transfer));
+    uint32_t halfWords = board.mBus.writeCount();
+    board.mBus.complete();
+    EXPECT_EQ(FB_SIZE, bytes);
+    EXPECT_EQ(FB_SIZE / 2, halfWords);
+    printf("%u byte frame buffer: %u DMA requests with 8 bit frames, %u with 16 bit frames\n", FB_SIZE, bytes, halfWords);
+    delete[] fb;
+}
@@ -0,0 +1,176 @@
+#include "../Telemetry.h"
+#include "../Console.h"
+#include "../tools/TelemetryDecoder.h"
+#include "SerialLine.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST(Telemetry, crc)
+{
+    Crc crc;
+    // what the CRC unit of the STM32 gives for a single word
+    uint32_t word = 0x12345678;
+    EXPECT_EQ(0xdf8a8a2b, crc.compute(&word, 4));
+    EXPECT_EQ(0xffffffff, crc.compute(&word, 0));
+    // a partial word is filled up with 0
+    uint8_t bytes[] = { 0x78, 0x56, 0x34, 0x12, 0xab, 0xcd };
+    uint32_t words[] = { 0x12345678, 0x0000cdab };
+    EXPECT_EQ(crc.compute(words, 8), crc.compute(bytes, 6));
+    EXPECT_EQ(Crc::update(Crc::update(Crc::INITIAL, words[0]), words[1]), crc.compute(bytes, 6));
+}
+
+TEST(Telemetry, cobs)
+{
+    std::default_random_engine generator(3);
+    std::uniform_int_distribution<unsigned int> bytes(0, 255);
+    for (unsigned int len : { 0u, 1u, 253u, 254u, 255u, 508u, 600u })
+    {
+        for (unsigned int zeros : { 0u, 1u, 50u })
+        {
+            std::vector<uint8_t> data(len);
+            for (uint8_t& b : data) b = bytes(generator) % 255 + 1;
+            for (unsigned int i = 0; i < zeros && len != 0; ++i) data[bytes(generator) % len] = 0;
+            std::vector<uint8_t> encoded(Cobs::maxEncodedSize(len));
+            unsigned int encodedLen = Cobs::encode(data.data(), len, encoded.data());
+            EXPECT_LE(encodedLen, encoded.size()) << len << " bytes with " << zeros << " zeros";
+            EXPECT_EQ(encoded.begin() + encodedLen, std::find(encoded.begin(), encoded.begin() + encodedLen, 0));
+            std::vector<uint8_t> decoded(encodedLen);
+            ASSERT_EQ(static_cast<int>(len), Cobs::decode(encoded.data(), encodedLen, decoded.data())) << len << " bytes with " << zeros << " zeros";
+            EXPECT_TRUE(std::equal(data.begin(), data.end(), decoded.begin()));
+        }
+    }
+    // the code points past the end, and a 0 in a block
+    const uint8_t broken[] = { 3, 1, 2, 5, 1 };
+    uint8_t out[sizeof(broken)];
+    EXPECT_EQ(-1, Cobs::decode(broken, sizeof(broken), out));
+    const uint8_t zero[] = { 3, 1, 0 };
+    EXPECT_EQ(-1, Cobs::decode(zero, sizeof(zero), out));
+}
+
+// frames and shell text on the same line, one broken on the way and one that didn't fit
+TEST(Telemetry, frames)
+{
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_TX_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    line.setTxStream(&stream, &dmaInterrupt);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(&stream, nullptr);
+    serial.writeFifo(new Console(512, Console::Overflow::Drop));
+    serial.enable(Device::All);
+    Crc crc;
+    Telemetry telemetry(serial, crc);
+
+    const int8_t samples[] = { 0, -1, 54, 12, 0, -128 };
+    const uint32_t distances[] = { 0, 1234, 0x01000000 };
+    const uint8_t raw[Telemetry::MAX_PAYLOAD] = { 0 };
+    std::string text = "> lis bin\n";
+    std::vector<char> prompt(text.begin(), text.end());
+    serial.write(prompt.data(), prompt.size());
+    EXPECT_TRUE(telemetry.send(Telemetry::Type::Acceleration, samples, sizeof(samples)));
+    EXPECT_TRUE(telemetry.send(Telemetry::Type::Distance, distances, sizeof(distances)));
+    EXPECT_TRUE(telemetry.send(Telemetry::Type::Raw, raw, sizeof(raw)));
+    // no room left for it
+    EXPECT_FALSE(telemetry.send(Telemetry::Type::Raw, raw, sizeof(raw)));
+    EXPECT_FALSE(telemetry.send(Telemetry::Type::Raw, raw, Telemetry::MAX_PAYLOAD + 1));
+    line.poll();
+    system.run(10000000);
+    EXPECT_TRUE(telemetry.send(Telemetry::Type::Acceleration, samples, 3));
+    line.poll();
+    system.run(1000000);
+    EXPECT_EQ(4, telemetry.sent());
+    EXPECT_EQ(1, telemetry.dropped());
+
+    std::string data = line.sent();
+    // a bit flipped in the second frame
+    std::size_t second = data.find('\0', data.find('\0', prompt.size() + 1) + 1);
+    data[second + 5] ^= 0x10;
+    TelemetryDecoder decoder;
+    // fed in pieces
+    for (std::size_t pos = 0; pos < data.size(); pos += 7) decoder.decode(data.data() + pos, std::min<std::size_t>(7, data.size() - pos));
+    decoder.finish();
+    EXPECT_EQ(text, decoder.text());
+    EXPECT_EQ(1, decoder.crcErrors());
+    // the broken and the dropped one
+    EXPECT_EQ(2, decoder.lost());
+    const std::vector<TelemetryDecoder::Frame>& frames = decoder.frames();
+    ASSERT_EQ(3, frames.size());
+    EXPECT_EQ(Telemetry::Type::Acceleration, frames[0].mType);
+    EXPECT_EQ(0, frames[0].mSequence);
+    EXPECT_EQ(sizeof(samples), frames[0].mPayload.size());
+    EXPECT_EQ(0, std::memcmp(samples, frames[0].mPayload.data(), sizeof(samples)));
+    EXPECT_EQ(Telemetry::Type::Raw, frames[1].mType);
+    EXPECT_EQ(sizeof(raw), frames[1].mPayload.size());
+    EXPECT_EQ(4, frames[2].mSequence);
+
+    char* buffer = nullptr;
+    std::size_t size = 0;
+    FILE* out = open_memstream(&buffer, &size);
+    decoder.write(out, frames[0]);
+    std::fclose(out);
+    EXPECT_EQ("#0 acceleration 0/-1/54 12/0/-128\n", std::string(buffer, size));
+    std::free(buffer);
+}
+
+// accelerometer samples as fast as the line takes them, against the same as text
+TEST(Telemetry, throughput)
+{
+    static const unsigned int FRAMES = 200;
+    static const unsigned int SAMPLES = Telemetry::MAX_PAYLOAD / 3;
+    HostSystem system;
+    Line line(system);
+    Dma dma(line.dma());
+    InterruptController::Line dmaInterrupt(system.mNvic, DMA_TX_INDEX);
+    Dma::Stream stream(dma, Dma::Stream::StreamIndex::Stream6, Dma::Stream::ChannelIndex::Channel4, &dmaInterrupt);
+    line.setTxStream(&stream, &dmaInterrupt);
+    Serial serial(line.usart(), &system.mRcc, ClockControl::Clock::APB1);
+    serial.config(921600);
+    serial.configDma(&stream, nullptr);
+    serial.writeFifo(new Console(1024, Console::Overflow::Drop));
+    serial.enable(Device::All);
+    Crc crc;
+    Telemetry telemetry(serial, crc);
+
+    int8_t samples[SAMPLES * 3];
+    unsigned int textSize = 0;
+    for (unsigned int frame = 0; frame < FRAMES; )
+    {
+        for (unsigned int i = 0; i < sizeof(samples); ++i) samples[i] = static_cast<int8_t>(frame * 31 + i * 7);
+        // waits for room instead of dropping
+        if (telemetry.ready(sizeof(samples)))
+        {
+            EXPECT_TRUE(telemetry.send(Telemetry::Type::Acceleration, samples, sizeof(samples)));
+            char text[32];
+            for (unsigned int i = 0; i < SAMPLES; ++i) textSize += std::sprintf(text, "%4d %4d %4d\n", samples[3 * i], samples[3 * i + 1], samples[3 * i + 2]);
+            ++frame;
+        }
+        line.poll();
+        // the next samples are ready
+        system.run(50000);
+    }
+    system.run(100000000);
+
+    EXPECT_EQ(0, telemetry.dropped());
+    TelemetryDecoder decoder;
+    decoder.decode(line.sent().data(), line.sent().size());
+    decoder.finish();
+    ASSERT_EQ(FRAMES, decoder.frames().size());
+    EXPECT_EQ(0, decoder.lost());
+    EXPECT_TRUE(std::equal(samples, samples + sizeof(samples), reinterpret_cast<const int8_t*>(decoder.frames().back().mPayload.data())));
+
+    unsigned int payload = FRAMES * sizeof(samples);
+    uint64_t time = line.idleTime() + line.sent().size() * BYTE_NS;
+    double efficiency = static_cast<double>(payload * BYTE_NS) / time;
+    std::printf("%u samples: %u bytes binary, %u bytes as text, %.1f%% of the line rate is payload (%.1f%% as text)\n", FRAMES * SAMPLES,
+                static_cast<unsigned int>(line.sent().size()), textSize, efficiency * 100, 100.0 * payload / textSize);
+    EXPECT_LE(0.95, efficiency);
+}
@@ -0,0 +1,156 @@
+#include "../Timebase.h"
+#include "../Dwt.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#define SIZE_OF_RCC 0x88
+#define SIZE_OF_DWT 0x20
+#define SIZE_OF_COREDEBUG 0x10
+
+static volatile uint32_t gCounter;
+
+// RCC memory that lets ClockControl::setSystemClock() go through, starting with the 16MHz internal clock
+class Rcc
+{
+public:
+    Rcc() : mClock(reinterpret_cast<unsigned long>(mData), 8000000)
+    {
+        std::memset(mData, 0, sizeof(mData));
+        mData[0] |= 0x02020000;  // HSERDY, PLLRDY
+    }
+
+    void setPll()
+    {
+        mData[2] |= 0x00000008;  // SWS = 2
+    }
+
+    uint32_t mData[SIZE_OF_RCC / 4];
+    ClockControl mClock;
+};
+
+TEST(Timebase, conversion)
+{
+    static_assert(Timebase::cyclesToNs(16, Timebase::multiplier(16000000)) == 1000, "constexpr conversion");
+    EXPECT_EQ(1000000000, Timebase::cyclesToNs(168000000, Timebase::multiplier(168000000)));
+    // the longest stretch without an update(), the rounding of the multiplier stays below 1ppb
+    EXPECT_NEAR(100000000000ull, Timebase::cyclesToNs(100ull * 168000000, Timebase::multiplier(168000000)), 100);
+    EXPECT_EQ(168, Timebase::nsToCycles(1000, Timebase::inverse(168000000)));
+    // never shorter than asked for
+    EXPECT_EQ(6, Timebase::nsToCycles(30, Timebase::inverse(168000000)));
+    EXPECT_EQ(1, Timebase::nsToCycles(1, Timebase::inverse(16000000)));
+    EXPECT_EQ(0, Timebase::nsToCycles(0, Timebase::inverse(16000000)));
+}
+
+TEST(Timebase, overflow)
+{
+    Rcc rcc;
+    gCounter = 0xffffff00;
+    Timebase timebase(&gCounter, &rcc.mClock);
+    EXPECT_EQ(0, timebase.ns());
+    gCounter = 0xffffffff;
+    EXPECT_EQ(0xffffffff, timebase.cycles());
+    gCounter = 0x10;
+    EXPECT_EQ(0x100000010ull, timebase.cycles());
+    // 16MHz, 62.5ns per cycle
+    EXPECT_EQ((0x100000010ull - 0xffffff00) * 125 / 2, timebase.ns());
+
+    // an hour in steps of half a wrap, with an update in between like SysTick does
+    uint64_t cycles = timebase.cycles();
+    uint64_t last = timebase.ns();
+    for (unsigned int i = 0; i < 3600 * 16 / 256; ++i)
+    {
+        for (unsigned int j = 0; j < 2; ++j)
+        {
+            gCounter += 0x7ffffffe;
+            cycles += 0x7ffffffe;
+            timebase.update();
+        }
+        EXPECT_EQ(cycles, timebase.cycles());
+        uint64_t ns = timebase.ns();
+        EXPECT_GT(ns, last);
+        last = ns;
+    }
+    EXPECT_EQ((cycles - 0xffffff00) * 125 / 2, timebase.ns());
+}
+
+TEST(Timebase, clockChange)
+{
+    Rcc rcc;
+    gCounter = 0;
+    Timebase timebase(&gCounter, &rcc.mClock);
+    gCounter = 16000000;
+    EXPECT_EQ(1000000000, timebase.ns());
+    rcc.setPll();
+    ASSERT_TRUE(rcc.mClock.setSystemClock(168000000));
+    ASSERT_EQ(168000000, rcc.mClock.clock(ClockControl::Clock::AHB));
+    // continues where it was, at the new clock
+    EXPECT_EQ(1000000000, timebase.ns());
+    gCounter += 168000000;
+    EXPECT_EQ(2000000000, timebase.ns());
+    gCounter += 168;
+    EXPECT_EQ(2000001000, timebase.ns());
+}
+
+TEST(Timebase, warmReset)
+{
+    Rcc rcc;
+    // the counter kept running over a reset with the trace enable still set
+    uint32_t dwtMemory[SIZE_OF_DWT / 4] = { 0x00000001, 0x9abcdef0 };
+    uint32_t coreDebugMemory[SIZE_OF_COREDEBUG / 4] = { 0, 0, 0, 0x01000000 };
+    Dwt dwt(reinterpret_cast<System::BaseAddress>(dwtMemory), reinterpret_cast<System::BaseAddress>(coreDebugMemory));
+    Timebase timebase(dwt.cycleCounter(), &rcc.mClock);
+    EXPECT_EQ(1, dwtMemory[0] & 1);
+    EXPECT_EQ(0x01000000, coreDebugMemory[3]);
+    EXPECT_EQ(0, timebase.cycles());
+    dwtMemory[1] += 16;
+    EXPECT_EQ(16, timebase.cycles());
+    EXPECT_EQ(1000, timebase.ns());
+
+    // and from a cold one
+    std::memset(dwtMemory, 0, sizeof(dwtMemory));
+    std::memset(coreDebugMemory, 0, sizeof(coreDebugMemory));
+    Dwt cold(reinterpret_cast<System::BaseAddress>(dwtMemory), reinterpret_cast<System::BaseAddress>(coreDebugMemory));
+    EXPECT_EQ(1, dwtMemory[0] & 1);
+    EXPECT_EQ(0x01000000, coreDebugMemory[3]);
+}
+
+TEST(Timebase, nonzeroStart)
+{
+    Rcc rcc;
+    gCounter = 0x12345678;
+    Timebase timebase(&gCounter, &rcc.mClock);
+    EXPECT_EQ(0, timebase.ns());
+    gCounter += 16;
+    EXPECT_EQ(1000, timebase.ns());
+    EXPECT_EQ(0x12345688, timebase.cycles());
+}
+
+TEST(Timebase, benchmark)
+{
+    static const unsigned int CALL_COUNT = 1000000;
+    HostSystem system;
+    Timebase timebase(&gCounter, &system.mRcc);
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < CALL_COUNT; ++i)
+    {
+        gCounter += 100;
+        sum += timebase.ns();
+    }
+    auto dwt = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < CALL_COUNT; ++i)
+    {
+        sum += system.mSysTick.ns();
+    }
+    auto sysTick = std::chrono::steady_clock::now();
+    typedef std::chrono::nanoseconds ns;
+    std::printf("ns() call: cycle counter %lu ns, SysTick %lu ns\n",
+                static_cast<unsigned long>(std::chrono::duration_cast<ns>(dwt - start).count() / CALL_COUNT),
+                static_cast<unsigned long>(std::chrono::duration_cast<ns>(sysTick - dwt).count() / CALL_COUNT));
+    EXPECT_NE(0, sum);
+}
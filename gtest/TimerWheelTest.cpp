@@ -0,0 +1,211 @@
+#include "../TimerWheel.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+class TestTimer : public TimerWheel::Timer
+{
+public:
+    TestTimer() : mWheel(nullptr), mOther(nullptr), mReadd(0) { }
+
+    TimerWheel* mWheel;
+    std::vector<uint64_t> mFired;
+    // removed from within the callback
+    TestTimer* mOther;
+    // added again from within the callback
+    uint32_t mReadd;
+
+protected:
+    virtual void expired()
+    {
+        mFired.push_back(mWheel->now());
+        if (mOther != nullptr) mWheel->remove(mOther);
+        if (mReadd != 0) mWheel->add(this, mReadd);
+    }
+};
+
+TEST(TimerWheel, oneShot)
+{
+    TimerWheel wheel;
+    TestTimer timer;
+    timer.mWheel = &wheel;
+    wheel.add(&timer, 5);
+    EXPECT_TRUE(timer.active());
+    EXPECT_EQ(1, wheel.count());
+    EXPECT_EQ(5, wheel.next(1000));
+    wheel.advance(4);
+    EXPECT_EQ(0, timer.mFired.size());
+    EXPECT_EQ(1, wheel.next(1000));
+    wheel.advance(1);
+    ASSERT_EQ(1, timer.mFired.size());
+    EXPECT_EQ(5, timer.mFired[0]);
+    EXPECT_FALSE(timer.active());
+    EXPECT_EQ(0, wheel.count());
+    EXPECT_EQ(1000, wheel.next(1000));
+    wheel.advance(1000);
+    EXPECT_EQ(1, timer.mFired.size());
+
+    // 0 means as soon as possible, which is the next ms
+    wheel.add(&timer, 0);
+    wheel.advance(1);
+    EXPECT_EQ(2, timer.mFired.size());
+}
+
+TEST(TimerWheel, repeating)
+{
+    TimerWheel wheel;
+    TestTimer timer;
+    timer.mWheel = &wheel;
+    wheel.add(&timer, 10, 10);
+    wheel.advance(1000);
+    ASSERT_EQ(100, timer.mFired.size());
+    for (unsigned int i = 0; i < timer.mFired.size(); ++i) EXPECT_EQ((i + 1) * 10, timer.mFired[i]);
+    EXPECT_TRUE(timer.active());
+    wheel.remove(&timer);
+    EXPECT_FALSE(timer.active());
+    wheel.advance(1000);
+    EXPECT_EQ(100, timer.mFired.size());
+    EXPECT_EQ(0, wheel.count());
+}
+
+TEST(TimerWheel, removeInCallback)
+{
+    TimerWheel wheel;
+    TestTimer first;
+    TestTimer second;
+    first.mWheel = second.mWheel = &wheel;
+    first.mOther = &second;
+    first.mReadd = 7;
+    wheel.add(&first, 3);
+    wheel.add(&second, 3);
+    wheel.advance(20);
+    // whoever comes first in the slot, the first one removes the second or the second one fired before
+    EXPECT_LE(second.mFired.size(), 1);
+    ASSERT_EQ(3, first.mFired.size());
+    EXPECT_EQ(3, first.mFired[0]);
+    EXPECT_EQ(10, first.mFired[1]);
+    EXPECT_EQ(17, first.mFired[2]);
+}
+
+TEST(TimerWheel, exactExpire)
+{
+    static const unsigned int TIMER_COUNT = 500;
+    TimerWheel wheel;
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<uint32_t> delay(1, 1 << 26);
+    std::uniform_int_distribution<uint32_t> step(1, 100000);
+    std::vector<TestTimer> timer(TIMER_COUNT);
+    std::vector<uint64_t> expire(TIMER_COUNT);
+    for (unsigned int i = 0; i < TIMER_COUNT; ++i)
+    {
+        timer[i].mWheel = &wheel;
+        // some in every level and some beyond the wheel
+        uint32_t ms = delay(generator) >> (i % 24);
+        expire[i] = ms == 0 ? 1 : ms;
+        wheel.add(&timer[i], ms);
+    }
+    // in arbitrary chunks, like a tickless SysTick would
+    while (wheel.now() < (1 << 26) + 1) wheel.advance(step(generator));
+    for (unsigned int i = 0; i < TIMER_COUNT; ++i)
+    {
+        ASSERT_EQ(1, timer[i].mFired.size()) << "timer " << i << " expire " << expire[i];
+        EXPECT_EQ(expire[i], timer[i].mFired[0]);
+    }
+    EXPECT_EQ(0, wheel.count());
+}
+
+TEST(TimerWheel, tickless)
+{
+    TimerWheel wheel;
+    TestTimer timer;
+    timer.mWheel = &wheel;
+    wheel.add(&timer, 200, 200);
+    unsigned int ticks = 0;
+    while (wheel.now() < 10000)
+    {
+        wheel.advance(wheel.next(1000));
+        ++ticks;
+    }
+    EXPECT_EQ(50, timer.mFired.size());
+    // woken for the timer and for each cascade, never every ms
+    EXPECT_LE(ticks, 50 + 10000 / TimerWheel::SLOT_COUNT + 1);
+}
+
+// The old SysTickControl::tick(), walking all events on every tick
+struct LinearTimer
+{
+    uint32_t mMs;
+    uint32_t mMsFromStart;
+};
+
+TEST(TimerWheel, benchmark)
+{
+    static const unsigned int TIMER_COUNT = 1000;
+    static const uint32_t DURATION = 60000;
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<uint32_t> period(1, 1000);
+    std::vector<uint32_t> periods(TIMER_COUNT);
+    for (uint32_t& p : periods) p = period(generator);
+
+    TimerWheel wheel;
+    std::vector<TestTimer> timer(TIMER_COUNT);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < TIMER_COUNT; ++i)
+    {
+        timer[i].mWheel = &wheel;
+        wheel.add(&timer[i], periods[i], periods[i]);
+    }
+    auto added = std::chrono::steady_clock::now();
+    unsigned int ticks = 0;
+    while (wheel.now() < DURATION)
+    {
+        wheel.advance(wheel.next(1000));
+        ++ticks;
+    }
+    auto run = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < TIMER_COUNT; ++i) wheel.remove(&timer[i]);
+    auto removed = std::chrono::steady_clock::now();
+    unsigned int expired = 0;
+    for (unsigned int i = 0; i < TIMER_COUNT; ++i)
+    {
+        EXPECT_EQ(DURATION / periods[i], timer[i].mFired.size());
+        expired += timer[i].mFired.size();
+    }
+
+    std::vector<LinearTimer> linear(TIMER_COUNT);
+    for (unsigned int i = 0; i < TIMER_COUNT; ++i) linear[i] = { periods[i], 0 };
+    auto linearStart = std::chrono::steady_clock::now();
+    unsigned int linearTicks = 0;
+    unsigned int linearExpired = 0;
+    uint32_t nextTick = 1;
+    for (uint32_t now = 0; now < DURATION; now += nextTick)
+    {
+        uint32_t passed = nextTick;
+        nextTick = 1000;
+        for (LinearTimer& t : linear)
+        {
+            t.mMsFromStart += passed;
+            if (t.mMsFromStart >= t.mMs)
+            {
+                ++linearExpired;
+                t.mMsFromStart -= t.mMs;
+            }
+            if (t.mMs - t.mMsFromStart < nextTick) nextTick = t.mMs - t.mMsFromStart;
+        }
+        ++linearTicks;
+    }
+    auto linearEnd = std::chrono::steady_clock::now();
+
+    typedef std::chrono::nanoseconds ns;
+    std::printf("%u timers, %ums: add %lu ns, remove %lu ns, %u ticks, %u expired, %lu ns per expire (linear walk: %u ticks, %lu ns per expire)\n",
+                TIMER_COUNT, DURATION,
+                static_cast<unsigned long>(std::chrono::duration_cast<ns>(added - start).count() / TIMER_COUNT),
+                static_cast<unsigned long>(std::chrono::duration_cast<ns>(removed - run).count() / TIMER_COUNT),
+                ticks, expired, static_cast<unsigned long>(std::chrono::duration_cast<ns>(run - added).count() / expired),
+                linearTicks, static_cast<unsigned long>(std::chrono::duration_cast<ns>(linearEnd - linearStart).count() / linearExpired));
+    EXPECT_EQ(0, wheel.count());
+}
@@ -0,0 +1,78 @@
+#include "../hw/tlc5940.h"
+#include "HostSystem.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#define SIZE_OF_GPIO 0x28
+#define SIZE_OF_TIMER 0x54
+
+// takes the transfers instead of a bus, with the frames as they go out
+class Frames : public Spi::Chip
+{
+public:
+    Frames(Spi& spi) : Spi::Chip(spi) { }
+
+    virtual bool transfer(Spi::Transfer* transfer)
+    {
+        mWordSize = transfer->mWordSize;
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(transfer->mWriteData);
+        mFrames.assign(data, data + transfer->mLength / 2);
+        ++mCount;
+        return true;
+    }
+
+    // the 12 bits of channel, 15 is sent first and every frame MSB first
+    unsigned int channel(unsigned int index)
+    {
+        unsigned int value = 0;
+        for (unsigned int bit = 12 * (15 - index); bit < 12 * (16 - index); ++bit)
+        {
+            value = (value << 1) | ((mFrames[bit / 16] >> (15 - bit % 16)) & 1);
+        }
+        return value;
+    }
+
+    Spi::WordSize mWordSize = Spi::WordSize::Bits8;
+    std::vector<uint16_t> mFrames;
+    unsigned int mCount = 0;
+};
+
+TEST(Tlc5940, grayscaleFrames)
+{
+    static const int PERCENT[16] = { 100, 99, 95, 90, 80, 75, 70, 60, 50, 40, 30, 20, 10, 0, 100, 99 };
+    static const unsigned int VALUE[16] = { 4095, 3768, 2701, 1782, 775, 511, 337, 146, 63, 27, 11, 4, 1, 0, 4095, 3768 };
+    HostSystem system;
+    uint32_t gpioMemory[SIZE_OF_GPIO / 4] = { };
+    uint32_t pwmMemory[SIZE_OF_TIMER / 4] = { };
+    uint32_t latchMemory[SIZE_OF_TIMER / 4] = { };
+    Gpio gpio(reinterpret_cast<System::BaseAddress>(gpioMemory));
+    Gpio::Pin xlat(gpio, Gpio::Index::Pin0);
+    Gpio::Pin blank(gpio, Gpio::Index::Pin1);
+    Timer pwm(reinterpret_cast<System::BaseAddress>(pwmMemory), ClockControl::Clock::APB2);
+    Timer latch(reinterpret_cast<System::BaseAddress>(latchMemory), ClockControl::Clock::APB1);
+    Spi spi(0, nullptr, ClockControl::Clock::APB2);
+    Frames frames(spi);
+    Tlc5940 tlc(frames, xlat, blank, pwm, latch);
+
+    for (int i = 0; i < 16; ++i) tlc.setOutput(i, PERCENT[i]);
+    tlc.send();
+    ASSERT_EQ(1u, frames.mCount);
+    EXPECT_EQ(Spi::WordSize::Bits16, frames.mWordSize);
+    // 192 bits
+    ASSERT_EQ(12u, frames.mFrames.size());
+    for (unsigned int i = 0; i < 16; ++i) EXPECT_EQ(VALUE[i], frames.channel(i)) << i;
+
+    // the neighbours in the same frames stay
+    tlc.setOutput(3, 0);
+    tlc.setOutput(10, 100);
+    tlc.send();
+    ASSERT_EQ(2u, frames.mCount);
+    for (unsigned int i = 0; i < 16; ++i) EXPECT_EQ(i == 3 ? 0 : (i == 10 ? 4095 : VALUE[i]), frames.channel(i)) << i;
+
+    // nothing new, nothing sent
+    tlc.setOutput(3, 0);
+    tlc.send();
+    EXPECT_EQ(2u, frames.mCount);
+}
@@ -0,0 +1,151 @@
+#include "../Trace.h"
+#include "../tools/TraceDecoder.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static uint32_t gCycles;
+
+// what the trace command writes, with console output around it
+static std::vector<char> dump(const Trace& trace, uint32_t clock)
+{
+    static const char PROMPT[] = "> trace\n";
+    std::vector<char> data(PROMPT, PROMPT + sizeof(PROMPT) - 1);
+    Trace::Header header;
+    trace.header(header, clock);
+    const char* p = reinterpret_cast<const char*>(&header);
+    data.insert(data.end(), p, p + sizeof(header));
+    for (unsigned int i = 0; i < header.mCount; ++i)
+    {
+        p = reinterpret_cast<const char*>(&trace.record(i));
+        data.insert(data.end(), p, p + sizeof(Trace::Record));
+    }
+    static const char DONE[] = "\n12 records, 0 lost.\n";
+    data.insert(data.end(), DONE, DONE + sizeof(DONE) - 1);
+    return data;
+}
+
+static std::string json(const TraceDecoder& decoder)
+{
+    char* buffer = nullptr;
+    std::size_t size = 0;
+    FILE* out = open_memstream(&buffer, &size);
+    decoder.writeJson(out);
+    std::fclose(out);
+    std::string result(buffer, size);
+    std::free(buffer);
+    return result;
+}
+
+TEST(Trace, roundTrip)
+{
+    Trace* trace = new Trace;
+    trace->setCounter(&gCycles);
+    int event;
+    // starts right before the counter wraps
+    gCycles = 0xfffff000;
+    trace->record(Trace::Type::EventDispatch, &event);
+    gCycles += 0x800;
+    trace->record(Trace::Type::InterruptEnter, 16 + 38);
+    gCycles += 0x400;
+    trace->record(Trace::Type::EventPost, &event);
+    gCycles += 0x400;
+    trace->record(Trace::Type::InterruptExit, 16 + 38);
+    gCycles += 0x100;
+    trace->record(Trace::Type::Marker, 42);
+    gCycles += 0x100;
+    trace->record(Trace::Type::EventDone, &event);
+    // an interrupt that got in between claiming the slot and reading the counter
+    gCycles -= 0x10;
+    trace->record(Trace::Type::InterruptEnter, 15);
+    EXPECT_EQ(7, trace->count());
+    EXPECT_EQ(0, trace->lost());
+
+    std::vector<char> data = dump(*trace, 168000000);
+    TraceDecoder decoder;
+    ASSERT_TRUE(decoder.decode(data.data(), data.size()));
+    EXPECT_EQ(168000000, decoder.clock());
+    EXPECT_EQ(0, decoder.lost());
+    const std::vector<TraceDecoder::Entry>& entries = decoder.entries();
+    ASSERT_EQ(7, entries.size());
+    static const int64_t CYCLES[] = { 0, 0x800, 0xc00, 0x1000, 0x1100, 0x1200, 0x11f0 };
+    static const Trace::Type TYPE[] = { Trace::Type::EventDispatch, Trace::Type::InterruptEnter, Trace::Type::EventPost, Trace::Type::InterruptExit,
+                                        Trace::Type::Marker, Trace::Type::EventDone, Trace::Type::InterruptEnter };
+    for (unsigned int i = 0; i < entries.size(); ++i)
+    {
+        EXPECT_EQ(CYCLES[i], entries[i].mCycles) << "record " << i;
+        EXPECT_EQ(TYPE[i], entries[i].mType) << "record " << i;
+    }
+    EXPECT_EQ(Trace::address(Trace::pack(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&event)))), entries[0].mData);
+    EXPECT_EQ(16 + 38, entries[1].mData);
+    EXPECT_EQ(42, entries[4].mData);
+
+    std::string out = json(decoder);
+    EXPECT_NE(std::string::npos, out.find("\"name\":\"IRQ 38\",\"cat\":\"interrupt\",\"ph\":\"B\",\"ts\":12.190"));
+    EXPECT_NE(std::string::npos, out.find("\"name\":\"marker 42\""));
+    EXPECT_NE(std::string::npos, out.find("\"name\":\"SysTick\""));
+    // posted from the interrupt
+    EXPECT_NE(std::string::npos, out.find("\"ph\":\"i\",\"s\":\"t\",\"ts\":18.286,\"pid\":1,\"tid\":1"));
+    delete trace;
+}
+
+TEST(Trace, addressRegions)
+{
+    Trace* trace = new Trace;
+    trace->setCounter(&gCycles);
+    gCycles = 0;
+    // the same offset in the CCM, the SRAM and the flash
+    static const uint32_t ADDRESS[] = { 0x1000a5a0, 0x2000a5a0, 0x0800a5a0, 0x2001fffc };
+    for (uint32_t address : ADDRESS) trace->record(Trace::Type::EventPost, Trace::pack(address));
+
+    std::vector<char> data = dump(*trace, 168000000);
+    TraceDecoder decoder;
+    ASSERT_TRUE(decoder.decode(data.data(), data.size()));
+    const std::vector<TraceDecoder::Entry>& entries = decoder.entries();
+    ASSERT_EQ(4, entries.size());
+    for (unsigned int i = 0; i < entries.size(); ++i) EXPECT_EQ(ADDRESS[i], entries[i].mData) << "record " << i;
+    std::string out = json(decoder);
+    EXPECT_NE(std::string::npos, out.find("\"name\":\"post 0x1000a5a0\""));
+    EXPECT_NE(std::string::npos, out.find("\"name\":\"post 0x2000a5a0\""));
+    delete trace;
+}
+
+TEST(Trace, overwrite)
+{
+    Trace* trace = new Trace;
+    trace->setCounter(&gCycles);
+    gCycles = 0;
+    for (unsigned int i = 0; i < Trace::SIZE + 10; ++i)
+    {
+        gCycles += 100;
+        trace->record(Trace::Type::Marker, i);
+    }
+    EXPECT_EQ(Trace::SIZE, trace->count());
+    EXPECT_EQ(10, trace->lost());
+    EXPECT_EQ(10, trace->record(0).data());
+
+    // nothing gets recorded while stopped
+    trace->enable(false);
+    trace->record(Trace::Type::Marker, 1234);
+    EXPECT_EQ(10, trace->lost());
+    trace->enable(true);
+
+    std::vector<char> data = dump(*trace, 1000000);
+    TraceDecoder decoder;
+    ASSERT_TRUE(decoder.decode(data.data(), data.size()));
+    EXPECT_EQ(10, decoder.lost());
+    ASSERT_EQ(Trace::SIZE, decoder.entries().size());
+    EXPECT_EQ(Trace::SIZE + 9, decoder.entries().back().mData);
+    EXPECT_EQ((Trace::SIZE - 1) * 100, decoder.entries().back().mCycles);
+    EXPECT_DOUBLE_EQ((Trace::SIZE - 1) * 100, decoder.us(decoder.entries().back().mCycles));
+
+    // cut off
+    EXPECT_FALSE(decoder.decode(data.data(), data.size() - 100));
+    trace->reset();
+    EXPECT_EQ(0, trace->count());
+    delete trace;
+}
@@ -1,6 +1,11 @@
 #include "adm1602.h"
 
-#include "../System.h"
+#include "../atomic.h"
+
+const unsigned int Adm1602::QUEUE_SIZE;
+const uint16_t Adm1602::RS;
+const uint16_t Adm1602::SLOW;
+const uint16_t Adm1602::POWER_UP;
 
 Adm1602::Adm1602(Gpio::Pin &enable, Gpio::Pin& rs, Gpio::Pin &d4, Gpio::Pin &d5, Gpio::Pin &d6, Gpio::Pin &d7) :
     mEnable(enable),
@@ -8,23 +13,27 @@ Adm1602::Adm1602(Gpio::Pin &enable, Gpio::Pin& rs, Gpio::Pin &d4, Gpio::Pin &d5,
     mData4(d4),
     mData5(d5),
     mData6(d6),
-    mData7(d7)
+    mData7(d7),
+    mQueue(),
+    mEvent(*this),
+    mBusy(false)
 {
     mData[0] = &mData4;
     mData[1] = &mData5;
     mData[2] = &mData6;
     mData[3] = &mData7;
+    System::instance()->setEventName(&mEvent, "adm1602");
 }
 
 void Adm1602::init()
 {
-    System::instance()->usleep(15000);
-    write(0x3); // Switch to 8bit so we can find or start
-    write(0x3); // Switch to 8bit so we can find or start
-    write(0x3); // Switch to 8bit so we can find or start
-    write(0x28); // DL = 0 -> 4bit, N = 1 -> 2 line, F = 0 -> 5x8
-    write(0x06); // Increase, no shift
-    write(0x0c); // Display on, cursor off
+    queue(POWER_UP);
+    queue(0x3); // Switch to 8bit so we can find or start
+    queue(0x3); // Switch to 8bit so we can find or start
+    queue(0x3); // Switch to 8bit so we can find or start
+    queue(0x28); // DL = 0 -> 4bit, N = 1 -> 2 line, F = 0 -> 5x8
+    queue(0x06); // Increase, no shift
+    queue(0x0c); // Display on, cursor off
 }
 
 void Adm1602::write(const char* str, unsigned len)
@@ -32,31 +41,64 @@ void Adm1602::write(const char* str, unsigned len)
     if (len > 0x20) len = 0x20;
     while (len > 0)
     {
-        write(*str++, true);
+        queue(static_cast<uint8_t>(*str++) | RS);
         --len;
     }
 }
 
 void Adm1602::moveTo(int addr)
 {
-    write(addr | 0x80);
+    queue((addr | 0x80) & 0xff);
 }
 
 void Adm1602::clear()
 {
-    write(0x01);
-    System::instance()->usleep(1600);
+    queue(0x01 | SLOW);
 }
 
 void Adm1602::home()
 {
-    write(0x02);
-    System::instance()->usleep(1600);
+    queue(0x02 | SLOW);
 }
 
 void Adm1602::cursor(bool on, bool blink)
 {
-    write(0x0c | (on ? 2 : 0) | (blink ? 1 : 0));
+    queue(0x0c | (on ? 2 : 0) | (blink ? 1 : 0));
+}
+
+void Adm1602::queue(uint16_t entry)
+{
+    uint32_t primask = interrupt_disable();
+    // the display is for debug messages, what doesn't fit gets lost
+    if (mQueue.push(entry) && !mBusy)
+    {
+        mBusy = true;
+        System::instance()->postEvent(&mEvent);
+    }
+    interrupt_restore(primask);
+}
+
+void Adm1602::eventCallback(System::Event *event)
+{
+    uint16_t entry;
+    uint32_t primask = interrupt_disable();
+    if (!mQueue.pop(entry))
+    {
+        mBusy = false;
+        interrupt_restore(primask);
+        return;
+    }
+    interrupt_restore(primask);
+
+    unsigned us = 40;
+    if ((entry & POWER_UP) != 0) us = 15000;
+    else
+    {
+        write(entry & 0xff, (entry & RS) != 0);
+        if ((entry & SLOW) != 0) us = 1600;
+    }
+    // back when the display is ready for the next one
+    System::instance()->postEventAfter(event, us * 1000ull);
 }
 
 void Adm1602::write(uint8_t data, bool rs)
@@ -75,7 +117,6 @@ void Adm1602::write(uint8_t data, bool rs)
     for (int i = 0; i < 4; ++i) mData[i]->set((data & (1 << i)) != 0);
     System::instance()->nspin(300); // Eneable set -> reset > 300ns, Data valid -> Enable reset > 60ns
     mEnable.reset();
-    System::instance()->usleep(40);
 }
 
 void Adm1602::debug()
@@ -92,3 +133,5 @@ void Adm1602::debug()
     buf[5] = ' ';
     System::instance()->consoleWrite(buf, 6);
 }
+
+template class StaticCircularBuffer<uint16_t, Adm1602::QUEUE_SIZE>;
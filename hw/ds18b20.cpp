@@ -1,40 +1,65 @@
 #include "ds18b20.h"
 
+const unsigned int Ds18b20::POLL_MS;
+const unsigned int Ds18b20::TIMEOUT_MS;
+
 Ds18b20::Ds18b20(Gpio::Pin &oneWire) :
-    mOneWire(oneWire)
+    mOneWire(oneWire),
+    mEvent(*this),
+    mDone(nullptr),
+    mTimeout(0),
+    mTemp(0)
 {
     setOverdriveSpeed(false);
+    System::instance()->setEventName(&mEvent, "ds18b20");
 }
 
-int Ds18b20::temp()
+void Ds18b20::measure(System::Event *done)
 {
+    mDone = done;
     if (reset())
     {
         writeByte(0xcc); // skip ROM, only one device
         writeByte(0x44); // convert
-
-        while (!mOneWire.get())
-        {
-
-        }
-
-        reset();
-        writeByte(0xcc); // skip ROM, only one device
-        writeByte(0xbe);
-
-        uint8_t buf[9];
-        for (int i = 0; i < 9; ++i) buf[i] = readByte();
-
-        printf("SP:");
-        for (int i = 0; i < 9; ++i) printf(" %02x", buf[i]);
-        printf("\n");
-        return (buf[1] << 8) | buf[0];
+        mTimeout = System::instance()->ns() + TIMEOUT_MS * 1000000ull;
+        System::instance()->postEventAfter(&mEvent, POLL_MS * 1000000ull);
     }
     else
     {
-        printf("No device found.\n");
+        finish(System::Event::Result::DataFail);
+    }
+}
+
+void Ds18b20::eventCallback(System::Event *event)
+{
+    // read slots get 0 while the conversion is running
+    if (!readBit())
+    {
+        if (System::instance()->ns() < mTimeout) System::instance()->postEventAfter(&mEvent, POLL_MS * 1000000ull);
+        else finish(System::Event::Result::DataFail);
+        return;
     }
-    return 0;
+
+    if (!reset())
+    {
+        finish(System::Event::Result::DataFail);
+        return;
+    }
+    writeByte(0xcc); // skip ROM, only one device
+    writeByte(0xbe); // read scratchpad
+    uint8_t buf[2];
+    for (int i = 0; i < 2; ++i) buf[i] = readByte();
+    // the rest of the scratchpad is not needed
+    reset();
+    mTemp = static_cast<int16_t>((buf[1] << 8) | buf[0]);
+    finish(System::Event::Result::DataSuccess);
+}
+
+void Ds18b20::finish(System::Event::Result result)
+{
+    if (mDone == nullptr) return;
+    mDone->setResult(result);
+    System::instance()->postEvent(mDone);
 }
 
 void Ds18b20::setOverdriveSpeed(bool overdrive)
@@ -4,15 +4,31 @@
 #include "../System.h"
 #include "../Gpio.h"
 
-class Ds18b20
+// The conversion runs while the event loop goes on, an event polls the sensor until it is done.
+// The time slots on the bus stay busy waits, they are too short and too tight for the event loop.
+class Ds18b20 : public System::Event::Callback
 {
 public:
     Ds18b20(Gpio::Pin& oneWire);
 
-    int temp();
+    // done gets posted when the temperature is there, with DataSuccess, or DataFail if the sensor didn't answer
+    void measure(System::Event* done);
+    // of the last measure(), in 1/16 degrees C
+    int temp() { return mTemp; }
+
+protected:
+    virtual void eventCallback(System::Event* event);
 
 private:
+    // 12 bit conversion takes 750ms
+    static const unsigned int POLL_MS = 50;
+    static const unsigned int TIMEOUT_MS = 1000;
+
     Gpio::Pin& mOneWire;
+    System::Event mEvent;
+    System::Event* mDone;
+    uint64_t mTimeout;
+    int mTemp;
     unsigned A;
     unsigned B;
     unsigned C;
@@ -26,6 +42,7 @@ private:
 
     void setOverdriveSpeed(bool overdrive);
     void usleep(unsigned us) { System::instance()->usleep(us); }
+    void finish(System::Event::Result result);
     bool reset();
     void writeBit(bool bit);
     bool readBit();
@@ -1,10 +1,11 @@
 #include "hcsr04.h"
 
 HcSr04::HcSr04(SysTickControl &sysTick, Gpio::ConfigurablePin& pin, ExternalInterrupt::Line* irq) :
-    mPins(&pin, &pin + 1), mIrqs(&irq, &irq + 1), mEvent(*this), mState(Init), mIndex(-1)
+    mPins(&pin, &pin + 1), mIrqs(&irq, &irq + 1), mEvent(*this, System::Event::Priority::High), mState(Init), mIndex(-1)
 {
     pin.configOutput(Gpio::OutputType::PushPull, Gpio::Pull::None, Gpio::Speed::Medium);
     clear();
+    System::instance()->setEventName(&mEvent, "hcsr04");
 }
 
 void HcSr04::addDevice(Gpio::ConfigurablePin &pin, ExternalInterrupt::Line *irq)
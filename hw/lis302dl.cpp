@@ -1,12 +1,23 @@
 #include "lis302dl.h"
 
+#include <cstdio>
+#include <cstring>
+
+const unsigned int LIS302DL::SAMPLE_TRANSFER_LENGTH;
+
 LIS302DL::LIS302DL(Spi::Chip &spi) :
     mTransferCompleteEvent(*this),
     mSpi(spi),
     mBuffer(new char[2]),
     mLine1(nullptr),
     mLine2(nullptr),
-    mDataReadyEvent(nullptr)
+    mDataReadyEvent(nullptr),
+    mSampleCount(0),
+    mSampleIndex(0),
+    mSamplePos(0),
+    mSampleReading(false),
+    mLostSamples(0),
+    mSampleCallback(nullptr)
 {
     memset(&mTransfer, 0, sizeof(mTransfer));
     mTransfer.mMaxSpeed = 10000000;
@@ -20,6 +31,17 @@ LIS302DL::LIS302DL(Spi::Chip &spi) :
     mTransfer.mReadData = mReadBuffer;
     mTransfer.mWriteData = mWriteBuffer;
     mTransfer.mLength = 2;
+
+    // OutX to OutZ in one go, with a register in between each of them
+    mSampleTransfer = mTransfer;
+    mSampleReadBuffer = new uint8_t[SAMPLE_TRANSFER_LENGTH];
+    mSampleWriteBuffer = new uint8_t[SAMPLE_TRANSFER_LENGTH];
+    memset(mSampleWriteBuffer, 0, SAMPLE_TRANSFER_LENGTH);
+    mSampleWriteBuffer[0] = READ | ADDR_INCR | static_cast<uint8_t>(Register::OutX);
+    mSampleTransfer.mReadData = mSampleReadBuffer;
+    mSampleTransfer.mWriteData = mSampleWriteBuffer;
+    mSampleTransfer.mLength = SAMPLE_TRANSFER_LENGTH;
+    mSampleTransfer.mEvent = &mTransferCompleteEvent;
 }
 
 void LIS302DL::enable()
@@ -49,6 +71,22 @@ void LIS302DL::setDataReadyEvent(System::Event *event)
     mDataReadyEvent = event;
 }
 
+void LIS302DL::startSampling(int8_t *buffer0, int8_t *buffer1, unsigned int count, Device::DoubleBufferCallback *callback)
+{
+    mSamples[0] = buffer0;
+    mSamples[1] = buffer1;
+    mSampleCount = count;
+    mSampleIndex = 0;
+    mSamplePos = 0;
+    mLostSamples = 0;
+    mSampleCallback = callback;
+}
+
+void LIS302DL::stopSampling()
+{
+    mSampleCallback = nullptr;
+}
+
 int8_t LIS302DL::x()
 {
     return static_cast<int8_t>(get(Register::OutX));
@@ -67,12 +105,32 @@ int8_t LIS302DL::z()
 
 void LIS302DL::eventCallback(System::Event *event)
 {
+    if (event != &mTransferCompleteEvent) return;
+    mSampleReading = false;
+    if (mSampleCallback == nullptr) return;
+    int8_t* sample = mSamples[mSampleIndex] + 3 * mSamplePos;
+    sample[0] = static_cast<int8_t>(mSampleReadBuffer[1]);
+    sample[1] = static_cast<int8_t>(mSampleReadBuffer[3]);
+    sample[2] = static_cast<int8_t>(mSampleReadBuffer[5]);
+    if (++mSamplePos == mSampleCount)
+    {
+        // the other one gets filled while this one is processed
+        unsigned int index = mSampleIndex;
+        mSampleIndex ^= 1;
+        mSamplePos = 0;
+        mSampleCallback->bufferComplete(index, mSamples[index], 3 * mSampleCount);
+    }
 }
 
 void LIS302DL::interruptCallback(InterruptController::Index index)
 {
     if (index == mLine1->index())
     {
+        if (mSampleCallback != nullptr)
+        {
+            if (mSampleReading) ++mLostSamples;
+            else mSampleReading = mSpi.transfer(&mSampleTransfer);
+        }
         if (mDataReadyEvent != 0) System::instance()->postEvent(mDataReadyEvent);
     }
     else if (index == mLine2->index())
@@ -16,6 +16,12 @@ public:
 
     void configInterrupt(ExternalInterrupt::Line* line1, ExternalInterrupt::Line* line2);
     void setDataReadyEvent(System::Event* event);
+    // Reads x, y and z on each data ready into buffer0 and buffer1 taking turns, count samples of 3 bytes
+    // each. Like the double buffer mode of the DMA, but the chip needs its address for every sample, so it
+    // can't be one SPI transfer for good. A sample that comes before the last one was read gets lost.
+    void startSampling(int8_t* buffer0, int8_t* buffer1, unsigned int count, Device::DoubleBufferCallback* callback);
+    void stopSampling();
+    unsigned int lostSamples() { return mLostSamples; }
 
     int8_t x();
     int8_t y();
@@ -106,6 +112,9 @@ protected:
         ADDR_CONST = 0x00,
     };
 
+    // the command and OutX to OutZ
+    static const unsigned int SAMPLE_TRANSFER_LENGTH = 6;
+
     System::Event mTransferCompleteEvent;
     Spi::Chip& mSpi;
     char* mBuffer;
@@ -115,6 +124,16 @@ protected:
     Spi::Transfer mTransfer;
     uint8_t* mReadBuffer;
     uint8_t* mWriteBuffer;
+    Spi::Transfer mSampleTransfer;
+    uint8_t* mSampleReadBuffer;
+    uint8_t* mSampleWriteBuffer;
+    int8_t* mSamples[2];
+    unsigned int mSampleCount;
+    unsigned int mSampleIndex;
+    unsigned int mSamplePos;
+    bool mSampleReading;
+    unsigned int mLostSamples;
+    Device::DoubleBufferCallback* mSampleCallback;
 
     virtual void eventCallback(System::Event* event);
     void interruptCallback(InterruptController::Index index);
@@ -121,6 +121,7 @@ Ssd1306::Ssd1306(Spi::Chip& spi, Gpio::Pin &cs, Gpio::Pin& dataCommand, Gpio::Pi
     mTransfer.mEndianess = Spi::Endianess::MsbFirst;
     mTransfer.mEvent = &mSpiEvent;
     mTransfer.mLength = 2;
+    System::instance()->setEventName(&mSpiEvent, "ssd1306");
 //    for (int i = 0; i < 256; ++i)
 //    {
 //        printf("{%02x, %02x, %02x, %02x, %02x}")
@@ -7,21 +7,24 @@ Tlc5940::Tlc5940(Spi::Chip& spi, Gpio::Pin &xlat, Gpio::Pin &blank, Timer &gsclk
     mPwm(gsclkPwm),
     mLatch(gsclkLatch),
     mModified(true),
-    mLatchEvent(*this),
+    mLatchEvent(*this, System::Event::Priority::High),
     mSpiEvent(*this),
     mNewData(false)
 {
-    mGrayScaleData = new uint8_t[GRAYSCALE_DATA_COUNT];
-    std::memset(mGrayScaleData, 0, GRAYSCALE_DATA_COUNT);
+    mGrayScaleData = new uint16_t[GRAYSCALE_DATA_COUNT];
+    std::memset(mGrayScaleData, 0, GRAYSCALE_DATA_COUNT * sizeof(uint16_t));
     memset(&mTransfer, 0, sizeof(mTransfer));
     mTransfer.mMaxSpeed = 60 * 1000 * 1000;
     mTransfer.mChipSelect = 0;
     mTransfer.mClockPhase = Spi::ClockPhase::FirstTransition;
     mTransfer.mClockPolarity = Spi::ClockPolarity::LowWhenIdle;
     mTransfer.mEndianess = Spi::Endianess::MsbFirst;
+    mTransfer.mWordSize = Spi::WordSize::Bits16;
     mTransfer.mEvent = &mSpiEvent;
-    mTransfer.mWriteData = mGrayScaleData;
-    mTransfer.mLength = GRAYSCALE_DATA_COUNT;
+    System::instance()->setEventName(&mSpiEvent, "tlc5940 spi");
+    System::instance()->setEventName(&mLatchEvent, "tlc5940");
+    mTransfer.mWriteData = reinterpret_cast<uint8_t*>(mGrayScaleData);
+    mTransfer.mLength = GRAYSCALE_DATA_COUNT * sizeof(uint16_t);
     mBlank.set();
     mXlat.reset();
     gsclkPwm.setMaster(Timer::MasterMode::Update);
@@ -35,7 +38,7 @@ Tlc5940::Tlc5940(Spi::Chip& spi, Gpio::Pin &xlat, Gpio::Pin &blank, Timer &gsclk
     gsclkLatch.enable();
 }
 
-// 00 01 11 22 23 33 44 45 55
+// 0001 1122 2333 4445 5566 6777
 // TIMER1 0x40010000
 // TIMER2 0x40000000
 
@@ -47,22 +50,21 @@ void Tlc5940::setOutput(int index, int percent)
     if (percent < 0) percent = 0;
     else if (percent >= static_cast<int>(sizeof(table) / sizeof(table[0]))) percent = sizeof(table) / sizeof(table[0]) - 1;
     int value = table[percent] & 0xfff;
-    int i = 15 - index;
+    // channel 15 goes out first, MSB first, it takes two frames when it doesn't fit into one
+    unsigned bit = 12 * (15 - index);
+    unsigned word = bit / 16;
+    unsigned shift = bit % 16;
+    bool two = shift > 4;
+    uint32_t mask = 0xfff00000 >> shift;
 
-    uint8_t old[2];
-    old[0] = mGrayScaleData[i + i / 2];
-    old[1] = mGrayScaleData[i + i / 2 + 1];
-    if ((i % 2) == 0)
-    {
-        mGrayScaleData[i + i / 2] = value >> 4;
-        mGrayScaleData[i + i / 2 + 1] = (mGrayScaleData[i + i / 2 + 1] & 0x0f) | ((value << 4) & 0xf0);
-    }
-    else
-    {
-        mGrayScaleData[i + i / 2] = (mGrayScaleData[i + i / 2] & 0xf0) | ((value >> 8) & 0x0f);
-        mGrayScaleData[i + i / 2 + 1] = value;
-    }
-    if (old[0] != mGrayScaleData[i + i / 2] || old[1] != mGrayScaleData[i + i / 2 + 1]) mModified = true;
+    uint16_t old[2];
+    old[0] = mGrayScaleData[word];
+    old[1] = two ? mGrayScaleData[word + 1] : 0;
+    uint32_t frames = (static_cast<uint32_t>(old[0]) << 16) | old[1];
+    frames = (frames & ~mask) | ((static_cast<uint32_t>(value) << 20) >> shift);
+    mGrayScaleData[word] = frames >> 16;
+    if (two) mGrayScaleData[word + 1] = frames;
+    if (old[0] != mGrayScaleData[word] || (two && old[1] != mGrayScaleData[word + 1])) mModified = true;
 }
 
 
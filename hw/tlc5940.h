@@ -13,7 +13,8 @@ public:
     void send();
 
 private:
-    static const int GRAYSCALE_DATA_COUNT = 16 + 8;
+    // 16 channels of 12 bits, in 16 bit frames
+    static const int GRAYSCALE_DATA_COUNT = 12;
     Spi::Chip& mSpi;
     Gpio::Pin& mXlat;
     Gpio::Pin& mBlank;
@@ -21,7 +22,7 @@ private:
     Timer& mLatch;
 
     bool mModified;
-    uint8_t* mGrayScaleData;
+    uint16_t* mGrayScaleData;
     System::Event mLatchEvent;
     System::Event mSpiEvent;
     bool mNewData;
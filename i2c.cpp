@@ -51,13 +51,13 @@ void I2C::configDma(Dma::Stream *write, Dma::Stream *read)
     {
         mDmaWrite->config(Dma::Stream::Direction::MemoryToPeripheral, false, true, dataSize, dataSize, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
         mDmaWrite->setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(&mBase->DR));
-        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Quater);
+        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Auto);
     }
     if (Device::mDmaRead != nullptr)
     {
         mDmaRead->config(Dma::Stream::Direction::PeripheralToMemory, false, true, dataSize, dataSize, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
         mDmaRead->setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(&mBase->DR));
-        mDmaWrite->configFifo(Dma::Stream::FifoThreshold::Quater);
+        mDmaRead->configFifo(Dma::Stream::FifoThreshold::Auto);
     }
 }
 
@@ -158,31 +158,31 @@ void I2C::interruptCallback(InterruptController::Index index)
     {
         if (sr1.BERR)
         {
-            printf("Bus error\n");
+            LOG_ERROR("I2C: bus error");
         }
         if (sr1.ARLO)
         {
-            printf("Arbitration lost\n");
+            LOG_ERROR("I2C: arbitration lost");
         }
         if (sr1.AF)
         {
-            printf("Acknowledge failure\n");
+            LOG_ERROR("I2C: acknowledge failure");
         }
         if (sr1.OVR)
         {
-            printf("Overrun/Underrun\n");
+            LOG_ERROR("I2C: overrun/underrun");
         }
         if (sr1.PECERR)
         {
-            printf("PEC error\n");
+            LOG_ERROR("I2C: PEC error");
         }
         if (sr1.TIMEOUT)
         {
-            printf("Timeout\n");
+            LOG_ERROR("I2C: timeout");
         }
         if (sr1.SMBALERT)
         {
-            printf("SMBus alert\n");
+            LOG_ERROR("I2C: SMBus alert");
         }
         *((uint16_t*)&mBase->SR1) = 0;
         mTransferBuffer.skip(1);
@@ -44,7 +44,7 @@ int main()
     gSys.mRcc.enable(ClockControl::Function::Dma1);
     gSys.mRcc.enable(ClockControl::Function::Dma2);
 
-    CommandInterpreter interpreter(gSys);
+    CommandInterpreter interpreter(gSys, gSys.mDebug, gSys.mRcc);
 
     gSys.mRcc.enable(ClockControl::Function::GpioD);
 
@@ -56,12 +56,17 @@ int main()
     gSys.mGpioD.set(Gpio::Index::Pin12);
     interpreter.add(new CmdHelp());
     interpreter.add(new CmdInfo(gSys));
+    interpreter.add(new CmdTop(gSys));
+    interpreter.add(new CmdTrace(gSys));
+    interpreter.add(new CmdLog(gSys));
+    interpreter.add(new CmdMemcpy(gSys));
     interpreter.add(new CmdFunc(gSys));
     interpreter.add(new CmdRead());
     interpreter.add(new CmdWrite());
 
     Lego lego;
     lego.init(gSys, interpreter);
+    gSys.mDmaManager.report();
 
     interpreter.start();
 
@@ -88,7 +93,7 @@ int main()
 
             gSys.mGpioD.set(Gpio::Index::Pin13);
             //printf("Event %p.\n", event);
-            event->callback();
+            gSys.dispatchEvent(event);
             gSys.mGpioD.reset(Gpio::Index::Pin13);
         }
     }
@@ -259,7 +259,7 @@ void Sdio::prepareTransfer(Direction direction, uint32_t* data, unsigned byteCou
     dctrl.bits.DTMODE = 0;
     mBase->DCTRL.value = dctrl.value;
     mDma.config((direction == Direction::Read) ? Dma::Stream::Direction::PeripheralToMemory : Dma::Stream::Direction::MemoryToPeripheral, false, true, Dma::Stream::DataSize::Word, Dma::Stream::DataSize::Word, Dma::Stream::BurstLength::Single, Dma::Stream::BurstLength::Single);
-    mDma.configFifo(Dma::Stream::FifoThreshold::Disable);
+    mDma.configFifo(Dma::Stream::FifoThreshold::Auto);
     mDma.setAddress(Dma::Stream::End::Memory, reinterpret_cast<System::BaseAddress>(data));
     mDma.setAddress(Dma::Stream::End::Peripheral, reinterpret_cast<System::BaseAddress>(mBase->FIFO));
     mDma.setCallback(this);
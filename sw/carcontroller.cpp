@@ -34,7 +34,7 @@ CarController::CarController(SysTickControl &sysTick, HcSr04& distance, int dist
                              Tlc5940& light) :
     mState(Stop),
     mCounter(0),
-    mTimer(*this, 100),
+    mTimer(*this, 100, System::Event::Priority::High),
     mDistance(distance),
     mDistanceLeft(distanceLeft),
     mDistanceRight(distanceRight),
@@ -50,6 +50,7 @@ CarController::CarController(SysTickControl &sysTick, HcSr04& distance, int dist
     mDestinationSpeed(0)
 {
     sysTick.addRepeatingEvent(&mTimer);
+    System::instance()->setEventName(&mTimer, "car");
     mLastDistanceIndex[0] = mDistanceFront;
     mLastDistanceIndex[1] = CENTER;
 }
@@ -376,11 +377,7 @@ void CarController::init(StmSystem &sys, CommandInterpreter& interpreter)
     extInt1.setCallback(&sys.mExtI);
     extInt1.enable();
 
-    sys.mSpi1.configDma(new Dma::Stream(sys.mDma2, Dma::Stream::StreamIndex::Stream3, Dma::Stream::ChannelIndex::Channel3,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA2_Stream3)),
-                         new Dma::Stream(sys.mDma2, Dma::Stream::StreamIndex::Stream2, Dma::Stream::ChannelIndex::Channel3,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA2_Stream2))
-                         );
+    sys.mSpi1.configDma(sys.mDmaManager.claim(DmaManager::Request::Spi1Tx, "SPI1 TX"), sys.mDmaManager.claim(DmaManager::Request::Spi1Rx, "SPI1 RX"));
     sys.mSpi1.setMasterSlave(Spi::MasterSlave::Master);
     sys.mSpi1.enable(Device::Part::All);
 
@@ -440,7 +437,7 @@ void CarController::init(StmSystem &sys, CommandInterpreter& interpreter)
     // acceleration sensor
     LIS302DL lis(spi1);
     lis.configInterrupt(new ExternalInterrupt::Line(sys.mExtI, 0), new ExternalInterrupt::Line(sys.mExtI, 1));
-    interpreter.add(new CmdLis(lis));
+    interpreter.add(new CmdLis(lis, &sys.mTelemetry));
 
     // clock command
     InterruptController::Line timer11Irq(sys.mNvic, StmSystem::InterruptIndex::TIM1_TRG_COM_TIM11);
@@ -468,11 +465,7 @@ void CarController::init(StmSystem &sys, CommandInterpreter& interpreter)
     sys.mGpioB.configOutput(Gpio::Index::Pin15, Gpio::OutputType::PushPull);
     sys.mGpioB.setAlternate(Gpio::Index::Pin15, Gpio::AltFunc::SPI2);
 
-    sys.mSpi2.configDma(new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream4, Dma::Stream::ChannelIndex::Channel0,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream4)),
-                         new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream3, Dma::Stream::ChannelIndex::Channel0,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream3))
-                         );
+    sys.mSpi2.configDma(sys.mDmaManager.claim(DmaManager::Request::Spi2Tx, "SPI2 TX"), sys.mDmaManager.claim(DmaManager::Request::Spi2Rx, "SPI2 RX"));
 
     // 74HC4052: 1x SPI3 -> 4x SPI
     sys.mRcc.enable(ClockControl::Function::GpioE);
@@ -524,11 +517,8 @@ void CarController::init(StmSystem &sys, CommandInterpreter& interpreter)
     sys.mGpioC.setAlternate(Gpio::Index::Pin12, Gpio::AltFunc::SPI3);
 
     sys.mRcc.enable(ClockControl::Function::Spi3);
-    sys.mSpi3.configDma(new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream5, Dma::Stream::ChannelIndex::Channel0,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream5)),
-                         new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream0, Dma::Stream::ChannelIndex::Channel0,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream0))
-                         );
+    // stream 5 of DMA1 is the one of USART2 RX, TX gets stream 7
+    sys.mSpi3.configDma(sys.mDmaManager.claim(DmaManager::Request::Spi3Tx, "SPI3 TX"), sys.mDmaManager.claim(DmaManager::Request::Spi3Rx, "SPI3 RX"));
     sys.mSpi3.setMasterSlave(Spi::MasterSlave::Master);
     sys.mSpi3.enable(Device::Part::All);
 
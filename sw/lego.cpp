@@ -21,11 +21,7 @@ void Lego::init(StmSystem &sys, CommandInterpreter &interpreter)
 //    sys.mGpioB.configOutput(Gpio::Index::Pin15, Gpio::OutputType::PushPull);
 //    sys.mGpioB.setAlternate(Gpio::Index::Pin15, Gpio::AltFunc::SPI2);
 
-//    sys.mSpi2.configDma(new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream4, Dma::Stream::ChannelIndex::Channel0,
-//                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream4)),
-//                         new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream3, Dma::Stream::ChannelIndex::Channel0,
-//                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream3))
-//                         );
+//    sys.mSpi2.configDma(sys.mDmaManager.claim(DmaManager::Request::Spi2Tx, "SPI2 TX"), sys.mDmaManager.claim(DmaManager::Request::Spi2Rx, "SPI2 RX"));
 //    sys.mSpi2.setMasterSlave(Spi::MasterSlave::Master);
 //    sys.mSpi2.enable(Device::Part::All);
 //    mSs = new Gpio::Pin(sys.mGpioB, Gpio::Index::Pin11);
@@ -41,11 +37,7 @@ void Lego::init(StmSystem &sys, CommandInterpreter &interpreter)
     sys.mGpioB.configOutput(Gpio::Index::Pin7, Gpio::OutputType::OpenDrain, Gpio::Pull::Up);
     sys.mGpioB.setAlternate(Gpio::Index::Pin7, Gpio::AltFunc::I2C1);
 
-    sys.mI2C1.configDma(new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream7, Dma::Stream::ChannelIndex::Channel1,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream7)),
-                         new Dma::Stream(sys.mDma1, Dma::Stream::StreamIndex::Stream0, Dma::Stream::ChannelIndex::Channel1,
-                                         new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::DMA1_Stream0))
-                         );
+    sys.mI2C1.configDma(sys.mDmaManager.claim(DmaManager::Request::I2c1Tx, "I2C1 TX"), sys.mDmaManager.claim(DmaManager::Request::I2c1Rx, "I2C1 RX"));
 
     sys.mI2C1.configInterrupt(new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::I2C1_EV), new InterruptController::Line(sys.mNvic, StmSystem::InterruptIndex::I2C1_ER));
     sys.mI2C1.enable(Device::All);
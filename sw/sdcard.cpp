@@ -120,7 +120,7 @@ SdCard::StateResult SdCard::interfaceCondition()
     {
         if (mStateData.lastResult == System::Event::Result::CommandTimeout)
         {
-            printf("V1 or no SD card.\n");
+            LOG_INFO("V1 or no SD card.");
             mCardInfo.mHcSupport = false;
             return StateResult::Continue;
         }
@@ -128,11 +128,11 @@ SdCard::StateResult SdCard::interfaceCondition()
         {
             if (mStateData.privateData.interfaceCondition.expectedResult == mSdio.shortResponse())
             {
-                printf("V2 or higher SD card.\n");
+                LOG_INFO("V2 or higher SD card.");
                 mCardInfo.mHcSupport = true;
                 return StateResult::Continue;
             }
-            printf("Expected response %08lx doesn't match actual response %08lx.\n", mStateData.privateData.interfaceCondition.expectedResult, mSdio.shortResponse());
+            LOG_ERROR("Expected response %08lx doesn't match actual response %08lx.", mStateData.privateData.interfaceCondition.expectedResult, mSdio.shortResponse());
             return StateResult::Stop;
         }
     }
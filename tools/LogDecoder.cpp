@@ -0,0 +1,193 @@
+#include "LogDecoder.h"
+
+#include <cstring>
+#include <elf.h>
+
+static const char SECTION[] = "logstr";
+
+LogDecoder::LogDecoder() :
+    mAddress(0),
+    mClock(0),
+    mLost(0)
+{
+}
+
+bool LogDecoder::readElf(const char *data, std::size_t size)
+{
+    // the firmware is 32 bit little endian, like the host
+    Elf32_Ehdr header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ident[EI_CLASS] != ELFCLASS32 || header.e_shentsize != sizeof(Elf32_Shdr)) return false;
+    if (header.e_shoff + header.e_shnum * sizeof(Elf32_Shdr) > size || header.e_shstrndx >= header.e_shnum) return false;
+
+    Elf32_Shdr names;
+    std::memcpy(&names, data + header.e_shoff + header.e_shstrndx * sizeof(Elf32_Shdr), sizeof(names));
+    for (unsigned int i = 0; i < header.e_shnum; ++i)
+    {
+        Elf32_Shdr section;
+        std::memcpy(&section, data + header.e_shoff + i * sizeof(Elf32_Shdr), sizeof(section));
+        if (names.sh_offset + section.sh_name + sizeof(SECTION) > size) continue;
+        if (std::memcmp(data + names.sh_offset + section.sh_name, SECTION, sizeof(SECTION)) != 0) continue;
+        if (section.sh_type != SHT_PROGBITS || section.sh_offset + section.sh_size > size) return false;
+        setStrings(data + section.sh_offset, section.sh_size, section.sh_addr);
+        return true;
+    }
+    return false;
+}
+
+void LogDecoder::setStrings(const char *data, std::size_t size, uint32_t address)
+{
+    mStrings.assign(data, size);
+    mAddress = address;
+}
+
+bool LogDecoder::decode(const char *data, std::size_t size)
+{
+    mEntries.clear();
+    const char* end = data + size;
+    const char* start = data;
+    while (end - start >= static_cast<std::ptrdiff_t>(sizeof(Log::Header)) && std::memcmp(start, Log::MAGIC, sizeof(Log::MAGIC)) != 0) ++start;
+    if (end - start < static_cast<std::ptrdiff_t>(sizeof(Log::Header))) return false;
+
+    Log::Header header;
+    std::memcpy(&header, start, sizeof(header));
+    start += sizeof(header);
+    if (static_cast<std::size_t>(end - start) < header.mCount * sizeof(uint32_t)) return false;
+    mClock = header.mClock;
+    mLost = header.mLost;
+    std::vector<uint32_t> words(header.mCount);
+    std::memcpy(words.data(), start, header.mCount * sizeof(uint32_t));
+
+    int64_t cycles = 0;
+    uint32_t last = 0;
+    for (unsigned int pos = 0; pos < words.size(); )
+    {
+        uint32_t recordHeader = words[pos];
+        unsigned int argWords = Log::recordArgWords(recordHeader);
+        Log::Level level = Log::recordLevel(recordHeader);
+        if (level < Log::Level::Error || level > Log::Level::Debug || pos + Log::RECORD_WORDS + argWords > words.size()) return false;
+        // records can be slightly out of order, so the difference is signed
+        if (pos != 0) cycles += static_cast<int32_t>(words[pos + 2] - last);
+        last = words[pos + 2];
+        Entry entry = { cycles, level, words[pos + 1], format(words[pos + 1], &words[pos + Log::RECORD_WORDS], argWords) };
+        mEntries.push_back(entry);
+        pos += Log::RECORD_WORDS + argWords;
+    }
+    return true;
+}
+
+void LogDecoder::write(FILE *out) const
+{
+    static const char LEVEL[] = "?EWID";
+    for (const Entry& entry : mEntries)
+    {
+        std::fprintf(out, "[%12.3f] %c %s\n", us(entry.mCycles), LEVEL[static_cast<unsigned int>(entry.mLevel)], entry.mText.c_str());
+    }
+}
+
+std::string LogDecoder::format(uint32_t address, const uint32_t *args, unsigned int count) const
+{
+    char buffer[64];
+    if (address - mAddress >= mStrings.size())
+    {
+        std::sprintf(buffer, "<unknown format 0x%08x>", address);
+        return buffer;
+    }
+    const char* f = mStrings.c_str() + (address - mAddress);
+    const uint32_t* end = args + count;
+    std::string text;
+    while (*f != '\0')
+    {
+        if (*f != '%')
+        {
+            text += *f++;
+            continue;
+        }
+        if (f[1] == '%')
+        {
+            text += '%';
+            f += 2;
+            continue;
+        }
+        // the conversion without its length, a * is replaced by the value
+        std::string spec(1, *f++);
+        while (*f != '\0' && std::strchr("-+ #0", *f) != nullptr) spec += *f++;
+        for (int i = 0; i < 2; ++i)
+        {
+            if (i == 1)
+            {
+                if (*f != '.') break;
+                spec += *f++;
+            }
+            if (*f == '*')
+            {
+                ++f;
+                if (args < end) spec += std::to_string(static_cast<int32_t>(*args++));
+            }
+            while (*f >= '0' && *f <= '9') spec += *f++;
+        }
+        unsigned int longs = 0;
+        while (*f != '\0' && std::strchr("hljztL", *f) != nullptr)
+        {
+            if (*f++ == 'l') ++longs;
+        }
+        char conversion = *f;
+        if (conversion == '\0') break;
+        ++f;
+        bool wide = longs >= 2 || std::strchr("fFeEgGaA", conversion) != nullptr;
+        if (args + (wide ? 2 : 1) > end)
+        {
+            text += "<missing>";
+            continue;
+        }
+        uint64_t value = wide ? args[0] | static_cast<uint64_t>(args[1]) << 32 : args[0];
+        args += wide ? 2 : 1;
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            spec += "lld";
+            std::snprintf(buffer, sizeof(buffer), spec.c_str(), wide ? static_cast<long long>(value) : static_cast<long long>(static_cast<int32_t>(value)));
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            spec += "ll";
+            spec += conversion;
+            std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<unsigned long long>(value));
+            break;
+        case 'c':
+            spec += 'c';
+            std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<int>(value));
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            double d;
+            std::memcpy(&d, &value, sizeof(d));
+            spec += conversion;
+            std::snprintf(buffer, sizeof(buffer), spec.c_str(), d);
+            break;
+        }
+        case 's':
+            // the string stayed in the RAM of the STM32
+            std::snprintf(buffer, sizeof(buffer), "<string 0x%08x>", static_cast<uint32_t>(value));
+            break;
+        default:
+            std::snprintf(buffer, sizeof(buffer), "0x%08x", static_cast<uint32_t>(value));
+            break;
+        }
+        text += buffer;
+    }
+    // one line per record
+    while (!text.empty() && text[text.size() - 1] == '\n') text.erase(text.size() - 1);
+    return text;
+}
@@ -0,0 +1,49 @@
+#ifndef LOGDECODER_H
+#define LOGDECODER_H
+
+#include "../Log.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Reads a dump of the log command and turns it into text with the format strings of the firmware
+class LogDecoder
+{
+public:
+    struct Entry
+    {
+        // since the first record, the 32 bit counter is unwrapped
+        int64_t mCycles;
+        Log::Level mLevel;
+        uint32_t mFormat;
+        std::string mText;
+    };
+
+    LogDecoder();
+
+    // takes the format strings from the section logstr of the ELF file, false if there is none
+    bool readElf(const char* data, std::size_t size);
+    // the format strings are at address in the firmware
+    void setStrings(const char* data, std::size_t size, uint32_t address);
+    // the dump can be surrounded by console output, false if there is none or it is cut off
+    bool decode(const char* data, std::size_t size);
+    void write(FILE* out) const;
+
+    const std::vector<Entry>& entries() const { return mEntries; }
+    uint32_t clock() const { return mClock; }
+    uint32_t lost() const { return mLost; }
+    double us(int64_t cycles) const { return mClock != 0 ? cycles * 1000000.0 / mClock : 0; }
+
+private:
+    std::string mStrings;
+    uint32_t mAddress;
+    std::vector<Entry> mEntries;
+    uint32_t mClock;
+    uint32_t mLost;
+
+    std::string format(uint32_t address, const uint32_t* args, unsigned int count) const;
+};
+
+#endif // LOGDECODER_H
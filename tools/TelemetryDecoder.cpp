@@ -0,0 +1,85 @@
+#include "TelemetryDecoder.h"
+
+TelemetryDecoder::TelemetryDecoder() :
+    mHaveSequence(false),
+    mNextSequence(0),
+    mLost(0),
+    mCrcErrors(0)
+{
+}
+
+void TelemetryDecoder::decode(const char *data, std::size_t size)
+{
+    for (const char* end = data + size; data != end; ++data)
+    {
+        if (*data != 0)
+        {
+            mPending += *data;
+            continue;
+        }
+        if (!mPending.empty()) segment(mPending);
+        mPending.clear();
+    }
+}
+
+void TelemetryDecoder::finish()
+{
+    mText += mPending;
+    mPending.clear();
+}
+
+void TelemetryDecoder::segment(const std::string &data)
+{
+    std::vector<uint8_t> frame(data.size());
+    int len = Cobs::decode(reinterpret_cast<const uint8_t*>(data.data()), data.size(), frame.data());
+    if (len >= static_cast<int>(Telemetry::HEADER_SIZE + Telemetry::CRC_SIZE))
+    {
+        len -= Telemetry::CRC_SIZE;
+        uint32_t crc = Crc::word(&frame[len]);
+        if (crc == Crc().compute(frame.data(), len))
+        {
+            Frame result = { static_cast<Telemetry::Type>(frame[0]), frame[1],
+                             std::vector<uint8_t>(frame.begin() + Telemetry::HEADER_SIZE, frame.begin() + len) };
+            if (mHaveSequence) mLost += static_cast<uint8_t>(result.mSequence - mNextSequence);
+            mHaveSequence = true;
+            mNextSequence = result.mSequence + 1;
+            mFrames.push_back(result);
+            return;
+        }
+    }
+    // the shell only writes text, anything else is what's left of a frame
+    for (char c : data)
+    {
+        if ((c < ' ' && c != '\n' && c != '\r' && c != '\t' && c != '\x1b') || c == '\x7f')
+        {
+            ++mCrcErrors;
+            return;
+        }
+    }
+    mText += data;
+}
+
+void TelemetryDecoder::write(FILE *out, const TelemetryDecoder::Frame &frame) const
+{
+    const std::vector<uint8_t>& p = frame.mPayload;
+    std::fprintf(out, "#%u", frame.mSequence);
+    switch (frame.mType)
+    {
+    case Telemetry::Type::Acceleration:
+        std::fprintf(out, " acceleration");
+        for (unsigned int i = 0; i + 3 <= p.size(); i += 3)
+        {
+            std::fprintf(out, " %d/%d/%d", static_cast<int8_t>(p[i]), static_cast<int8_t>(p[i + 1]), static_cast<int8_t>(p[i + 2]));
+        }
+        break;
+    case Telemetry::Type::Distance:
+        std::fprintf(out, " distance");
+        for (unsigned int i = 0; i + 4 <= p.size(); i += 4) std::fprintf(out, " %umm", Crc::word(&p[i]));
+        break;
+    default:
+        std::fprintf(out, " type %u", static_cast<unsigned int>(frame.mType));
+        for (uint8_t b : p) std::fprintf(out, " %02x", b);
+        break;
+    }
+    std::fprintf(out, "\n");
+}
@@ -0,0 +1,47 @@
+#ifndef TELEMETRYDECODER_H
+#define TELEMETRYDECODER_H
+
+#include "../Telemetry.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Splits what came over the console line into the telemetry frames and the text of the shell
+class TelemetryDecoder
+{
+public:
+    struct Frame
+    {
+        Telemetry::Type mType;
+        uint8_t mSequence;
+        std::vector<uint8_t> mPayload;
+    };
+
+    TelemetryDecoder();
+
+    // can be fed in pieces, what isn't complete at the end waits for the next call or finish()
+    void decode(const char* data, std::size_t size);
+    void finish();
+    void write(FILE* out, const Frame& frame) const;
+
+    const std::vector<Frame>& frames() const { return mFrames; }
+    const std::string& text() const { return mText; }
+    // frames missing in the sequence and ones that got broken on the way
+    unsigned int lost() const { return mLost; }
+    unsigned int crcErrors() const { return mCrcErrors; }
+
+private:
+    std::string mPending;
+    std::vector<Frame> mFrames;
+    std::string mText;
+    bool mHaveSequence;
+    uint8_t mNextSequence;
+    unsigned int mLost;
+    unsigned int mCrcErrors;
+
+    void segment(const std::string& data);
+};
+
+#endif // TELEMETRYDECODER_H
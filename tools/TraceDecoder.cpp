@@ -0,0 +1,111 @@
+#include "TraceDecoder.h"
+
+#include <cstring>
+#include <deque>
+#include <map>
+
+TraceDecoder::TraceDecoder() :
+    mClock(0),
+    mLost(0)
+{
+}
+
+bool TraceDecoder::decode(const char *data, std::size_t size)
+{
+    mEntries.clear();
+    const char* end = data + size;
+    const char* start = data;
+    while (end - start >= static_cast<std::ptrdiff_t>(sizeof(Trace::Header)) && std::memcmp(start, Trace::MAGIC, sizeof(Trace::MAGIC)) != 0) ++start;
+    if (end - start < static_cast<std::ptrdiff_t>(sizeof(Trace::Header))) return false;
+
+    Trace::Header header;
+    std::memcpy(&header, start, sizeof(header));
+    start += sizeof(header);
+    if (static_cast<std::size_t>(end - start) < header.mCount * sizeof(Trace::Record)) return false;
+    mClock = header.mClock;
+    mLost = header.mLost;
+
+    int64_t cycles = 0;
+    uint32_t last = 0;
+    for (unsigned int i = 0; i < header.mCount; ++i)
+    {
+        Trace::Record record;
+        std::memcpy(&record, start + i * sizeof(record), sizeof(record));
+        // records can be slightly out of order, so the difference is signed
+        if (i != 0) cycles += static_cast<int32_t>(record.mCycles - last);
+        last = record.mCycles;
+        Entry entry = { cycles, record.type(), record.data() };
+        if (entry.mType == Trace::Type::EventPost || entry.mType == Trace::Type::EventDispatch || entry.mType == Trace::Type::EventDone)
+        {
+            entry.mData = Trace::address(entry.mData);
+        }
+        mEntries.push_back(entry);
+    }
+    return true;
+}
+
+static void interruptName(char* name, uint32_t exception)
+{
+    if (exception == 15) std::sprintf(name, "SysTick");
+    else if (exception >= 16) std::sprintf(name, "IRQ %u", exception - 16);
+    else std::sprintf(name, "exception %u", exception);
+}
+
+void TraceDecoder::writeJson(FILE *out) const
+{
+    enum { EVENT_THREAD, INTERRUPT_THREAD };
+    std::fprintf(out, "{\"otherData\":{\"clock\":%u,\"lost\":%u},\"traceEvents\":[\n", mClock, mLost);
+    std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"events\"}},\n", EVENT_THREAD);
+    std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"interrupts\"}}", INTERRUPT_THREAD);
+
+    // the ring can start in the middle of anything, ends without a begin are dropped
+    unsigned int eventDepth = 0;
+    unsigned int interruptDepth = 0;
+    std::map<uint32_t, std::deque<int64_t> > posted;
+    for (const Entry& entry : mEntries)
+    {
+        char name[32];
+        double ts = us(entry.mCycles);
+        switch (entry.mType)
+        {
+        case Trace::Type::InterruptEnter:
+            ++interruptDepth;
+            interruptName(name, entry.mData);
+            std::fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"interrupt\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", name, ts, INTERRUPT_THREAD);
+            break;
+        case Trace::Type::InterruptExit:
+            if (interruptDepth == 0) break;
+            --interruptDepth;
+            std::fprintf(out, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, INTERRUPT_THREAD);
+            break;
+        case Trace::Type::EventPost:
+            posted[entry.mData].push_back(entry.mCycles);
+            std::fprintf(out, ",\n{\"name\":\"post 0x%08x\",\"cat\":\"event\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                         entry.mData, ts, interruptDepth != 0 ? INTERRUPT_THREAD : EVENT_THREAD);
+            break;
+        case Trace::Type::EventDispatch:
+        {
+            ++eventDepth;
+            std::fprintf(out, ",\n{\"name\":\"event 0x%08x\",\"cat\":\"event\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%u", entry.mData, ts, EVENT_THREAD);
+            std::deque<int64_t>& queue = posted[entry.mData];
+            if (!queue.empty())
+            {
+                std::fprintf(out, ",\"args\":{\"latency_us\":%.3f}", us(entry.mCycles - queue.front()));
+                queue.pop_front();
+            }
+            std::fprintf(out, "}");
+            break;
+        }
+        case Trace::Type::EventDone:
+            if (eventDepth == 0) break;
+            --eventDepth;
+            std::fprintf(out, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, EVENT_THREAD);
+            break;
+        case Trace::Type::Marker:
+            std::fprintf(out, ",\n{\"name\":\"marker %u\",\"cat\":\"marker\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                         entry.mData, ts, interruptDepth != 0 ? INTERRUPT_THREAD : EVENT_THREAD);
+            break;
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+}
@@ -0,0 +1,39 @@
+#ifndef TRACEDECODER_H
+#define TRACEDECODER_H
+
+#include "../Trace.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Reads a dump of the trace command and writes it as Chrome trace JSON
+class TraceDecoder
+{
+public:
+    struct Entry
+    {
+        // since the first record, the 32 bit counter is unwrapped
+        int64_t mCycles;
+        Trace::Type mType;
+        uint32_t mData;
+    };
+
+    TraceDecoder();
+
+    // the dump can be surrounded by console output, false if there is none or it is cut off
+    bool decode(const char* data, std::size_t size);
+    void writeJson(FILE* out) const;
+
+    const std::vector<Entry>& entries() const { return mEntries; }
+    uint32_t clock() const { return mClock; }
+    uint32_t lost() const { return mLost; }
+    double us(int64_t cycles) const { return mClock != 0 ? cycles * 1000000.0 / mClock : 0; }
+
+private:
+    std::vector<Entry> mEntries;
+    uint32_t mClock;
+    uint32_t mLost;
+};
+
+#endif // TRACEDECODER_H
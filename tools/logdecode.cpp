@@ -0,0 +1,48 @@
+#include "LogDecoder.h"
+
+#include <cstdio>
+#include <vector>
+
+static bool readFile(const char* name, std::vector<char>& data)
+{
+    FILE* in = std::fopen(name, "rb");
+    if (in == nullptr)
+    {
+        std::perror(name);
+        return false;
+    }
+    char buffer[4096];
+    std::size_t len;
+    while ((len = std::fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + len);
+    std::fclose(in);
+    return true;
+}
+
+// Turns the output of the log command into text, with the format strings from the firmware it was made by.
+// Capture the console for example with "picocom -b 921600 --logfile dump /dev/ttyUSB0".
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "Usage: %s <example.elf> <dump>\n", argv[0]);
+        return 1;
+    }
+    std::vector<char> elf;
+    std::vector<char> dump;
+    if (!readFile(argv[1], elf) || !readFile(argv[2], dump)) return 1;
+
+    LogDecoder decoder;
+    if (!decoder.readElf(elf.data(), elf.size()))
+    {
+        std::fprintf(stderr, "%s: no format strings found\n", argv[1]);
+        return 1;
+    }
+    if (!decoder.decode(dump.data(), dump.size()))
+    {
+        std::fprintf(stderr, "%s: no complete log dump found\n", argv[2]);
+        return 1;
+    }
+    decoder.write(stdout);
+    std::fprintf(stderr, "%zu records, %u lost, %u Hz\n", decoder.entries().size(), decoder.lost(), decoder.clock());
+    return 0;
+}
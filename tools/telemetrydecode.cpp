@@ -0,0 +1,31 @@
+#include "TelemetryDecoder.h"
+
+#include <cstdio>
+
+// Shows the telemetry frames in a capture of the console, for example made with
+// "picocom -b 921600 --logfile capture /dev/ttyUSB0", the text of the shell goes to stderr.
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "Usage: %s <capture>\n", argv[0]);
+        return 1;
+    }
+    FILE* in = std::fopen(argv[1], "rb");
+    if (in == nullptr)
+    {
+        std::perror(argv[1]);
+        return 1;
+    }
+    TelemetryDecoder decoder;
+    char buffer[4096];
+    std::size_t len;
+    while ((len = std::fread(buffer, 1, sizeof(buffer), in)) > 0) decoder.decode(buffer, len);
+    std::fclose(in);
+    decoder.finish();
+
+    for (const TelemetryDecoder::Frame& frame : decoder.frames()) decoder.write(stdout, frame);
+    std::fprintf(stderr, "%s", decoder.text().c_str());
+    std::fprintf(stderr, "%zu frames, %u lost, %u CRC errors\n", decoder.frames().size(), decoder.lost(), decoder.crcErrors());
+    return 0;
+}
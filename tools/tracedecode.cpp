@@ -0,0 +1,43 @@
+#include "TraceDecoder.h"
+
+#include <cstdio>
+#include <vector>
+
+// Turns the output of the trace command into a Chrome trace, to be opened with chrome://tracing or
+// ui.perfetto.dev. Capture the console for example with "picocom -b 921600 --logfile dump /dev/ttyUSB0".
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::fprintf(stderr, "Usage: %s <dump> [<trace.json>]\n", argv[0]);
+        return 1;
+    }
+    FILE* in = std::fopen(argv[1], "rb");
+    if (in == nullptr)
+    {
+        std::perror(argv[1]);
+        return 1;
+    }
+    std::vector<char> data;
+    char buffer[4096];
+    std::size_t len;
+    while ((len = std::fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + len);
+    std::fclose(in);
+
+    TraceDecoder decoder;
+    if (!decoder.decode(data.data(), data.size()))
+    {
+        std::fprintf(stderr, "%s: no complete trace dump found\n", argv[1]);
+        return 1;
+    }
+    FILE* out = argc == 3 ? std::fopen(argv[2], "w") : stdout;
+    if (out == nullptr)
+    {
+        std::perror(argv[2]);
+        return 1;
+    }
+    decoder.writeJson(out);
+    if (out != stdout) std::fclose(out);
+    std::fprintf(stderr, "%zu records, %u lost, %u Hz\n", decoder.entries().size(), decoder.lost(), decoder.clock());
+    return 0;
+}